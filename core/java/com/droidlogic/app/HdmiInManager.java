@@ -18,6 +18,17 @@ public class HdmiInManager {
     private Context mContext = null;
 
     private SystemControlManager mSystenControl;
+    private OnSignalChangeListener mSignalListener = null;
+
+    /**
+     * Called from a native monitor thread whenever the HDMI-IN signal or
+     * audio rate changes, while HDMI-IN is initialized. The getters then
+     * return the new state without touching sysfs.
+     * @hide
+     */
+    public interface OnSignalChangeListener {
+        void onSignalChanged();
+    }
 
     static {
         System.loadLibrary("hdmiin");
@@ -41,6 +52,19 @@ public class HdmiInManager {
             _init(source, isFullscreen);
     }
 
+    /**
+     * @hide
+     */
+    public void setOnSignalChangeListener(OnSignalChangeListener listener) {
+        mSignalListener = listener;
+    }
+
+    private void onNativeSignalChanged() {
+        OnSignalChangeListener listener = mSignalListener;
+        if (listener != null)
+            listener.onSignalChanged();
+    }
+
     /**
      * @hide
      */
@@ -185,6 +209,18 @@ public class HdmiInManager {
         return ret;
     }
 
+    /**
+     * @hide
+     * @return {capture to render delay us, target buffering us, underruns, overruns},
+     * or null when HDMI-IN audio is not running
+     */
+    public int[] getAudioLatency() {
+        int[] ret = null;
+        if (getHdmiInEnable())
+            ret = _getAudioLatency();
+        return ret;
+    }
+
     /**
      * @hide
      */
@@ -359,6 +395,7 @@ public class HdmiInManager {
     private native boolean _hdmiSignal();
     private native void _enableAudio(int flag);
     private native int _handleAudio();
+    private native int[] _getAudioLatency();
     private native void _startMonitorUsbHostBusThread();
     private native int _setAmaudioMusicGain(int gain);
     private native int _setAmaudioLeftGain(int gain);
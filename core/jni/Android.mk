@@ -8,6 +8,10 @@ LOCAL_SRC_FILES:= \
     onload.cpp \
     HDMIIN/audio_utils_ctl.cpp \
     HDMIIN/mAlsa.cpp \
+    HDMIIN/audio_drift_ctl.cpp \
+    HDMIIN/audio_noise_gate.cpp \
+    HDMIIN/hdmiin_monitor.cpp \
+    HDMIIN/vfm_map.cpp \
     HDMIIN/audiodsp_ctl.cpp \
 
 LOCAL_C_INCLUDES += \
@@ -60,6 +64,8 @@ endif
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(LOCAL_PATH)/HDMIIN/tests/Android.mk
+
 endif
 
 include $(CLEAR_VARS)
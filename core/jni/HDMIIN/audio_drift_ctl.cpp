@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     AMLOGIC AUDIO_DRIFT_CTL
+ */
+
+#include <string.h>
+
+#include "audio_drift_ctl.h"
+
+/*
+ * PI gains on the normalized fill error (fill - target) / target.
+ * KP reaches the ratio limit when the ring is ~1/6 away from its target,
+ * KI is applied per rendered frame and settles a constant drift within a
+ * few minutes without ringing.
+ */
+#define DRIFT_KP                (3e-3f)
+#define DRIFT_KI                (9e-10f)
+#define DRIFT_MAX_RATIO         (AUDIO_DRIFT_MAX_PPM * 1e-6f)
+/* time constant of the fill level low-pass, in frames (~1s at 48kHz) */
+#define DRIFT_FILL_AVG_FRAMES   (48000)
+
+/* target occupancy steps of the latency tuner, in samples */
+#define TUNER_STEP_DOWN         (256)
+#define TUNER_STEP_UP           (2048)
+/* clean playback time before shrinking, doubled after every underrun */
+#define TUNER_HOLD_NS           (10LL * 1000000000LL)
+#define TUNER_HOLD_MAX_NS       (320LL * 1000000000LL)
+
+static float clampf(float v, float lo, float hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static short cubic(short p0, short p1, short p2, short p3, float t) {
+    float v = p1 + 0.5f * t * (p2 - p0 + t * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3
+            + t * (3.0f * (p1 - p2) + p3 - p0)));
+
+    return (short)clampf(v, -32768.0f, 32767.0f);
+}
+
+void AudioDriftInit(audio_drift_ctl_t *ctl, int target_fill) {
+    memset(ctl, 0, sizeof(*ctl));
+    ctl->target_fill = target_fill;
+    AudioDriftReset(ctl);
+}
+
+void AudioDriftReset(audio_drift_ctl_t *ctl) {
+    ctl->fill_avg = (float)ctl->target_fill;
+    ctl->ratio = 1.0f + ctl->integral;
+    ctl->frac = 0.0f;
+    memset(ctl->hist, 0, sizeof(ctl->hist));
+}
+
+static void AudioDriftUpdate(audio_drift_ctl_t *ctl, int avail, int out_frames) {
+    float alpha = (float)out_frames / (out_frames + DRIFT_FILL_AVG_FRAMES);
+    float err;
+
+    ctl->fill_avg += ((float)avail - ctl->fill_avg) * alpha;
+    err = (ctl->fill_avg - ctl->target_fill) / ctl->target_fill;
+
+    ctl->integral = clampf(ctl->integral + DRIFT_KI * err * out_frames,
+            -DRIFT_MAX_RATIO, DRIFT_MAX_RATIO);
+    ctl->ratio = 1.0f + clampf(DRIFT_KP * err + ctl->integral,
+            -DRIFT_MAX_RATIO, DRIFT_MAX_RATIO);
+}
+
+int AudioDriftRead(audio_drift_ctl_t *ctl, short *ring, int ring_size,
+        int *read_idx, int avail, short *out, int out_frames) {
+    int idx = *read_idx;
+    int consumed = 0;
+    int need;
+
+    AudioDriftUpdate(ctl, avail, out_frames);
+
+    need = ((int)(ctl->frac + ctl->ratio * out_frames) + 1) * AUDIO_DRIFT_CHANNELS;
+    if (need > avail) {
+        ctl->resets++;
+        return -1;
+    }
+
+    for (int i = 0; i < out_frames; i++) {
+        while (ctl->frac >= 1.0f) {
+            memmove(ctl->hist[0], ctl->hist[1], 3 * sizeof(ctl->hist[0]));
+            for (int ch = 0; ch < AUDIO_DRIFT_CHANNELS; ch++) {
+                ctl->hist[3][ch] = ring[idx];
+                ring[idx] = 0;
+                if (++idx == ring_size)
+                    idx = 0;
+            }
+            consumed += AUDIO_DRIFT_CHANNELS;
+            ctl->frac -= 1.0f;
+        }
+        for (int ch = 0; ch < AUDIO_DRIFT_CHANNELS; ch++) {
+            out[i * AUDIO_DRIFT_CHANNELS + ch] = cubic(ctl->hist[0][ch], ctl->hist[1][ch],
+                    ctl->hist[2][ch], ctl->hist[3][ch], ctl->frac);
+        }
+        ctl->frac += ctl->ratio;
+    }
+
+    *read_idx = idx;
+    return consumed;
+}
+
+void AudioLatencyTunerInit(audio_latency_tuner_t *tuner, int min_fill, int max_fill, int target) {
+    memset(tuner, 0, sizeof(*tuner));
+    tuner->min_fill = min_fill;
+    tuner->max_fill = max_fill;
+    tuner->target = target;
+    tuner->hold_ns = TUNER_HOLD_NS;
+    tuner->last_change_ns = -1;
+}
+
+int AudioLatencyTunerUpdate(audio_latency_tuner_t *tuner, long long now_ns, int underrun) {
+    if (tuner->last_change_ns < 0)
+        tuner->last_change_ns = now_ns;
+
+    if (underrun) {
+        tuner->underruns++;
+        tuner->target += TUNER_STEP_UP;
+        if (tuner->target > tuner->max_fill)
+            tuner->target = tuner->max_fill;
+        tuner->hold_ns *= 2;
+        if (tuner->hold_ns > TUNER_HOLD_MAX_NS)
+            tuner->hold_ns = TUNER_HOLD_MAX_NS;
+        tuner->last_change_ns = now_ns;
+    } else if (now_ns - tuner->last_change_ns >= tuner->hold_ns) {
+        tuner->target -= TUNER_STEP_DOWN;
+        if (tuner->target < tuner->min_fill)
+            tuner->target = tuner->min_fill;
+        tuner->last_change_ns = now_ns;
+    }
+
+    return tuner->target;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     AMLOGIC AUDIO_DRIFT_CTL
+ *
+ *     Keeps the HDMI-IN capture ring near its target occupancy by slightly
+ *     resampling (at most +/-500ppm) the data handed to the AudioTrack,
+ *     instead of dropping the ring content when the capture and playback
+ *     clocks drift apart. The latency tuner moves that target occupancy
+ *     down while playback runs clean and back up after an underrun.
+ */
+
+#ifndef __AUDIO_DRIFT_CTL_H__
+#define __AUDIO_DRIFT_CTL_H__
+
+#define AUDIO_DRIFT_CHANNELS                (2)
+#define AUDIO_DRIFT_MAX_PPM                 (500)
+
+typedef struct audio_drift_ctl {
+    int target_fill;        /* ring occupancy to hold, in samples */
+    float fill_avg;         /* low-passed ring occupancy, in samples */
+    float integral;         /* integral term of the PI controller */
+    float ratio;            /* input frames consumed per output frame */
+    float frac;             /* position between hist[1] and hist[2] */
+    short hist[4][AUDIO_DRIFT_CHANNELS];
+    unsigned int resets;
+} audio_drift_ctl_t;
+
+typedef struct audio_latency_tuner {
+    int min_fill;           /* bounds of the target occupancy, in samples */
+    int max_fill;
+    int target;
+    long long hold_ns;      /* clean playback needed before the next shrink */
+    long long last_change_ns;
+    unsigned int underruns;
+} audio_latency_tuner_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void AudioDriftInit(audio_drift_ctl_t *ctl, int target_fill);
+void AudioDriftReset(audio_drift_ctl_t *ctl);
+/*
+ * Render out_frames stereo frames into out from the ring starting at
+ * *read_idx, where avail samples are readable. Consumed samples are zeroed
+ * and *read_idx is advanced. Returns the number of samples consumed, or -1
+ * when the ring does not hold enough data and the caller has to reset it.
+ */
+int AudioDriftRead(audio_drift_ctl_t *ctl, short *ring, int ring_size,
+        int *read_idx, int avail, short *out, int out_frames);
+
+void AudioLatencyTunerInit(audio_latency_tuner_t *tuner, int min_fill, int max_fill, int target);
+/*
+ * Feed one tracker callback. Returns the ring occupancy the drift
+ * controller should hold from now on.
+ */
+int AudioLatencyTunerUpdate(audio_latency_tuner_t *tuner, long long now_ns, int underrun);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     AMLOGIC AUDIO_NOISE_GATE
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "audio_noise_gate.h"
+
+void AudioNoiseGateRefInit(audio_noise_gate_ref_t *gate, int thresh) {
+    memset(gate, 0, sizeof(*gate));
+    gate->thresh = thresh;
+}
+
+void AudioNoiseGateProcessRef(audio_noise_gate_ref_t *gate, short *buf, int frames) {
+    for (int i = 0; i < frames; i++) {
+        for (int ch = 0; ch < 2; ch++) {
+            int level = abs(buf[2 * i + ch]);
+
+            gate->sum[ch] += level - gate->history[ch][gate->pos];
+            gate->history[ch][gate->pos] = level;
+
+            if ((gate->sum[ch] >> NOISE_GATE_HISTORY_BASE) <= gate->thresh) {
+                if (gate->zero_count[ch] < NOISE_GATE_HOLD)
+                    gate->zero_count[ch]++;
+            } else {
+                gate->zero_count[ch] = 0;
+            }
+            gate->gated[ch] = gate->zero_count[ch] >= NOISE_GATE_HOLD;
+
+            if (gate->gated[ch])
+                buf[2 * i + ch] = 0;
+        }
+        gate->pos = (gate->pos + 1) & (NOISE_GATE_HISTORY_NUM - 1);
+    }
+}
+
+void AudioNoiseGateInit(audio_noise_gate_t *gate, int thresh) {
+    memset(gate, 0, sizeof(*gate));
+    gate->thresh = thresh;
+    gate->gain[0] = NOISE_GATE_UNITY;
+    gate->gain[1] = NOISE_GATE_UNITY;
+}
+
+/* sum of |sample| per channel over frames interleaved stereo frames */
+static void BlockLevel(const short *buf, int frames, int *left, int *right) {
+    int l = 0, r = 0;
+    int i = 0;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    int32x4_t acc_l = vdupq_n_s32(0);
+    int32x4_t acc_r = vdupq_n_s32(0);
+    int32x2_t sum;
+
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(buf + 2 * i);
+        acc_l = vpadalq_s16(acc_l, vqabsq_s16(v.val[0]));
+        acc_r = vpadalq_s16(acc_r, vqabsq_s16(v.val[1]));
+    }
+    sum = vpadd_s32(vadd_s32(vget_low_s32(acc_l), vget_high_s32(acc_l)),
+            vadd_s32(vget_low_s32(acc_r), vget_high_s32(acc_r)));
+    l = vget_lane_s32(sum, 0);
+    r = vget_lane_s32(sum, 1);
+#endif
+
+    for (; i < frames; i++) {
+        l += abs(buf[2 * i]);
+        r += abs(buf[2 * i + 1]);
+    }
+
+    *left += l;
+    *right += r;
+}
+
+static void ApplyGain(audio_noise_gate_t *gate, short *buf, int frames) {
+    if (gate->gain_step[0] == 0 && gate->gain_step[1] == 0) {
+        if (gate->gain[0] == NOISE_GATE_UNITY && gate->gain[1] == NOISE_GATE_UNITY)
+            return;
+        if (gate->gain[0] == 0 && gate->gain[1] == 0) {
+            memset(buf, 0, frames * 2 * sizeof(short));
+            return;
+        }
+    }
+
+    for (int ch = 0; ch < 2; ch++) {
+        int gain = gate->gain[ch];
+        int step = gate->gain_step[ch];
+
+        if (step == 0 && gain == NOISE_GATE_UNITY)
+            continue;
+        for (int i = 0; i < frames; i++) {
+            gain += step;
+            buf[2 * i + ch] = (short)((buf[2 * i + ch] * gain) >> 15);
+        }
+        gate->gain[ch] = gain;
+    }
+}
+
+static void EndBlock(audio_noise_gate_t *gate) {
+    for (int ch = 0; ch < 2; ch++) {
+        int target;
+
+        gate->sum[ch] += gate->block_sum[ch] - gate->history[ch][gate->pos];
+        gate->history[ch][gate->pos] = gate->block_sum[ch];
+        gate->block_sum[ch] = 0;
+
+        if ((gate->sum[ch] >> NOISE_GATE_HISTORY_BASE) <= gate->thresh) {
+            gate->zero_count[ch] += NOISE_GATE_BLOCK;
+            if (gate->zero_count[ch] > NOISE_GATE_HOLD)
+                gate->zero_count[ch] = NOISE_GATE_HOLD;
+        } else {
+            gate->zero_count[ch] = 0;
+        }
+        gate->gated[ch] = gate->zero_count[ch] >= NOISE_GATE_HOLD;
+
+        // the previous ramp has just completed, start the next one so that
+        // the gain reaches its target at the end of the coming block
+        target = gate->gated[ch] ? 0 : NOISE_GATE_UNITY;
+        gate->gain_step[ch] = (target - gate->gain[ch]) >> NOISE_GATE_BLOCK_BASE;
+    }
+    gate->pos = (gate->pos + 1) & (NOISE_GATE_BLOCK_NUM - 1);
+    gate->block_fill = 0;
+}
+
+void AudioNoiseGateProcess(audio_noise_gate_t *gate, short *buf, int frames) {
+    while (frames > 0) {
+        int n = NOISE_GATE_BLOCK - gate->block_fill;
+
+        if (n > frames)
+            n = frames;
+
+        BlockLevel(buf, n, &gate->block_sum[0], &gate->block_sum[1]);
+        ApplyGain(gate, buf, n);
+
+        gate->block_fill += n;
+        buf += 2 * n;
+        frames -= n;
+
+        if (gate->block_fill == NOISE_GATE_BLOCK)
+            EndBlock(gate);
+    }
+}
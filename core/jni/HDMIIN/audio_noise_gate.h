@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     AMLOGIC AUDIO_NOISE_GATE
+ *
+ *     Mutes a channel of the HDMI-IN stream once its average level over the
+ *     last HISTORY_NUM samples stayed at or below the threshold for NOISE_HIS
+ *     samples, and opens it again as soon as the level rises.
+ *
+ *     AudioNoiseGateProcessRef() keeps the per-sample algorithm as the
+ *     reference. AudioNoiseGateProcess() takes the same decisions once per
+ *     NOISE_GATE_BLOCK frames from SIMD block energies and ramps the gain
+ *     over one block instead of switching it on a sample.
+ */
+
+#ifndef __AUDIO_NOISE_GATE_H__
+#define __AUDIO_NOISE_GATE_H__
+
+#define NOISE_GATE_HISTORY_BASE     (12)
+#define NOISE_GATE_HISTORY_NUM      (1 << NOISE_GATE_HISTORY_BASE)
+#define NOISE_GATE_BLOCK_BASE       (6)
+#define NOISE_GATE_BLOCK            (1 << NOISE_GATE_BLOCK_BASE)
+#define NOISE_GATE_BLOCK_NUM        (NOISE_GATE_HISTORY_NUM / NOISE_GATE_BLOCK)
+#define NOISE_GATE_HOLD             (48000 * 5)
+#define NOISE_GATE_UNITY            (1 << 15)
+
+typedef struct audio_noise_gate_ref {
+    int thresh;
+    int history[2][NOISE_GATE_HISTORY_NUM];
+    int sum[2];
+    unsigned int pos;
+    unsigned int zero_count[2];
+    int gated[2];
+} audio_noise_gate_ref_t;
+
+typedef struct audio_noise_gate {
+    int thresh;
+    int history[2][NOISE_GATE_BLOCK_NUM];   /* per block level sums */
+    int sum[2];
+    int block_sum[2];
+    unsigned int pos;
+    unsigned int block_fill;                /* frames in the current block */
+    unsigned int zero_count[2];
+    int gated[2];
+    int gain[2];                            /* Q15 */
+    int gain_step[2];
+} audio_noise_gate_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void AudioNoiseGateRefInit(audio_noise_gate_ref_t *gate, int thresh);
+void AudioNoiseGateProcessRef(audio_noise_gate_ref_t *gate, short *buf, int frames);
+
+void AudioNoiseGateInit(audio_noise_gate_t *gate, int thresh);
+/* gate frames interleaved stereo frames of buf in place */
+void AudioNoiseGateProcess(audio_noise_gate_t *gate, short *buf, int frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
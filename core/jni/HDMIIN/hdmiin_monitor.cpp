@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     AMLOGIC HDMIIN_MONITOR
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "hdmiin_monitor.h"
+
+#undef LOGD
+#undef LOGE
+#define LOGD printf
+#define LOGE printf
+
+/*
+ * Not every RX driver calls sysfs_notify() on every parameter, so the nodes
+ * are still re-read when poll() times out. Once each open node has raised a
+ * notification the timeout only guards against missed events.
+ */
+#define MONITOR_FALLBACK_MS         (1000)
+#define MONITOR_NOTIFIED_MS         (5000)
+
+static const char *const node_names[HDMIIN_NODE_NUM] = {
+    "audio_sample_rate",
+    "input_mode",
+    "horz_active",
+    "vert_active",
+    "is_hdmi_mode",
+    "is_interlace",
+};
+
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static hdmiin_signal_state_t cached_state;
+static int node_fd[HDMIIN_NODE_NUM];
+static int wake_fd = -1;
+static bool running = false;
+static volatile bool stop_request = false;
+static pthread_t monitor_thread;
+static hdmiin_signal_cb signal_cb = NULL;
+static void *signal_user = NULL;
+
+static int ReadNode(int fd, char *buf) {
+    int len = pread(fd, buf, HDMIIN_NODE_VALUE_SIZE - 1, 0);
+
+    if (len < 0)
+        return -1;
+
+    buf[len] = '\0';
+    if (len > 0 && buf[len - 1] == '\n')
+        buf[len - 1] = '\0';
+    return 0;
+}
+
+/* re-read all nodes, returns true when the cached state changed */
+static bool Refresh(void) {
+    hdmiin_signal_state_t state;
+    bool changed;
+
+    memset(&state, 0, sizeof(state));
+    for (int i = 0; i < HDMIIN_NODE_NUM; i++) {
+        if (node_fd[i] >= 0 && ReadNode(node_fd[i], state.value[i]) == 0)
+            state.valid[i] = 1;
+    }
+
+    pthread_mutex_lock(&state_lock);
+    memcpy(state.notified, cached_state.notified, sizeof(state.notified));
+    changed = memcmp(state.valid, cached_state.valid, sizeof(state.valid)) != 0
+        || memcmp(state.value, cached_state.value, sizeof(state.value)) != 0;
+    if (changed) {
+        state.changes = cached_state.changes + 1;
+        cached_state = state;
+    }
+    pthread_mutex_unlock(&state_lock);
+
+    return changed;
+}
+
+/* true once every open node has raised a notification */
+static bool AllNotified(void) {
+    bool all = true;
+
+    pthread_mutex_lock(&state_lock);
+    for (int i = 0; i < HDMIIN_NODE_NUM; i++) {
+        if (node_fd[i] >= 0 && !cached_state.notified[i])
+            all = false;
+    }
+    pthread_mutex_unlock(&state_lock);
+    return all;
+}
+
+static void *MonitorLoop(void *arg) {
+    struct pollfd fds[HDMIIN_NODE_NUM + 1];
+    int fd_node[HDMIIN_NODE_NUM + 1];
+
+    while (!stop_request) {
+        int nfds = 0;
+        int ret;
+        // one silent node keeps the short timeout for all
+        int timeout = AllNotified() ? MONITOR_NOTIFIED_MS : MONITOR_FALLBACK_MS;
+
+        fds[nfds].fd = wake_fd;
+        fds[nfds].events = POLLIN;
+        fds[nfds++].revents = 0;
+        for (int i = 0; i < HDMIIN_NODE_NUM; i++) {
+            if (node_fd[i] < 0)
+                continue;
+            fd_node[nfds] = i;
+            fds[nfds].fd = node_fd[i];
+            fds[nfds].events = POLLPRI;
+            fds[nfds++].revents = 0;
+        }
+
+        ret = poll(fds, nfds, timeout);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            LOGE("hdmiin monitor poll error: %s\n", strerror(errno));
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            read(wake_fd, &count, sizeof(count));
+            if (stop_request)
+                break;
+        }
+        pthread_mutex_lock(&state_lock);
+        for (int i = 1; i < nfds; i++) {
+            if (fds[i].revents & (POLLPRI | POLLERR))
+                cached_state.notified[fd_node[i]] = 1;
+        }
+        pthread_mutex_unlock(&state_lock);
+
+        // a changed node is re-read with the others, the callback then
+        // sees one consistent snapshot of the signal
+        if (Refresh() && signal_cb != NULL) {
+            hdmiin_signal_state_t state;
+
+            pthread_mutex_lock(&state_lock);
+            state = cached_state;
+            pthread_mutex_unlock(&state_lock);
+            signal_cb(&state, signal_user);
+        }
+    }
+
+    return NULL;
+}
+
+int HdmiInMonitorStart(const char *param_path, hdmiin_signal_cb cb, void *user) {
+    char path[PATH_MAX];
+
+    if (running)
+        HdmiInMonitorStop();
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        LOGE("hdmiin monitor eventfd error: %s\n", strerror(errno));
+        return -1;
+    }
+
+    for (int i = 0; i < HDMIIN_NODE_NUM; i++) {
+        snprintf(path, sizeof(path), "%s%s", param_path, node_names[i]);
+        node_fd[i] = open(path, O_RDONLY | O_CLOEXEC);
+    }
+
+    memset(&cached_state, 0, sizeof(cached_state));
+    // the first read also arms sysfs_notify() for the following poll()
+    Refresh();
+
+    signal_cb = cb;
+    signal_user = user;
+    stop_request = false;
+    pthread_mutex_lock(&state_lock);
+    running = true;
+    pthread_mutex_unlock(&state_lock);
+
+    if (pthread_create(&monitor_thread, NULL, MonitorLoop, NULL) != 0) {
+        LOGE("hdmiin monitor thread create error\n");
+        pthread_mutex_lock(&state_lock);
+        running = false;
+        pthread_mutex_unlock(&state_lock);
+        for (int i = 0; i < HDMIIN_NODE_NUM; i++) {
+            if (node_fd[i] >= 0)
+                close(node_fd[i]);
+        }
+        close(wake_fd);
+        wake_fd = -1;
+        return -1;
+    }
+
+    LOGD("hdmiin monitor started on %s\n", param_path);
+    return 0;
+}
+
+void HdmiInMonitorStop(void) {
+    if (!running)
+        return;
+
+    pthread_mutex_lock(&state_lock);
+    running = false;
+    pthread_mutex_unlock(&state_lock);
+
+    stop_request = true;
+    HdmiInMonitorKick();
+    // stopped from the callback: the loop exits once the callback returns
+    if (pthread_equal(pthread_self(), monitor_thread))
+        pthread_detach(monitor_thread);
+    else
+        pthread_join(monitor_thread, NULL);
+
+    for (int i = 0; i < HDMIIN_NODE_NUM; i++) {
+        if (node_fd[i] >= 0)
+            close(node_fd[i]);
+        node_fd[i] = -1;
+    }
+    close(wake_fd);
+    wake_fd = -1;
+    signal_cb = NULL;
+    signal_user = NULL;
+}
+
+int HdmiInMonitorGetState(hdmiin_signal_state_t *state) {
+    int ret = -1;
+
+    pthread_mutex_lock(&state_lock);
+    if (running) {
+        *state = cached_state;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&state_lock);
+
+    return ret;
+}
+
+void HdmiInMonitorKick(void) {
+    uint64_t one = 1;
+
+    if (wake_fd >= 0)
+        write(wake_fd, &one, sizeof(one));
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     AMLOGIC HDMIIN_MONITOR
+ *
+ *     Keeps the HDMI RX signal sysfs nodes open on a native thread, waits
+ *     for sysfs_notify() on them and caches their content, so the JNI
+ *     getters can answer without any file I/O for the nodes the driver
+ *     notifies on. The callback only fires when a node content actually
+ *     changed.
+ */
+
+#ifndef __HDMIIN_MONITOR_H__
+#define __HDMIIN_MONITOR_H__
+
+enum {
+    HDMIIN_NODE_AUDIO_SAMPLE_RATE,
+    HDMIIN_NODE_INPUT_MODE,
+    HDMIIN_NODE_HORZ_ACTIVE,
+    HDMIIN_NODE_VERT_ACTIVE,
+    HDMIIN_NODE_IS_HDMI_MODE,
+    HDMIIN_NODE_IS_INTERLACE,
+    HDMIIN_NODE_NUM,
+};
+
+#define HDMIIN_NODE_VALUE_SIZE      (128)
+
+typedef struct hdmiin_signal_state {
+    int valid[HDMIIN_NODE_NUM];         /* node exists and was read */
+    int notified[HDMIIN_NODE_NUM];      /* node raised sysfs_notify(), its value follows the driver */
+    char value[HDMIIN_NODE_NUM][HDMIIN_NODE_VALUE_SIZE]; /* without trailing newline */
+    unsigned int changes;
+} hdmiin_signal_state_t;
+
+typedef void (*hdmiin_signal_cb)(const hdmiin_signal_state_t *state, void *user);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* param_path is the driver parameter directory, ending with '/' */
+int HdmiInMonitorStart(const char *param_path, hdmiin_signal_cb cb, void *user);
+void HdmiInMonitorStop(void);
+/* returns -1 while the monitor is not running */
+int HdmiInMonitorGetState(hdmiin_signal_state_t *state);
+/* re-read every node now, for drivers or tests without sysfs_notify() */
+void HdmiInMonitorKick(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,7 +26,10 @@
 #include <cutils/log.h>
 #include <cutils/str_parms.h>
 #include <cutils/properties.h>
+#include <utils/Timers.h>
 #include "audio_global_cfg.h"
+#include "audio_drift_ctl.h"
+#include "audio_noise_gate.h"
 #include "mAlsa.h"
 #ifdef BOARD_ALSA_AUDIO_TINY
 #include <tinyalsa/asoundlib.h>
@@ -60,30 +63,27 @@ static Mutex tracker_ctrl_lock;
 #define save_distance_max   4096*4
 #define save_distance_min   4096
 #define mid_buffer_distance 2048*5
+#define record_rate         48000
 
 short *temp_buffer = NULL;
 short *end_temp_buffer = NULL;
 short volatile *record_write_pointer;
 short volatile *playback_read_pointer;
+static audio_drift_ctl_t drift_ctl;
+static audio_latency_tuner_t latency_tuner;
 
+static nsecs_t last_record_time = 0;
+static unsigned int record_overruns = 0;
+static int pipeline_latency_ms = 0;
+static int pipeline_delay_us = 0;
 
-//static bool gEnableNoiseGate = false;
-//static bool gUserSetEnableNoiseGate = false;
-static unsigned zero_count_left = 2000;
-static unsigned zero_count_right = 2000;
-static signed zero_left = 0;
-static signed zero_right = 0;
-static unsigned NOISE_HIS = 48000 * 5;
-//static signed gNoiseGateThresh = 0;
 
-#define HISTORY_BASE   (12)
-#define HISTORY_NUM    (1<<12)
-static signed history[2][HISTORY_NUM];
+#define PROP_NOISE_GATE         "sys.hdmiin.noisegate"
+#define PROP_NOISE_GATE_THRESH  "sys.hdmiin.noisegate.thresh"
 
-static signed sum_left = 0;
-static signed sum_right = 0;
-static unsigned left_pos = 0;
-static unsigned right_pos = 0;
+static bool gEnableNoiseGate = false;
+static signed gNoiseGateThresh = 16;
+static audio_noise_gate_t noise_gate;
 
 static void FreeRecorder(void) {
     LOGD("*****FreeRecorder****\n");
@@ -147,6 +147,13 @@ static int InitTempBuffer() {
         end_temp_buffer = temp_buffer + temp_buffer_size;
         record_write_pointer = temp_buffer;
         playback_read_pointer = temp_buffer;
+        AudioDriftInit(&drift_ctl, mid_buffer_distance);
+        AudioNoiseGateInit(&noise_gate, gNoiseGateThresh);
+        AudioLatencyTunerInit(&latency_tuner, save_distance_min + 2048,
+                save_distance_max - 4096, mid_buffer_distance);
+        last_record_time = 0;
+        record_overruns = 0;
+        pipeline_delay_us = 0;
     }
     LOGD("***1**InitTempBuffer****\n");
     return 0;
@@ -220,6 +227,25 @@ static int GetReadSpace(short volatile *WritePoint, short volatile *ReadPoint) {
     return space;
 }
 
+/*
+ * The sample rendered now was captured ring occupancy ago, counted back from
+ * the last recorder chunk, plus the AudioRecord/AudioTrack latencies.
+ */
+static void UpdatePipelineDelay(int available_read_space) {
+    int delay_us;
+
+    if (last_record_time == 0)
+        return;
+
+    delay_us = (int)((systemTime(SYSTEM_TIME_MONOTONIC) - last_record_time) / 1000)
+        + (int)((long long)available_read_space * 1000000 / (2 * record_rate))
+        + pipeline_latency_ms * 1000;
+    if (pipeline_delay_us == 0)
+        pipeline_delay_us = delay_us;
+    else
+        pipeline_delay_us += (delay_us - pipeline_delay_us) / 16;
+}
+
 static void recorderCallback(int event, void* user, void *info) {
 //#if CC_AUD_SRC_IN_BUF_ANDROID
     if (AudioRecord::EVENT_MORE_DATA == event) {
@@ -233,12 +259,14 @@ static void recorderCallback(int event, void* user, void *info) {
         int available_write_space;
         int i;
         available_write_space = GetWriteSpace(record_write_pointer,playback_read_pointer);
+        last_record_time = systemTime(SYSTEM_TIME_MONOTONIC);
 
         // LOGE("~~~~~available_write_space = %d \n", available_write_space);
 
         if(available_write_space <= save_distance_min )
         {
             //memcpy((short *)record_write_pointer, pbuf->raw, pbuf->size);
+            record_overruns++;
             LOGE("[%s]: *********Throw a frame data away!!!!!!!!\n", __FUNCTION__);
         }
         else
@@ -293,42 +321,34 @@ static void trackerCallback(int event, void* user, void *info) {
         Mutex::Autolock _l(temp_buffer_lock);
 #endif
         int available_read_space;
+        int read_idx = playback_read_pointer - temp_buffer;
+        bool underrun;
         available_read_space = GetReadSpace(record_write_pointer,playback_read_pointer);
 
         // LOGE("~~~~~available_read_space = %d \n", available_read_space);
 
-        if(available_read_space <= save_distance_min )
+        // resample by at most AUDIO_DRIFT_MAX_PPM so the ring stays around
+        // the tuned target while the HDMI RX and playback clocks drift
+        underrun = available_read_space <= save_distance_min
+            || AudioDriftRead(&drift_ctl, temp_buffer, temp_buffer_size, &read_idx,
+                    available_read_space, (short *)pbuf->raw, pbuf->size / 4) < 0;
+        drift_ctl.target_fill = AudioLatencyTunerUpdate(&latency_tuner,
+                systemTime(SYSTEM_TIME_MONOTONIC), underrun);
+
+        if (underrun)
         {
             //memcpy(pbuf->raw, (short *)playback_read_pointer, pbuf->size);
             record_write_pointer = temp_buffer;
-            playback_read_pointer = record_write_pointer + mid_buffer_distance;
+            playback_read_pointer = end_temp_buffer - drift_ctl.target_fill;
+            AudioDriftReset(&drift_ctl);
             LOGE("[%s]: ********Throw a frame data away!!!!!!!!\n", __FUNCTION__);
         }
         else
         {
-            unsigned int offset_bytes = 2*(end_temp_buffer-playback_read_pointer);
-            unsigned int copy_bytes;
-
-            if(offset_bytes >= pbuf->size)
-            {
-                memcpy(pbuf->raw, (short *)playback_read_pointer, pbuf->size);
-                memset((void *)playback_read_pointer,0, pbuf->size);
-                playback_read_pointer += pbuf->size/2;
-
-                if(playback_read_pointer == end_temp_buffer)
-                playback_read_pointer = temp_buffer;
-            }
-            else
-            {
-                memcpy(pbuf->raw, (short *)playback_read_pointer, offset_bytes);
-                memset((void *)playback_read_pointer,0, offset_bytes);
-                copy_bytes = offset_bytes;
-                offset_bytes = pbuf->size - copy_bytes;
-                playback_read_pointer = temp_buffer;
-                memcpy((short *)pbuf->raw + (copy_bytes/2), (short *)playback_read_pointer, offset_bytes);
-                memset((void *)playback_read_pointer,0, offset_bytes);
-                playback_read_pointer += offset_bytes/2;
-            }
+            playback_read_pointer = temp_buffer + read_idx;
+            UpdatePipelineDelay(available_read_space);
+            if (gEnableNoiseGate)
+                AudioNoiseGateProcess(&noise_gate, (short *)pbuf->raw, pbuf->size / 4);
             //DoDumpData(pbuf->raw, pbuf->size);
         }
 
@@ -426,7 +446,6 @@ err_exit:
 int mAlsaInit(int tm_sleep, int init_flag, int track_rate) {
 #if CC_DISABLE_ALSA_MODULE == 0
     int tmp_ret;
-    int record_rate = 48000;
 
     LOGD("Enter mAlsaInit function.\n");
 
@@ -437,6 +456,9 @@ int mAlsaInit(int tm_sleep, int init_flag, int track_rate) {
     mAlsaUninit(0);
     //audio_select_source(1);
 
+    gEnableNoiseGate = property_get_bool(PROP_NOISE_GATE, false);
+    gNoiseGateThresh = property_get_int32(PROP_NOISE_GATE_THRESH, gNoiseGateThresh);
+
     if (InitTempBuffer() != 0) {
         LOGE("[%s:%d] Failed to create temp_buffer!\n", __FUNCTION__, __LINE__);
         return 0;
@@ -509,6 +531,10 @@ int mAlsaInit(int tm_sleep, int init_flag, int track_rate) {
             return -1;
         }
 
+        pipeline_latency_ms = glpTracker->latency();
+        if (glpRecorder != NULL)
+            pipeline_latency_ms += glpRecorder->latency();
+
         if (init_flag & CC_FLAG_START_TRACK) {
             glpTracker->start();
         }
@@ -590,6 +616,20 @@ void mAlsaStartTracker(void) {
 #endif
 }
 
+int mAlsaGetLatencyInfo(mAlsaLatencyInfo *info) {
+#if CC_ALSA_HAS_MUTEX_LOCK == 1
+    Mutex::Autolock _l(temp_buffer_lock);
+#endif
+    if (temp_buffer == NULL)
+        return -1;
+
+    info->delay_us = pipeline_delay_us;
+    info->target_us = (int)((long long)latency_tuner.target * 1000000 / (2 * record_rate));
+    info->underruns = latency_tuner.underruns;
+    info->overruns = record_overruns;
+    return 0;
+}
+
 void mAlsaStopTracker(void) {
 #if CC_DISABLE_ALSA_MODULE == 0
     if (glpTracker != NULL) {
@@ -16,6 +16,14 @@
 #define CC_FLAG_START_RECORD            (0x0004)
 #define CC_FLAG_START_TRACK             (0x0008)
 #define CC_FLAG_SOP_RECORD		(0x0010)
+
+typedef struct mAlsaLatencyInfo {
+    int delay_us;               /* capture to render delay estimate */
+    int target_us;              /* ring occupancy held by the latency tuner */
+    unsigned int underruns;
+    unsigned int overruns;
+} mAlsaLatencyInfo;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -26,6 +34,7 @@ int mAlsaStartRecorder(void);
 int mAlsaStopRecorder(void);
 void mAlsaStartTracker(void);
 void mAlsaStopTracker(void);
+int mAlsaGetLatencyInfo(mAlsaLatencyInfo *info);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     Offline harness for the HDMI-IN drift compensation. It replays the
+ *     recorder/tracker ring protocol of mAlsa.cpp with a capture clock that
+ *     drifts against the playback clock, plus callback jitter, and checks
+ *     that 10 simulated minutes run without ring resets or dropped chunks
+ *     while the latency stays bounded. The same loop then runs with the
+ *     latency tuner enabled and checks that it settles on a lower target
+ *     on a clean board and backs off without repeated underruns on a
+ *     jittery one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_drift_ctl.h"
+
+/* keep in sync with mAlsa.cpp */
+#define temp_buffer_size    4096*5
+#define save_distance_max   4096*4
+#define save_distance_min   4096
+#define mid_buffer_distance 2048*5
+
+#define SAMPLE_RATE         48000
+#define RECORD_FRAMES       1024
+#define TRACK_FRAMES        960
+#define SIM_SECONDS         600
+/* allowed deviation from mid_buffer_distance once settled, in samples */
+#define MAX_FILL_ERROR      4096
+#define SETTLE_SECONDS      60
+#define TUNER_SIM_SECONDS   1800
+/* underruns plus dropped chunks tolerated while the tuner probes */
+#define TUNER_MAX_GLITCHES  8
+
+static short ring[temp_buffer_size];
+static int write_idx;
+static int read_idx;
+static unsigned int rand_state;
+
+static double jitter(double max_s) {
+    rand_state = rand_state * 1103515245 + 12345;
+    return max_s * ((double)((rand_state >> 8) & 0xffff) / 0x8000 - 1.0);
+}
+
+static int readSpace(void) {
+    return write_idx >= read_idx ? write_idx - read_idx : temp_buffer_size - (read_idx - write_idx);
+}
+
+static int runCase(int drift_ppm, double jitter_s, bool tune) {
+    audio_drift_ctl_t ctl;
+    audio_latency_tuner_t tuner;
+    short chunk[RECORD_FRAMES * 2];
+    short out[TRACK_FRAMES * 2];
+    double record_period = (double)RECORD_FRAMES / (SAMPLE_RATE * (1.0 + drift_ppm * 1e-6));
+    double track_period = (double)TRACK_FRAMES / SAMPLE_RATE;
+    double sim_seconds = tune ? TUNER_SIM_SECONDS : SIM_SECONDS;
+    long record_n = 0, track_n = 0;
+    unsigned int resets = 0, drops = 0;
+    int max_error = 0;
+
+    memset(ring, 0, sizeof(ring));
+    write_idx = 0;
+    read_idx = mid_buffer_distance;
+    rand_state = 1;
+    AudioDriftInit(&ctl, mid_buffer_distance);
+    AudioLatencyTunerInit(&tuner, save_distance_min + 2048, save_distance_max - 4096,
+        mid_buffer_distance);
+    for (int i = 0; i < RECORD_FRAMES * 2; i++)
+        chunk[i] = (short)(i * 7);
+
+    while (true) {
+        double t_rec = record_n * record_period + jitter(jitter_s);
+        double t_trk = track_n * track_period + jitter(jitter_s);
+        double now = t_rec < t_trk ? t_rec : t_trk;
+
+        if (now > sim_seconds)
+            break;
+
+        if (t_rec <= t_trk) {
+            record_n++;
+            if (temp_buffer_size - readSpace() <= save_distance_min) {
+                drops++;
+                continue;
+            }
+            for (int i = 0; i < RECORD_FRAMES * 2; i++) {
+                ring[write_idx] = chunk[i];
+                if (++write_idx == temp_buffer_size)
+                    write_idx = 0;
+            }
+        } else {
+            int avail = readSpace();
+            bool underrun;
+
+            track_n++;
+            underrun = avail <= save_distance_min
+                || AudioDriftRead(&ctl, ring, temp_buffer_size, &read_idx, avail, out, TRACK_FRAMES) < 0;
+            if (tune)
+                ctl.target_fill = AudioLatencyTunerUpdate(&tuner, (long long)(now * 1e9), underrun);
+            if (underrun) {
+                write_idx = 0;
+                read_idx = temp_buffer_size - ctl.target_fill;
+                AudioDriftReset(&ctl);
+                resets++;
+                continue;
+            }
+            if (!tune && now > SETTLE_SECONDS) {
+                int error = abs(avail - ctl.target_fill);
+                if (error > max_error)
+                    max_error = error;
+            }
+        }
+    }
+
+    if (tune) {
+        printf("tuner drift %+5d ppm jitter %4.1f ms: underruns %u drops %u target %d samples (%.1f ms)\n",
+            drift_ppm, jitter_s * 1000, resets, drops, tuner.target,
+            tuner.target * 1000.0 / (SAMPLE_RATE * 2));
+        if (resets + drops > TUNER_MAX_GLITCHES)
+            return 1;
+        /* a clean board ends on the lowest target, a jittery one backs off */
+        return (resets == 0) == (tuner.target == tuner.min_fill) ? 0 : 1;
+    }
+
+    printf("drift %+5d ppm jitter %4.1f ms: resets %u drops %u max fill error %d samples (%.1f ms), ratio %.6f\n",
+        drift_ppm, jitter_s * 1000, resets, drops, max_error,
+        max_error * 1000.0 / (SAMPLE_RATE * 2), ctl.ratio);
+
+    return (resets == 0 && drops == 0 && max_error <= MAX_FILL_ERROR) ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    static const int drifts[] = {0, 100, -100, 300, -300, 450, -450};
+    static const double jitters[] = {0.0, 0.002, 0.008};
+    static const double tuner_jitters[] = {0.002, 0.008, 0.020};
+    int failed = 0;
+
+    for (unsigned i = 0; i < sizeof(drifts) / sizeof(drifts[0]); i++) {
+        for (unsigned j = 0; j < sizeof(jitters) / sizeof(jitters[0]); j++)
+            failed += runCase(drifts[i], jitters[j], false);
+    }
+    for (unsigned j = 0; j < sizeof(tuner_jitters) / sizeof(tuner_jitters[0]); j++)
+        failed += runCase(300, tuner_jitters[j], true);
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     Compares the gate decisions of the block noise gate with the
+ *     per-sample reference over synthetic HDMI-IN style programme material
+ *     (music, hiss between tracks, DC offset, one-sided silence), then
+ *     reports the processing cost per sample of both.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_noise_gate.h"
+
+#define SAMPLE_RATE         48000
+#define TRACK_FRAMES        960
+#define GATE_THRESH         16
+/* decision may lag by at most one level window around a transition */
+#define MAX_LAG_BLOCKS      (NOISE_GATE_BLOCK_NUM + 1)
+#define BENCH_SECONDS       60
+
+enum {
+    SEG_MUSIC,
+    SEG_HISS,
+    SEG_DC,
+    SEG_LEFT_ONLY,
+};
+
+typedef struct segment {
+    int type;
+    double seconds;
+} segment_t;
+
+static unsigned int rand_state = 1;
+
+static int noise(int amplitude) {
+    rand_state = rand_state * 1103515245 + 12345;
+    return (int)((rand_state >> 8) % (2 * amplitude + 1)) - amplitude;
+}
+
+static short *makeSignal(const segment_t *segs, int count, int *frames) {
+    int total = 0;
+    short *buf;
+    int pos = 0;
+
+    for (int i = 0; i < count; i++)
+        total += (int)(segs[i].seconds * SAMPLE_RATE);
+    buf = (short *)malloc(total * 2 * sizeof(short));
+
+    for (int i = 0; i < count; i++) {
+        int n = (int)(segs[i].seconds * SAMPLE_RATE);
+
+        for (int j = 0; j < n; j++, pos++) {
+            double t = (double)pos / SAMPLE_RATE;
+            double env = 0.5 + 0.5 * sin(2 * M_PI * 0.7 * t);
+            int music = (int)(6000 * env * (sin(2 * M_PI * 440 * t) + 0.5 * sin(2 * M_PI * 1250 * t)));
+            int l = 0, r = 0;
+
+            switch (segs[i].type) {
+            case SEG_MUSIC:
+                l = music + noise(8);
+                r = music / 2 + noise(8);
+                break;
+            case SEG_HISS:
+                l = noise(12);
+                r = noise(12);
+                break;
+            case SEG_DC:
+                l = 40 + noise(4);
+                r = -3 + noise(4);
+                break;
+            case SEG_LEFT_ONLY:
+                l = music;
+                r = noise(6);
+                break;
+            }
+            buf[2 * pos] = (short)l;
+            buf[2 * pos + 1] = (short)r;
+        }
+    }
+
+    *frames = total;
+    return buf;
+}
+
+static int compareDecisions(const char *name, const segment_t *segs, int count) {
+    audio_noise_gate_ref_t *ref = (audio_noise_gate_ref_t *)malloc(sizeof(*ref));
+    audio_noise_gate_t gate;
+    int frames;
+    short *in = makeSignal(segs, count, &frames);
+    short *ref_buf = (short *)malloc(frames * 2 * sizeof(short));
+    short *blk_buf = (short *)malloc(frames * 2 * sizeof(short));
+    int blocks = 0, mismatches = 0, run = 0, max_run = 0, gated = 0;
+
+    memcpy(ref_buf, in, frames * 2 * sizeof(short));
+    memcpy(blk_buf, in, frames * 2 * sizeof(short));
+    AudioNoiseGateRefInit(ref, GATE_THRESH);
+    AudioNoiseGateInit(&gate, GATE_THRESH);
+
+    for (int pos = 0; pos + NOISE_GATE_BLOCK <= frames; pos += NOISE_GATE_BLOCK) {
+        AudioNoiseGateProcessRef(ref, ref_buf + 2 * pos, NOISE_GATE_BLOCK);
+        AudioNoiseGateProcess(&gate, blk_buf + 2 * pos, NOISE_GATE_BLOCK);
+        blocks++;
+        if (ref->gated[0] != gate.gated[0] || ref->gated[1] != gate.gated[1]) {
+            mismatches++;
+            if (++run > max_run)
+                max_run = run;
+        } else {
+            run = 0;
+        }
+        gated += gate.gated[0] + gate.gated[1];
+    }
+
+    printf("%-12s blocks %6d gated %6d mismatched %4d longest %3d\n",
+        name, blocks, gated, mismatches, max_run);
+
+    free(in);
+    free(ref_buf);
+    free(blk_buf);
+    free(ref);
+    return (gated > 0 && max_run <= MAX_LAG_BLOCKS) ? 0 : 1;
+}
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void benchmark(void) {
+    static const segment_t segs[] = {
+        {SEG_MUSIC, BENCH_SECONDS / 2}, {SEG_HISS, BENCH_SECONDS / 2},
+    };
+    audio_noise_gate_ref_t *ref = (audio_noise_gate_ref_t *)malloc(sizeof(*ref));
+    audio_noise_gate_t gate;
+    int frames;
+    short *in = makeSignal(segs, 2, &frames);
+    short *buf = (short *)malloc(frames * 2 * sizeof(short));
+    double start, ref_ns, blk_ns;
+
+    AudioNoiseGateRefInit(ref, GATE_THRESH);
+    memcpy(buf, in, frames * 2 * sizeof(short));
+    start = nowNs();
+    for (int pos = 0; pos + TRACK_FRAMES <= frames; pos += TRACK_FRAMES)
+        AudioNoiseGateProcessRef(ref, buf + 2 * pos, TRACK_FRAMES);
+    ref_ns = nowNs() - start;
+
+    AudioNoiseGateInit(&gate, GATE_THRESH);
+    memcpy(buf, in, frames * 2 * sizeof(short));
+    start = nowNs();
+    for (int pos = 0; pos + TRACK_FRAMES <= frames; pos += TRACK_FRAMES)
+        AudioNoiseGateProcess(&gate, buf + 2 * pos, TRACK_FRAMES);
+    blk_ns = nowNs() - start;
+
+    printf("per-sample reference: %.2f ns/sample\n", ref_ns / (frames * 2));
+    printf("block gate:           %.2f ns/sample\n", blk_ns / (frames * 2));
+
+    free(in);
+    free(buf);
+    free(ref);
+}
+
+int main(int argc, char **argv) {
+    static const segment_t between_tracks[] = {
+        {SEG_MUSIC, 3}, {SEG_HISS, 8}, {SEG_MUSIC, 2}, {SEG_HISS, 6}, {SEG_MUSIC, 1},
+    };
+    static const segment_t dc_offset[] = {
+        {SEG_MUSIC, 2}, {SEG_DC, 7}, {SEG_HISS, 7},
+    };
+    static const segment_t one_sided[] = {
+        {SEG_HISS, 6}, {SEG_LEFT_ONLY, 8}, {SEG_MUSIC, 1},
+    };
+    int failed = 0;
+
+    failed += compareDecisions("tracks", between_tracks, 5);
+    failed += compareDecisions("dc offset", dc_offset, 3);
+    failed += compareDecisions("one sided", one_sided, 3);
+    benchmark();
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     Runs the HDMI-IN signal monitor against a fake sysfs directory.
+ *     Regular files never raise POLLPRI, so HdmiInMonitorKick() (the
+ *     monitor eventfd) stands in for the driver sysfs_notify().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "hdmiin_monitor.h"
+
+#define WAIT_MS             500
+
+static char sysfs_dir[64];
+static pthread_mutex_t cb_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cb_cond = PTHREAD_COND_INITIALIZER;
+static int callbacks = 0;
+static hdmiin_signal_state_t last_state;
+static int failed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failed++; \
+    } \
+} while (0)
+
+static void writeNode(const char *name, const char *value) {
+    char path[128];
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/%s", sysfs_dir, name);
+    fp = fopen(path, "w");
+    fputs(value, fp);
+    fclose(fp);
+}
+
+static void onSignal(const hdmiin_signal_state_t *state, void *user) {
+    pthread_mutex_lock(&cb_lock);
+    callbacks++;
+    last_state = *state;
+    pthread_cond_broadcast(&cb_cond);
+    pthread_mutex_unlock(&cb_lock);
+}
+
+/* kick the monitor and wait for callback number expected, returns ms */
+static double kickAndWait(int expected) {
+    struct timespec start, now, deadline;
+    double ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += WAIT_MS * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    HdmiInMonitorKick();
+    pthread_mutex_lock(&cb_lock);
+    while (callbacks < expected) {
+        if (pthread_cond_timedwait(&cb_cond, &cb_lock, &deadline) != 0)
+            break;
+    }
+    pthread_mutex_unlock(&cb_lock);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ms = (now.tv_sec - start.tv_sec) * 1e3 + (now.tv_nsec - start.tv_nsec) / 1e6;
+    return ms;
+}
+
+int main(int argc, char **argv) {
+    hdmiin_signal_state_t state;
+    char param_path[80];
+    double ms;
+
+    strcpy(sysfs_dir, "/tmp/hdmiin_sysfs_XXXXXX");
+    if (mkdtemp(sysfs_dir) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(param_path, sizeof(param_path), "%s/", sysfs_dir);
+
+    writeNode("audio_sample_rate", "48.0 kHz\n");
+    writeNode("input_mode", "HDMI:1080p60hz\n");
+    writeNode("horz_active", "1920\n");
+    writeNode("vert_active", "1080\n");
+    writeNode("is_hdmi_mode", "1\n");
+    // is_interlace left out on purpose
+
+    CHECK(HdmiInMonitorGetState(&state) == -1);
+    CHECK(HdmiInMonitorStart(param_path, onSignal, NULL) == 0);
+
+    CHECK(HdmiInMonitorGetState(&state) == 0);
+    CHECK(!strcmp(state.value[HDMIIN_NODE_AUDIO_SAMPLE_RATE], "48.0 kHz"));
+    CHECK(!strcmp(state.value[HDMIIN_NODE_INPUT_MODE], "HDMI:1080p60hz"));
+    CHECK(atoi(state.value[HDMIIN_NODE_HORZ_ACTIVE]) == 1920);
+    CHECK(state.valid[HDMIIN_NODE_IS_HDMI_MODE]);
+    CHECK(!state.valid[HDMIIN_NODE_IS_INTERLACE]);
+
+    // nothing changed: no callback
+    kickAndWait(1);
+    CHECK(callbacks == 0);
+
+    // a kick is no notification, the getters keep reading these nodes from sysfs
+    CHECK(HdmiInMonitorGetState(&state) == 0);
+    for (int i = 0; i < HDMIIN_NODE_NUM; i++)
+        CHECK(!state.notified[i]);
+
+    // source switches to 720p with 44.1 kHz audio
+    writeNode("audio_sample_rate", "44.1 kHz\n");
+    writeNode("horz_active", "1280\n");
+    writeNode("vert_active", "720\n");
+    ms = kickAndWait(1);
+    CHECK(callbacks == 1);
+    CHECK(!strcmp(last_state.value[HDMIIN_NODE_AUDIO_SAMPLE_RATE], "44.1 kHz"));
+    CHECK(atoi(last_state.value[HDMIIN_NODE_VERT_ACTIVE]) == 720);
+    printf("change delivered in %.2f ms\n", ms);
+
+    // same content rewritten: still no new callback
+    writeNode("horz_active", "1280\n");
+    kickAndWait(2);
+    CHECK(callbacks == 1);
+
+    // DVI source
+    writeNode("is_hdmi_mode", "0\n");
+    kickAndWait(2);
+    CHECK(callbacks == 2);
+    CHECK(HdmiInMonitorGetState(&state) == 0);
+    CHECK(atoi(state.value[HDMIIN_NODE_IS_HDMI_MODE]) == 0);
+    CHECK(state.changes == last_state.changes);
+
+    HdmiInMonitorStop();
+    CHECK(HdmiInMonitorGetState(&state) == -1);
+
+    static const char *const nodes[] = {
+        "audio_sample_rate", "input_mode", "horz_active", "vert_active", "is_hdmi_mode",
+    };
+    for (unsigned i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++) {
+        char path[128];
+        snprintf(path, sizeof(path), "%s/%s", sysfs_dir, nodes[i]);
+        unlink(path);
+    }
+    rmdir(sysfs_dir);
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     Parses vfm map output captured from boards, then runs the HDMI-IN
+ *     window switch sequence against a fake map node. The fake driver
+ *     applies add/rm to its own copy of the map and rewrites the node, so
+ *     a re-parse always sees what a real driver would report, also after
+ *     the edits tvserver makes behind our back. The
+ *     benchmark compares the cached graph with reading the map before every
+ *     lookup, as getPath() did.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "vfm_map.h"
+
+#define FAKE_PATH_NUM       32
+#define BENCH_SWITCHES      2000
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failed++; \
+    } \
+} while (0)
+
+static const char *const board_maps[] = {
+    // m8 box, hdmiin not started
+    "default { decoder(0) ppmgr(0) deinterlace(0) amvideo}\n"
+    "default_osd { osd amvideo}\n"
+    "default_ext { vdin0(0) deinterlace(0) amvideo}\n"
+    "tvpath { vdin0 amvideo2}\n"
+    "default_amlvideo2 { vdin1 amlvideo2}\n",
+    // hdmiin running windowed, no trailing newline, extra blanks
+    "default { decoder(1) ppmgr(1) deinterlace(1) amvideo(1)}\n"
+    "  hdmiin {   vdin0(1)  amlvideo2(1) }\n"
+    "default_amlvideo2 { vdin1 amlvideo2.1}",
+    // header noise and a prefix clash between tvpath and tvpath_pip
+    "map info:\n"
+    "tvpath_pip { vdin1 deinterlace amvideo}\n"
+    "tvpath { vdin0 amvideo}\n",
+};
+
+static char map_file[64];
+static char frame_file[64];
+static char fake_name[FAKE_PATH_NUM][VFM_NAME_LEN];
+static char fake_modules[FAKE_PATH_NUM][256];
+static int fail_next = 0;
+static int failed = 0;
+
+static void writeFile(const char *path, const char *text) {
+    FILE *fp = fopen(path, "w");
+    fputs(text, fp);
+    fclose(fp);
+}
+
+static void fakeLoad(const char *text) {
+    char line[256];
+
+    memset(fake_name, 0, sizeof(fake_name));
+    for (int i = 0; *text != '\0' && i < FAKE_PATH_NUM; i++) {
+        int len = strcspn(text, "\n");
+        snprintf(line, sizeof(line), "%.*s", len, text);
+        sscanf(line, "%31s { %[^}]", fake_name[i], fake_modules[i]);
+        text += len + (text[len] == '\n');
+    }
+}
+
+static void fakeFlush(void) {
+    char text[FAKE_PATH_NUM * 300] = {0,};
+
+    for (int i = 0; i < FAKE_PATH_NUM; i++) {
+        if (fake_name[i][0] == '\0')
+            continue;
+        snprintf(text + strlen(text), sizeof(text) - strlen(text), "%s { %s}\n",
+            fake_name[i], fake_modules[i]);
+    }
+    writeFile(map_file, text);
+}
+
+/* behaves like vfm_map_store(): rm of an unknown path and add of a known one fail */
+static int fakeWriter(const char *cmd) {
+    char name[VFM_NAME_LEN];
+    int i, free_slot = -1;
+
+    if (fail_next) {
+        fail_next = 0;
+        return -1;
+    }
+    if (sscanf(cmd + (cmd[0] == 'a' ? 4 : 3), "%31s", name) != 1)
+        return -1;
+
+    for (i = 0; i < FAKE_PATH_NUM; i++) {
+        if (!strcmp(fake_name[i], name))
+            break;
+        if (free_slot < 0 && fake_name[i][0] == '\0')
+            free_slot = i;
+    }
+
+    if (!strncmp(cmd, "rm ", 3)) {
+        if (i == FAKE_PATH_NUM)
+            return -1;
+        fake_name[i][0] = '\0';
+    } else {
+        if (i < FAKE_PATH_NUM || free_slot < 0)
+            return -1;
+        strcpy(fake_name[free_slot], name);
+        strcpy(fake_modules[free_slot], cmd + 4 + strlen(name) + 1);
+    }
+
+    fakeFlush();
+    return 0;
+}
+
+/* benchmark writer: the driver accepts everything, the node stays as it is */
+static int nullWriter(const char *cmd) {
+    return 0;
+}
+
+static void reset(const char *text) {
+    VfmMapInit(map_file, frame_file);
+    VfmMapSetWriter(fakeWriter);
+    fakeLoad(text);
+    fakeFlush();
+}
+
+static void testParse(void) {
+    const vfm_path_t *path;
+
+    VfmMapInit(map_file, frame_file);
+    CHECK(VfmMapParse(board_maps[0]) == 5);
+    path = VfmMapGet("default");
+    CHECK(path != NULL && path->module_num == 4);
+    CHECK(path != NULL && !strcmp(path->modules[2], "deinterlace"));
+    CHECK(VfmMapHasModule("default_ext", "vdin0"));
+    CHECK(VfmMapHasModule("default_ext", "amvideo"));
+    CHECK(!VfmMapHasModule("tvpath", "amvideo"));
+    CHECK(VfmMapHasModule("tvpath", "amvideo2"));
+    CHECK(VfmMapGet("hdmiin") == NULL);
+
+    CHECK(VfmMapParse(board_maps[1]) == 3);
+    CHECK(VfmMapGet("default_ext") == NULL);
+    CHECK(VfmMapHasModule("hdmiin", "amlvideo2"));
+    CHECK(!VfmMapHasModule("hdmiin", "amvideo"));
+    CHECK(VfmMapHasModule("default_amlvideo2", "amlvideo2.1"));
+
+    CHECK(VfmMapParse(board_maps[2]) == 2);
+    CHECK(VfmMapGet("tvpath") != NULL && VfmMapGet("tvpath")->module_num == 2);
+    CHECK(VfmMapHasModule("tvpath_pip", "deinterlace"));
+    CHECK(!VfmMapHasModule("tvpath", "deinterlace"));
+}
+
+/* init() and deinit() of a fullscreen HDMI-IN window */
+static void windowSwitch(bool reparse) {
+    vfm_path_t tvpath, default_ext;
+
+    if (reparse)
+        VfmMapLoad();
+    VfmMapSave("tvpath", &tvpath);
+    VfmMapRemove("tvpath");
+    if (reparse)
+        VfmMapLoad();
+    VfmMapSave("default_ext", &default_ext);
+    VfmMapRemove("default_ext");
+    VfmMapSafeRemove("hdmiin");
+    VfmMapAdd("hdmiin", "vdin0 amvideo");
+
+    if (reparse)
+        VfmMapLoad();
+    VfmMapSafeRemove("hdmiin");
+    VfmMapRestore(&tvpath);
+    VfmMapRestore(&default_ext);
+}
+
+static void testSwitch(void) {
+    vfm_map_stats_t stats;
+
+    reset(board_maps[0]);
+    writeFile(frame_file, "0\n");
+
+    windowSwitch(false);
+    VfmMapGetStats(&stats);
+    // the first lookup, then the safe removes and restores read it back
+    CHECK(stats.loads == 5);
+    CHECK(stats.write_failures == 0);
+    CHECK(VfmMapGet("hdmiin") == NULL);
+    CHECK(VfmMapHasModule("tvpath", "amvideo2"));
+    CHECK(VfmMapHasModule("default_ext", "deinterlace"));
+
+    // the graph matches what the driver reports afterwards
+    VfmMapLoad();
+    CHECK(VfmMapHasModule("tvpath", "amvideo2"));
+    CHECK(VfmMapGet("default_ext") != NULL && VfmMapGet("default_ext")->module_num == 3);
+
+    // someone else removed tvpath behind our back: the failed rm re-parses
+    fakeWriter("rm tvpath");
+    CHECK(VfmMapGet("tvpath") != NULL);
+    CHECK(VfmMapRemove("tvpath") == -1);
+    CHECK(VfmMapGet("tvpath") == NULL);
+    VfmMapGetStats(&stats);
+    CHECK(stats.loads == 7);
+    CHECK(stats.write_failures == 1);
+
+    // a refused add leaves the graph as the driver has it
+    fail_next = 1;
+    CHECK(VfmMapAdd("hdmiin", "vdin0 amlvideo2") == -1);
+    CHECK(VfmMapGet("hdmiin") == NULL);
+}
+
+static void testSafeRemove(void) {
+    vfm_map_stats_t stats;
+    struct timespec start, end;
+    double ms;
+
+    // path without amvideo goes at once, whatever the frame count says
+    reset(board_maps[1]);
+    writeFile(frame_file, "3\n");
+    CHECK(VfmMapSafeRemove("hdmiin") == 0);
+    CHECK(VfmMapGet("hdmiin") == NULL);
+    VfmMapGetStats(&stats);
+    CHECK(stats.remove_waits == 0);
+
+    // missing path: nothing to wait for and no write
+    CHECK(VfmMapSafeRemove("hdmiin") == 0);
+    VfmMapGetStats(&stats);
+    CHECK(stats.writes == 1);
+
+    // frames pending: short waits first, then a bounded total
+    reset("hdmiin { vdin0 amvideo}\n");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    CHECK(VfmMapSafeRemove("hdmiin") == 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    VfmMapGetStats(&stats);
+    printf("frames never drained: %u waits, removed after %.0f ms\n", stats.remove_waits, ms);
+    CHECK(VfmMapGet("hdmiin") == NULL);
+    CHECK(ms >= 19000 && ms < 22000);
+
+    // unreadable frame count: removed after the retries, like safeRmPath() did
+    reset("hdmiin { vdin0 amvideo}\n");
+    unlink(frame_file);
+    VfmMapGetStats(&stats);
+    CHECK(VfmMapSafeRemove("hdmiin") == 0);
+    CHECK(VfmMapGet("hdmiin") == NULL);
+    VfmMapGetStats(&stats);
+    CHECK(stats.remove_waits == 0);
+}
+
+/* tvserver adds and removes paths on the same node */
+static void testSharedMap(void) {
+    vfm_path_t tvpath;
+
+    reset(board_maps[0]);
+    writeFile(frame_file, "0\n");
+    CHECK(VfmMapGet("hdmiin") == NULL);
+
+    // added behind our back, still removed
+    fakeWriter("add hdmiin vdin0 amvideo");
+    CHECK(VfmMapSafeRemove("hdmiin") == 0);
+    VfmMapLoad();
+    CHECK(VfmMapGet("hdmiin") == NULL);
+
+    // removed behind our back, no rm the driver would refuse
+    fakeWriter("add hdmiin vdin0 amvideo");
+    VfmMapLoad();
+    fakeWriter("rm hdmiin");
+    CHECK(VfmMapSafeRemove("hdmiin") == 0);
+    CHECK(VfmMapGet("hdmiin") == NULL);
+
+    // put back by tvserver before the restore, replaced by the saved one
+    CHECK(VfmMapSave("tvpath", &tvpath) == 0);
+    CHECK(VfmMapRemove("tvpath") == 0);
+    fakeWriter("add tvpath vdin0 amvideo");
+    CHECK(VfmMapRestore(&tvpath) == 0);
+    VfmMapLoad();
+    CHECK(VfmMapHasModule("tvpath", "amvideo2"));
+    CHECK(!VfmMapHasModule("tvpath", "amvideo"));
+
+    vfm_map_stats_t stats;
+    VfmMapGetStats(&stats);
+    CHECK(stats.write_failures == 0);
+}
+
+static void benchmark(void) {
+    vfm_map_stats_t stats;
+    struct timespec start, end;
+    unsigned int cached_loads = 0, reparse_loads = 0;
+    char text[4096] = {0,};
+
+    // a busy map: every path of the m8 box plus some decoder instances
+    strcpy(text, board_maps[0]);
+    for (int i = 0; i < 12; i++)
+        snprintf(text + strlen(text), sizeof(text) - strlen(text),
+            "vdec-map-%d { vdec.h264.%02d(0) ppmgr(0) deinterlace(0) amvideo}\n", i, i);
+
+    for (int mode = 0; mode < 2; mode++) {
+        reset(text);
+        VfmMapSetWriter(nullWriter);
+        writeFile(frame_file, "0\n");
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < BENCH_SWITCHES; i++)
+            windowSwitch(mode == 1);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        VfmMapGetStats(&stats);
+        double us = ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3)
+            / BENCH_SWITCHES;
+        printf("%-8s %7.1f us/switch, %u map reads\n",
+            mode ? "reparse" : "cached", us, stats.loads);
+        if (mode)
+            reparse_loads = stats.loads;
+        else
+            cached_loads = stats.loads;
+    }
+    // safe removes and restores always read the map, tvserver may have changed it
+    CHECK(cached_loads == 1 + 4 * BENCH_SWITCHES);
+    CHECK(reparse_loads == 7 * BENCH_SWITCHES);
+}
+
+int main(int argc, char **argv) {
+    int fd;
+
+    strcpy(map_file, "/tmp/vfm_map_XXXXXX");
+    fd = mkstemp(map_file);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    snprintf(frame_file, sizeof(frame_file), "%s.count", map_file);
+
+    testParse();
+    testSwitch();
+    testSafeRemove();
+    testSharedMap();
+    benchmark();
+
+    unlink(map_file);
+    unlink(frame_file);
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     AMLOGIC VFM_MAP
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "vfm_map.h"
+
+#undef LOGD
+#undef LOGE
+#define LOGD printf
+#define LOGE printf
+
+#define VFM_MAP_BUF_SIZE            (1024*4)
+#define VFM_HASH_SIZE               (VFM_MAX_NAMES * 2)
+#define VFM_CMD_SIZE                (VFM_NAME_LEN * (VFM_MAX_MODULES + 2))
+
+/*
+ * safeRmPath() used to sleep a whole second per retry, 20 retries. amvideo
+ * normally drops its frames within a vsync or two, so start at 5 ms and
+ * double up to 640 ms, still giving up after the same 20 s.
+ */
+#define REMOVE_WAIT_MIN_US          (5000)
+#define REMOVE_WAIT_MAX_US          (640000)
+#define REMOVE_WAIT_TOTAL_US        (20000000)
+/* safeRmPath() removed the path anyway after 20 failed reads */
+#define REMOVE_READ_RETRIES         (20)
+
+static char map_node[PATH_MAX] = "/sys/class/vfm/map";
+static char frame_count_node[PATH_MAX] = "/sys/module/amvideo/parameters/new_frame_count";
+
+/* path and module names share one intern table, the id is the mask bit */
+static char names[VFM_MAX_NAMES][VFM_NAME_LEN];
+static int name_num = 0;
+static unsigned char name_hash[VFM_HASH_SIZE]; /* id + 1, 0 for empty */
+
+static vfm_path_t paths[VFM_MAX_NAMES];        /* indexed by name id */
+static bool loaded = false;
+static vfm_map_stats_t stats;
+
+static int SysfsWrite(const char *cmd);
+static vfm_map_writer writer = SysfsWrite;
+
+static unsigned int Hash(const char *name, int len) {
+    unsigned int h = 2166136261u;
+
+    for (int i = 0; i < len; i++)
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    return h;
+}
+
+/* returns the id of name[0..len), interning it when create is set */
+static int Lookup(const char *name, int len, bool create) {
+    unsigned int slot;
+
+    if (len <= 0 || len >= VFM_NAME_LEN)
+        return -1;
+
+    slot = Hash(name, len) % VFM_HASH_SIZE;
+    while (name_hash[slot] != 0) {
+        int id = name_hash[slot] - 1;
+        if (!strncmp(names[id], name, len) && names[id][len] == '\0')
+            return id;
+        slot = (slot + 1) % VFM_HASH_SIZE;
+    }
+
+    if (!create)
+        return -1;
+    if (name_num >= VFM_MAX_NAMES) {
+        LOGE("vfm map: too many names, dropping %.*s\n", len, name);
+        return -1;
+    }
+
+    memcpy(names[name_num], name, len);
+    names[name_num][len] = '\0';
+    name_hash[slot] = name_num + 1;
+    return name_num++;
+}
+
+static int SysfsWrite(const char *cmd) {
+    int fd = open(map_node, O_RDWR);
+    int len = strlen(cmd);
+    int ret;
+
+    if (fd < 0) {
+        LOGE("vfm map: open %s error: %s\n", map_node, strerror(errno));
+        return -1;
+    }
+    ret = write(fd, cmd, len);
+    if (ret != len)
+        LOGE("vfm map: write \"%s\" error: %s\n", cmd, strerror(errno));
+    close(fd);
+
+    return ret == len ? 0 : -1;
+}
+
+/* set path id to the modules in text[0..len), separated by blanks */
+static void SetPath(int id, const char *text, int len) {
+    vfm_path_t *path = &paths[id];
+    const char *end = text + len;
+
+    memset(path, 0, sizeof(*path));
+    strcpy(path->name, names[id]);
+
+    while (text < end) {
+        const char *start;
+        int module;
+
+        while (text < end && (*text == ' ' || *text == '\t' || *text == '\n'))
+            text++;
+        start = text;
+        while (text < end && *text != ' ' && *text != '\t' && *text != '\n')
+            text++;
+        if (text == start)
+            break;
+
+        // "deinterlace(1)": the state in brackets is not part of the name
+        const char *bracket = (const char *)memchr(start, '(', text - start);
+        module = Lookup(start, (bracket ? bracket : text) - start, true);
+        if (module < 0 || path->module_num >= VFM_MAX_MODULES)
+            continue;
+
+        strcpy(path->modules[path->module_num++], names[module]);
+        path->module_mask |= 1ULL << module;
+    }
+}
+
+static int Write(const char *cmd) {
+    stats.writes++;
+    if (writer(cmd) == 0)
+        return 0;
+
+    // the driver refused: the graph may no longer match, read it back
+    stats.write_failures++;
+    VfmMapLoad();
+    return -1;
+}
+
+void VfmMapInit(const char *map, const char *frame_count) {
+    strncpy(map_node, map, sizeof(map_node) - 1);
+    strncpy(frame_count_node, frame_count, sizeof(frame_count_node) - 1);
+    memset(names, 0, sizeof(names));
+    memset(name_hash, 0, sizeof(name_hash));
+    memset(paths, 0, sizeof(paths));
+    memset(&stats, 0, sizeof(stats));
+    name_num = 0;
+    loaded = false;
+}
+
+void VfmMapSetWriter(vfm_map_writer w) {
+    writer = w != NULL ? w : SysfsWrite;
+}
+
+/*
+ * The node reads back one path per line:
+ *     default { decoder(0) ppmgr(0) deinterlace(0) amvideo}
+ */
+int VfmMapParse(const char *text) {
+    int num = 0;
+
+    for (int i = 0; i < VFM_MAX_NAMES; i++)
+        paths[i].name[0] = '\0';
+
+    while (*text != '\0') {
+        const char *eol = strchr(text, '\n');
+        const char *open, *close, *name_end;
+        int id;
+
+        if (eol == NULL)
+            eol = text + strlen(text);
+
+        open = (const char *)memchr(text, '{', eol - text);
+        close = open ? (const char *)memchr(open, '}', eol - open) : NULL;
+        if (close != NULL) {
+            while (*text == ' ')
+                text++;
+            name_end = text;
+            while (name_end < open && *name_end != ' ')
+                name_end++;
+            id = Lookup(text, name_end - text, true);
+            if (id >= 0) {
+                SetPath(id, open + 1, close - open - 1);
+                num++;
+            }
+        }
+
+        text = *eol ? eol + 1 : eol;
+    }
+
+    loaded = true;
+    return num;
+}
+
+int VfmMapLoad(void) {
+    char buf[VFM_MAP_BUF_SIZE];
+    int fd, len;
+
+    stats.loads++;
+    fd = open(map_node, O_RDONLY);
+    if (fd < 0) {
+        LOGE("vfm map: open %s error: %s\n", map_node, strerror(errno));
+        return -1;
+    }
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len < 0)
+        return -1;
+
+    buf[len] = '\0';
+    return VfmMapParse(buf);
+}
+
+const vfm_path_t *VfmMapGet(const char *name) {
+    int id;
+
+    if (!loaded)
+        VfmMapLoad();
+
+    id = Lookup(name, strlen(name), false);
+    if (id < 0 || paths[id].name[0] == '\0')
+        return NULL;
+    return &paths[id];
+}
+
+int VfmMapSave(const char *name, vfm_path_t *saved) {
+    const vfm_path_t *path = VfmMapGet(name);
+
+    if (path == NULL) {
+        memset(saved, 0, sizeof(*saved));
+        return -1;
+    }
+    *saved = *path;
+    return 0;
+}
+
+int VfmMapHasModule(const char *name, const char *module) {
+    const vfm_path_t *path = VfmMapGet(name);
+    int id;
+
+    if (path == NULL)
+        return 0;
+    id = Lookup(module, strlen(module), false);
+    return id >= 0 && (path->module_mask & (1ULL << id)) != 0;
+}
+
+int VfmMapAdd(const char *name, const char *modules) {
+    char cmd[VFM_CMD_SIZE];
+    int id;
+
+    if (!loaded)
+        VfmMapLoad();
+
+    snprintf(cmd, sizeof(cmd), "add %s %s", name, modules);
+    if (Write(cmd) < 0)
+        return -1;
+
+    id = Lookup(name, strlen(name), true);
+    if (id >= 0)
+        SetPath(id, modules, strlen(modules));
+    return 0;
+}
+
+int VfmMapRemove(const char *name) {
+    char cmd[VFM_CMD_SIZE];
+    int id;
+
+    if (!loaded)
+        VfmMapLoad();
+
+    snprintf(cmd, sizeof(cmd), "rm %s", name);
+    if (Write(cmd) < 0)
+        return -1;
+
+    id = Lookup(name, strlen(name), false);
+    if (id >= 0)
+        paths[id].name[0] = '\0';
+    return 0;
+}
+
+static int ReadFrameCount(void) {
+    char buf[32];
+    int fd = open(frame_count_node, O_RDONLY);
+    int len;
+
+    if (fd < 0)
+        return -1;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+
+    buf[len] = '\0';
+    return atoi(buf);
+}
+
+int VfmMapSafeRemove(const char *name) {
+    int wait_us = REMOVE_WAIT_MIN_US;
+    int waited_us = 0;
+    int read_failures = 0;
+
+    // tvserver edits the map too, decide on what the driver has now
+    VfmMapLoad();
+    if (VfmMapGet(name) == NULL)
+        return 0;
+
+    // frames only need to drain when the path ends in the video layer
+    if (VfmMapHasModule(name, "amvideo")) {
+        while (waited_us < REMOVE_WAIT_TOTAL_US) {
+            int count = ReadFrameCount();
+
+            if (count < 0) {
+                if (++read_failures < REMOVE_READ_RETRIES)
+                    continue;
+                LOGE("vfm map: can not read %s, remove %s anyway\n", frame_count_node, name);
+                break;
+            }
+            if (count == 0)
+                break;
+
+            usleep(wait_us);
+            waited_us += wait_us;
+            stats.remove_waits++;
+            wait_us *= 2;
+            if (wait_us > REMOVE_WAIT_MAX_US)
+                wait_us = REMOVE_WAIT_MAX_US;
+        }
+    }
+
+    return VfmMapRemove(name);
+}
+
+int VfmMapRestore(const vfm_path_t *saved) {
+    char modules[VFM_CMD_SIZE] = {0,};
+
+    if (saved->name[0] == '\0')
+        return 0;
+
+    for (int i = 0; i < saved->module_num; i++) {
+        if (i > 0)
+            strcat(modules, " ");
+        strcat(modules, saved->modules[i]);
+    }
+
+    // the driver refuses "rm" of a path it does not have
+    VfmMapLoad();
+    if (VfmMapGet(saved->name) != NULL)
+        VfmMapRemove(saved->name);
+    return VfmMapAdd(saved->name, modules);
+}
+
+void VfmMapGetStats(vfm_map_stats_t *s) {
+    *s = stats;
+}
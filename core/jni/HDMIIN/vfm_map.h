@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ *     AMLOGIC VFM_MAP
+ *
+ *     /sys/class/vfm/map parsed once into named paths of modules. Path and
+ *     module names are interned, so finding a path or checking whether it
+ *     contains a module is a hash lookup plus a bit test. The add/rm
+ *     commands issued through this module update the graph in place; the
+ *     map is parsed again when such a write fails, and before a safe remove
+ *     or a restore since tvserver edits the map too.
+ */
+
+#ifndef __VFM_MAP_H__
+#define __VFM_MAP_H__
+
+#define VFM_NAME_LEN                (32)
+#define VFM_MAX_MODULES             (16)
+#define VFM_MAX_NAMES               (64)
+
+typedef struct vfm_path {
+    char name[VFM_NAME_LEN];        /* empty when the path does not exist */
+    int module_num;
+    char modules[VFM_MAX_MODULES][VFM_NAME_LEN];
+    unsigned long long module_mask; /* bit per interned module name */
+} vfm_path_t;
+
+typedef struct vfm_map_stats {
+    unsigned int loads;             /* reads and parses of the map node */
+    unsigned int writes;
+    unsigned int write_failures;
+    unsigned int remove_waits;      /* backoff sleeps before a remove */
+} vfm_map_stats_t;
+
+/* write one command to the map node, returns 0 on success */
+typedef int (*vfm_map_writer)(const char *cmd);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void VfmMapInit(const char *map_node, const char *frame_count_node);
+void VfmMapSetWriter(vfm_map_writer writer);
+int VfmMapParse(const char *text);
+int VfmMapLoad(void);
+/* NULL when the path does not exist */
+const vfm_path_t *VfmMapGet(const char *name);
+/* copy a path for VfmMapRestore(), returns -1 when it does not exist */
+int VfmMapSave(const char *name, vfm_path_t *saved);
+int VfmMapHasModule(const char *name, const char *module);
+int VfmMapAdd(const char *name, const char *modules);
+int VfmMapRemove(const char *name);
+/* remove once the video layer has released its frames */
+int VfmMapSafeRemove(const char *name);
+int VfmMapRestore(const vfm_path_t *saved);
+void VfmMapGetStats(vfm_map_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -29,6 +29,8 @@
 #include "HDMIIN/audiodsp_control.h"
 #include "HDMIIN/audio_utils_ctl.h"
 #include "HDMIIN/mAlsa.h"
+#include "HDMIIN/hdmiin_monitor.h"
+#include "HDMIIN/vfm_map.h"
 #include "cutils/properties.h"
 
 #include <gui/IGraphicBufferProducer.h>
@@ -56,10 +58,9 @@ static bool sysfsChecked = false;
 static bool useSii9293 = false;
 static bool useSii9233a = false;
 
-static char vfmTvpath[PATH_MAX] = {0,};
-static char vfmDefaultExt[PATH_MAX] = {0,};
-static char vfmDefaultAmlvideo2[PATH_MAX] = {0,};
-static char vfmHdmiin[PATH_MAX] = {0,};
+static vfm_path_t vfmTvpath;
+static vfm_path_t vfmDefaultExt;
+static vfm_path_t vfmDefaultAmlvideo2;
 static bool rmPathFlag = false;
 static int inputSource = 0;
 static sp<ANativeWindow> window = NULL;
@@ -69,6 +70,11 @@ static bool isDisplayFullscreen = false;
 //check use ppmgr
 static bool usePpmgr = false;
 
+//signal change callback into HdmiInManager
+static JavaVM *javaVm = NULL;
+static jobject managerObj = NULL;
+static jmethodID onSignalChangedId = NULL;
+
 enum State{
     START,
     PAUSE,
@@ -239,14 +245,86 @@ static char* getFs(const char* path, const char* key, char *buf) {
     return buf;
 }
 
+/*
+ * Driver parameters are served from the monitor cache while HDMI-IN is
+ * initialized and the driver notifies on them, and read from sysfs
+ * otherwise: the cache of a node without sysfs_notify() is up to a
+ * poll timeout old.
+ */
+static int readParam(int node, const char* key, char* buf) {
+    hdmiin_signal_state_t state;
+    char fsBuf[PATH_MAX] = {0,};
+
+    if (HdmiInMonitorGetState(&state) == 0 && state.notified[node]) {
+        if (!state.valid[node])
+            return -1;
+        strcpy(buf, state.value[node]);
+        return 0;
+    }
+
+    return readValue(getFs(paramPath, key, fsBuf), buf);
+}
+
+static int readParam(int node, const char* key) {
+    hdmiin_signal_state_t state;
+    char fsBuf[PATH_MAX] = {0,};
+
+    if (HdmiInMonitorGetState(&state) == 0 && state.notified[node])
+        return state.valid[node] ? atoi(state.value[node]) : 0;
+
+    return readValue(getFs(paramPath, key, fsBuf));
+}
+
+static void signalChanged(const hdmiin_signal_state_t *state, void *user) {
+    JNIEnv *env = NULL;
+
+    if (javaVm == NULL || managerObj == NULL || onSignalChangedId == NULL)
+        return;
+
+    if (javaVm->AttachCurrentThread(&env, NULL) != JNI_OK) {
+        ALOGE("signalChanged, attach thread failed");
+        return;
+    }
+    ALOGV("signal changed (%u): %s", state->changes, state->value[HDMIIN_NODE_INPUT_MODE]);
+    env->CallVoidMethod(managerObj, onSignalChangedId);
+    if (env->ExceptionCheck()) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+    javaVm->DetachCurrentThread();
+}
+
+static void startMonitor(JNIEnv *env, jobject obj) {
+    jclass clazz;
+
+    env->GetJavaVM(&javaVm);
+    managerObj = env->NewGlobalRef(obj);
+    clazz = env->GetObjectClass(obj);
+    onSignalChangedId = env->GetMethodID(clazz, "onNativeSignalChanged", "()V");
+    if (onSignalChangedId == NULL)
+        env->ExceptionClear();
+    env->DeleteLocalRef(clazz);
+
+    HdmiInMonitorStart(paramPath, signalChanged, NULL);
+}
+
+static void stopMonitor(JNIEnv *env) {
+    HdmiInMonitorStop();
+    if (managerObj != NULL) {
+        env->DeleteGlobalRef(managerObj);
+        managerObj = NULL;
+    }
+    onSignalChangedId = NULL;
+}
+
 static void dispAndroid() {
     char fsBuf[PATH_MAX] = {0,};
     memset(fsBuf, 0, sizeof(fsBuf));
     sendCommand(getFs(classPath, "enable", fsBuf) , "0"); // disable "hdmi in"
     //sendCommand(PPSCALER_PATH, "0"); // disable pscaler  for "hdmi in"
 
-    sendCommand(VFM_MAP_PATH, "rm default_ext" );
-    sendCommand(VFM_MAP_PATH, "add default_ext vdin0 vm amvideo" );
+    VfmMapRemove("default_ext");
+    VfmMapAdd("default_ext", "vdin0 vm amvideo");
     sendCommand(BYPASS_PROG_PATH, "0" );
 
      /* set and enable freescale */
@@ -269,8 +347,8 @@ static void dispHdmi() {
     sendCommand(getFs(classPath, "enable", fsBuf) , "0"); // disable "hdmi in"
     sendCommand(DISABLE_VIDEO_PATH, "2"); // disable video layer, video layer will be enabled after "hdmi in" is enabled
 
-    sendCommand(VFM_MAP_PATH, "rm default_ext" );
-    sendCommand(VFM_MAP_PATH, "add default_ext vdin0 deinterlace amvideo" );
+    VfmMapRemove("default_ext");
+    VfmMapAdd("default_ext", "vdin0 deinterlace amvideo");
     sendCommand(BYPASS_PROG_PATH, "1" );
 
      /* disable OSD layer */
@@ -358,140 +436,6 @@ static void checkSysfs() {
     ALOGV("paramPath %s", paramPath);
 }
 
-static void getPath(const char *name, char *vfmPath) {
-    int len = 0;
-    int offset = 0;
-    char* ptr = NULL;
-    char* starptr = NULL;
-    char buf[1024*4]={0,};
-    int fd = open(VFM_MAP_PATH, O_RDWR);
-    if(fd >= 0) {
-        len = read(fd, buf, sizeof(buf));
-        close(fd);
-        if(len > 0) {
-            ptr = strstr(buf, name);
-            if(ptr) {
-                starptr = ptr;
-                ptr = strchr(starptr, '}');
-                if(ptr) {
-                    offset = ptr - starptr + 1;
-                    strncpy(vfmPath, starptr, offset);
-                }
-            }
-        }
-    }
-}
-
-static void resumePath(const char *name, char *vfmPath)
-{
-    char* ptr = NULL;
-    char* endptr = NULL;
-    int offset = 0;
-    char path[512]={0,};
-    char buf[512]={0,};
-    char *bufptr = NULL;
-    char *context = NULL;
-    char cmd[32] = {0,};
-
-    if(strlen(vfmPath) > 0) {
-        memset(cmd, 0, sizeof(cmd));
-        sprintf(cmd, "rm %s\n", name);
-        sendCommand(VFM_MAP_PATH, cmd);
-
-        endptr = strchr(vfmPath, '}');
-        ptr = strchr(vfmPath, '{');
-        strncpy(buf, ptr + 1, endptr - ptr - 1);
-        bufptr = buf;
-        snprintf(path, sizeof(path), "add %s ", name);
-        while ((ptr = strtok_r(bufptr, " ", &context)) != NULL) {
-            if (strlen(ptr) > 0) {
-                endptr = strchr(ptr, '(');
-                if (endptr != NULL) {
-                    offset = endptr - ptr;
-                    strncat(path, ptr, offset);
-                    strcat(path, " ");
-                } else
-                    strcat(path, ptr);
-            }
-            bufptr = NULL;
-        }
-        sendCommand(VFM_MAP_PATH, path);
-    }
-}
-
-static bool searchPath(const char *vfmPath, const char *module) {
-    char *ptr = NULL;
-    char *endptr = NULL;
-    char buf[512] = {0,};
-    char *bufptr = NULL;
-    char *context = NULL;
-    char node[128] = {0,};
-
-    if (strlen(vfmPath) > 0) {
-        endptr = strchr(vfmPath, '}');
-        ptr = strchr(vfmPath, '{');
-        strncpy(buf, ptr + 1, endptr - ptr - 1);
-        bufptr = buf;
-        while ((ptr = strtok_r(bufptr, " ", &context)) != NULL) {
-            if (strlen(ptr) > 0) {
-                endptr = strchr(ptr, '(');
-                memset(node, 0, sizeof(node));
-                if (endptr != NULL) {
-                    strncpy(node, ptr, endptr - ptr);
-                } else
-                    strcpy(node, ptr);
-                if (!strcmp(node, module))
-                    return true;
-            }
-            bufptr = NULL;
-        }
-    }
-
-    return false;
-}
-
-static void safeRmPath(const char* path) {
-    int retry = 20; //retry 20 times
-    int len = 0;
-    int readRlt = 0;
-    char buf[512]={0,};
-    char cmd[512]={0,};
-
-    if (!strcmp(path, "hdmiin") && strlen(vfmHdmiin) > 0) {
-        if (!searchPath(vfmHdmiin, "amvideo")) {
-            sendCommand(VFM_MAP_PATH, "rm hdmiin");
-            return;
-        }
-    }
-
-    strcpy(cmd, "rm ");
-    while(retry > 0) {
-        int fd = open(VIDEO_FRAME_COUNT_PATH, O_RDONLY);
-        if (fd >= 0) {
-            memset(buf, 0, sizeof(buf));
-            len = read(fd, buf, sizeof(buf));
-            close(fd);
-            if (len > 0) {
-                readRlt = atoi(buf);
-                if(readRlt > 0)
-                    sleep(1);  // sleep 10 ms
-                else if(readRlt == 0) {
-                    strcat(cmd, path);
-                    sendCommand(VFM_MAP_PATH, cmd);
-                    break;
-                } else
-                    break;
-            }
-        }
-        retry--;
-
-        if(retry == 0) {
-            strcat(cmd, path);
-            sendCommand(VFM_MAP_PATH, cmd);
-        }
-    }
-}
-
 static bool checkBoolProp(const char *name, const char *def) {
     char prop[PROPERTY_VALUE_MAX] = {0,};
 
@@ -553,25 +497,25 @@ static void init(JNIEnv *env, jobject obj, int source, bool isFullscreen) {
             ALOGE("mScreenDev == NULL");
     }
 
-    //rm tvpath for conflict
-    memset(vfmTvpath, 0, sizeof(vfmTvpath));
-    memset(vfmDefaultExt, 0, sizeof(vfmDefaultExt));
-    memset(vfmDefaultAmlvideo2, 0, sizeof(vfmDefaultAmlvideo2));
-    memset(vfmHdmiin, 0, sizeof(vfmHdmiin));
-    getPath("tvpath ", vfmTvpath);
-    sendCommand(VFM_MAP_PATH, "rm tvpath");
-    getPath("default_ext ", vfmDefaultExt);
-    sendCommand(VFM_MAP_PATH, "rm default_ext");
+    //rm tvpath for conflict, the map is read once and then kept in step
+    //with our own add/rm commands until deinit()
+    VfmMapInit(VFM_MAP_PATH, VIDEO_FRAME_COUNT_PATH);
+    VfmMapLoad();
+    if (VfmMapSave("tvpath", &vfmTvpath) == 0)
+        VfmMapRemove("tvpath");
+    if (VfmMapSave("default_ext", &vfmDefaultExt) == 0)
+        VfmMapRemove("default_ext");
+    memset(&vfmDefaultAmlvideo2, 0, sizeof(vfmDefaultAmlvideo2));
     if (!isDisplayFullscreen || !useVideoLayer) {
-        getPath("default_amlvideo2 ", vfmDefaultAmlvideo2);
-        sendCommand(VFM_MAP_PATH, "rm default_amlvideo2");
+        if (VfmMapSave("default_amlvideo2", &vfmDefaultAmlvideo2) == 0)
+            VfmMapRemove("default_amlvideo2");
     }
 
-    safeRmPath("hdmiin");
+    VfmMapSafeRemove("hdmiin");
     if (usePpmgr) {
         ALOGV("usePpmgr\n");
-        // sendCommand(VFM_MAP_PATH, "rm default_amlvideo2" );
-        sendCommand(VFM_MAP_PATH, "add hdmiin vdin0 amlvideo2 ppmgr amvideo" );
+        // VfmMapRemove("default_amlvideo2");
+        VfmMapAdd("hdmiin", "vdin0 amlvideo2 ppmgr amvideo");
 
         /* set and enable freescale */
         sendCommand(FREESCALE_PATH, "0");
@@ -582,9 +526,9 @@ static void init(JNIEnv *env, jobject obj, int source, bool isFullscreen) {
         sendCommand(FREESCALE_1_PATH, "1");
     } else {
         if (isDisplayFullscreen && useVideoLayer)
-            sendCommand(VFM_MAP_PATH, "add hdmiin vdin0 amvideo");
+            VfmMapAdd("hdmiin", "vdin0 amvideo");
         else
-            sendCommand(VFM_MAP_PATH, "add hdmiin vdin0 amlvideo2");
+            VfmMapAdd("hdmiin", "vdin0 amlvideo2");
     }
 
     if (useSii9233a) {
@@ -606,6 +550,8 @@ static void init(JNIEnv *env, jobject obj, int source, bool isFullscreen) {
     }
     if (isDisplayFullscreen && useVideoLayer)
         sendCommand(HDMIIN_ON_VIDEO_PATH, "1");
+
+    startMonitor(env, obj);
 }
 
 static void setMwFull();
@@ -613,6 +559,7 @@ static void setMwFull();
 static void deinit(JNIEnv *env, jobject obj) {
     char fsBuf[PATH_MAX] = {0,};
     videoEnable = 0;
+    stopMonitor(env);
 
     if (useSii9233a || useSii9293) {
         memset(fsBuf, 0, sizeof(fsBuf));
@@ -627,13 +574,11 @@ static void deinit(JNIEnv *env, jobject obj) {
     if (isDisplayFullscreen && useVideoLayer)
         sendCommand(DISABLE_VIDEO_PATH, "2");
 
-    memset(vfmHdmiin, 0, sizeof(vfmHdmiin));
-    getPath("hdmiin ", vfmHdmiin);
-    safeRmPath("hdmiin");
-    resumePath("tvpath", vfmTvpath);
-    resumePath("default_ext", vfmDefaultExt);
+    VfmMapSafeRemove("hdmiin");
+    VfmMapRestore(&vfmTvpath);
+    VfmMapRestore(&vfmDefaultExt);
     if (!isDisplayFullscreen || !useVideoLayer)
-        resumePath("default_amlvideo2", vfmDefaultAmlvideo2);
+        VfmMapRestore(&vfmDefaultAmlvideo2);
     else
         sendCommand(HDMIIN_ON_VIDEO_PATH, "0");
     sysfsChecked = false;
@@ -764,7 +709,6 @@ static void displayPip(JNIEnv *env, jobject obj, jint x, jint y, jint width, jin
 }
 
 static jint getHActive(JNIEnv *env, jobject obj) {
-    char fsBuf[PATH_MAX] = {0,};
     char value[128] = {0,};
     char buf[16] = {0,};
     int ret = 0;
@@ -772,8 +716,7 @@ static jint getHActive(JNIEnv *env, jobject obj) {
 
     if (useSii9233a || useSii9293) {
         memset(value, 0, sizeof(value));
-        memset(fsBuf, 0, sizeof(fsBuf));
-        ret = readValue(getFs(paramPath, "input_mode", fsBuf), value);
+        ret = readParam(HDMIIN_NODE_INPUT_MODE, "input_mode", value);
         if (ret == -1)
             return ret;
 
@@ -792,20 +735,17 @@ static jint getHActive(JNIEnv *env, jobject obj) {
         }
     }
 
-    memset(fsBuf, 0, sizeof(fsBuf));
-    return readValue(getFs(paramPath, "horz_active", fsBuf));
+    return readParam(HDMIIN_NODE_HORZ_ACTIVE, "horz_active");
 }
 
 static jstring getHdmiInSize(JNIEnv *env, jobject obj) {
     char value[128] = {0,};
-    char fsBuf[PATH_MAX] = {0,};
     int ret = 0;
 
     checkSysfs();
     if (useSii9233a || useSii9293) {
         memset(value, 0, sizeof(value));
-        memset(fsBuf, 0, sizeof(fsBuf));
-        ret = readValue(getFs(paramPath, "input_mode", fsBuf), value);
+        ret = readParam(HDMIIN_NODE_INPUT_MODE, "input_mode", value);
         if (ret == -1)
             return NULL;
 
@@ -820,15 +760,13 @@ static jstring getHdmiInSize(JNIEnv *env, jobject obj) {
 
 static jint getVActive(JNIEnv *env, jobject obj) {
     char value[128] = {0,};
-    char fsBuf[PATH_MAX] = {0,};
     char buf[16] = {0,};
     int ret = 0;
     unsigned int i = 0;
 
     if (useSii9233a || useSii9293) {
         memset(value, 0, sizeof(value));
-        memset(fsBuf, 0, sizeof(fsBuf));
-        ret = readValue(getFs(paramPath, "input_mode", fsBuf), value);
+        ret = readParam(HDMIIN_NODE_INPUT_MODE, "input_mode", value);
         if (ret == -1)
             return ret;
 
@@ -847,20 +785,17 @@ static jint getVActive(JNIEnv *env, jobject obj) {
         }
     }
 
-    memset(fsBuf, 0, sizeof(fsBuf));
-    return readValue(getFs(paramPath, "vert_active", fsBuf));
+    return readParam(HDMIIN_NODE_VERT_ACTIVE, "vert_active");
 }
 
 static jboolean isDvi(JNIEnv *env, jobject obj) {
     char value[128] = {0,};
-    char fsBuf[PATH_MAX] = {0,};
     char buf[16] = {0,};
     int ret = 0;
 
     if (useSii9233a || useSii9293) {
         memset(value, 0, sizeof(value));
-        memset(fsBuf, 0, sizeof(fsBuf));
-        ret = readValue(getFs(paramPath, "input_mode", fsBuf), value);
+        ret = readParam(HDMIIN_NODE_INPUT_MODE, "input_mode", value);
         if (ret == -1)
             return JNI_FALSE;
 
@@ -875,8 +810,7 @@ static jboolean isDvi(JNIEnv *env, jobject obj) {
         return (strcmp(buf, "DVI") == 0);
     }
 
-    memset(fsBuf, 0, sizeof(fsBuf));
-    return (readValue(getFs(paramPath, "is_hdmi_mode", fsBuf)) == 0);
+    return (readParam(HDMIIN_NODE_IS_HDMI_MODE, "is_hdmi_mode") == 0);
 }
 
 static jboolean isPowerOn(JNIEnv *env, jobject obj) {
@@ -933,15 +867,13 @@ static jboolean isEnable(JNIEnv *env, jobject obj) {
 
 static jboolean isInterlace(JNIEnv *env, jobject obj) {
     char value[128] = {0,};
-    char fsBuf[PATH_MAX] = {0,};
     char buf[16] = {0,};
     int ret = 0;
     unsigned int i = 0;
 
     if (useSii9233a || useSii9293) {
-        memset(fsBuf, 0, sizeof(fsBuf));
         memset(value, 0, sizeof(value));
-        ret = readValue(getFs(paramPath, "input_mode", fsBuf), value);
+        ret = readParam(HDMIIN_NODE_INPUT_MODE, "input_mode", value);
         if (ret == -1)
             return JNI_FALSE;
 
@@ -960,8 +892,7 @@ static jboolean isInterlace(JNIEnv *env, jobject obj) {
         }
     }
 
-    memset(buf, 0, sizeof(buf));
-    return (readValue(getFs(paramPath, "is_interlace", fsBuf)) == 1);
+    return (readParam(HDMIIN_NODE_IS_INTERLACE, "is_interlace") == 1);
 }
 
 static jboolean hdmiPlugged(JNIEnv *env, jobject obj) {
@@ -1021,8 +952,7 @@ static jint handleAudio(JNIEnv *env, jobject obj) {
 
     audioReady = 0;
     memset(value, 0, sizeof(value));
-    memset(fsBuf, 0, sizeof(fsBuf));
-    ret = readValue(getFs(paramPath, "audio_sample_rate", fsBuf), value);
+    ret = readParam(HDMIIN_NODE_AUDIO_SAMPLE_RATE, "audio_sample_rate", value);
     if (ret == -1)
         audioReady = 0;
     else if (strstr(value, "kHz") != NULL)
@@ -1068,6 +998,28 @@ static jint handleAudio(JNIEnv *env, jobject obj) {
     return audioReady;
 }
 
+/*
+ * Returns {delay us, target occupancy us, underruns, overruns} of the
+ * HDMI-IN audio pipeline, or null while audio is not running.
+ */
+static jintArray getAudioLatency(JNIEnv *env, jobject obj) {
+    mAlsaLatencyInfo info;
+    jint values[4];
+    jintArray array;
+
+    if (audioState == 0 || mAlsaGetLatencyInfo(&info) < 0)
+        return NULL;
+
+    values[0] = info.delay_us;
+    values[1] = info.target_us;
+    values[2] = info.underruns;
+    values[3] = info.overruns;
+    array = env->NewIntArray(4);
+    if (array != NULL)
+        env->SetIntArrayRegion(array, 0, 4, values);
+    return array;
+}
+
 static void setEnable(JNIEnv *env, jobject obj, jboolean enable) {
     char fsBuf[PATH_MAX] = {0,};
     if (enable) {
@@ -1246,6 +1198,7 @@ static JNINativeMethod sMethods[] =
     {"_hdmiSignal", "()Z", (void*)hdmiSignal},
     {"_enableAudio", "(I)V", (void*)enableAudio},
     {"_handleAudio", "()I", (void*)handleAudio},
+    {"_getAudioLatency", "()[I", (void*)getAudioLatency},
     {"_setEnable", "(Z)V", (void*)setEnable},
     {"_setSourceType", "()I", (void*)setSourceType},
     {"_isSurfaceAvailable", "(Landroid/view/Surface;)Z", (void*)isSurfaceAvailable},
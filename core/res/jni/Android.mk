@@ -3,7 +3,8 @@ LOCAL_PATH := $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
-    uevent.cpp
+    uevent.cpp \
+    uevent_matcher.cpp
 
 LOCAL_C_INCLUDES := \
     libnativehelper/include_jni
@@ -36,4 +37,4 @@ endif
 LOCAL_SRC_FILES := $(LOCAL_MODULE)
 include $(BUILD_PREBUILT)
 
-
+include $(LOCAL_PATH)/tests/Android.mk
@@ -0,0 +1,17 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    uevent_matcher_test.cpp \
+    ../uevent_matcher.cpp
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/..
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-uevent-jni-matcher
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
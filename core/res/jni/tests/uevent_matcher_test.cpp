@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Host test for the UEventObserver JNI matcher: the automaton must agree
+ * with the old per field strstr() scan on every message of a generated
+ * corpus, keep working while another thread adds and removes match strings,
+ * and the messages per second of both are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "uevent_matcher.h"
+
+using namespace android;
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+#define CORPUS_SIZE     10000
+
+// what the framework observers register, substrings of a field
+static const char* sMatches[] = {
+    "DEVPATH=/devices/virtual/switch/hdmi",
+    "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi",
+    "DEVPATH=/devices/virtual/switch/hdmi_audio",
+    "SUBSYSTEM=power_supply",
+    "hdmirx",
+    "DEVPATH=/devices/virtual/misc/uinput",
+    "usb_interface",
+    "SWITCH_NAME=video_layer1",
+};
+
+// the scan uevent.cpp did before the automaton
+static bool legacyMatch(const std::vector<std::string>& matches, const char* buffer,
+        size_t length) {
+    for (size_t i = 0; i < matches.size(); i++) {
+        const char* field = buffer;
+        const char* end = buffer + length + 1;
+        do {
+            if (strstr(field, matches[i].c_str()))
+                return true;
+            field += strlen(field) + 1;
+        } while (field != end);
+    }
+    return false;
+}
+
+// fields separated by '\n' in the source text, '\0' on the wire
+static std::string message(const char* text) {
+    std::string msg(text);
+
+    for (size_t i = 0; i < msg.size(); i++) {
+        if (msg[i] == '\n')
+            msg[i] = '\0';
+    }
+    return msg;
+}
+
+static void buildCorpus(std::vector<std::string>& corpus) {
+    char text[1024];
+
+    srand(20080101);
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        int kind = rand() % 100;
+        int seq = 1000 + i;
+
+        if (kind < 40) {
+            snprintf(text, sizeof(text),
+                "add@/devices/platform/ff500000.dwc2_a/usb1/1-1/1-1:1.%d\nACTION=add\n"
+                "DEVPATH=/devices/platform/ff500000.dwc2_a/usb1/1-1/1-1:1.%d\nSUBSYSTEM=usb\n"
+                "DEVTYPE=%s\nPRODUCT=46d/c52b/1211\nTYPE=0/0/0\nSEQNUM=%d",
+                i % 4, i % 4, (i % 7) ? "usb_device" : "usb_interface", seq);
+        } else if (kind < 70) {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/block/loop%d\nACTION=change\n"
+                "DEVPATH=/devices/virtual/block/loop%d\nSUBSYSTEM=block\nMAJOR=7\n"
+                "MINOR=%d\nDEVNAME=loop%d\nDEVTYPE=disk\nSEQNUM=%d",
+                i % 16, i % 16, i % 16, i % 16, seq);
+        } else if (kind < 80) {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/power_supply/battery\nACTION=change\n"
+                "DEVPATH=/devices/virtual/power_supply/battery\nSUBSYSTEM=power_supply\n"
+                "POWER_SUPPLY_CAPACITY=%d\nSEQNUM=%d", i % 100, seq);
+        } else if (kind < 90) {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/switch/hdmi%s\nACTION=change\n"
+                "DEVPATH=/devices/virtual/switch/hdmi%s\nSUBSYSTEM=switch\n"
+                "SWITCH_NAME=hdmi\nSWITCH_STATE=%d\nSEQNUM=%d",
+                (i & 2) ? "_audio" : "", (i & 2) ? "_audio" : "", i & 1, seq);
+        } else {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/thermal/thermal_zone%d\nACTION=change\n"
+                "DEVPATH=/devices/virtual/thermal/thermal_zone%d\nSUBSYSTEM=thermal\n"
+                "TRIP=%d\nSEQNUM=%d", i % 3, i % 3, i % 5, seq);
+        }
+        corpus.push_back(message(text));
+    }
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void testAutomaton() {
+    std::vector<std::string> matches;
+    matches.push_back("he");
+    matches.push_back("she");
+    matches.push_back("hers");
+    UeventAutomaton automaton(matches);
+    std::string msg;
+
+    CHECK(automaton.matches("ushers", 6));
+    CHECK(automaton.matches("xhe", 3));
+    CHECK(!automaton.matches("hxe", 3));
+    // no match across a field boundary
+    msg = message("xxs\nhx\nh\ne");
+    CHECK(!automaton.matches(msg.c_str(), msg.size()));
+    msg = message("xxs\nshe");
+    CHECK(automaton.matches(msg.c_str(), msg.size()));
+
+    std::vector<std::string> none;
+    UeventAutomaton empty(none);
+    CHECK(!empty.matches("anything", 8));
+    CHECK(empty.stateCount() == 1);
+
+    none.push_back("");
+    UeventAutomaton always(none);
+    CHECK(always.matches("", 0));
+}
+
+static void testCorpus() {
+    std::vector<std::string> corpus;
+    std::vector<std::string> matches;
+    UeventMatcher matcher;
+    int matched = 0;
+
+    buildCorpus(corpus);
+    for (size_t i = 0; i < sizeof(sMatches) / sizeof(sMatches[0]); i++) {
+        matches.push_back(sMatches[i]);
+        matcher.addMatch(sMatches[i]);
+    }
+
+    for (size_t i = 0; i < corpus.size(); i++) {
+        bool want = legacyMatch(matches, corpus[i].c_str(), corpus[i].size());
+        bool got = matcher.isMatch(corpus[i].c_str(), corpus[i].size());
+        CHECK(want == got);
+        if (want != got) {
+            printf("  message %d differs\n", (int)i);
+            break;
+        }
+        if (got)
+            matched++;
+    }
+    printf("corpus: %d messages, %d matched\n", (int)corpus.size(), matched);
+    CHECK(matched > CORPUS_SIZE / 10 && matched < CORPUS_SIZE * 9 / 10);
+
+    // removing one of two equal strings keeps the other
+    matcher.addMatch("SUBSYSTEM=thermal");
+    matcher.addMatch("SUBSYSTEM=thermal");
+    std::string thermal = message("change@/x\nSUBSYSTEM=thermal");
+    matcher.removeMatch("SUBSYSTEM=thermal");
+    CHECK(matcher.isMatch(thermal.c_str(), thermal.size()));
+    matcher.removeMatch("SUBSYSTEM=thermal");
+    CHECK(!matcher.isMatch(thermal.c_str(), thermal.size()));
+
+    int rounds = 20;
+    volatile int sink = 0;
+    int64_t start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < corpus.size(); i++)
+            sink += legacyMatch(matches, corpus[i].c_str(), corpus[i].size());
+    }
+    int64_t legacyNs = nowNs() - start;
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < corpus.size(); i++)
+            sink += matcher.isMatch(corpus[i].c_str(), corpus[i].size());
+    }
+    int64_t matcherNs = nowNs() - start;
+
+    double total = (double)rounds * corpus.size();
+    printf("strstr scan: %.0f messages/s, automaton: %.0f messages/s\n",
+        total * 1e9 / legacyNs, total * 1e9 / matcherNs);
+}
+
+static std::atomic<bool> gStop(false);
+static UeventMatcher* gSwapMatcher;
+
+static void* swapLoop(void* data) {
+    while (!gStop) {
+        gSwapMatcher->addMatch("SUBSYSTEM=thermal");
+        gSwapMatcher->removeMatch("SUBSYSTEM=thermal");
+    }
+    return NULL;
+}
+
+static void testConcurrentSwap() {
+    UeventMatcher matcher;
+    std::string hdmi = message("change@/devices/virtual/switch/hdmi\n"
+        "DEVPATH=/devices/virtual/switch/hdmi\nSWITCH_STATE=1");
+    std::string usb = message("add@/devices/usb1\nSUBSYSTEM=usb");
+    pthread_t thread;
+    int misses = 0;
+
+    matcher.addMatch(sMatches[0]);
+    gSwapMatcher = &matcher;
+    pthread_create(&thread, NULL, swapLoop, NULL);
+    // the receive side keeps seeing a complete automaton while it is replaced
+    for (int i = 0; i < 200000; i++) {
+        if (!matcher.isMatch(hdmi.c_str(), hdmi.size()) || matcher.isMatch(usb.c_str(), usb.size()))
+            misses++;
+    }
+    gStop = true;
+    pthread_join(thread, NULL);
+    CHECK(misses == 0);
+}
+
+int main(int argc, char** argv) {
+    testAutomaton();
+    testCorpus();
+    testConcurrentSwap();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
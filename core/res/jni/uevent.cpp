@@ -19,16 +19,20 @@
 
 #include "jni.h"
 
-#include <utils/Mutex.h>
-#include <utils/Vector.h>
-#include <utils/String8.h>
+#include <utils/Log.h>
 #include <cutils/uevent.h>
 
+#include "uevent_matcher.h"
+
+// well above the kernel uevent buffer plus the action@devpath header
+#define UEVENT_MSG_LEN (8 * 1024)
+
 namespace android {
 
-static Mutex gMatchesMutex;
-static Vector<String8> gMatches;
+static UeventMatcher gMatcher;
 static int gFd;
+// only the UEventObserver thread receives
+static char gBuffer[UEVENT_MSG_LEN];
 
 static void nativeSetup(JNIEnv *env, jclass clazz) {
     gFd = uevent_open_socket(64*1024, true);
@@ -37,64 +41,46 @@ static void nativeSetup(JNIEnv *env, jclass clazz) {
     }
 }
 
-static bool isMatch(const char* buffer, size_t length) {
-    AutoMutex _l(gMatchesMutex);
-
-    for (size_t i = 0; i < gMatches.size(); i++) {
-        const String8& match = gMatches.itemAt(i);
-
-        // Consider all zero-delimited fields of the buffer.
-        const char* field = buffer;
-        const char* end = buffer + length + 1;
-        do {
-            if (strstr(field, match.string())) {
-                //ALOGD("Matched uevent message with pattern: %s", match.string());
-                return true;
-            }
-            field += strlen(field) + 1;
-        } while (field != end);
-    }
-    return false;
-}
-
 static jstring nativeWaitForNextEvent(JNIEnv *env, jclass clazz) {
-    char buffer[1024];
+    char* buffer = gBuffer;
 
     for (;;) {
-        int length = uevent_kernel_multicast_recv(gFd, buffer, 1022);
+        int length = uevent_kernel_multicast_recv(gFd, buffer, UEVENT_MSG_LEN - 1);
         if (length <= 0) {
             return NULL;
         }
         buffer[length] = '\0';
 
-        if (isMatch(buffer, length)) {
-            // Assume the message is ASCII.
-            jchar message[length];
+        if (gMatcher.isMatch(buffer, length)) {
+            // NewStringUTF stops at '\0', UEvent splits the fields at '\n'.
+            // Keep it valid modified UTF-8, the message should be ASCII anyway.
             for (int i = 0; i < length; i++) {
-                message[i] = buffer[i];
+                if (buffer[i] == '\0')
+                    buffer[i] = '\n';
+                else if ((unsigned char)buffer[i] >= 0x80)
+                    buffer[i] = '?';
             }
-            return env->NewString(message, length);
+            return env->NewStringUTF(buffer);
         }
     }
 }
 
 static void nativeAddMatch(JNIEnv* env, jclass clazz, jstring matchStr) {
     const char* match = env->GetStringUTFChars(matchStr, NULL);
+    if (match == NULL)
+        return;
 
-    AutoMutex _l(gMatchesMutex);
-    gMatches.add(String8(match));
+    gMatcher.addMatch(match);
+    env->ReleaseStringUTFChars(matchStr, match);
 }
 
 static void nativeRemoveMatch(JNIEnv* env, jclass clazz, jstring matchStr) {
     const char* match = env->GetStringUTFChars(matchStr, NULL);
+    if (match == NULL)
+        return;
 
-    AutoMutex _l(gMatchesMutex);
-    for (size_t i = 0; i < gMatches.size(); i++) {
-        if (gMatches.itemAt(i) == match) {
-            gMatches.removeAt(i);
-            break; // only remove first occurrence
-        }
-    }
+    gMatcher.removeMatch(match);
+    env->ReleaseStringUTFChars(matchStr, match);
 }
 
 static const JNINativeMethod gMethods[] = {
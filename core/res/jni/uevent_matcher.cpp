@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "uevent_matcher.h"
+
+namespace android {
+
+UeventAutomaton::UeventAutomaton(const std::vector<std::string>& matches) {
+    memset(mClass, 0, sizeof(mClass));
+    mClassCount = 1;
+    for (size_t i = 0; i < matches.size(); i++) {
+        for (size_t j = 0; j < matches[i].size(); j++) {
+            uint8_t c = matches[i][j];
+            if (mClass[c] == 0)
+                mClass[c] = mClassCount++;
+        }
+    }
+
+    // trie, -1 for a missing edge
+    mNext.assign(mClassCount, -1);
+    mOutput.assign(1, 0);
+    for (size_t i = 0; i < matches.size(); i++) {
+        int state = 0;
+        for (size_t j = 0; j < matches[i].size(); j++) {
+            int cls = mClass[(uint8_t)matches[i][j]];
+            if (mNext[state * mClassCount + cls] < 0) {
+                mNext[state * mClassCount + cls] = mOutput.size();
+                mNext.resize(mNext.size() + mClassCount, -1);
+                mOutput.push_back(0);
+            }
+            state = mNext[state * mClassCount + cls];
+        }
+        mOutput[state] = 1;
+    }
+
+    // breadth first: failure links, then fill the missing edges from them
+    std::vector<int32_t> fail(mOutput.size(), 0);
+    std::vector<int32_t> queue;
+    queue.reserve(mOutput.size());
+    for (int cls = 0; cls < mClassCount; cls++) {
+        int32_t& next = mNext[cls];
+        if (next < 0) {
+            next = 0;
+        } else {
+            fail[next] = 0;
+            queue.push_back(next);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        int state = queue[head];
+        for (int cls = 0; cls < mClassCount; cls++) {
+            int32_t& next = mNext[state * mClassCount + cls];
+            int32_t fallback = mNext[fail[state] * mClassCount + cls];
+            if (next < 0) {
+                next = fallback;
+            } else {
+                fail[next] = fallback;
+                mOutput[next] |= mOutput[fallback];
+                queue.push_back(next);
+            }
+        }
+    }
+
+    // store row offsets and key the output on them too, the scan then needs
+    // no arithmetic beyond one add per byte
+    for (size_t i = 0; i < mNext.size(); i++)
+        mNext[i] *= mClassCount;
+    std::vector<uint8_t> output(mNext.size(), 0);
+    for (size_t i = 0; i < mOutput.size(); i++)
+        output[i * mClassCount] = mOutput[i];
+    mOutput.swap(output);
+}
+
+bool UeventAutomaton::matches(const char* buffer, size_t length) const {
+    const int32_t* next = mNext.data();
+    const uint8_t* output = mOutput.data();
+    int state = 0;
+
+    // an empty match string is in every message
+    if (output[0])
+        return true;
+    for (size_t i = 0; i < length; i++) {
+        state = next[state + mClass[(uint8_t)buffer[i]]];
+        if (output[state])
+            return true;
+    }
+    return false;
+}
+
+UeventMatcher::UeventMatcher()
+    : mCurrent(NULL), mHazard(NULL) {
+    pthread_mutex_init(&mLock, NULL);
+    publish();
+}
+
+UeventMatcher::~UeventMatcher() {
+    delete mCurrent.load();
+    for (size_t i = 0; i < mRetired.size(); i++)
+        delete mRetired[i];
+    pthread_mutex_destroy(&mLock);
+}
+
+// called with mLock held, or from the constructor
+void UeventMatcher::publish() {
+    const UeventAutomaton* old = mCurrent.exchange(new UeventAutomaton(mMatches));
+    if (old != NULL)
+        mRetired.push_back(old);
+
+    // free everything the reader is not scanning right now
+    const UeventAutomaton* inUse = mHazard.load();
+    for (size_t i = 0; i < mRetired.size(); ) {
+        if (mRetired[i] != inUse) {
+            delete mRetired[i];
+            mRetired.erase(mRetired.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+void UeventMatcher::addMatch(const char* match) {
+    pthread_mutex_lock(&mLock);
+    mMatches.push_back(match);
+    publish();
+    pthread_mutex_unlock(&mLock);
+}
+
+void UeventMatcher::removeMatch(const char* match) {
+    pthread_mutex_lock(&mLock);
+    for (size_t i = 0; i < mMatches.size(); i++) {
+        if (mMatches[i] == match) {
+            mMatches.erase(mMatches.begin() + i);
+            publish();
+            break; // only remove first occurrence
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+bool UeventMatcher::isMatch(const char* buffer, size_t length) {
+    const UeventAutomaton* automaton = mCurrent.load();
+
+    // publish the hazard, then make sure it was not retired meanwhile
+    while (true) {
+        mHazard.store(automaton);
+        const UeventAutomaton* current = mCurrent.load();
+        if (current == automaton)
+            break;
+        automaton = current;
+    }
+
+    bool matched = automaton->matches(buffer, length);
+    mHazard.store(NULL);
+    return matched;
+}
+
+}   // namespace android
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UEVENT_MATCHER_H
+#define UEVENT_MATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace android {
+
+/*
+ * Aho-Corasick automaton over the match strings, compiled to a DFA on a
+ * compressed alphabet: bytes no match string uses share one class, which
+ * always leads back to the root, so a '\0' field separator ends any partial
+ * match just like the per field strstr() did.
+ */
+class UeventAutomaton {
+public:
+    UeventAutomaton(const std::vector<std::string>& matches);
+
+    // true when any match string is a substring of the message
+    bool matches(const char* buffer, size_t length) const;
+    int stateCount() const { return (int)mNext.size() / mClassCount; }
+
+private:
+    uint16_t mClass[256];       // 0 for bytes no match string uses
+    int mClassCount;
+    std::vector<int32_t> mNext;     // [row + class], rows are state * mClassCount
+    std::vector<uint8_t> mOutput;   // [row], a match string ends in this state
+};
+
+/*
+ * Match strings of the UEventObserver thread. add/remove compile a new
+ * automaton and swap it in; the receive thread never takes a lock. Only
+ * one thread may call isMatch(), the automaton it is scanning is guarded
+ * by a single hazard pointer.
+ */
+class UeventMatcher {
+public:
+    UeventMatcher();
+    ~UeventMatcher();
+
+    void addMatch(const char* match);
+    void removeMatch(const char* match);
+    bool isMatch(const char* buffer, size_t length);
+
+private:
+    void publish();
+
+    pthread_mutex_t mLock;
+    std::vector<std::string> mMatches;
+    std::atomic<const UeventAutomaton*> mCurrent;
+    std::atomic<const UeventAutomaton*> mHazard;
+    std::vector<const UeventAutomaton*> mRetired;
+};
+
+}   // namespace android
+
+#endif // UEVENT_MATCHER_H
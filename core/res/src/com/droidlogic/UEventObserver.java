@@ -136,7 +136,8 @@ public abstract class UEventObserver {
 
             while (offset < length) {
                 int equals = message.indexOf('=', offset);
-                int at = message.indexOf('\0', offset);
+                // the native side hands fields over separated by '\n'
+                int at = message.indexOf('\n', offset);
                 if (at < 0) break;
 
                 if (equals > offset && equals < at) {
@@ -3,6 +3,7 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
   SystemControlClient.cpp \
+  ServiceConnector.cpp \
   ISystemControlService.cpp \
   ISystemControlNotify.cpp
 
@@ -61,13 +62,28 @@ LOCAL_SRC_FILES:= \
   main_systemcontrol.cpp \
   VdcLoop.c \
   SysWrite.cpp \
+  SysfsFdCache.cpp \
+  PropertyCache.cpp \
+  UnifyKeySession.cpp \
+  SysfsBatch.cpp \
+  ModeSwitchSequencer.cpp \
+  ModeSwitchTracer.cpp \
+  BootWatcher.cpp \
+  HotplugDebouncer.cpp \
+  DolbyVisionSwitch.cpp \
+  DeepColorTable.cpp \
   SystemControl.cpp \
   SystemControlHal.cpp \
   SystemControlService.cpp \
   DisplayMode.cpp \
+  DisplayModeRegistry.cpp \
+  SinkCaps.cpp \
   Dimension.cpp \
+  Video3DDetector.cpp \
   SysTokenizer.cpp \
   UEventObserver.cpp \
+  UeventMatcher.cpp \
+  UeventHub.cpp \
   HDCP/aes.cpp \
   HDCP/HdcpKeyDecrypt.cpp \
   HDCP/HDCPRxKey.cpp \
@@ -167,9 +183,23 @@ LOCAL_CFLAGS += -DANDROID_PLATFORM_SDK_VERSION=$(PLATFORM_SDK_VERSION)
 LOCAL_SRC_FILES:= \
   main_recovery.cpp \
   SysWrite.cpp \
+  SysfsFdCache.cpp \
+  PropertyCache.cpp \
+  UnifyKeySession.cpp \
+  SysfsBatch.cpp \
+  ModeSwitchSequencer.cpp \
+  ModeSwitchTracer.cpp \
+  BootWatcher.cpp \
+  HotplugDebouncer.cpp \
+  DolbyVisionSwitch.cpp \
+  DeepColorTable.cpp \
   DisplayMode.cpp \
+  DisplayModeRegistry.cpp \
+  SinkCaps.cpp \
   SysTokenizer.cpp \
   UEventObserver.cpp \
+  UeventMatcher.cpp \
+  UeventHub.cpp \
   HDCP/aes.cpp \
   HDCP/HdcpKeyDecrypt.cpp \
   HDCP/HDCPRxKey.cpp \
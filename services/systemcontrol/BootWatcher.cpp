@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 follow boot animation and boot video on one thread, woken by property changes
+ *  - 2 hand the screen from the uboot logo over in recovery and boot video mode
+ *  - 3 time of every boot milestone since DisplayMode::init()
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "BootWatcher.h"
+#include "common.h"
+
+static const boot_watch_config_t sDefaultConfig = {
+    4000,       //bootanimStartMs
+    1000,       //firstFrameMs
+    100,        //defaultDelayMs
+    1000,       //logoHandoverMs
+    120000,     //bootvideoMaxMs
+};
+
+const boot_watch_config_t *BootWatcher::getDefaultConfig() {
+    return &sDefaultConfig;
+}
+
+BootWatcher::BootWatcher(const property_backend_t *backend, const boot_watch_config_t *config,
+        Callback *callback, int64_t originNs)
+    :mBackend(backend),
+    mConfig(*config),
+    mCallback(callback),
+    mOriginNs(originNs) {
+    pthread_mutex_init(&mLock, NULL);
+    mStats.bootanimRunningMs = -1;
+    mStats.bootvideoStoppedMs = -1;
+    mStats.statusMs = -1;
+    mStats.finishedMs = -1;
+    mStats.doneMs = -1;
+    mStats.wakeups = 0;
+    mStats.holdMs = 0;
+}
+
+BootWatcher::~BootWatcher() {
+    pthread_mutex_destroy(&mLock);
+}
+
+int64_t BootWatcher::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int64_t BootWatcher::sinceOrigin() {
+    return (now() - mOriginNs) / 1000000;
+}
+
+bool BootWatcher::start() {
+    pthread_t id;
+    pthread_attr_t attr;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(&id, &attr, threadLoop, this);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        SYS_LOGE("Create boot watcher error!\n");
+        return false;
+    }
+    return true;
+}
+
+void *BootWatcher::threadLoop(void *data) {
+    ((BootWatcher *)data)->run();
+    return NULL;
+}
+
+int BootWatcher::getProperty(const char *name, char *value, const char *def) {
+    const prop_info *pi = mBackend != NULL ? mBackend->find(name) : NULL;
+
+    if (pi != NULL && mBackend->read(pi, value) > 0)
+        return strlen(value);
+    strcpy(value, def);
+    return strlen(value);
+}
+
+bool BootWatcher::waitFor(const char *name, const char *value, bool contains, int timeoutMs) {
+    int64_t deadline = now() + (int64_t)timeoutMs * 1000000;
+    char current[PROPERTY_CACHE_VALUE_LEN];
+
+    while (true) {
+        const prop_info *pi = mBackend != NULL ? mBackend->find(name) : NULL;
+        uint32_t serial = 0;
+
+        //serial first, a write after it wakes the wait below at once
+        current[0] = '\0';
+        if (pi != NULL) {
+            serial = mBackend->serial(pi);
+            mBackend->read(pi, current);
+        } else if (mBackend != NULL) {
+            serial = mBackend->areaSerial();
+        }
+        if (contains ? strstr(current, value) != NULL : !strcmp(current, value))
+            return true;
+
+        int64_t leftNs = deadline - now();
+        if (leftNs <= 0)
+            return false;
+
+        pthread_mutex_lock(&mLock);
+        mStats.wakeups++;
+        pthread_mutex_unlock(&mLock);
+        if (mBackend != NULL && mBackend->wait != NULL) {
+            struct timespec timeout;
+            uint32_t newSerial = 0;
+            timeout.tv_sec = leftNs / 1000000000LL;
+            timeout.tv_nsec = leftNs % 1000000000LL;
+            mBackend->wait(pi, serial, &newSerial, &timeout);
+        } else {
+            int64_t leftUs = leftNs / 1000;
+            usleep(leftUs < BOOT_WATCH_POLL_MS * 1000 ? leftUs : BOOT_WATCH_POLL_MS * 1000);
+        }
+    }
+}
+
+void BootWatcher::hold(const char *why, int ms) {
+    if (ms <= 0)
+        return;
+
+    int64_t start = now();
+    usleep((useconds_t)ms * 1000);
+    SYS_LOGI("boot watcher held %lldms of %dms for %s, %lldms after init\n",
+        (long long)((now() - start) / 1000000), ms, why, (long long)sinceOrigin());
+    pthread_mutex_lock(&mLock);
+    mStats.holdMs += ms;
+    pthread_mutex_unlock(&mLock);
+}
+
+void BootWatcher::run() {
+    char fsMode[PROPERTY_CACHE_VALUE_LEN] = {0};
+    char bootvideo[PROPERTY_CACHE_VALUE_LEN] = {0};
+    char recovery[PROPERTY_CACHE_VALUE_LEN] = {0};
+    char delay[PROPERTY_CACHE_VALUE_LEN] = {0};
+
+    getProperty(BOOT_PROP_FS_MODE, fsMode, "android");
+    bool recoveryFs = !strcmp(fsMode, "recovery");
+
+    if (!recoveryFs) {
+        //init had started boot animation, will set init.svc.* running
+        if (waitFor(BOOT_PROP_BOOTANIM, "running", false, mConfig.bootanimStartMs)) {
+            pthread_mutex_lock(&mLock);
+            mStats.bootanimRunningMs = sinceOrigin();
+            pthread_mutex_unlock(&mLock);
+        } else {
+            SYS_LOGI("boot animation did not run in %dms\n", mConfig.bootanimStartMs);
+        }
+
+        char *end = NULL;
+        getProperty(BOOT_PROP_BOOTANIM_DELAY, delay, "");
+        long delayMs = strtol(delay, &end, 0);
+        if (delay[0] == '\0' || *end != '\0')
+            delayMs = mConfig.defaultDelayMs;
+        hold("first boot animation frame", delayMs + mConfig.firstFrameMs);
+    }
+
+    getProperty(BOOT_PROP_BOOTVIDEO, bootvideo, "0");
+    bool bootvideoMode = !strcmp(bootvideo, "1");
+    SYS_LOGI("boot animation detect boot video:%s\n", bootvideo);
+    if (!bootvideoMode) {
+        mCallback->onBootanimStatus(1);
+        pthread_mutex_lock(&mLock);
+        mStats.statusMs = sinceOrigin();
+        pthread_mutex_unlock(&mLock);
+    }
+
+    // Cannot access amldisplay_prop in P, selinux never allowed!
+    // check service property instead
+    getProperty(BOOT_PROP_RECOVERY_SERVICE, recovery, "stopped");
+    if (!strcmp(recovery, "running") || recoveryFs || bootvideoMode) {
+        SYS_LOGI("recovery or bootvideo mode\n");
+        hold("logo handover", mConfig.logoHandoverMs);
+        mCallback->onLogoHandover(bootvideoMode);
+    }
+
+    mCallback->onBootAnimFinished();
+    pthread_mutex_lock(&mLock);
+    mStats.finishedMs = sinceOrigin();
+    pthread_mutex_unlock(&mLock);
+    SYS_LOGI("boot animation finished %lldms after init\n", (long long)mStats.finishedMs);
+
+    if (bootvideoMode) {
+        if (waitFor(BOOT_PROP_BOOTVIDEO_SERVICE, "stopped", true, mConfig.bootvideoMaxMs)) {
+            pthread_mutex_lock(&mLock);
+            mStats.bootvideoStoppedMs = sinceOrigin();
+            pthread_mutex_unlock(&mLock);
+        } else {
+            SYS_LOGI("boot video did not stop in %dms\n", mConfig.bootvideoMaxMs);
+        }
+        mCallback->onBootanimStatus(1);
+        pthread_mutex_lock(&mLock);
+        mStats.statusMs = sinceOrigin();
+        pthread_mutex_unlock(&mLock);
+    }
+
+    pthread_mutex_lock(&mLock);
+    mStats.doneMs = sinceOrigin();
+    pthread_mutex_unlock(&mLock);
+}
+
+void BootWatcher::getStats(boot_watch_stats_t *stats) {
+    pthread_mutex_lock(&mLock);
+    *stats = mStats;
+    pthread_mutex_unlock(&mLock);
+}
+
+int BootWatcher::dump(char *result) {
+    if (NULL == result)
+        return -1;
+
+    boot_watch_stats_t stats;
+    char buf[CC_MAX_LINE_LEN] = {0};
+
+    getStats(&stats);
+    snprintf(buf, sizeof(buf), "\nboot since init: bootanim running %lldms, finished %lldms, "
+        "status %lldms, bootvideo stopped %lldms, done %lldms\n"
+        "boot watcher wakeups:%d hold:%dms\n",
+        (long long)stats.bootanimRunningMs, (long long)stats.finishedMs, (long long)stats.statusMs,
+        (long long)stats.bootvideoStoppedMs, (long long)stats.doneMs, stats.wakeups, stats.holdMs);
+    strcat(result, buf);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 follow boot animation and boot video on one thread, woken by property changes
+ *  - 2 hand the screen from the uboot logo over in recovery and boot video mode
+ *  - 3 time of every boot milestone since DisplayMode::init()
+ */
+
+#ifndef BOOT_WATCHER_H
+#define BOOT_WATCHER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "PropertyCache.h"
+
+#define BOOT_PROP_BOOTANIM              "init.svc.bootanim"
+#define BOOT_PROP_BOOTANIM_DELAY        "const.bootanim.delay"
+#define BOOT_PROP_BOOTVIDEO             "service.bootvideo"
+#define BOOT_PROP_BOOTVIDEO_SERVICE     "init.svc.bootvideo"
+#define BOOT_PROP_RECOVERY_SERVICE      "init.svc.recovery"
+#define BOOT_PROP_FS_MODE               "const.filesystem.mode"
+
+//polls of the old loops, only where the backend can not wait
+#define BOOT_WATCH_POLL_MS              100
+
+typedef struct boot_watch_config {
+    //some boot videos need 2~3s to start playing, bootanim may never run
+    int bootanimStartMs;
+    //bootanimation loads its zip and posts the first frame after init starts it,
+    //hdcp must not retrain the link before, on top of const.bootanim.delay
+    int firstFrameMs;
+    int defaultDelayMs;             //const.bootanim.delay when unset
+    //the player or recovery needs this long to put a frame up before the logo goes
+    int logoHandoverMs;
+    int bootvideoMaxMs;
+} boot_watch_config_t;
+
+//ms since the origin given to the watcher, -1 while it did not happen
+typedef struct boot_watch_stats {
+    int64_t bootanimRunningMs;
+    int64_t bootvideoStoppedMs;
+    int64_t statusMs;               //onBootanimStatus()
+    int64_t finishedMs;             //onBootAnimFinished()
+    int64_t doneMs;
+    int wakeups;                    //property waits and polls
+    int holdMs;                     //slept for the display
+} boot_watch_stats_t;
+
+class BootWatcher
+{
+public:
+    class Callback {
+    public:
+        Callback() {};
+        virtual ~Callback() {};
+        //apps see the boot animation as done
+        virtual void onBootanimStatus(int status) = 0;
+        //recovery or boot video owns the screen now, close the uboot logo
+        virtual void onLogoHandover(bool bootvideo) = 0;
+        //hdcp may start authenticating
+        virtual void onBootAnimFinished() = 0;
+    };
+
+    static const boot_watch_config_t *getDefaultConfig();
+
+    //originNs is CLOCK_MONOTONIC of DisplayMode::init(), the stats count from it
+    BootWatcher(const property_backend_t *backend, const boot_watch_config_t *config,
+        Callback *callback, int64_t originNs);
+    ~BootWatcher();
+
+    //detached thread running run()
+    bool start();
+    void run();
+    void getStats(boot_watch_stats_t *stats);
+    int dump(char *result);
+
+    static int64_t now();
+
+private:
+    int getProperty(const char *name, char *value, const char *def);
+    //until name reads value, or only contains it, false at the deadline
+    bool waitFor(const char *name, const char *value, bool contains, int timeoutMs);
+    void hold(const char *why, int ms);
+    int64_t sinceOrigin();
+    static void *threadLoop(void *data);
+
+    const property_backend_t *mBackend;
+    boot_watch_config_t mConfig;
+    Callback *mCallback;
+    int64_t mOriginNs;
+    pthread_mutex_t mLock;
+    boot_watch_stats_t mStats;
+};
+
+#endif // BOOT_WATCHER_H
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 once per edid, walk the priority list of every mode the sink lists
+ *  - 2 ask valid_mode only about colors in dc_cap, up to the first it takes
+ *  - 3 answer the best deep color of a mode with one lookup
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+#include <stdio.h>
+#include <string.h>
+#include "DeepColorTable.h"
+
+//indexes of the supported bits
+static const char* COLOR_ATTRIBUTES[DEEP_COLOR_TOTAL] = {
+    COLOR_YCBCR444_12BIT,
+    COLOR_YCBCR444_10BIT,
+    COLOR_YCBCR444_8BIT,
+    COLOR_YCBCR422_12BIT,
+    COLOR_YCBCR422_10BIT,
+    COLOR_YCBCR422_8BIT,
+    COLOR_YCBCR420_12BIT,
+    COLOR_YCBCR420_10BIT,
+    COLOR_YCBCR420_8BIT,
+    COLOR_RGB_12BIT,
+    COLOR_RGB_10BIT,
+    COLOR_RGB_8BIT,
+};
+
+//this is prior selected list  of 4k2k50hz, 4k2k60hz smpte50hz, smpte60hz
+static const char* COLOR_ATTRIBUTE_LIST1[] = {
+    COLOR_YCBCR420_12BIT,
+    COLOR_YCBCR420_10BIT,
+    COLOR_YCBCR420_8BIT,
+    COLOR_YCBCR422_12BIT,
+    COLOR_YCBCR422_10BIT,
+    COLOR_YCBCR444_8BIT,
+    COLOR_YCBCR422_8BIT,
+    COLOR_RGB_8BIT,
+};
+
+//this is prior selected list  of other display mode
+static const char* COLOR_ATTRIBUTE_LIST2[] = {
+    COLOR_YCBCR444_12BIT,
+    COLOR_YCBCR422_12BIT,
+    COLOR_RGB_12BIT,
+    COLOR_YCBCR444_10BIT,
+    COLOR_YCBCR422_10BIT,
+    COLOR_RGB_10BIT,
+    COLOR_YCBCR444_8BIT,
+    COLOR_YCBCR422_8BIT,
+    COLOR_RGB_8BIT,
+};
+
+//this is prior selected list  of Low Power Mode 4k2k50hz, 4k2k60hz smpte50hz, smpte60hz
+static const char* COLOR_ATTRIBUTE_LIST3[] = {
+    COLOR_YCBCR420_8BIT,
+    COLOR_YCBCR420_10BIT,
+    COLOR_YCBCR420_12BIT,
+    COLOR_YCBCR422_8BIT,
+    COLOR_YCBCR422_10BIT,
+    COLOR_YCBCR422_12BIT,
+    COLOR_YCBCR444_8BIT,
+    COLOR_RGB_8BIT,
+};
+
+//this is prior selected list of Low Power Mode other display mode
+static const char* COLOR_ATTRIBUTE_LIST4[] = {
+    COLOR_YCBCR444_8BIT,
+    COLOR_YCBCR422_8BIT,
+    COLOR_RGB_8BIT,
+    COLOR_YCBCR444_10BIT,
+    COLOR_YCBCR422_10BIT,
+    COLOR_RGB_10BIT,
+    COLOR_YCBCR444_12BIT,
+    COLOR_YCBCR422_12BIT,
+    COLOR_RGB_12BIT,
+};
+
+int DeepColorTable::findColor(const char *color) {
+    for (int i = 0; i < DEEP_COLOR_TOTAL; i++) {
+        if (!strcmp(COLOR_ATTRIBUTES[i], color))
+            return i;
+    }
+    return -1;
+}
+
+const char *DeepColorTable::getColor(int index) {
+    if (index < 0 || index >= DEEP_COLOR_TOTAL)
+        return NULL;
+    return COLOR_ATTRIBUTES[index];
+}
+
+const char **DeepColorTable::getPriorityList(const char *mode, bool lowPower, int *length) {
+    //filter some color value options, aimed at some modes.
+    if (!strcmp(mode, MODE_4K2K60HZ) || !strcmp(mode, MODE_4K2K50HZ)
+        || !strcmp(mode, MODE_4K2KSMPTE60HZ) || !strcmp(mode, MODE_4K2KSMPTE50HZ)) {
+        if (lowPower) {
+            *length = sizeof(COLOR_ATTRIBUTE_LIST3) / sizeof(COLOR_ATTRIBUTE_LIST3[0]);
+            return COLOR_ATTRIBUTE_LIST3;
+        }
+        *length = sizeof(COLOR_ATTRIBUTE_LIST1) / sizeof(COLOR_ATTRIBUTE_LIST1[0]);
+        return COLOR_ATTRIBUTE_LIST1;
+    }
+
+    if (lowPower) {
+        *length = sizeof(COLOR_ATTRIBUTE_LIST4) / sizeof(COLOR_ATTRIBUTE_LIST4[0]);
+        return COLOR_ATTRIBUTE_LIST4;
+    }
+    *length = sizeof(COLOR_ATTRIBUTE_LIST2) / sizeof(COLOR_ATTRIBUTE_LIST2[0]);
+    return COLOR_ATTRIBUTE_LIST2;
+}
+
+void DeepColorTable::clear() {
+    memset(mRows, 0, sizeof(mRows));
+    mRowCount = 0;
+    mProbes = 0;
+    mLowPower = false;
+}
+
+void DeepColorTable::build(const SinkCaps *caps, bool lowPower, Prober *prober) {
+    clear();
+    mLowPower = lowPower;
+    //without dc_cap getBestHdmiDeepColorAttr() polls for it, leave that to it
+    if (!caps->hasDeepColorList())
+        return;
+
+    for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
+        const char *mode = DisplayModeRegistry::get(i)->name;
+        char mode420[MODE_LEN] = {0};
+        //a mode the sink only takes in 420 is listed as "2160p60hz420"
+        snprintf(mode420, sizeof(mode420), "%s420", mode);
+        if (!caps->hasMode(mode) && !caps->hasMode(mode420))
+            continue;
+
+        deep_color_row_t *row = &mRows[i];
+        row->valid = true;
+        row->best = -1;
+        mRowCount++;
+
+        //the colors after the first valid one are never picked, left to valid_mode
+        int length = 0;
+        const char **list = getPriorityList(mode, lowPower, &length);
+        for (int k = 0; k < length; k++) {
+            if (!caps->hasDeepColor(list[k]))
+                continue;
+
+            int c = findColor(list[k]);
+            row->probed |= 1u << c;
+            mProbes++;
+            if (prober->probeDeepColor(mode, list[k])) {
+                row->supported |= 1u << c;
+                row->best = c;
+                break;
+            }
+        }
+    }
+    SYS_LOGI("deep color table of %d modes, %d probes\n", mRowCount, mProbes);
+}
+
+const deep_color_row_t *DeepColorTable::findRow(const char *mode) const {
+    const display_mode_record_t *record = DisplayModeRegistry::find(mode);
+    if (record == NULL || !mRows[record->index].valid)
+        return NULL;
+    return &mRows[record->index];
+}
+
+const char *DeepColorTable::bestColorFor(const char *mode) const {
+    const deep_color_row_t *row = findRow(mode);
+    if (row == NULL)
+        return NULL;
+    return row->best >= 0 ? COLOR_ATTRIBUTES[row->best] : "";
+}
+
+int DeepColorTable::supports(const char *mode, const char *color) const {
+    const deep_color_row_t *row = findRow(mode);
+    int c = findColor(color);
+    if (row == NULL || c < 0 || !(row->probed & (1u << c)))
+        return -1;
+    return (row->supported & (1u << c)) ? 1 : 0;
+}
+
+void DeepColorTable::dump(char *result) const {
+    char buf[CC_MAX_LINE_LEN] = {0};
+
+    snprintf(buf, sizeof(buf), "\ndeep color table: %d modes, %d probes%s\n",
+        mRowCount, mProbes, mLowPower ? ", low power" : "");
+    strcat(result, buf);
+    for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
+        const deep_color_row_t *row = &mRows[i];
+        if (!row->valid)
+            continue;
+
+        int probes = 0;
+        for (int c = 0; c < DEEP_COLOR_TOTAL; c++) {
+            if (row->probed & (1u << c))
+                probes++;
+        }
+        snprintf(buf, sizeof(buf), "  %s: %s, %d probed\n", DisplayModeRegistry::get(i)->name,
+            row->best >= 0 ? COLOR_ATTRIBUTES[row->best] : "none", probes);
+        strcat(result, buf);
+    }
+}
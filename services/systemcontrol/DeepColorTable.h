@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 once per edid, walk the priority list of every mode the sink lists
+ *  - 2 ask valid_mode only about colors in dc_cap, up to the first it takes
+ *  - 3 answer the best deep color of a mode with one lookup
+ */
+
+#ifndef DEEP_COLOR_TABLE_H
+#define DEEP_COLOR_TABLE_H
+
+#include <stdint.h>
+#include "SinkCaps.h"
+
+#define COLOR_YCBCR444_12BIT             "444,12bit"
+#define COLOR_YCBCR444_10BIT             "444,10bit"
+#define COLOR_YCBCR444_8BIT              "444,8bit"
+#define COLOR_YCBCR422_12BIT             "422,12bit"
+#define COLOR_YCBCR422_10BIT             "422,10bit"
+#define COLOR_YCBCR422_8BIT              "422,8bit"
+#define COLOR_YCBCR420_12BIT             "420,12bit"
+#define COLOR_YCBCR420_10BIT             "420,10bit"
+#define COLOR_YCBCR420_8BIT              "420,8bit"
+#define COLOR_RGB_12BIT                  "rgb,12bit"
+#define COLOR_RGB_10BIT                  "rgb,10bit"
+#define COLOR_RGB_8BIT                   "rgb,8bit"
+
+#define DEEP_COLOR_TOTAL                12
+
+typedef struct deep_color_row {
+    bool valid;                     //the sink lists the mode
+    uint16_t probed;                //bit per color index, asked of valid_mode
+    uint16_t supported;             //bit per color index, valid_mode took it
+    int8_t best;                    //first of the priority list in dc_cap and taken, -1 for none
+} deep_color_row_t;
+
+class DeepColorTable
+{
+public:
+    class Prober {
+    public:
+        virtual ~Prober() {}
+        //valid_mode asked with the color appended to the mode
+        virtual bool probeDeepColor(const char *mode, const char *color) = 0;
+    };
+
+    //plain data like SinkCaps, clear() or build() before use
+    void clear();
+    //a row for every mode of the mode list the sink lists, nothing without dc_cap
+    void build(const SinkCaps *caps, bool lowPower, Prober *prober);
+
+    bool isValid() const { return mRowCount > 0; }
+    int getRowCount() const { return mRowCount; }
+    int getProbeCount() const { return mProbes; }
+
+    //NULL without a row for mode, "" when the sink takes none of its priority list
+    const char *bestColorFor(const char *mode) const;
+    //1 or 0 as valid_mode said, -1 without a row or for a color not asked
+    int supports(const char *mode, const char *color) const;
+
+    static int findColor(const char *color);
+    static const char *getColor(int index);
+    //the order getBestHdmiDeepColorAttr() tries colors in
+    static const char **getPriorityList(const char *mode, bool lowPower, int *length);
+
+    void dump(char *result) const;
+
+private:
+    const deep_color_row_t *findRow(const char *mode) const;
+
+    deep_color_row_t mRows[DISPLAY_MODE_TOTAL];
+    int mRowCount;
+    int mProbes;
+    bool mLowPower;
+};
+
+#endif // DEEP_COLOR_TABLE_H
@@ -30,9 +30,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <poll.h>
 
 #include "Dimension.h"
+#include "CPQControl.h"
 
 #ifndef RECOVERY_MODE
 //#include <gui/SurfaceComposerClient.h> //for video 3d mode set
@@ -47,6 +47,7 @@ Dimension::Dimension(DisplayMode *displayMode, SysWrite *sysWrite)
     mLogLevel(LOG_LEVEL_DEFAULT),
     mDisplay3DFormat(0) {
 
+    memset(&mLastDetect, 0, sizeof(mLastDetect));
     pDisplayMode = displayMode;
     pSysWrite = sysWrite;
     pTxAuth = displayMode->geTxAuth();
@@ -587,49 +588,45 @@ bool Dimension::switch2DTo3D(int format) {
     return ret;
 }
 
+//the decoder format, sampled when the pq poll thread sees new frame info
+class Video3DSource : public Video3DDetector::Source {
+public:
+    Video3DSource(Dimension *dimension)
+        :mDimension(dimension) {
+        mPQControl = CPQControl::GetInstance();
+        mSeen = mPQControl->getVframeSizeChanges();
+    }
+    virtual int sample3DFormat() {
+        return mDimension->getVideo3DFormat();
+    }
+    virtual bool waitFrameChange(int timeoutMs) {
+        //no poll device there, this times out and samples on the timer
+        return mPQControl->waitVframeSizeChange(&mSeen, timeoutMs);
+    }
+
+private:
+    Dimension *mDimension;
+    CPQControl *mPQControl;
+    unsigned int mSeen;
+};
+
 void* Dimension::detect3DThread(void* data) {
     Dimension *pThiz = (Dimension*)data;
-    int retry = RETRY_MAX;
-    int di3Dformat[5] = {0};
-    int times[5] = {0};
-   // String16 di3DformatStr;
+    Video3DSource source(pThiz);
+    Video3DDetector detector(Video3DDetector::getDefaultConfig(), &source);
+    detect_3d_result_t result;
     char format3DStr[64] = {0};
 
-    while (retry > 0) {
-        retry--;
-        di3Dformat[retry] = pThiz->getVideo3DFormat();
-        //ALOGI("[detect3DThread]di3Dformat[%d]:%d\n", retry, di3Dformat[retry]);
-        usleep(200000);//200ms
-    }
-
-    //get the 3d format which was detected most times
-    for (int i = 0; i < RETRY_MAX - 1; i++) {
-        for (int j = i + 1; j < RETRY_MAX; j++) {
-            if (di3Dformat[i] == di3Dformat[j]) {
-                times[i]++;
-            }
-        }
-    }
-    int max = times[0];
-    int idx = 0;
-    for (int i = 0; i < RETRY_MAX - 1; i++) {
-        if (times[i] > max) {
-            max = times[i];
-            idx = i;
-        }
-    }
-    //can't detect 3d format correctly, 3d off
-    if (max == 1) {
-        idx = 0;
-        di3Dformat[0] = 0;
-    }
+    //3d off when the samples do not agree on a format
+    int format = detector.detect(&result);
 
     if (pThiz->mLogLevel > LOG_LEVEL_1) {
-        ALOGI("[detect3DThread]after queue di3Dformat[%d]:%d\n", idx, di3Dformat[idx]);
+        ALOGI("[detect3DThread]after %d samples di3Dformat:%d\n", result.samples, format);
     }
 
-    pThiz->mDisplay3DFormat = di3Dformat[idx];
-    pThiz->get3DFormatStr(di3Dformat[idx], format3DStr);
+    pThiz->mLastDetect = result;
+    pThiz->mDisplay3DFormat = format;
+    pThiz->get3DFormatStr(format, format3DStr);
     pThiz->set3DMode(format3DStr);
     return NULL;
 }
@@ -799,5 +796,9 @@ int Dimension::dump(char *result) {
     get3DFormatStr(getDisplay3DFormat(), format3DStr);
     sprintf(buf, "\n display 3d format: %s , display 3d to 2d format:%d\n", format3DStr, getDisplay3DTo2DFormat());
     strcat(result, buf);
+    sprintf(buf, " last 3d detect: format:%d %s, samples:%d frame changes:%d, %lldms\n",
+        mLastDetect.format, mLastDetect.confirmed ? "confirmed" : "voted", mLastDetect.samples,
+        mLastDetect.frameChanges, (long long)mLastDetect.latencyUs / 1000);
+    strcat(result, buf);
     return 0;
 }
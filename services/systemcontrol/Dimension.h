@@ -25,6 +25,7 @@
 #include "DisplayMode.h"
 #include "SysWrite.h"
 #include "common.h"
+#include "Video3DDetector.h"
 
 #include <sys/ioctl.h>
 
@@ -94,8 +95,6 @@
 #define VPP_3D_MODE_LA 0x3
 #define VPP_3D_MODE_FA 0x4
 
-#define RETRY_MAX 5
-
 enum {
     FORMAT_3D_OFF                           = 0,
     FORMAT_3D_AUTO                          = 1,
@@ -185,6 +184,7 @@ private:
         axis_t dst;
     };
     window_axis_t mWindowAxis;
+    detect_3d_result_t mLastDetect;
 };
 // ----------------------------------------------------------------------------
 } // namespace android
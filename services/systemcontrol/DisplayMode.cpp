@@ -38,6 +38,10 @@
 #include <cutils/properties.h>
 #include "DisplayMode.h"
 #include "SysTokenizer.h"
+#include "SysfsBatch.h"
+#include "ModeSwitchSequencer.h"
+#include "UeventHub.h"
+#include "DisplayModeRegistry.h"
 
 #ifndef RECOVERY_MODE
 #include <binder/IBinder.h>
@@ -47,32 +51,6 @@
 using namespace android;
 #endif
 
-static const char* DISPLAY_MODE_LIST[DISPLAY_MODE_TOTAL] = {
-    MODE_480I,
-    MODE_480P,
-    MODE_480CVBS,
-    MODE_576I,
-    MODE_576P,
-    MODE_576CVBS,
-    MODE_720P,
-    MODE_720P50HZ,
-    MODE_1080P24HZ,
-    MODE_1080I50HZ,
-    MODE_1080P50HZ,
-    MODE_1080I,
-    MODE_1080P,
-    MODE_4K2K24HZ,
-    MODE_4K2K25HZ,
-    MODE_4K2K30HZ,
-    MODE_4K2K50HZ,
-    MODE_4K2K60HZ,
-    MODE_4K2KSMPTE,
-    MODE_4K2KSMPTE30HZ,
-    MODE_4K2KSMPTE50HZ,
-    MODE_4K2KSMPTE60HZ,
-    MODE_768P,
-};
-
 // Sink reference table, sorted by priority, per CDF
 static const char* MODES_SINK[] = {
     "2160p60hz",
@@ -104,13 +82,6 @@ static const char* MODES_REPEATER[] = {
     "576p50hz",
 };
 
-static const char* DV_MODE_TYPE[] = {
-    "DV_RGB_444_8BIT",
-    "DV_YCbCr_422_12BIT",
-    "LL_YCbCr_422_12BIT",
-    "LL_RGB_444_12BIT"
-};
-
 /**
  * strstr - Find the first substring in a %NUL terminated string
  * @s1: The string to be searched
@@ -177,7 +148,12 @@ DisplayMode::DisplayMode(const char *path, Ubootenv *ubootenv)
     mDisplayWidth(FULL_WIDTH_1080),
     mDisplayHeight(FULL_HEIGHT_1080),
     mLogLevel(LOG_LEVEL_DEFAULT),
-    mEnvLock(PTHREAD_MUTEX_INITIALIZER) {
+    mEnvLock(PTHREAD_MUTEX_INITIALIZER),
+    mCapsLock(PTHREAD_MUTEX_INITIALIZER),
+    mCapsValid(false),
+    mCapsGeneration(0),
+    mSwitchLock(PTHREAD_MUTEX_INITIALIZER),
+    mInitNs(BootWatcher::now()) {
 
     if (NULL == path) {
         pConfigPath = DISPLAY_CFG_FILE;
@@ -209,31 +185,39 @@ DisplayMode::~DisplayMode() {
 }
 
 void DisplayMode::init() {
+    mInitNs = BootWatcher::now();
     parseConfigFile();
-    pFrameRateAutoAdaption = new FrameRateAutoAdaption(this);
+    //one instance, the uevent thread hands it the hints and setAutoSwitchFrameRate() reads its flag
+    pFrameRateAutoAdaption = new FrameRateAutoAdaption(FrameRateAutoAdaption::getDefaultConfig(), this);
+    pFrameRateAutoAdaption->start();
 
     getBootEnv(UBOOTENV_REBOOT_MODE, mRebootMode);
     SYS_LOGI("reboot_mode :%s\n", mRebootMode);
 
     SYS_LOGI("display mode init type: %d [0:none 1:tablet 2:mbox 3:tv], soc type:%s, default UI:%s",
         mDisplayType, mSocType, mDefaultUI);
+    pHotplug = new HotplugDebouncer(HotplugDebouncer::getDefaultConfig(), this);
+    if (!pHotplug->start()) {
+        delete pHotplug;
+        pHotplug = NULL;
+    }
     if (DISPLAY_TYPE_MBOX == mDisplayType) {
         pTxAuth = new HDCPTxAuth();
         pTxAuth->setUevntCallback(this);
-        pTxAuth->setFRAutoAdpt(new FrameRateAutoAdaption(this));
+        pTxAuth->setFRAutoAdpt(pFrameRateAutoAdaption);
         setSourceDisplay(OUPUT_MODE_STATE_INIT);
         dumpCaps();
     } else if (DISPLAY_TYPE_TV == mDisplayType) {
         setTvModelName();
         pTxAuth = new HDCPTxAuth();
         pTxAuth->setUevntCallback(this);
-        pTxAuth->setFRAutoAdpt(new FrameRateAutoAdaption(this));
+        pTxAuth->setFRAutoAdpt(pFrameRateAutoAdaption);
         pRxAuth = new HDCPRxAuth(pTxAuth);
         setSinkDisplay(true);
     } else if (DISPLAY_TYPE_REPEATER == mDisplayType) {
         pTxAuth = new HDCPTxAuth();
         pTxAuth->setUevntCallback(this);
-        pTxAuth->setFRAutoAdpt(new FrameRateAutoAdaption(this));
+        pTxAuth->setFRAutoAdpt(pFrameRateAutoAdaption);
         pRxAuth = new HDCPRxAuth(pTxAuth);
         setSourceDisplay(OUPUT_MODE_STATE_INIT);
         dumpCaps();
@@ -301,6 +285,26 @@ void DisplayMode::setBootEnv(const char* key, char* value) {
     mUbootenv->updateValue(key, value);
 }
 
+void DisplayMode::stageBootEnv(const char* key, const char* value) {
+    if (mLogLevel > LOG_LEVEL_1)
+        SYS_LOGI("stageBootEnv key:%s value:%s", key, value);
+
+    mUbootenv->setValue(key, value);
+}
+
+//one frame of the current mode lets the sink act on avmute, the old fixed delay is the ceiling
+int DisplayMode::getMuteHoldUs() {
+    char curMode[MODE_LEN] = {0};
+    pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, curMode);
+
+    const display_mode_record_t *record = DisplayModeRegistry::find(curMode);
+    if (record == NULL || record->frequency <= 0)
+        return MODE_SWITCH_MUTE_HOLD_US;
+
+    int frameUs = 1000000 / record->frequency;
+    return frameUs < MODE_SWITCH_MUTE_HOLD_US ? frameUs : MODE_SWITCH_MUTE_HOLD_US;
+}
+
 int DisplayMode::parseConfigFile(){
     const char* WHITESPACE = " \t\r";
 
@@ -353,20 +357,53 @@ int DisplayMode::parseConfigFile(){
 void DisplayMode::setSourceDisplay(output_mode_state state) {
     hdmi_data_t data;
     char outputmode[MODE_LEN] = {0};
+    int trace = beginModeSwitchTrace(getModeSwitchCause(state));
 
     pSysWrite->writeSysfs(SYS_DISABLE_VIDEO, VIDEO_LAYER_DISABLE);
 
-    memset(&data, 0, sizeof(hdmi_data_t));
-    getHdmiData(&data);
+    selectSourceDisplay(state, &data, outputmode, trace);
+    //if the tv don't support current outputmode,then switch to best outputmode
+    pSysWrite->writeSysfs(H265_DOUBLE_WRITE_MODE, (HDMI_SINK_TYPE_NONE == data.sinkType) ? "3" : "0");
+
+    int64_t start = ModeSwitchTracer::now();
+    if (OUPUT_MODE_STATE_INIT == state) {
+        updateDefaultUI();
+    }
+
+    //output mode not the same
+    if (strcmp(data.current_mode, outputmode)) {
+        if (OUPUT_MODE_STATE_INIT == state) {
+            //when change mode, need close uboot logo to avoid logo scaling wrong
+            pSysWrite->writeSysfs(DISPLAY_FB0_BLANK, "1");
+            pSysWrite->writeSysfs(DISPLAY_FB1_BLANK, "1");
+            pSysWrite->writeSysfs(DISPLAY_FB1_FREESCALE, "0");
+        }
+    }
+    DetectDolbyVisionOutputMode(state, outputmode);
+    mTracer.addSpan(trace, 0, false, start, ModeSwitchTracer::now(), "dolby vision mode");
+    setSourceOutputMode(outputmode, state, trace);
+}
+
+/* *
+ * @Description: read the sink and pick the output mode for it, writes nothing but the
+ *               uboot logo scaling at boot, the hotplug worker runs it ahead of the switch
+ * @params: data: filled with the sink the mode was picked for
+ * */
+void DisplayMode::selectSourceDisplay(output_mode_state state, hdmi_data_t *data, char *outputmode, int trace) {
+    memset(data, 0, sizeof(hdmi_data_t));
+    int64_t start = ModeSwitchTracer::now();
+    getHdmiData(data);
+    mTracer.addSpan(trace, 0, false, start, ModeSwitchTracer::now(), "getHdmiData");
+    start = ModeSwitchTracer::now();
     if (pSysWrite->getPropertyBoolean(PROP_HDMIONLY, true)) {
-        if (HDMI_SINK_TYPE_NONE != data.sinkType) {
-            if ((!strcmp(data.current_mode, MODE_480CVBS) || !strcmp(data.current_mode, MODE_576CVBS))
+        if (HDMI_SINK_TYPE_NONE != data->sinkType) {
+            if ((!strcmp(data->current_mode, MODE_480CVBS) || !strcmp(data->current_mode, MODE_576CVBS))
                     && (OUPUT_MODE_STATE_INIT == state)) {
                 pSysWrite->writeSysfs(DISPLAY_FB1_FREESCALE, "0");
                 pSysWrite->writeSysfs(DISPLAY_FB0_FREESCALE, "0x10001");
             }
 
-            getHdmiOutputMode(outputmode, &data);
+            getHdmiOutputMode(outputmode, data);
         } else {
             getBootEnv(UBOOTENV_CVBSMODE, outputmode);
         }
@@ -374,16 +411,12 @@ void DisplayMode::setSourceDisplay(output_mode_state state) {
         getBootEnv(UBOOTENV_OUTPUTMODE, outputmode);
     }
 
-    //if the tv don't support current outputmode,then switch to best outputmode
-    if (HDMI_SINK_TYPE_NONE == data.sinkType) {
-        pSysWrite->writeSysfs(H265_DOUBLE_WRITE_MODE, "3");
+    if (HDMI_SINK_TYPE_NONE == data->sinkType) {
         //if (strcmp(outputmode, MODE_480CVBS) && strcmp(outputmode, MODE_576CVBS))
         //    strcpy(outputmode, MODE_576CVBS);
 
         if (strlen(outputmode) == 0)
             strcpy(outputmode, "none");
-    } else {
-        pSysWrite->writeSysfs(H265_DOUBLE_WRITE_MODE, "0");
     }
 
 #if defined(ODROID)
@@ -406,27 +439,12 @@ void DisplayMode::setSourceDisplay(output_mode_state state) {
 #endif
 
     SYS_LOGI("display sink type:%d [0:none, 1:sink, 2:repeater], old outputmode:%s, new outputmode:%s\n",
-            data.sinkType,
-            data.current_mode,
+            data->sinkType,
+            data->current_mode,
             outputmode);
     if (strlen(outputmode) == 0)
         strcpy(outputmode, DEFAULT_OUTPUT_MODE);
-
-    if (OUPUT_MODE_STATE_INIT == state) {
-        updateDefaultUI();
-    }
-
-    //output mode not the same
-    if (strcmp(data.current_mode, outputmode)) {
-        if (OUPUT_MODE_STATE_INIT == state) {
-            //when change mode, need close uboot logo to avoid logo scaling wrong
-            pSysWrite->writeSysfs(DISPLAY_FB0_BLANK, "1");
-            pSysWrite->writeSysfs(DISPLAY_FB1_BLANK, "1");
-            pSysWrite->writeSysfs(DISPLAY_FB1_FREESCALE, "0");
-        }
-    }
-    DetectDolbyVisionOutputMode(state, outputmode);
-    setSourceOutputMode(outputmode, state);
+    mTracer.addSpan(trace, 0, false, start, ModeSwitchTracer::now(), "select mode");
 }
 
 void DisplayMode::setSourceOutputMode(const char* outputmode){
@@ -434,6 +452,40 @@ void DisplayMode::setSourceOutputMode(const char* outputmode){
 }
 
 void DisplayMode::setSourceOutputMode(const char* outputmode, output_mode_state state) {
+    setSourceOutputMode(outputmode, state, beginModeSwitchTrace(getModeSwitchCause(state)));
+}
+
+int DisplayMode::beginModeSwitchTrace(int cause) {
+    char curMode[MODE_LEN] = {0};
+
+    pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, curMode);
+    return mTracer.begin(cause, curMode);
+}
+
+int DisplayMode::getModeSwitchCause(output_mode_state state) {
+    switch (state) {
+        case OUPUT_MODE_STATE_INIT:
+            return MODE_SWITCH_CAUSE_BOOT;
+        case OUPUT_MODE_STATE_POWER:
+            return MODE_SWITCH_CAUSE_HOTPLUG;
+        case OUPUT_MODE_STATE_SWITCH_ADAPTER:
+        case OUPUT_MODE_STATE_ADAPTER_END:
+            return MODE_SWITCH_CAUSE_FRAME_RATE;
+        default:
+            return MODE_SWITCH_CAUSE_USER;
+    }
+}
+
+void DisplayMode::setSourceOutputMode(const char* outputmode, output_mode_state state, int trace,
+        const char* colorAttr, int dvState) {
+    //binder calls, the hotplug and the frame rate workers all switch, one at a time
+    mutex_lock(&mSwitchLock);
+    setSourceOutputModeLocked(outputmode, state, trace, colorAttr, dvState);
+    mutex_unlock(&mSwitchLock);
+}
+
+void DisplayMode::setSourceOutputModeLocked(const char* outputmode, output_mode_state state, int trace,
+        const char* colorAttr, int dvState) {
     char value[MAX_STR_LEN] = {0};
 
     bool cvbsMode = false;
@@ -442,9 +494,19 @@ void DisplayMode::setSourceOutputMode(const char* outputmode, output_mode_state
         hdmi_data_t data;
 
         SYS_LOGI("outputmode is [auto] mode, need find the best mode\n");
+        int64_t start = ModeSwitchTracer::now();
         getHdmiData(&data);
+        mTracer.addSpan(trace, 0, false, start, ModeSwitchTracer::now(), "getHdmiData");
+        start = ModeSwitchTracer::now();
         getHdmiOutputMode((char *)outputmode, &data);
+        mTracer.addSpan(trace, 0, false, start, ModeSwitchTracer::now(), "select mode");
     }
+    mTracer.setTarget(trace, outputmode);
+
+    //bootenv saves of the last switch go first, the checks below read it
+    int64_t start = ModeSwitchTracer::now();
+    ModeSwitchSequencer::drain();
+    mTracer.addSpan(trace, 0, false, start, ModeSwitchTracer::now(), "drain worker");
 
     bool deepColorEnabled = pSysWrite->getPropertyBoolean(PROP_DEEPCOLOR, true);
     pSysWrite->readSysfs(HDMI_TX_FRAMRATE_POLICY, value);
@@ -456,6 +518,7 @@ void DisplayMode::setSourceOutputMode(const char* outputmode, output_mode_state
             //deep color disabled, only need check output mode same or not
             if (!deepColorEnabled) {
                 SYS_LOGI("deep color is Disabled, and curDisplayMode is same to outputmode, return\n");
+                mTracer.cancel(trace);
                 return;
             }
 
@@ -466,131 +529,244 @@ void DisplayMode::setSourceOutputMode(const char* outputmode, output_mode_state
             getBootEnv(UBOOTENV_COLORATTRIBUTE, saveColorAttribute);
             //if bestOutputmode is enable, need change deepcolor to best deepcolor.
             if (isBestOutputmode()) {
+                SinkCaps caps;
+                DeepColorTable colors;
                 FormatColorDepth deepColor;
+                getSinkCaps(&caps, false, &colors);
+                deepColor.setSinkCaps(&caps);
+                deepColor.setColorTable(&colors);
                 deepColor.getBestHdmiDeepColorAttr(outputmode, saveColorAttribute);
             }
             SYS_LOGI("curColorAttribute:[%s] ,saveColorAttribute: [%s]\n", curColorAttribute, saveColorAttribute);
-            if (NULL != strstr(curColorAttribute, saveColorAttribute))
+            if (NULL != strstr(curColorAttribute, saveColorAttribute)) {
+                mTracer.cancel(trace);
                 return;
+            }
         }
     }
-    // 1.set avmute and close phy
-    if (OUPUT_MODE_STATE_INIT != state) {
-        pSysWrite->writeSysfs(DISPLAY_HDMI_AVMUTE, "1");
-        if (OUPUT_MODE_STATE_POWER != state) {
-            usleep(50000);//50ms
-            pSysWrite->writeSysfs(DISPLAY_HDMI_HDCP_MODE, "-1");
-            //usleep(100000);//100ms
-            pSysWrite->writeSysfs(DISPLAY_HDMI_PHY, "0"); /* Turn off TMDS PHY */
-            usleep(50000);//50ms
+    if (!strcmp(outputmode, MODE_480CVBS) || !strcmp(outputmode, MODE_576CVBS)) {
+        cvbsMode = true;
+    }
+
+    //the dolby vision core follows the new mode inside this switch, not in a second one after it
+    char dvMode[MODE_LEN] = {0};
+    if ((MODE_SWITCH_DV_KEEP == dvState) && !cvbsMode && (OUPUT_MODE_STATE_INIT != state)
+            && isDolbyVisionEnable()) {
+        dvState = getDolbyVisionType();
+        prepareDolbyVision(&dvState, outputmode, dvMode);
+        if (strcmp(dvMode, outputmode)) {
+            SYS_LOGI("CurMode[%s] is not support dolbyvision, need setmode to [%s]", outputmode, dvMode);
+            outputmode = dvMode;
+            colorAttr = NULL;
+            mTracer.setTarget(trace, outputmode);
         }
     }
 
-    // 2.stop hdcp tx
-    pTxAuth->stop();
+    //deep color only asks the sink and the driver, work it out before the screen goes black
+    char colorAttribute[MODE_LEN] = {0};
+    bool deepColor;
+    if (NULL != colorAttr) {
+        //the hotplug worker picked it with the mode
+        strcpy(colorAttribute, colorAttr);
+        deepColor = colorAttribute[0] != '\0';
+    } else {
+        start = ModeSwitchTracer::now();
+        deepColor = getDeepColorAttribute(cvbsMode, state, outputmode, colorAttribute);
+        mTracer.addSpan(trace, 0, false, start, ModeSwitchTracer::now(), "deep color select");
+    }
 
-    if (!strcmp(outputmode, MODE_480CVBS) || !strcmp(outputmode, MODE_576CVBS)) {
-        cvbsMode = true;
+    ModeSwitchSequencer seq("mode switch");
+    seq.setTracer(&mTracer, trace);
+    bool muted = OUPUT_MODE_STATE_INIT != state;
+    bool phyCycle = muted && OUPUT_MODE_STATE_POWER != state;
+
+    // 1.set avmute and close phy
+    int mute = -1;
+    if (muted) {
+        mute = seq.addStep("mute", 0, NULL);
+        SysfsBatch &writes = seq.writes(mute);
+        writes.add(DISPLAY_HDMI_AVMUTE, "1");
+        if (phyCycle) {
+            writes.addDelay(getMuteHoldUs());
+            writes.add(DISPLAY_HDMI_HDCP_MODE, "-1");
+            writes.add(DISPLAY_HDMI_PHY, "0"); /* Turn off TMDS PHY */
+            writes.addDelay(MODE_SWITCH_PHY_OFF_US);
+        }
     }
 
+    // 2.stop hdcp tx
+    int hdcpStop = seq.addStep("hdcp stop", ModeSwitchSequencer::after(mute), [this]() {
+        pTxAuth->stop();
+        return true;
+    });
+
     //write framerate policy
-    if (!cvbsMode) {
-        setAutoSwitchFrameRate(state);
-    }
+    int policy = seq.addStep("framerate policy", ModeSwitchSequencer::after(hdcpStop), [&]() {
+        if (!cvbsMode)
+            setAutoSwitchFrameRate(state);
+        return true;
+    });
 
-    // 3. set deep color and outputmode
-    updateDeepColor(cvbsMode, state, outputmode);
-    char curMode[MODE_LEN] = {0};
-    pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, curMode);
+    //the core goes to bypass before the mode changes under it
+    int dvOff = -1;
+    if (DOLBY_VISION_SET_DISABLE == dvState)
+        dvOff = addDolbyVisionSteps(seq, dvState, ModeSwitchSequencer::after(policy));
 
-    if (strstr(mRebootMode, "quiescent")) {
-        SYS_LOGI("reboot_mode is quiescent\n");
-        pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, "null");
-        return;
+    // 3. set deep color and outputmode
+    int color = -1;
+    if (deepColor) {
+        color = seq.addStep("deep color", ModeSwitchSequencer::after(policy)
+                | ModeSwitchSequencer::after(dvOff), [&]() {
+            char attr[MODE_LEN] = {0};
+            pSysWrite->readSysfs(DISPLAY_HDMI_COLOR_ATTR, attr);
+            if (strstr(attr, colorAttribute) == NULL) {
+                SYS_LOGI("set DeepcolorAttr value is different from attr sysfs value\n");
+                pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, "null");
+                pSysWrite->writeSysfs(DISPLAY_HDMI_COLOR_ATTR, colorAttribute);
+            } else {
+                SYS_LOGI("cur deepcolor attr value is equals to colorAttribute, Do not need set it\n");
+            }
+            SYS_LOGI("setMboxOutputMode colorAttribute = %s\n", colorAttribute);
+            //saved with the output mode by the bootenv step
+            char ubootvar[100] = {0};
+            sprintf(ubootvar, "ubootenv.var.%s_deepcolor", outputmode);
+            stageBootEnv(ubootvar, colorAttribute);
+            stageBootEnv(UBOOTENV_COLORATTRIBUTE, colorAttribute);
+            return true;
+        });
     }
 
-    if (strstr(curMode, outputmode) == NULL) {
-        if (cvbsMode) {
+    int modeSet = seq.addStep("output mode", ModeSwitchSequencer::after(policy)
+            | ModeSwitchSequencer::after(dvOff) | ModeSwitchSequencer::after(color), [&]() {
+        char curMode[MODE_LEN] = {0};
+        pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, curMode);
+
+        if (strstr(mRebootMode, "quiescent")) {
+            SYS_LOGI("reboot_mode is quiescent\n");
             pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, "null");
+            return false;
         }
-        pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, outputmode);
-    } else {
-        SYS_LOGI("cur display mode is equals to outputmode, Do not need set it\n");
-    }
-    if (pSysWrite->getPropertyBoolean(PROP_DISPLAY_SIZE_CHECK, true)) {
-        char resolution[MODE_LEN] = {0};
-        char defaultResolution[MODE_LEN] = {0};
-        char finalResolution[MODE_LEN] = {0};
-        int w = 0, h = 0, w1 =0, h1 = 0;
-        pSysWrite->readSysfs(SYS_DISPLAY_RESOLUTION, resolution);
-        pSysWrite->getPropertyString(PROP_DISPLAY_SIZE, defaultResolution, "0x0");
-        sscanf(resolution, "%dx%d", &w, &h);
-        sscanf(defaultResolution, "%dx%d", &w1, &h1);
-        if ((w != w1) || (h != h1)) {
-            sprintf(finalResolution, "%dx%d", w, h);
-            pSysWrite->setProperty(PROP_DISPLAY_SIZE, finalResolution);
-        }
-    }
 
-    char defaultResolution[MODE_LEN] = {0};
-    pSysWrite->getPropertyString(PROP_DISPLAY_SIZE, defaultResolution, "0x0");
-    SYS_LOGI("set display-size:%s\n", defaultResolution);
+        if (strstr(curMode, outputmode) == NULL) {
+            if (cvbsMode) {
+                pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, "null");
+            }
+            pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, outputmode);
+        } else {
+            SYS_LOGI("cur display mode is equals to outputmode, Do not need set it\n");
+        }
+        return true;
+    });
+
+    //surfaceflinger picks the size up later, nothing here waits for it
+    seq.addAsyncStep("display size", ModeSwitchSequencer::after(modeSet), [this]() {
+        if (pSysWrite->getPropertyBoolean(PROP_DISPLAY_SIZE_CHECK, true)) {
+            char resolution[MODE_LEN] = {0};
+            char defaultResolution[MODE_LEN] = {0};
+            char finalResolution[MODE_LEN] = {0};
+            int w = 0, h = 0, w1 =0, h1 = 0;
+            pSysWrite->readSysfs(SYS_DISPLAY_RESOLUTION, resolution);
+            pSysWrite->getPropertyString(PROP_DISPLAY_SIZE, defaultResolution, "0x0");
+            sscanf(resolution, "%dx%d", &w, &h);
+            sscanf(defaultResolution, "%dx%d", &w1, &h1);
+            if ((w != w1) || (h != h1)) {
+                sprintf(finalResolution, "%dx%d", w, h);
+                pSysWrite->setProperty(PROP_DISPLAY_SIZE, finalResolution);
+            }
+            SYS_LOGI("set display-size:%s\n", finalResolution[0] != '\0' ? finalResolution : defaultResolution);
+        }
+        return true;
+    });
 
-    //update free_scale_axis and window_axis
-    updateFreeScaleAxis();
-    updateWindowAxis(outputmode);
+    //4. turn on phy, the axis work below runs while it comes up
+    int phyOn = -1;
+    if (muted && !cvbsMode) {
+        phyOn = seq.addStep("phy on", ModeSwitchSequencer::after(modeSet), NULL);
+        seq.writes(phyOn).add(DISPLAY_HDMI_PHY, "1"); /* Turn on TMDS PHY */
+    }
 
-    initHdrSdrMode();
+    //update free_scale_axis and window_axis, the sink is still muted
+    int axis = seq.addStep("axis", ModeSwitchSequencer::after(modeSet), [&]() {
+        updateFreeScaleAxis();
+        updateWindowAxis(outputmode);
 
-    if (0 == pSysWrite->getPropertyInt(PROP_BOOTCOMPLETE, 0)) {
-        setVideoPlayingAxis();
-    }
+        initHdrSdrMode();
 
-    SYS_LOGI("setMboxOutputMode cvbsMode = %d\n", cvbsMode);
-    //4. turn on phy and clear avmute
-    if (OUPUT_MODE_STATE_INIT != state && !cvbsMode) {
-        pSysWrite->writeSysfs(DISPLAY_HDMI_PHY, "1"); /* Turn on TMDS PHY */
-        usleep(20000);
-        pSysWrite->writeSysfs(DISPLAY_HDMI_AUDIO_MUTE, "1");
-        pSysWrite->writeSysfs(DISPLAY_HDMI_AUDIO_MUTE, "0");
-        if ((state == OUPUT_MODE_STATE_SWITCH) && isDolbyVisionEnable())
-            usleep(20000);
-        pSysWrite->writeSysfs(DISPLAY_HDMI_AVMUTE, "-1");
+        if (0 == pSysWrite->getPropertyInt(PROP_BOOTCOMPLETE, 0)) {
+            setVideoPlayingAxis();
+        }
+        SYS_LOGI("setMboxOutputMode cvbsMode = %d\n", cvbsMode);
+        return true;
+    });
+
+    //the hdmi tx reports the dolby vision status once it sends in the new mode
+    int dvOn = -1;
+    if ((MODE_SWITCH_DV_KEEP != dvState) && (DOLBY_VISION_SET_DISABLE != dvState))
+        dvOn = addDolbyVisionSteps(seq, dvState, ModeSwitchSequencer::after(modeSet)
+            | ModeSwitchSequencer::after(phyOn));
+
+    //clear avmute once the phy is up
+    int unmute = -1;
+    if (phyOn >= 0) {
+        unmute = seq.addStep("unmute", ModeSwitchSequencer::after(phyOn)
+                | ModeSwitchSequencer::after(axis) | ModeSwitchSequencer::after(dvOn), NULL);
+        SysfsBatch &writes = seq.writes(unmute);
+        writes.addDelay(MODE_SWITCH_PHY_ON_US);
+        writes.add(DISPLAY_HDMI_AUDIO_MUTE, "1");
+        writes.add(DISPLAY_HDMI_AUDIO_MUTE, "0");
+        writes.add(DISPLAY_HDMI_AVMUTE, "-1");
     }
 
     //5. start HDMI HDCP authenticate
-    if (!cvbsMode) {
-        pTxAuth->start();
-    }
+    int hdcpStart = seq.addStep("hdcp start", ModeSwitchSequencer::after(axis)
+            | ModeSwitchSequencer::after(dvOn) | ModeSwitchSequencer::after(unmute), [&]() {
+        if (!cvbsMode) {
+            pTxAuth->start();
+        }
+        return true;
+    });
 
-    if (OUPUT_MODE_STATE_INIT == state) {
-        startBootanimDetectThread();
-        char bootvideo[MODE_LEN] = {0};
-        pSysWrite->getPropertyString(PROP_BOOTVIDEO_SERVICE, bootvideo, "0");
-        if (strcmp(bootvideo, "1") == 0) {
-            startBootvideoDetectThread();
+    int shown = seq.addStep("notify", ModeSwitchSequencer::after(hdcpStart), [&]() {
+        if (OUPUT_MODE_STATE_INIT == state) {
+            startBootWatcher();
+        } else {
+            pSysWrite->writeSysfs(SYS_DISABLE_VIDEO, VIDEO_LAYER_ENABLE);
         }
-    } else {
-        pSysWrite->writeSysfs(SYS_DISABLE_VIDEO, VIDEO_LAYER_ENABLE);
-    }
 
 #ifndef RECOVERY_MODE
-    notifyEvent(EVENT_OUTPUT_MODE_CHANGE);
+        int64_t start = ModeSwitchTracer::now();
+        notifyEvent(EVENT_OUTPUT_MODE_CHANGE);
+        mTracer.addSpan(trace, 1, false, start, ModeSwitchTracer::now(), "notifyEvent");
 #endif
-    if (!cvbsMode && (OUPUT_MODE_STATE_INIT != state) && isDolbyVisionEnable() && setDolbyVisionState) {
-        setDolbyVisionEnable(getDolbyVisionType());
-    }
+
+        //in memory only, the save below writes the partition once
+        stageBootEnv(UBOOTENV_OUTPUTMODE, outputmode);
+        if (strstr(outputmode, "cvbs") != NULL) {
+            stageBootEnv(UBOOTENV_CVBSMODE, outputmode);
+        } else {
+            stageBootEnv(UBOOTENV_HDMIMODE, outputmode);
+        }
+        return true;
+    });
+
     //audio
-    memset(value, 0, sizeof(0));
-    getBootEnv(UBOOTENV_DIGITAUDIO, value);
-    setDigitalMode(value);
+    seq.addAsyncStep("digital audio", ModeSwitchSequencer::after(shown), [this]() {
+        char value[MAX_STR_LEN] = {0};
+        getBootEnv(UBOOTENV_DIGITAUDIO, value);
+        setDigitalMode(value);
+        return true;
+    });
 
-    setBootEnv(UBOOTENV_OUTPUTMODE, (char *)outputmode);
-    if (strstr(outputmode, "cvbs") != NULL) {
-        setBootEnv(UBOOTENV_CVBSMODE, (char *)outputmode);
-    } else {
-        setBootEnv(UBOOTENV_HDMIMODE, (char *)outputmode);
-    }
+    //also saves the deep color of a quiescent boot, which stops before the mode is set
+    seq.addAsyncStep("save bootenv", ModeSwitchSequencer::after(color), [this]() {
+        mUbootenv->commit();
+        return true;
+    });
+
+    seq.run();
+    mTracer.end(trace);
+    if (mLogLevel > LOG_LEVEL_1)
+        SYS_LOGI("mode switch timeline:\n%s", seq.dump().c_str());
     SYS_LOGI("set output mode:%s done\n", outputmode);
 }
 
@@ -678,17 +854,9 @@ bool DisplayMode::writeHdcpRXImg(const char *path) {
 
 //get the best hdmi mode by edid
 void DisplayMode::getBestHdmiMode(char* mode, hdmi_data_t* data) {
-    char* pos = strchr(data->edid, '*');
-    if (pos != NULL) {
-        char* findReturn = pos;
-        while (*findReturn != 0x0a && findReturn >= data->edid) {
-            findReturn--;
-        }
-        //*pos = 0;
-        //strcpy(mode, findReturn + 1);
-
-        findReturn = findReturn + 1;
-        strncpy(mode, findReturn, pos - findReturn);
+    const char *native = data->caps.getNativeMode();
+    if (strlen(native) > 0) {
+        strcpy(mode, native);
         SYS_LOGI("set HDMI to best edid mode: %s\n", mode);
     }
 
@@ -727,52 +895,14 @@ void DisplayMode::getBestHdmiMode(char* mode, hdmi_data_t* data) {
 
 //get the highest hdmi mode by edid
 void DisplayMode::getHighestHdmiMode(char* mode, hdmi_data_t* data) {
-    char value[MODE_LEN] = {0};
-    char tempMode[MODE_LEN] = {0};
-
-    char* startpos;
-    char* destpos;
-
-    startpos = data->edid;
-    strcpy(value, DEFAULT_OUTPUT_MODE);
-
-    while (strlen(startpos) > 0) {
-        //get edid resolution to tempMode in order.
-        destpos = strstr(startpos, "\n");
-        if (NULL == destpos)
-            break;
-        memset(tempMode, 0, MODE_LEN);
-        strncpy(tempMode, startpos, destpos - startpos);
-        startpos = destpos + 1;
-        if (!pSysWrite->getPropertyBoolean(PROP_SUPPORT_4K, true)
-            &&(strstr(tempMode, "2160") || strstr(tempMode, "smpte"))) {
-                SYS_LOGE("This platform not support : %s\n", tempMode);
-            continue;
-        }
-
-        if (tempMode[strlen(tempMode) - 1] == '*') {
-            tempMode[strlen(tempMode) - 1] = '\0';
-        }
-
-        if (!pSysWrite->getPropertyBoolean(PROP_SUPPORT_OVER_4K30, true)
-                &&(resolveResolutionValue(tempMode) > resolveResolutionValue("2160p30hz")
-                    || strstr(tempMode, "smpte"))) {
-            SYS_LOGE("This platform not support the mode over 2160p30hz, current mode is:[%s]\n", tempMode);
-            continue;
-        }
-        if (resolveResolutionValue(tempMode) > resolveResolutionValue(value)) {
-            memset(value, 0, MODE_LEN);
-            strcpy(value, tempMode);
-        }
-    }
-    strcpy(mode, value);
+    data->caps.getHighest(DEFAULT_OUTPUT_MODE,
+        pSysWrite->getPropertyBoolean(PROP_SUPPORT_4K, true),
+        pSysWrite->getPropertyBoolean(PROP_SUPPORT_OVER_4K30, true), mode);
     SYS_LOGI("set HDMI to highest edid mode: %s\n", mode);
 }
 
 int64_t DisplayMode::resolveResolutionValue(const char *mode) {
-    resolution_t resol_t;
-    resolveResolution(mode, &resol_t);
-    return resol_t.resolution_num;
+    return DisplayModeRegistry::resolutionValue(mode);
 }
 
 /* *
@@ -783,35 +913,19 @@ int64_t DisplayMode::resolveResolutionValue(const char *mode) {
  *  User can select Highest resolution base this value.
  */
 void DisplayMode::resolveResolution(const char *mode, resolution_t* resol_t) {
+    const display_mode_record_t *record = DisplayModeRegistry::find(mode);
+
     memset(resol_t, 0, sizeof(resolution_t));
-    bool validMode = false;
-    if (strlen(mode) != 0) {
-        for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
-            if (strcmp(mode, DISPLAY_MODE_LIST[i]) == 0) {
-                validMode = true;
-                break;
-            }
-        }
-    }
-    if (!validMode) {
+    if (record == NULL) {
         SYS_LOGI("the resolveResolution mode [%s] is not valid\n", mode);
         return;
     }
 
-    resol_t->resolution = atoi(mode);
-    resol_t->standard = strstr(mode, "p") == NULL ? 'i' : 'p';
-    char* position = (char *)strstr(mode, resol_t->standard == 'p' ? "p" : "i");
-    resol_t->frequency = atoi(position + 1);
-    position = (char *)strstr(mode, "hz");
-    resol_t->deepcolor = strlen(position + 2) == 0 ? 0 : atoi(position + 2);
-
-    int i = strstr(mode, "p") == NULL ? 0 : 1;
-    //[ 0:15]bit : resolution deepcolor
-    //[16:27]bit : frequency
-    //[28:31]bit : standard 'p' is 1, and 'i' is 0.
-    //[32:63]bit : resolution
-    resol_t->resolution_num = resol_t->deepcolor + (resol_t->frequency<< 16)
-        + (((int64_t)i) << 28) + (((int64_t)resol_t->resolution) << 32);
+    resol_t->resolution = record->resolution;
+    resol_t->standard = record->standard;
+    resol_t->frequency = record->frequency;
+    resol_t->deepcolor = record->deepcolor;
+    resol_t->resolution_num = record->resolution_num;
 }
 
 //get the highest priority mode defined by CDF table
@@ -829,7 +943,7 @@ void DisplayMode::getHighestPriorityMode(char* mode, hdmi_data_t* data) {
     }
 
     for (int i = 0; i < modeSize; i++) {
-        if (strstr(data->edid, pMode[i]) != NULL) {
+        if (data->caps.mentionsMode(pMode[i])) {
             strcpy(mode, pMode[i]);
             return;
         }
@@ -840,22 +954,9 @@ void DisplayMode::getHighestPriorityMode(char* mode, hdmi_data_t* data) {
 
 //check if the edid support current hdmi mode
 void DisplayMode::filterHdmiMode(char* mode, hdmi_data_t* data) {
-    char *pCmp = data->edid;
-    while ((pCmp - data->edid) < (int)strlen(data->edid)) {
-        char *pos = strchr(pCmp, 0x0a);
-        if (NULL == pos)
-            break;
-
-        int step = 1;
-        if (*(pos - 1) == '*') {
-            pos -= 1;
-            step += 1;
-        }
-        if (!strncmp(pCmp, data->ubootenv_hdmimode, pos - pCmp)) {
-            strcpy(mode, data->ubootenv_hdmimode);
-            return;
-        }
-        pCmp = pos + step;
+    if (data->caps.acceptsMode(data->ubootenv_hdmimode)) {
+        strcpy(mode, data->ubootenv_hdmimode);
+        return;
     }
     if (DISPLAY_TYPE_TV == mDisplayType) {
         #ifdef TEST_UBOOT_MODE
@@ -913,20 +1014,10 @@ void DisplayMode::getHdmiData(hdmi_data_t* data) {
     else if (NULL != strstr(sinkType, "repeater"))
         data->sinkType = HDMI_SINK_TYPE_REPEATER;
 
+    data->caps.clear();
     if (HDMI_SINK_TYPE_NONE != data->sinkType) {
-        int count = 0;
-        while (true) {
-            pSysWrite->readSysfsOriginal(DISPLAY_HDMI_EDID, data->edid);
-            if (strlen(data->edid) > 0)
-                break;
-
-            if (count >= 5) {
-                strcpy(data->edid, "null edid");
-                break;
-            }
-            count++;
-            usleep(500000);
-        }
+        getSinkCaps(&data->caps, true);
+        strcpy(data->edid, data->caps.getText());
     }
     pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, data->current_mode);
     getBootEnv(UBOOTENV_HDMIMODE, data->ubootenv_hdmimode);
@@ -984,124 +1075,151 @@ bool DisplayMode::modeSupport(char *mode, int sinkType) {
     return false;
 }
 
-void DisplayMode::startBootanimDetectThread() {
-    pthread_t id;
-    int ret = pthread_create(&id, NULL, bootanimDetect, this);
-    if (ret != 0) {
-        SYS_LOGE("Create BootanimDetect error!\n");
+void DisplayMode::startBootWatcher() {
+    if (pBootWatcher != NULL)
+        return;
+
+    //bootanim and bootvideo on one thread, it is not stopped and lives with the service
+    pBootWatcher = new BootWatcher(PropertyCache::getDefaultBackend(), BootWatcher::getDefaultConfig(),
+        this, mInitNs);
+    if (!pBootWatcher->start()) {
+        delete pBootWatcher;
+        pBootWatcher = NULL;
     }
 }
 
-//if detected bootanim is running, then close uboot logo
-void* DisplayMode::bootanimDetect(void* data) {
-    DisplayMode *pThiz = (DisplayMode*)data;
-    char bootanimState[MODE_LEN] = {"stopped"};
-    char fs_mode[MODE_LEN] = {0};
-    char recovery_state[MODE_LEN] = {0};
-    char outputmode[MODE_LEN] = {0};
-    char bootvideo[MODE_LEN] = {0};
-
-    pThiz->pSysWrite->getPropertyString(PROP_FS_MODE, fs_mode, "android");
-    pThiz->pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, outputmode);
-
-    //not in the recovery mode
-    if (strcmp(fs_mode, "recovery")) {
-        //some boot videos maybe need 2~3s to start playing, so if the bootamin property
-        //don't run after about 4s, exit the loop.
-        int timeout = 40;
-        while (timeout > 0) {
-            //init had started boot animation, will set init.svc.* running
-            pThiz->pSysWrite->getPropertyString(PROP_BOOTANIM, bootanimState, "stopped");
-            if (!strcmp(bootanimState, "running"))
-                break;
-
-            usleep(100000);
-            timeout--;
-        }
+void DisplayMode::onBootanimStatus(int status) {
+    setBootanimStatus(status);
+}
 
-        int delayMs = pThiz->pSysWrite->getPropertyInt(PROP_BOOTANIM_DELAY, 100);
-        usleep(delayMs * 1000);
-        usleep(1000 * 1000);
-    }
-
-    pThiz->pSysWrite->getPropertyString(PROP_BOOTVIDEO_SERVICE, bootvideo, "0");
-    SYS_LOGI("boot animation detect boot video:%s\n", bootvideo);
-    if (strcmp(bootvideo, "1") != 0) {
-        pThiz->setBootanimStatus(1);
-    }
-
-    // Cannot access amldisplay_prop in P, selinux never allowed!
-    // check service property instead
-    pThiz->pSysWrite->getPropertyString("init.svc.recovery", recovery_state, "stopped");
-    SYS_LOGE("recovery running state is:%s!\n", recovery_state);
-    if ((!strcmp(recovery_state, "running"))|| (!strcmp(fs_mode, "recovery")) || (!strcmp(bootvideo, "1"))) {
-        //recovery or bootvideo mode
-        SYS_LOGE("recovery  or bootvideo mode");
-        usleep(1000000LL);
-        pThiz->pSysWrite->writeSysfs(DISPLAY_FB0_BLANK, "1");
-        //need close fb1, because uboot logo show in fb1
-        pThiz->pSysWrite->writeSysfs(DISPLAY_FB1_BLANK, "1");
-        pThiz->pSysWrite->writeSysfs(DISPLAY_FB1_FREESCALE, "0");
-        pThiz->pSysWrite->writeSysfs(DISPLAY_FB0_FREESCALE, "0x10001");
-        //not boot video running
-        if (strcmp(bootvideo, "1")) {
-            //open fb0, let bootanimation show in it
-            pThiz->pSysWrite->writeSysfs(DISPLAY_FB0_BLANK, "0");
-        }
+//if detected recovery or bootvideo is running, then close uboot logo
+void DisplayMode::onLogoHandover(bool bootvideo) {
+    pSysWrite->writeSysfs(DISPLAY_FB0_BLANK, "1");
+    //need close fb1, because uboot logo show in fb1
+    pSysWrite->writeSysfs(DISPLAY_FB1_BLANK, "1");
+    pSysWrite->writeSysfs(DISPLAY_FB1_FREESCALE, "0");
+    pSysWrite->writeSysfs(DISPLAY_FB0_FREESCALE, "0x10001");
+    //not boot video running
+    if (!bootvideo) {
+        //open fb0, let bootanimation show in it
+        pSysWrite->writeSysfs(DISPLAY_FB0_BLANK, "0");
     }
-
-    if (pThiz->pTxAuth)
-        pThiz->pTxAuth->setBootAnimFinished(true);
-    else
-        SYS_LOGE("pThiz->pTxAuth=NULL");
-
-    SYS_LOGE("recovery  or bootvideo end");
-    usleep(1000000LL);
-
-    return NULL;
 }
 
-void DisplayMode::startBootvideoDetectThread() {
-    pthread_t id;
-    int ret = pthread_create(&id, NULL, bootvideoDetect, this);
-    if (ret != 0) {
-        SYS_LOGE("Create Bootvideo error!\n");
-    }
+void DisplayMode::onBootAnimFinished() {
+    if (pTxAuth)
+        pTxAuth->setBootAnimFinished(true);
+    else
+        SYS_LOGE("pTxAuth=NULL");
 }
 
-void* DisplayMode::bootvideoDetect(void* data) {
-    DisplayMode *pThiz = (DisplayMode*)data;
-    int timeout = 1200;
-    char value[MODE_LEN] = {0};
-    SYS_LOGI("Need to setBootanimStatus 1 after bootvideo complete");
-    while (timeout > 0) {
-        pThiz->pSysWrite->getProperty("init.svc.bootvideo", value);
-        if (strstr(value, "stopped") != NULL) {
-            pThiz->setBootanimStatus(1);
-            return NULL;
+//get edid crc value to check edid change
+bool DisplayMode::isEdidChange() {
+    char crc[MAX_STR_LEN] = {0};
+    char crcvalue[MAX_STR_LEN] = {0};
+    if (getEdidCrc(crc, MAX_STR_LEN)) {
+        if (!getBootEnv(UBOOTENV_EDIDCRCVALUE, crcvalue) || strncmp(crc, crcvalue, strlen(crc))) {
+            setBootEnv(UBOOTENV_EDIDCRCVALUE, crc);
+            return true;
         }
-        usleep(100000);
-        timeout--;
     }
-    pThiz->setBootanimStatus(1);
-    return NULL;
+    return false;
 }
 
-//get edid crc value to check edid change
-bool DisplayMode::isEdidChange() {
+//the crc the driver prints after the raw edid, false without a sink
+bool DisplayMode::getEdidCrc(char *crc, int len) {
     char edid[MAX_STR_LEN] = {0};
-    char crcvalue[MAX_STR_LEN] = {0};
     unsigned int crcheadlength = strlen(DEFAULT_EDID_CRCHEAD);
     pSysWrite->readSysfs(DISPLAY_EDID_VALUE, edid);
     char *p = strstr(edid, DEFAULT_EDID_CRCHEAD);
-    if (p != NULL && strlen(p) > crcheadlength) {
-        p += crcheadlength;
-        if (!getBootEnv(UBOOTENV_EDIDCRCVALUE, crcvalue) || strncmp(p, crcvalue, strlen(p))) {
-            setBootEnv(UBOOTENV_EDIDCRCVALUE, p);
-            return true;
+    if (p == NULL || strlen(p) <= crcheadlength)
+        return false;
+
+    strncpy(crc, p + crcheadlength, len - 1);
+    crc[len - 1] = '\0';
+    return true;
+}
+
+/*
+ * disp_cap, dc_cap, dv_cap and hdr_cap are read and parsed once per sink,
+ * later calls get the copy kept for the same edid crc.
+ * waitEdid: retry an empty disp_cap as getHdmiData() did, the sink is there
+ * colors: the best deep color of each mode the sink lists, built with the caps
+ */
+bool DisplayMode::getSinkCaps(SinkCaps *caps, bool waitEdid, DeepColorTable *colors, char *crcOut) {
+    //kept until the hotplug uevent drops them, no sysfs read on a hit
+    mutex_lock(&mCapsLock);
+    if (mCapsValid) {
+        *caps = mSinkCaps;
+        if (colors != NULL)
+            *colors = mColorTable;
+        if (crcOut != NULL)
+            strcpy(crcOut, mCapsCrc);
+        mutex_unlock(&mCapsLock);
+        return true;
+    }
+    int generation = mCapsGeneration;
+    mutex_unlock(&mCapsLock);
+
+    char crc[MODE_LEN] = {0};
+    bool hasCrc = getEdidCrc(crc, MODE_LEN);
+    char dispCap[MAX_STR_LEN] = {0};
+    char dcCap[MAX_STR_LEN] = {0};
+    char dvCap[MAX_STR_LEN] = {0};
+    char hdrCap[MAX_STR_LEN] = {0};
+
+    int count = 0;
+    while (true) {
+        pSysWrite->readSysfsOriginal(DISPLAY_HDMI_EDID, dispCap);
+        if (strlen(dispCap) > 0 || !waitEdid)
+            break;
+
+        if (count >= 5) {
+            strcpy(dispCap, "null edid");
+            break;
         }
+        count++;
+        usleep(500000);
+    }
+    pSysWrite->readSysfs(DISPLAY_HDMI_DEEP_COLOR, dcCap);
+    pSysWrite->readSysfs(DOLBY_VISION_IS_SUPPORT, dvCap);
+    pSysWrite->readSysfsOriginal(DISPLAY_HDMI_HDR, hdrCap);
+
+    caps->parse(dispCap, dcCap, dvCap, hdrCap);
+    SYS_LOGI("sink caps parsed, crc [%s], %d modes, native [%s], dv [%s]\n",
+        crc, caps->getModeCount(), caps->getNativeMode(), caps->getDolbyVisionCaps());
+
+    //a sink still reading its edid is parsed again on the next call,
+    //the color table only pays off when it is kept
+    DeepColorTable table;
+    table.clear();
+    if (hasCrc && caps->getModeCount() > 0) {
+        if (DISPLAY_TYPE_TV != mDisplayType) {
+            FormatColorDepth deepColor;
+            table.build(caps, pSysWrite->getPropertyBoolean(LOW_POWER_DEFAULT_COLOR, false), &deepColor);
+        }
+        mutex_lock(&mCapsLock);
+        //a hotplug meanwhile, the edid read may be of the sink before
+        if (generation == mCapsGeneration) {
+            mSinkCaps = *caps;
+            mColorTable = table;
+            strcpy(mCapsCrc, crc);
+            mCapsValid = true;
+        }
+        mutex_unlock(&mCapsLock);
     }
-    return false;
+    if (colors != NULL)
+        *colors = table;
+    if (crcOut != NULL)
+        strcpy(crcOut, crc);
+    return hasCrc;
+}
+
+void DisplayMode::invalidateSinkCaps() {
+    mutex_lock(&mCapsLock);
+    mCapsValid = false;
+    mCapsGeneration++;
+    mutex_unlock(&mCapsLock);
 }
 
 bool DisplayMode::isBestOutputmode() {
@@ -1192,83 +1310,7 @@ void DisplayMode::setAutoSwitchFrameRate(int state) {
 void DisplayMode::updateDefaultUI() {
 #if defined(ODROID)
     SYS_LOGI("%s, mDefaultUI = %s", __func__, mDefaultUI);
-    if (!strncmp(mDefaultUI, "480x320", 7)) {
-        mDisplayWidth = 480;
-        mDisplayHeight = 320;
-    } else if (!strncmp(mDefaultUI, "640x480", 7)) {
-        mDisplayWidth = 640;
-        mDisplayHeight = 480;
-    } else if (!strncmp(mDefaultUI, "480", 3)) {
-        mDisplayWidth = 720;
-        mDisplayHeight = 480;
-    } else if (!strncmp(mDefaultUI, "800x480", 7)) {
-        mDisplayWidth = 800;
-        mDisplayHeight = 480;
-    } else if (!strncmp(mDefaultUI, "576", 3)) {
-        mDisplayWidth = 720;
-        mDisplayHeight = 576;
-    } else if (!strncmp(mDefaultUI, "800x600", 7)) {
-        mDisplayWidth = 800;
-        mDisplayHeight = 600;
-    } else if (!strncmp(mDefaultUI, "1024x600", 8)) {
-        mDisplayWidth = 1024;
-        mDisplayHeight = 600;
-    } else if (!strncmp(mDefaultUI, "1024x768", 8)) {
-        mDisplayWidth = 1024;
-        mDisplayHeight = 768;
-    } else if (!strncmp(mDefaultUI, "720", 3)) {
-        mDisplayWidth = 1280;
-        mDisplayHeight = 720;
-    } else if (!strncmp(mDefaultUI, "1280x800", 8)) {
-        mDisplayWidth = 1280;
-        mDisplayHeight = 800;
-    } else if (!strncmp(mDefaultUI, "1360x768", 8)) {
-        mDisplayWidth = 1360;
-        mDisplayHeight = 768;
-    } else if (!strncmp(mDefaultUI, "1366x768", 8)) {
-        mDisplayWidth = 1366;
-        mDisplayHeight = 768;
-    } else if (!strncmp(mDefaultUI, "1440x900", 8)) {
-        mDisplayWidth = 1440;
-        mDisplayHeight = 900;
-    } else if (!strncmp(mDefaultUI, "1280x1024", 9)) {
-        mDisplayWidth = 1280;
-        mDisplayHeight = 1024;
-    } else if (!strncmp(mDefaultUI, "1600x900", 8)) {
-        mDisplayWidth = 1600;
-        mDisplayHeight = 900;
-    } else if (!strncmp(mDefaultUI, "1680x1050", 9)) {
-        mDisplayWidth = 1680;
-        mDisplayHeight = 1050;
-    } else if (!strncmp(mDefaultUI, "1600x1200", 9)) {
-        mDisplayWidth = 1600;
-        mDisplayHeight = 1200;
-    } else if (!strncmp(mDefaultUI, "1080", 4)) {
-        mDisplayWidth = 1920;
-        mDisplayHeight = 1080;
-    } else if (!strncmp(mDefaultUI, "1920x1200", 9)) {
-        mDisplayWidth = 1920;
-        mDisplayHeight = 1200;
-    } else if (!strncmp(mDefaultUI, "2560x1080", 9)) {
-        mDisplayWidth = 2560;
-        mDisplayHeight = 1080;
-    } else if (!strncmp(mDefaultUI, "2560x1440", 9)) {
-        mDisplayWidth = 2560;
-        mDisplayHeight = 1440;
-    } else if (!strncmp(mDefaultUI, "2560x1600", 9)) {
-        mDisplayWidth = 2560;
-        mDisplayHeight = 1600;
-    } else if (!strncmp(mDefaultUI, "3440x1440", 9)) {
-        /* 3440x1440 - scaling with 21:9 ratio */
-        mDisplayWidth = 2560;
-        mDisplayHeight = 1080;
-    } else if (!strncmp(mDefaultUI, "2160", 4)) {
-        /* FIXME: real 4K framebuffer is too slow, so using 1080p
-         * fbset(3840, 2160, 32);
-         */
-        mDisplayWidth = 1920;
-        mDisplayHeight = 1080;
-    } else if (!strncmp(mDefaultUI, "custombuilt", 11)) {
+    if (!strncmp(mDefaultUI, "custombuilt", 11)) {
         char value[64];
         getBootEnv(UBOOTENV_CUSTOMWIDTH, value);
         mDisplayWidth = atoi(value);
@@ -1279,40 +1321,27 @@ void DisplayMode::updateDefaultUI() {
             mDisplayWidth = 1920;
         if (mDisplayHeight == 2160)
             mDisplayHeight = 1080;
-    }
-#else
-    if (!strncmp(mDefaultUI, "720", 3)) {
-        mDisplayWidth= FULL_WIDTH_720;
-        mDisplayHeight = FULL_HEIGHT_720;
-        //pSysWrite->setProperty(PROP_LCD_DENSITY, DESITY_720P);
-        //pSysWrite->setProperty(PROP_WINDOW_WIDTH, "1280");
-        //pSysWrite->setProperty(PROP_WINDOW_HEIGHT, "720");
-    } else if (!strncmp(mDefaultUI, "1080", 4)) {
-        mDisplayWidth = FULL_WIDTH_1080;
-        mDisplayHeight = FULL_HEIGHT_1080;
-        //pSysWrite->setProperty(PROP_LCD_DENSITY, DESITY_1080P);
-        //pSysWrite->setProperty(PROP_WINDOW_WIDTH, "1920");
-        //pSysWrite->setProperty(PROP_WINDOW_HEIGHT, "1080");
-    } else if (!strncmp(mDefaultUI, "4k2k", 4)) {
-        mDisplayWidth = FULL_WIDTH_4K2K;
-        mDisplayHeight = FULL_HEIGHT_4K2K;
-        //pSysWrite->setProperty(PROP_LCD_DENSITY, DESITY_2160P);
-        //pSysWrite->setProperty(PROP_WINDOW_WIDTH, "3840");
-        //pSysWrite->setProperty(PROP_WINDOW_HEIGHT, "2160");
+        return;
     }
 #endif
+    DisplayModeRegistry::getUiSize(mDefaultUI, &mDisplayWidth, &mDisplayHeight);
 }
 
-void DisplayMode::updateDeepColor(bool cvbsMode, output_mode_state state, const char* outputmode) {
+bool DisplayMode::getDeepColorAttribute(bool cvbsMode, output_mode_state state, const char* outputmode, char* colorAttribute) {
     if (!cvbsMode && (mDisplayType != DISPLAY_TYPE_TV)) {
-        char colorAttribute[MODE_LEN] = {0};
+        SinkCaps caps;
+        DeepColorTable colors;
         FormatColorDepth deepColor;
+        getSinkCaps(&caps, false, &colors);
+        deepColor.setSinkCaps(&caps);
+        deepColor.setColorTable(&colors);
         if (pSysWrite->getPropertyBoolean(PROP_DEEPCOLOR, true)) {
             char mode[MAX_STR_LEN] = {0};
             if (isDolbyVisionEnable() && isTvSupportDolbyVision(mode)) {
                  char type[MODE_LEN] = {0};
                 pSysWrite->getPropertyString(PROP_DOLBY_VISION_TYPE, type, "1");
-                if (atoi(type) != 1 && strstr(mode, DV_MODE_TYPE[atoi(type)]) == NULL) {
+                const char *dvType = SinkCaps::getDolbyVisionType(atoi(type));
+                if (atoi(type) != 1 && (dvType == NULL || strstr(mode, dvType) == NULL)) {
                     strcpy(type, "1");
                 }
                 switch (atoi(type)) {
@@ -1335,20 +1364,9 @@ void DisplayMode::updateDeepColor(bool cvbsMode, output_mode_state state, const
         } else {
             strcpy(colorAttribute, "default");
         }
-        char attr[MODE_LEN] = {0};
-        pSysWrite->readSysfs(DISPLAY_HDMI_COLOR_ATTR, attr);
-        if (strstr(attr, colorAttribute) == NULL) {
-            SYS_LOGI("set DeepcolorAttr value is different from attr sysfs value\n");
-            pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, "null");
-            pSysWrite->writeSysfs(DISPLAY_HDMI_COLOR_ATTR, colorAttribute);
-        } else {
-            SYS_LOGI("cur deepcolor attr value is equals to colorAttribute, Do not need set it\n");
-        }
-        SYS_LOGI("setMboxOutputMode colorAttribute = %s\n", colorAttribute);
-        //save to ubootenv
-        saveDeepColorAttr(outputmode, colorAttribute);
-        setBootEnv(UBOOTENV_COLORATTRIBUTE, colorAttribute);
+        return true;
     }
+    return false;
 }
 
 void DisplayMode::updateFreeScaleAxis() {
@@ -1379,124 +1397,17 @@ void DisplayMode::getBootanimStatus(int *status) {
 }
 
 void DisplayMode::getPosition(const char* curMode, int *position) {
-    char keyValue[20] = {0};
-    char ubootvar[100] = {0};
     int defaultWidth = 0;
     int defaultHeight = 0;
 #if defined(ODROID)
-    //SYS_LOGI("%s %s", __func__, curMode);
-    strncpy(keyValue, curMode, strlen(curMode) - 4);
     if (!strcmp(curMode, "custombuilt")) {
         defaultWidth = mDisplayWidth;
         defaultHeight = mDisplayHeight;
-    } else if (!strncmp(keyValue, "480x320", 7)) {
-        defaultWidth = 480;
-        defaultHeight = 320;
-    } else if (!strncmp(keyValue, "640x480", 7)) {
-        defaultWidth = 640;
-        defaultHeight = 480;
-    } else if (!strncmp(keyValue, "480", 3)) {
-        defaultWidth = 720;
-        defaultHeight = 480;
-    } else if (!strncmp(keyValue, "800x480", 7)) {
-        defaultWidth = 800;
-        defaultHeight = 480;
-    } else if (!strncmp(keyValue, "576", 3)) {
-        defaultWidth = 720;
-        defaultHeight = 576;
-    } else if (!strncmp(keyValue, "800x600", 7)) {
-        defaultWidth = 800;
-        defaultHeight = 600;
-    } else if (!strncmp(keyValue, "1024x600", 8)) {
-        defaultWidth = 1024;
-        defaultHeight = 600;
-    } else if (!strncmp(keyValue, "1024x768", 8)) {
-        defaultWidth = 1024;
-        defaultHeight = 768;
-    } else if (!strncmp(keyValue, "720", 3)) {
-        defaultWidth = 1280;
-        defaultHeight = 720;
-    } else if (!strncmp(keyValue, "1280x800", 8)) {
-        defaultWidth = 1280;
-        defaultHeight = 800;
-    } else if (!strncmp(keyValue, "1360x768", 8)) {
-        defaultWidth = 1360;
-        defaultHeight = 768;
-    } else if (!strncmp(keyValue, "1366x768", 8)) {
-        defaultWidth = 1366;
-        defaultHeight = 768;
-    } else if (!strncmp(keyValue, "1440x900", 8)) {
-        defaultWidth = 1440;
-        defaultHeight = 900;
-    } else if (!strncmp(keyValue, "1280x1024", 9)) {
-        defaultWidth = 1280;
-        defaultHeight = 1024;
-    } else if (!strncmp(keyValue, "1600x900", 8)) {
-        defaultWidth = 1600;
-        defaultHeight = 900;
-    } else if (!strncmp(keyValue, "1680x1050", 9)) {
-        defaultWidth = 1680;
-        defaultHeight = 1050;
-    } else if (!strncmp(keyValue, "1600x1200", 9)) {
-        defaultWidth = 1600;
-        defaultHeight = 1200;
-    } else if (!strncmp(keyValue, "1080", 4)) {
-        defaultWidth = 1920;
-        defaultHeight = 1080;
-    } else if (!strncmp(keyValue, "1920x1200", 9)) {
-        defaultWidth = 1920;
-        defaultHeight = 1200;
-    } else if (!strncmp(keyValue, "2560x1080", 9)) {
-        defaultWidth = 2560;
-        defaultHeight = 1080;
-    } else if (!strncmp(keyValue, "2560x1440", 9)) {
-        defaultWidth = 2560;
-        defaultHeight = 1440;
-    } else if (!strncmp(keyValue, "2560x1600", 9)) {
-        defaultWidth = 2560;
-        defaultHeight = 1600;
-    } else if (!strncmp(keyValue, "3440x1440", 9)) {
-        defaultWidth = 3440;
-        defaultHeight = 1440;
-    } else if (!strncmp(keyValue, "2160", 4)) {
-        defaultWidth = 3840;
-        defaultHeight = 2160;
+    } else {
+        DisplayModeRegistry::getDefaultSize(curMode, &defaultWidth, &defaultHeight);
     }
 #else
-    if (strstr(curMode, "480")) {
-        strcpy(keyValue, strstr(curMode, MODE_480P_PREFIX) ? MODE_480P_PREFIX : MODE_480I_PREFIX);
-        defaultWidth = FULL_WIDTH_480;
-        defaultHeight = FULL_HEIGHT_480;
-    } else if (strstr(curMode, "576")) {
-        strcpy(keyValue, strstr(curMode, MODE_576P_PREFIX) ? MODE_576P_PREFIX : MODE_576I_PREFIX);
-        defaultWidth = FULL_WIDTH_576;
-        defaultHeight = FULL_HEIGHT_576;
-    } else if (strstr(curMode, MODE_720P_PREFIX)) {
-        strcpy(keyValue, MODE_720P_PREFIX);
-        defaultWidth = FULL_WIDTH_720;
-        defaultHeight = FULL_HEIGHT_720;
-    } else if (strstr(curMode, MODE_768P_PREFIX)) {
-        strcpy(keyValue, MODE_768P_PREFIX);
-        defaultWidth = FULL_WIDTH_768;
-        defaultHeight = FULL_HEIGHT_768;
-    } else if (strstr(curMode, MODE_1080I_PREFIX)) {
-        strcpy(keyValue, MODE_1080I_PREFIX);
-        defaultWidth = FULL_WIDTH_1080;
-        defaultHeight = FULL_HEIGHT_1080;
-    } else if (strstr(curMode, MODE_1080P_PREFIX)) {
-        strcpy(keyValue, MODE_1080P_PREFIX);
-        defaultWidth = FULL_WIDTH_1080;
-        defaultHeight = FULL_HEIGHT_1080;
-    } else if (strstr(curMode, MODE_4K2K_PREFIX)) {
-        strcpy(keyValue, MODE_4K2K_PREFIX);
-        defaultWidth = FULL_WIDTH_4K2K;
-        defaultHeight = FULL_HEIGHT_4K2K;
-    } else if (strstr(curMode, MODE_4K2KSMPTE_PREFIX)) {
-        strcpy(keyValue, "4k2ksmpte");
-        defaultWidth = FULL_WIDTH_4K2KSMPTE;
-        defaultHeight = FULL_HEIGHT_4K2KSMPTE;
-    } else {
-        strcpy(keyValue, MODE_1080P_PREFIX);
+    if (!DisplayModeRegistry::getDefaultSize(curMode, &defaultWidth, &defaultHeight)) {
         defaultWidth = FULL_WIDTH_1080;
         defaultHeight = FULL_HEIGHT_1080;
     }
@@ -1552,30 +1463,18 @@ void DisplayMode::getDeepColorAttr(const char* mode, char* value) {
  * else mode is ""
  */
 bool DisplayMode::isTvSupportDolbyVision(char *mode) {
-    char dv_cap[MAX_STR_LEN] = {0};
+    SinkCaps caps;
     strcpy(mode, "");
     if (DISPLAY_TYPE_TV == mDisplayType) {
         SYS_LOGI("Current Device is TV, no dv_cap\n");
         return false;
     }
 
-    pSysWrite->readSysfs(DOLBY_VISION_IS_SUPPORT, dv_cap);
-    if (strstr(dv_cap, "The Rx don't support DolbyVision")) {
+    getSinkCaps(&caps, false);
+    if (!caps.isDolbyVisionSupported()) {
         return false;
     }
-    for (int i = DISPLAY_MODE_TOTAL - 1; i >= 0; i--) {
-        if (strstr(dv_cap, DISPLAY_MODE_LIST[i]) != NULL) {
-            strcat(mode, DISPLAY_MODE_LIST[i]);
-            strcat(mode, ",");
-            break;
-        }
-    }
-    for (int i = 0; i < sizeof(DV_MODE_TYPE)/sizeof(DV_MODE_TYPE[0]); i++) {
-        if (strstr(dv_cap, DV_MODE_TYPE[i])) {
-            strcat(mode, DV_MODE_TYPE[i]);
-            strcat(mode, ",");
-        }
-    }
+    strcpy(mode, caps.getDolbyVisionCaps());
     SYS_LOGI("Current Tv Support DV type [%s]", mode);
     return true;
 }
@@ -1585,113 +1484,139 @@ bool DisplayMode::isDolbyVisionEnable() {
 }
 
 void DisplayMode::setDolbyVisionEnable(int state) {
-    char tvmode[MAX_STR_LEN] = {0};
     char outputmode[MODE_LEN] = {0};
-    int value_state = state;
-    pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, outputmode);
+    char mode[MODE_LEN] = {0};
+    int trace = beginModeSwitchTrace(MODE_SWITCH_CAUSE_DOLBY_VISION);
 
+    //the mute and the policies are part of the switch, no other one runs in between
+    mutex_lock(&mSwitchLock);
+    pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, outputmode);
+    //the mute lasts until the core or the mode switch below clears it
     pSysWrite->writeSysfs(DISPLAY_HDMI_AVMUTE, "1");
-    if (DOLBY_VISION_SET_DISABLE != value_state) {
-        pSysWrite->setProperty(PROP_DOLBY_VISION_ENABLE, "true");
-        //if TV
-        if (DISPLAY_TYPE_TV == mDisplayType) {
-            setHdrMode(HDR_MODE_OFF);
-            pSysWrite->writeSysfs(DOLBY_VISION_POLICY_OLD, DV_POLICY_FOLLOW_SOURCE);
-            pSysWrite->writeSysfs(DOLBY_VISION_POLICY, DV_POLICY_FOLLOW_SOURCE);
-        }
+    //the type the sink takes, the core is told and waited for in that one
+    if (prepareDolbyVision(&state, outputmode, mode)) {
+        //the sink takes the core with the mode, both change under one mute and phy cycle
+        if (!strcmp(mode, outputmode))
+            pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, "null");
+        setSourceOutputModeLocked(mode, OUPUT_MODE_STATE_SWITCH, trace, NULL, state);
+    } else {
+        mTracer.setTarget(trace, outputmode);
+        ModeSwitchSequencer seq("dolby vision");
+        seq.setTracer(&mTracer, trace);
+        int dv = addDolbyVisionSteps(seq, state, 0);
+        int unmute = seq.addStep("unmute", ModeSwitchSequencer::after(dv), NULL);
+        seq.writes(unmute).add(DISPLAY_HDMI_AVMUTE, "-1");
+        seq.run();
+        mTracer.end(trace);
+    }
+    mutex_unlock(&mSwitchLock);
+    SYS_LOGI("setDolbyVisionEnable Enable [%d]", isDolbyVisionEnable());
+}
 
-        //if OTT
-        if ((DISPLAY_TYPE_MBOX == mDisplayType) || (DISPLAY_TYPE_REPEATER == mDisplayType)) {
-            char mode[MAX_STR_LEN] = {0};
-            FormatColorDepth deepColor;
-            if (isTvSupportDolbyVision(mode)) {
-                setBootEnv(UBOOTENV_ISBESTMODE, "false");
-                SYS_LOGI("Tv is Support DolbyVision, highest mode is [%s]", mode);
-                if (value_state != 1 && strstr(mode, DV_MODE_TYPE[value_state]) == NULL) {
-                    value_state = 1;
-                }
-                switch (value_state) {
-                    case DOLBY_VISION_SET_ENABLE:
-                        pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "0");
-                        setBootEnv(UBOOTENV_COLORATTRIBUTE, "444,8bit");
-                        break;
-                    case DOLBY_VISION_SET_ENABLE_LL_YUV:
-                        pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "0");
-                        setBootEnv(UBOOTENV_COLORATTRIBUTE, "422,12bit");
-                        pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "1");
-                        break;
-                    case DOLBY_VISION_SET_ENABLE_LL_RGB:
-                        pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "0");
-                        if (deepColor.isModeSupportDeepColorAttr(outputmode, "444,12bit"))
-                            setBootEnv(UBOOTENV_COLORATTRIBUTE, "444,12bit");
-                        else if (deepColor.isModeSupportDeepColorAttr(outputmode, "444,10bit"))
-                            setBootEnv(UBOOTENV_COLORATTRIBUTE, "444,10bit");
-                        pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "2");
-                        break;
-                    default:
-                        pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "0");
-                        setBootEnv(UBOOTENV_COLORATTRIBUTE, "444,8bit");
-                }
-                char tmp[10];
-                sprintf(tmp, "%d", value_state);
-                pSysWrite->setProperty(PROP_DOLBY_VISION_TYPE, tmp);
-                char tvmode[MODE_LEN] = {0};
-                for (int i = DISPLAY_MODE_TOTAL - 1; i >= 0; i--) {
-                    if (strstr(mode, DISPLAY_MODE_LIST[i]) != NULL) {
-                        strcpy(tvmode, DISPLAY_MODE_LIST[i]);
-                    }
-                }
-                setDolbyVisionState = false;
-                if ((resolveResolutionValue(outputmode) > resolveResolutionValue(tvmode))
-                        || (strstr(outputmode, "smpte") != NULL)) {
-                    SYS_LOGI("CurMode[%s] is not support dolbyvision, need setmode to [%s]", outputmode, tvmode);
-                    setSourceOutputMode(tvmode);
-                } else {
-                    pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, "null");
-                    setSourceOutputMode(outputmode);
+/* *
+ * @Description: everything of a dolby vision switch that goes before the mute: the
+ *               properties, the policies and the color attribute uboot starts with
+ * @params: state: the type asked for, on return the type the sink takes
+ * @params: mode: the output mode the sink can take dolby vision in
+ * @result: true when the output mode has to be set again for the sink to follow
+ * */
+bool DisplayMode::prepareDolbyVision(int *state, const char* outputmode, char* mode) {
+    char dvCaps[MAX_STR_LEN] = {0};
+    int value_state = *state;
+
+    strcpy(mode, outputmode);
+    if (DOLBY_VISION_SET_DISABLE == value_state) {
+        pSysWrite->setProperty(PROP_DOLBY_VISION_ENABLE, "false");
+        return isTvSupportDolbyVision(dvCaps);
+    }
+
+    pSysWrite->setProperty(PROP_DOLBY_VISION_ENABLE, "true");
+    //if TV
+    if (DISPLAY_TYPE_TV == mDisplayType) {
+        setHdrMode(HDR_MODE_OFF);
+        pSysWrite->writeSysfs(DOLBY_VISION_POLICY_OLD, DV_POLICY_FOLLOW_SOURCE);
+        pSysWrite->writeSysfs(DOLBY_VISION_POLICY, DV_POLICY_FOLLOW_SOURCE);
+        return false;
+    }
+
+    //if OTT
+    bool switchMode = false;
+    if ((DISPLAY_TYPE_MBOX == mDisplayType) || (DISPLAY_TYPE_REPEATER == mDisplayType)) {
+        FormatColorDepth deepColor;
+        if (isTvSupportDolbyVision(dvCaps)) {
+            setBootEnv(UBOOTENV_ISBESTMODE, "false");
+            SYS_LOGI("Tv is Support DolbyVision, highest mode is [%s]", dvCaps);
+            value_state = DolbyVisionSwitch::getSinkState(value_state, dvCaps);
+            *state = value_state;
+            switch (value_state) {
+                case DOLBY_VISION_SET_ENABLE:
+                    pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "0");
+                    setBootEnv(UBOOTENV_COLORATTRIBUTE, "444,8bit");
+                    break;
+                case DOLBY_VISION_SET_ENABLE_LL_YUV:
+                    pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "0");
+                    setBootEnv(UBOOTENV_COLORATTRIBUTE, "422,12bit");
+                    pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "1");
+                    break;
+                case DOLBY_VISION_SET_ENABLE_LL_RGB:
+                    pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "0");
+                    if (deepColor.isModeSupportDeepColorAttr(outputmode, "444,12bit"))
+                        setBootEnv(UBOOTENV_COLORATTRIBUTE, "444,12bit");
+                    else if (deepColor.isModeSupportDeepColorAttr(outputmode, "444,10bit"))
+                        setBootEnv(UBOOTENV_COLORATTRIBUTE, "444,10bit");
+                    pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "2");
+                    break;
+                default:
+                    pSysWrite->writeSysfs(DOLBY_VISION_LL_POLICY, "0");
+                    setBootEnv(UBOOTENV_COLORATTRIBUTE, "444,8bit");
+            }
+            char tmp[10];
+            sprintf(tmp, "%d", value_state);
+            pSysWrite->setProperty(PROP_DOLBY_VISION_TYPE, tmp);
+            char tvmode[MODE_LEN] = {0};
+            for (int i = DISPLAY_MODE_TOTAL - 1; i >= 0; i--) {
+                const char *name = DisplayModeRegistry::get(i)->name;
+                if (strstr(dvCaps, name) != NULL) {
+                    strcpy(tvmode, name);
                 }
-                setDolbyVisionState = true;
             }
-            pSysWrite->writeSysfs(DOLBY_VISION_POLICY_OLD, DV_POLICY_FOLLOW_SINK);
-            pSysWrite->writeSysfs(DOLBY_VISION_HDR10_POLICY_OLD, DV_HDR10_POLICY);
-            pSysWrite->writeSysfs(DOLBY_VISION_POLICY, DV_POLICY_FOLLOW_SINK);
-            pSysWrite->writeSysfs(DOLBY_VISION_HDR10_POLICY, DV_HDR10_POLICY);
+            if ((resolveResolutionValue(outputmode) > resolveResolutionValue(tvmode))
+                    || (strstr(outputmode, "smpte") != NULL)) {
+                strcpy(mode, tvmode);
+            }
+            switchMode = true;
         }
+        pSysWrite->writeSysfs(DOLBY_VISION_POLICY_OLD, DV_POLICY_FOLLOW_SINK);
+        pSysWrite->writeSysfs(DOLBY_VISION_HDR10_POLICY_OLD, DV_HDR10_POLICY);
+        pSysWrite->writeSysfs(DOLBY_VISION_POLICY, DV_POLICY_FOLLOW_SINK);
+        pSysWrite->writeSysfs(DOLBY_VISION_HDR10_POLICY, DV_HDR10_POLICY);
+    }
+    return switchMode;
+}
 
-        setSdrMode(SDR_MODE_OFF);
-        usleep(100000);//100ms
-        pSysWrite->writeSysfs(DOLBY_VISION_ENABLE_OLD, DV_ENABLE);
-        pSysWrite->writeSysfs(DOLBY_VISION_MODE_OLD, DV_MODE_IPT_TUNNEL);
-        pSysWrite->writeSysfs(DOLBY_VISION_ENABLE, DV_ENABLE);
-        pSysWrite->writeSysfs(DOLBY_VISION_MODE, DV_MODE_IPT_TUNNEL);
-        usleep(100000);//100ms
-        if (DISPLAY_TYPE_TV == mDisplayType) {
-            setHdrMode(HDR_MODE_AUTO);
-        }
-        initGraphicsPriority();
-        SYS_LOGI("setDolbyVisionEnable Enable [%d]", isDolbyVisionEnable());
-    } else {
-        pSysWrite->setProperty(PROP_DOLBY_VISION_ENABLE, "false");
-        pSysWrite->writeSysfs(DOLBY_VISION_POLICY_OLD, DV_POLICY_FORCE_MODE);
-        pSysWrite->writeSysfs(DOLBY_VISION_MODE_OLD, DV_MODE_BYPASS);
-        pSysWrite->writeSysfs(DOLBY_VISION_POLICY, DV_POLICY_FORCE_MODE);
-        pSysWrite->writeSysfs(DOLBY_VISION_MODE, DV_MODE_BYPASS);
-        usleep(100000);//100ms
-        pSysWrite->writeSysfs(DOLBY_VISION_ENABLE_OLD, DV_DISABLE);
-        pSysWrite->writeSysfs(DOLBY_VISION_ENABLE, DV_DISABLE);
+int DisplayMode::addDolbyVisionSteps(ModeSwitchSequencer &seq, int state, uint32_t deps) {
+    DolbyVisionSwitch dv(DolbyVisionSwitch::getDefaultNodes());
+    bool enable = DOLBY_VISION_SET_DISABLE != state;
+
+    //sdr off first, it latches on the frame before the core starts
+    int core = seq.addStep("dolby vision", deps, [this, enable]() {
+        if (enable)
+            setSdrMode(SDR_MODE_OFF);
+        return true;
+    });
+    if (enable)
+        dv.addEnable(seq.writes(core), state, getMuteHoldUs());
+    else
+        dv.addDisable(seq.writes(core));
+
+    return seq.addStep("dolby vision priority", ModeSwitchSequencer::after(core), [this, enable]() {
         if (DISPLAY_TYPE_TV == mDisplayType) {
             setHdrMode(HDR_MODE_AUTO);
         }
-        char mode[MAX_STR_LEN] = {0};
-        if (isTvSupportDolbyVision(mode)) {
-            pSysWrite->writeSysfs(SYSFS_DISPLAY_MODE, "null");
-            setSourceOutputMode(outputmode);
-        }
-        SYS_LOGI("setDolbyVisionEnable Enable [%d]", isDolbyVisionEnable());
-    }
-
-    usleep(300000);//300ms
-    pSysWrite->writeSysfs(DISPLAY_HDMI_AVMUTE, "-1");
+        if (enable)
+            initGraphicsPriority();
+        return true;
+    });
 }
 
 /* *
@@ -1752,8 +1677,9 @@ void DisplayMode::DetectDolbyVisionOutputMode(output_mode_state state, char* out
         if (isTvSupportDolbyVision(mode)) {
             char tvmode[MODE_LEN] = {0};
             for (int i = DISPLAY_MODE_TOTAL - 1; i >= 0; i--) {
-                if (strstr(mode, DISPLAY_MODE_LIST[i]) != NULL) {
-                    strcpy(tvmode, DISPLAY_MODE_LIST[i]);
+                const char *name = DisplayModeRegistry::get(i)->name;
+                if (strstr(mode, name) != NULL) {
+                    strcpy(tvmode, name);
                 }
             }
             if (resolveResolutionValue(outputmode) > resolveResolutionValue(tvmode)
@@ -1763,7 +1689,8 @@ void DisplayMode::DetectDolbyVisionOutputMode(output_mode_state state, char* out
             }
             char type[MODE_LEN] = {0};
             pSysWrite->getPropertyString(PROP_DOLBY_VISION_TYPE, type, "1");
-            if (atoi(type) != 1 && strstr(mode, DV_MODE_TYPE[atoi(type)]) == NULL) {
+            const char *dvType = SinkCaps::getDolbyVisionType(atoi(type));
+            if (atoi(type) != 1 && (dvType == NULL || strstr(mode, dvType) == NULL)) {
                 strcpy(type, "1");
             }
             switch (atoi(type)) {
@@ -1858,13 +1785,8 @@ void DisplayMode::initHdrSdrMode() {
 }
 
 int DisplayMode::modeToIndex(const char *mode) {
-    int index = DISPLAY_MODE_1080P;
-    for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
-        if (!strcmp(mode, DISPLAY_MODE_LIST[i])) {
-            index = i;
-            break;
-        }
-    }
+    const display_mode_record_t *record = DisplayModeRegistry::find(mode);
+    int index = record != NULL ? record->index : DISPLAY_MODE_1080P;
 
     //SYS_LOGI("modeToIndex mode:%s index:%d", mode, index);
     return index;
@@ -1874,6 +1796,13 @@ void DisplayMode::isHDCPTxAuthSuccess(int *status) {
     pTxAuth->isAuthSuccess(status);
 }
 
+//the uevent thread, a hotplug switch may be running on the debouncer worker
+void DisplayMode::onHdrExit() {
+    mutex_lock(&mSwitchLock);
+    pTxAuth->hdrExitReset();
+    mutex_unlock(&mSwitchLock);
+}
+
 void DisplayMode::onTxEvent (char* switchName, char* hpdstate, int outputState) {
     SYS_LOGI("onTxEvent switchName:%s hpdstate:%s state: %d\n", switchName, hpdstate, outputState);
 #ifndef RECOVERY_MODE
@@ -1883,8 +1812,6 @@ void DisplayMode::onTxEvent (char* switchName, char* hpdstate, int outputState)
     }
     if (hpdstate) {
         notifyEvent((hpdstate[0] == '1') ? EVENT_HDMI_PLUG_IN : EVENT_HDMI_PLUG_OUT);
-        if (hpdstate[0] == '1')
-            dumpCaps();
     }
     if (strstr(mRebootMode, "quiescent")) {
         SYS_LOGI("reset mRebootMode normal\n");
@@ -1892,12 +1819,121 @@ void DisplayMode::onTxEvent (char* switchName, char* hpdstate, int outputState)
         setBootEnv(UBOOTENV_REBOOT_MODE, mRebootMode);
     }
 #endif
-    setSourceDisplay((output_mode_state)outputState);
+    //the sink may have changed, read its edid again
+    invalidateSinkCaps();
+    if (pHotplug == NULL || OUPUT_MODE_STATE_POWER != outputState) {
+        setSourceDisplay((output_mode_state)outputState);
+        return;
+    }
+    //resume: the driver turned the phy off on suspend, the whole switch runs again
+    if (!strcmp(switchName, HDMI_UEVENT_HDMI_POWER)) {
+        char hpd[MODE_LEN] = {0};
+        pSysWrite->readSysfs(DISPLAY_HPD_STATE, hpd);
+        pHotplug->onHotplug(hpd[0] == '1', true);
+        return;
+    }
+    //a burst of plug events ends in one switch on the hotplug worker
+    pHotplug->onHotplug(hpdstate != NULL && hpdstate[0] == '1');
 }
 
-void DisplayMode::onDispModeSyncEvent (const char* outputmode, int state) {
-    SYS_LOGI("onDispModeSyncEvent outputmode:%s state: %d\n", outputmode, state);
-    setSourceOutputMode(outputmode, (output_mode_state)state);
+void DisplayMode::getFrameRateOutput(char *outputmode, char *policy, char *fracPolicy) {
+    pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, outputmode);
+    pSysWrite->readSysfs(HDMI_FRAME_RATE_AUTO, policy);
+    pSysWrite->readSysfs(HDMI_TX_FRAMRATE_POLICY, fracPolicy);
+}
+
+bool DisplayMode::getFrameRateSinkCaps(SinkCaps *caps, char *crc, int len) {
+    char capsCrc[MODE_LEN] = {0};
+    bool hasCrc = getSinkCaps(caps, false, NULL, capsCrc);
+
+    strncpy(crc, capsCrc, len - 1);
+    crc[len - 1] = '\0';
+    return hasCrc;
+}
+
+void DisplayMode::onFrameRateSwitch(const char* outputmode, int reason) {
+    output_mode_state state = OUPUT_MODE_STATE_SWITCH;
+    if (FRAME_RATE_SWITCH_PULLDOWN == reason)
+        state = OUPUT_MODE_STATE_SWITCH_ADAPTER;
+    else if (FRAME_RATE_SWITCH_END == reason)
+        state = OUPUT_MODE_STATE_ADAPTER_END;
+
+    SYS_LOGI("onFrameRateSwitch outputmode:%s state: %d\n", outputmode, state);
+    setSourceOutputMode(outputmode, state);
+}
+
+bool DisplayMode::computeHotplugTarget(bool plugged, hotplug_target_t *target) {
+    hdmi_data_t data;
+    char crc[MODE_LEN] = {0};
+    char crcAfter[MODE_LEN] = {0};
+    bool hasCrc = getEdidCrc(crc, MODE_LEN);
+
+    //no trace yet, the switch may never come
+    selectSourceDisplay(OUPUT_MODE_STATE_POWER, &data, target->mode, 0);
+    if (HDMI_SINK_TYPE_NONE != data.sinkType)
+        dumpCaps();
+
+    bool cvbsMode = !strcmp(target->mode, MODE_480CVBS) || !strcmp(target->mode, MODE_576CVBS);
+    if (!getDeepColorAttribute(cvbsMode, OUPUT_MODE_STATE_POWER, target->mode, target->colorAttr))
+        target->colorAttr[0] = '\0';
+    target->dolbyVision = !cvbsMode && isDolbyVisionEnable()
+        && (DOLBY_VISION_SET_DISABLE != getDolbyVisionType());
+
+    //the sink may still be writing its edid, its caps are read again on the retry
+    if ((hasCrc != getEdidCrc(crcAfter, MODE_LEN)) || strcmp(crc, crcAfter)) {
+        invalidateSinkCaps();
+        return false;
+    }
+    return true;
+}
+
+void DisplayMode::getHotplugCurrent(hotplug_target_t *current) {
+    char dv[MODE_LEN] = {0};
+
+    pSysWrite->readSysfs(SYSFS_DISPLAY_MODE, current->mode);
+    pSysWrite->readSysfs(DISPLAY_HDMI_COLOR_ATTR, current->colorAttr);
+    //only one of the dolby vision modules is loaded
+    pSysWrite->readSysfs(DOLBY_VISION_ENABLE, dv);
+    if (dv[0] == '\0')
+        pSysWrite->readSysfs(DOLBY_VISION_ENABLE_OLD, dv);
+    current->dolbyVision = (strstr(current->mode, "cvbs") == NULL) && !strcmp(dv, DV_ENABLE);
+
+    char phy[MODE_LEN] = {0};
+    pSysWrite->readSysfs(DISPLAY_HDMI_PHY, phy);
+    current->linkUp = phy[0] == '1';
+}
+
+void DisplayMode::onHotplugSwitch(const hotplug_target_t *target) {
+    int trace = beginModeSwitchTrace(MODE_SWITCH_CAUSE_HOTPLUG);
+
+    pSysWrite->writeSysfs(SYS_DISABLE_VIDEO, VIDEO_LAYER_DISABLE);
+    pSysWrite->writeSysfs(H265_DOUBLE_WRITE_MODE, (strstr(target->mode, "cvbs") != NULL
+        || !strcmp(target->mode, "none")) ? "3" : "0");
+    setSourceOutputMode(target->mode, OUPUT_MODE_STATE_POWER, trace, target->colorAttr);
+}
+
+//the mode stays, the steps of a switch after the mode is set still run
+void DisplayMode::onHotplugKeep(const hotplug_target_t *target) {
+    mutex_lock(&mSwitchLock);
+    if (target->plugged && strstr(target->mode, "cvbs") == NULL) {
+        SysfsBatch writes("hotplug keep");
+        writes.add(DISPLAY_HDMI_PHY, "1");
+        writes.addDelay(MODE_SWITCH_PHY_ON_US);
+        writes.add(DISPLAY_HDMI_AUDIO_MUTE, "1");
+        writes.add(DISPLAY_HDMI_AUDIO_MUTE, "0");
+        writes.add(DISPLAY_HDMI_AVMUTE, "-1");
+        writes.commit();
+
+        //the sink was away, it has to authenticate again
+        pTxAuth->stop();
+        pTxAuth->start();
+    }
+    pSysWrite->writeSysfs(SYS_DISABLE_VIDEO, VIDEO_LAYER_ENABLE);
+
+    char value[MAX_STR_LEN] = {0};
+    getBootEnv(UBOOTENV_DIGITAUDIO, value);
+    setDigitalMode(value);
+    mutex_unlock(&mSwitchLock);
 }
 
 //for debug
@@ -1954,7 +1990,19 @@ int DisplayMode::dump(char *result) {
         sprintf(buf, "default ui:%s\n", mDefaultUI);
         strcat(result, buf);
         dumpCaps(result);
-    }
+        mutex_lock(&mCapsLock);
+        if (mCapsValid)
+            mColorTable.dump(result);
+        mutex_unlock(&mCapsLock);
+    }
+    UeventHub::getInstance()->dump(result);
+    if (pBootWatcher != NULL)
+        pBootWatcher->dump(result);
+    if (pHotplug != NULL)
+        pHotplug->dump(result);
+    if (pFrameRateAutoAdaption != NULL)
+        pFrameRateAutoAdaption->dump(result);
+    mTracer.dump(result, DISPLAY_MODE_DUMP_LEN);
     return 0;
 }
 
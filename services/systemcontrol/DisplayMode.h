@@ -29,6 +29,12 @@
 #include "HDCP/HDCPRx22ImgKey.h"
 #include "HDCP/HDCPRxKey.h"
 #include "FrameRateAutoAdaption.h"
+#include "DisplayModeRegistry.h"
+#include "SinkCaps.h"
+#include "ModeSwitchTracer.h"
+#include "BootWatcher.h"
+#include "HotplugDebouncer.h"
+#include "DolbyVisionSwitch.h"
 #include <FormatColorDepth.h>
 #include <map>
 #include <cmath>
@@ -121,6 +127,19 @@ using namespace android;
 #define DISPLAY_EDID_RAW                "/sys/class/amhdmitx/amhdmitx0/rawedid"
 #define DISPLAY_HDMI_PHY                "/sys/class/amhdmitx/amhdmitx0/phy"
 
+//mode switch ceiling, the fixed delay it replaces
+#define MODE_SWITCH_MUTE_HOLD_US        50000
+//the phy node only echoes what was written, nothing tells when the sink
+//follows the tmds clock, these settle times stay as they were
+#define MODE_SWITCH_PHY_OFF_US          50000
+#define MODE_SWITCH_PHY_ON_US           20000
+
+//setSourceOutputMode() leaves the dolby vision core alone, or follows the mode with it
+#define MODE_SWITCH_DV_KEEP             -1
+
+//what dump() may write, the mode switch traces take most of it
+#define DISPLAY_MODE_DUMP_LEN           (MAX_STR_LEN * 8)
+
 #define AUDIO_DSP_DIGITAL_RAW           "/sys/class/audiodsp/digital_raw"
 #define AV_HDMI_CONFIG                  "/sys/class/amhdmitx/amhdmitx0/config"
 #define AV_HDMI_3D_SUPPORT              "/sys/class/amhdmitx/amhdmitx0/support_3d"
@@ -135,37 +154,6 @@ using namespace android;
 #define HDMI_TX_SWITCH_HDR              "/sys/class/extcon/hdmi_hdr/state"
 #define HDMI_TX_HDMI_AUDIO_UEVENT       "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi_audio"
 
-//dolby vision sysfs
-#define DOLBY_VISION_POLICY_OLD         "/sys/module/am_vecm/parameters/dolby_vision_policy"
-#define DOLBY_VISION_HDR10_POLICY_OLD   "/sys/module/am_vecm/parameters/dolby_vision_hdr10_policy"
-#define DOLBY_VISION_ENABLE_OLD         "/sys/module/am_vecm/parameters/dolby_vision_enable"
-#define DOLBY_VISION_MODE_OLD           "/sys/class/amvecm/dv_mode"
-#define DOLBY_VISION_POLICY             "/sys/module/amdolby_vision/parameters/dolby_vision_policy"
-#define DOLBY_VISION_HDR10_POLICY       "/sys/module/amdolby_vision/parameters/dolby_vision_hdr10_policy"
-#define DOLBY_VISION_ENABLE             "/sys/module/amdolby_vision/parameters/dolby_vision_enable"
-#define DOLBY_VISION_MODE               "/sys/class/amdolby_vision/dv_mode"
-#define DOLBY_VISION_IS_SUPPORT         "/sys/class/amhdmitx/amhdmitx0/dv_cap"
-#define DOLBY_VISION_GRAPHICS_PRIORITY_OLD  "/sys/module/am_vecm/parameters/dolby_vision_graphics_priority"
-#define DOLBY_VISION_LL_POLICY_OLD          "/sys/module/am_vecm/parameters/dolby_vision_ll_policy"
-#define DOLBY_VISION_GRAPHICS_PRIORITY  "/sys/module/amdolby_vision/parameters/dolby_vision_graphics_priority"
-#define DOLBY_VISION_LL_POLICY          "/sys/module/amdolby_vision/parameters/dolby_vision_ll_policy"
-
-#define DOLBY_VISION_SET_ENABLE_LL_RGB  3
-#define DOLBY_VISION_SET_ENABLE_LL_YUV  2
-#define DOLBY_VISION_SET_ENABLE         1
-#define DOLBY_VISION_SET_DISABLE        0
-
-#define DV_ENABLE                       "Y"
-#define DV_DISABLE                      "N"
-
-#define DV_POLICY_FOLLOW_SINK           "0"
-#define DV_POLICY_FOLLOW_SOURCE         "1"
-#define DV_POLICY_FORCE_MODE            "2"
-#define DV_HDR10_POLICY                 "3"
-
-#define DV_MODE_BYPASS                  "0x0"
-#define DV_MODE_IPT_TUNNEL              "0x2"
-
 #define HDMI_UEVENT_HDMI                "hdmi"
 #define HDMI_UEVENT_HDMI_POWER          "hdmi_power"
 #define HDMI_UEVENT_HDMI_HDR            "hdmi_hdr"
@@ -210,9 +198,7 @@ using namespace android;
 #define PROP_WINDOW_HEIGHT              "const.window.h"
 #define PROP_HAS_CVBS_MODE              "ro.vendor.platform.has.cvbsmode"
 #define PROP_BEST_OUTPUT_MODE           "ro.vendor.platform.best_outputmode"
-#define PROP_BOOTANIM                   "init.svc.bootanim"
 #define PROP_FS_MODE                    "const.filesystem.mode"
-#define PROP_BOOTANIM_DELAY             "const.bootanim.delay"
 #define PROP_BOOTVIDEO_SERVICE          "service.bootvideo"
 #define PROP_DEEPCOLOR                  "vendor.sys.open.deepcolor" //default close this function, when reboot
 #define PROP_BOOTCOMPLETE               "service.bootanim.exit"
@@ -255,21 +241,6 @@ using namespace android;
 #define UBOOTENV_CUSTOMWIDTH            "ubootenv.var.customwidth"
 #define UBOOTENV_CUSTOMHEIGHT           "ubootenv.var.customheight"
 
-#define FULL_WIDTH_480                  720
-#define FULL_HEIGHT_480                 480
-#define FULL_WIDTH_576                  720
-#define FULL_HEIGHT_576                 576
-#define FULL_WIDTH_720                  1280
-#define FULL_HEIGHT_720                 720
-#define FULL_WIDTH_768                  1366
-#define FULL_HEIGHT_768                 768
-#define FULL_WIDTH_1080                 1920
-#define FULL_HEIGHT_1080                1080
-#define FULL_WIDTH_4K2K                 3840
-#define FULL_HEIGHT_4K2K                2160
-#define FULL_WIDTH_4K2KSMPTE            4096
-#define FULL_HEIGHT_4K2KSMPTE           2160
-
 enum {
     EVENT_OUTPUT_MODE_CHANGE            = 0,
     EVENT_DIGITAL_MODE_CHANGE           = 1,
@@ -287,68 +258,6 @@ enum {
     DISPLAY_TYPE_REPEATER               = 4
 };
 
-#define MODE_480I                       "480i60hz"
-#define MODE_480P                       "480p60hz"
-#define MODE_480CVBS                    "480cvbs"
-#define MODE_576I                       "576i50hz"
-#define MODE_576P                       "576p50hz"
-#define MODE_576CVBS                    "576cvbs"
-#define MODE_720P50HZ                   "720p50hz"
-#define MODE_720P                       "720p60hz"
-#define MODE_768P                       "768p60hz"
-#define MODE_1080P24HZ                  "1080p24hz"
-#define MODE_1080I50HZ                  "1080i50hz"
-#define MODE_1080P50HZ                  "1080p50hz"
-#define MODE_1080I                      "1080i60hz"
-#define MODE_1080P                      "1080p60hz"
-#define MODE_4K2K24HZ                   "2160p24hz"
-#define MODE_4K2K25HZ                   "2160p25hz"
-#define MODE_4K2K30HZ                   "2160p30hz"
-#define MODE_4K2K50HZ                   "2160p50hz"
-#define MODE_4K2K60HZ                   "2160p60hz"
-#define MODE_4K2KSMPTE                  "smpte24hz"
-#define MODE_4K2KSMPTE30HZ              "smpte30hz"
-#define MODE_4K2KSMPTE50HZ              "smpte50hz"
-#define MODE_4K2KSMPTE60HZ              "smpte60hz"
-
-#define MODE_480I_PREFIX                "480i"
-#define MODE_480P_PREFIX                "480p"
-#define MODE_576I_PREFIX                "576i"
-#define MODE_576P_PREFIX                "576p"
-#define MODE_720P_PREFIX                "720p"
-#define MODE_768P_PREFIX                "768p"
-#define MODE_1080I_PREFIX               "1080i"
-#define MODE_1080P_PREFIX               "1080p"
-#define MODE_4K2K_PREFIX                "2160p"
-#define MODE_4K2KSMPTE_PREFIX           "smpte"
-
-enum {
-    DISPLAY_MODE_480I                   = 0,
-    DISPLAY_MODE_480P                   = 1,
-    DISPLAY_MODE_480CVBS                = 2,
-    DISPLAY_MODE_576I                   = 3,
-    DISPLAY_MODE_576P                   = 4,
-    DISPLAY_MODE_576CVBS                = 5,
-    DISPLAY_MODE_720P50HZ               = 6,
-    DISPLAY_MODE_720P                   = 7,
-    DISPLAY_MODE_1080P24HZ              = 8,
-    DISPLAY_MODE_1080I50HZ              = 9,
-    DISPLAY_MODE_1080P50HZ              = 10,
-    DISPLAY_MODE_1080I                  = 11,
-    DISPLAY_MODE_1080P                  = 12,
-    DISPLAY_MODE_4K2K24HZ               = 13,
-    DISPLAY_MODE_4K2K25HZ               = 14,
-    DISPLAY_MODE_4K2K30HZ               = 15,
-    DISPLAY_MODE_4K2K50HZ               = 16,
-    DISPLAY_MODE_4K2K60HZ               = 17,
-    DISPLAY_MODE_4K2KSMPTE              = 18,
-    DISPLAY_MODE_4K2KSMPTE30HZ          = 19,
-    DISPLAY_MODE_4K2KSMPTE50HZ          = 20,
-    DISPLAY_MODE_4K2KSMPTE60HZ          = 21,
-    DISPLAY_MODE_768P                   = 22,
-    DISPLAY_MODE_TOTAL                  = 23
-};
-
 typedef enum {
     OUPUT_MODE_STATE_INIT               = 0,
     OUPUT_MODE_STATE_POWER              = 1,//hot plug
@@ -367,6 +276,7 @@ typedef enum {
 
 typedef struct hdmi_data {
     char edid[MAX_STR_LEN];
+    SinkCaps caps;                  //edid parsed, empty without a sink
     int sinkType;
     char current_mode[MODE_LEN];
     char ubootenv_hdmimode[MODE_LEN];
@@ -393,8 +303,12 @@ typedef struct resolution {
 
 // ----------------------------------------------------------------------------
 
+class ModeSwitchSequencer;
+
 class DisplayMode : public HDCPTxAuth::TxUevntCallbak,
-                                      private FrameRateAutoAdaption::Callbak
+                                      private FrameRateAutoAdaption::Callbak,
+                                      private BootWatcher::Callback,
+                                      private HotplugDebouncer::Callback
 {
 public:
     DisplayMode(const char *path);
@@ -425,8 +339,6 @@ public:
     void setHdrMode(const char* mode);
     void setSdrMode(const char* mode);
     void isHDCPTxAuthSuccess( int *status);
-    static void* bootanimDetect(void *data);
-    static void* bootvideoDetect(void *data);
 
     void setSourceDisplay(output_mode_state state);
 
@@ -446,7 +358,17 @@ public:
 #endif
 
     virtual void onTxEvent (char* switchName, char* hpdstate, int outputState);
-    virtual void onDispModeSyncEvent (const char* outputmode, int state);
+    virtual void onHdrExit();
+    virtual void getFrameRateOutput(char *outputmode, char *policy, char *fracPolicy);
+    virtual bool getFrameRateSinkCaps(SinkCaps *caps, char *crc, int len);
+    virtual void onFrameRateSwitch(const char* outputmode, int reason);
+    virtual void onBootanimStatus(int status);
+    virtual void onLogoHandover(bool bootvideo);
+    virtual void onBootAnimFinished();
+    virtual bool computeHotplugTarget(bool plugged, hotplug_target_t *target);
+    virtual void getHotplugCurrent(hotplug_target_t *current);
+    virtual void onHotplugSwitch(const hotplug_target_t *target);
+    virtual void onHotplugKeep(const hotplug_target_t *target);
     void hdcpSwitch();
 
     void setBootanimStatus(int status);
@@ -456,6 +378,9 @@ private:
 
     bool getBootEnv(const char* key, char* value);
     void setBootEnv(const char* key, char* value);
+    //in memory only, the mode switch saves the partition once
+    void stageBootEnv(const char* key, const char* value);
+    int getMuteHoldUs();
 
     int parseConfigFile();
     void getBestHdmiMode(char * mode, hdmi_data_t* data);
@@ -466,20 +391,37 @@ private:
     void resolveResolution(const char *mode, resolution_t* resol_t);
     void setAutoSwitchFrameRate(int state);
     void updateDefaultUI();
-    void updateDeepColor(bool cvbsMode, output_mode_state state, const char* outputmode);
+    //false when the output has no deep color to set
+    bool getDeepColorAttribute(bool cvbsMode, output_mode_state state, const char* outputmode, char* colorAttribute);
     void updateFreeScaleAxis();
     void updateWindowAxis(const char* outputmode);
     void initGraphicsPriority();
 	void initHdrSdrMode();
     bool isEdidChange();
+    bool getEdidCrc(char *crc, int len);
+    //true when the caps are of an edid with a crc, crc gets it, MODE_LEN
+    bool getSinkCaps(SinkCaps *caps, bool waitEdid, DeepColorTable *colors = NULL, char *crc = NULL);
+    void invalidateSinkCaps();
     bool isBestOutputmode();
     bool modeSupport(char *mode, int sinkType);
     void setSourceOutputMode(const char* outputmode, output_mode_state state);
+    //trace from beginModeSwitchTrace(), ended or cancelled here, colorAttr NULL to work it out,
+    //dvState DOLBY_VISION_SET_* switches the dolby vision core inside the same mute
+    void setSourceOutputMode(const char* outputmode, output_mode_state state, int trace,
+        const char* colorAttr = NULL, int dvState = MODE_SWITCH_DV_KEEP);
+    //the same with mSwitchLock held by the caller
+    void setSourceOutputModeLocked(const char* outputmode, output_mode_state state, int trace,
+        const char* colorAttr, int dvState);
+    void selectSourceDisplay(output_mode_state state, hdmi_data_t *data, char *outputmode, int trace);
+    int beginModeSwitchTrace(int cause);
+    bool prepareDolbyVision(int *state, const char* outputmode, char* mode);
+    //returns the last step, the core is switched once the deps are done
+    int addDolbyVisionSteps(ModeSwitchSequencer &seq, int state, uint32_t deps);
+    static int getModeSwitchCause(output_mode_state state);
     void setSinkOutputMode(const char* outputmode, bool initState);
     int modeToIndex(const char *mode);
     void startHdmiPlugDetectThread();
-    void startBootanimDetectThread();
-    void startBootvideoDetectThread();
+    void startBootWatcher();
     static void* HdmiUenventThreadLoop(void* data);
     void setSinkDisplay(bool initState);
     int getBootenvInt(const char* key, int defaultVal);
@@ -492,6 +434,25 @@ private:
 
     mutex_t mEnvLock;
 
+    //capabilities of the sink with the edid crc mCapsCrc, dropped on hotplug
+    mutex_t mCapsLock;
+    SinkCaps mSinkCaps;
+    DeepColorTable mColorTable;
+    bool mCapsValid;
+    char mCapsCrc[MODE_LEN];
+    int mCapsGeneration;            //moves on every drop, a parse started before is not kept
+
+    //held for the whole of a mode switch
+    mutex_t mSwitchLock;
+
+    ModeSwitchTracer mTracer;
+
+    //CLOCK_MONOTONIC of init(), the boot watcher times from it
+    int64_t mInitNs;
+    BootWatcher *pBootWatcher = NULL;
+    //plug uevents end up here, the switch runs on its worker
+    HotplugDebouncer *pHotplug = NULL;
+
     int mDisplayWidth;
     int mDisplayHeight;
 
@@ -509,7 +470,6 @@ private:
 
     // bootAnimation flag
     int mBootanimStatus;
-    bool setDolbyVisionState = true;
 #ifndef RECOVERY_MODE
     sp<SystemControlNotify> mNotifyListener;
 #endif
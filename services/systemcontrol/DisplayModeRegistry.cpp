@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 the output modes systemcontrol knows, parsed at compile time
+ *  - 2 find the record of a mode with one hash and one string compare
+ *  - 3 default window and UI sizes of a mode
+ */
+
+#include <string.h>
+#include "DisplayModeRegistry.h"
+
+//slot of a mode is the top bits of its hash
+#define MODE_SLOT_BITS          6
+#define MODE_SLOTS              (1 << MODE_SLOT_BITS)
+#define MODE_SEED_TRIES         4096
+
+typedef struct size_rule {
+    const char *text;
+    int width;
+    int height;
+    int uiWidth;                    //framebuffer size when it is the default UI
+    int uiHeight;
+} size_rule_t;
+
+//mode list order, the dolby vision capability scans walk it from the end
+static constexpr const char *sModeNames[DISPLAY_MODE_TOTAL] = {
+    MODE_480I,
+    MODE_480P,
+    MODE_480CVBS,
+    MODE_576I,
+    MODE_576P,
+    MODE_576CVBS,
+    MODE_720P,
+    MODE_720P50HZ,
+    MODE_1080P24HZ,
+    MODE_1080I50HZ,
+    MODE_1080P50HZ,
+    MODE_1080I,
+    MODE_1080P,
+    MODE_4K2K24HZ,
+    MODE_4K2K25HZ,
+    MODE_4K2K30HZ,
+    MODE_4K2K50HZ,
+    MODE_4K2K60HZ,
+    MODE_4K2KSMPTE,
+    MODE_4K2KSMPTE30HZ,
+    MODE_4K2KSMPTE50HZ,
+    MODE_4K2KSMPTE60HZ,
+    MODE_768P,
+};
+
+//first rule whose text is in the mode wins
+static constexpr size_rule_t sPositionRules[] = {
+    { "480",                    FULL_WIDTH_480,         FULL_HEIGHT_480,        0, 0 },
+    { "576",                    FULL_WIDTH_576,         FULL_HEIGHT_576,        0, 0 },
+    { MODE_720P_PREFIX,         FULL_WIDTH_720,         FULL_HEIGHT_720,        0, 0 },
+    { MODE_768P_PREFIX,         FULL_WIDTH_768,         FULL_HEIGHT_768,        0, 0 },
+    { MODE_1080I_PREFIX,        FULL_WIDTH_1080,        FULL_HEIGHT_1080,       0, 0 },
+    { MODE_1080P_PREFIX,        FULL_WIDTH_1080,        FULL_HEIGHT_1080,       0, 0 },
+    { MODE_4K2K_PREFIX,         FULL_WIDTH_4K2K,        FULL_HEIGHT_4K2K,       0, 0 },
+    { MODE_4K2KSMPTE_PREFIX,    FULL_WIDTH_4K2KSMPTE,   FULL_HEIGHT_4K2KSMPTE,  0, 0 },
+};
+
+#if defined(ODROID)
+//first rule the mode starts with wins, the frequency is left out of the match
+static const size_rule_t sOdroidRules[] = {
+    { "480x320",    480,  320,  480,  320 },
+    { "640x480",    640,  480,  640,  480 },
+    { "480",        720,  480,  720,  480 },
+    { "800x480",    800,  480,  800,  480 },
+    { "576",        720,  576,  720,  576 },
+    { "800x600",    800,  600,  800,  600 },
+    { "1024x600",   1024, 600,  1024, 600 },
+    { "1024x768",   1024, 768,  1024, 768 },
+    { "720",        1280, 720,  1280, 720 },
+    { "1280x800",   1280, 800,  1280, 800 },
+    { "1360x768",   1360, 768,  1360, 768 },
+    { "1366x768",   1366, 768,  1366, 768 },
+    { "1440x900",   1440, 900,  1440, 900 },
+    { "1280x1024",  1280, 1024, 1280, 1024 },
+    { "1600x900",   1600, 900,  1600, 900 },
+    { "1680x1050",  1680, 1050, 1680, 1050 },
+    { "1600x1200",  1600, 1200, 1600, 1200 },
+    { "1080",       1920, 1080, 1920, 1080 },
+    { "1920x1200",  1920, 1200, 1920, 1200 },
+    { "2560x1080",  2560, 1080, 2560, 1080 },
+    { "2560x1440",  2560, 1440, 2560, 1440 },
+    { "2560x1600",  2560, 1600, 2560, 1600 },
+    //21:9 UI is scaled, real 4K framebuffer is too slow
+    { "3440x1440",  3440, 1440, 2560, 1080 },
+    { "2160",       3840, 2160, 1920, 1080 },
+};
+#else
+static const size_rule_t sUiRules[] = {
+    { "720",        0, 0, FULL_WIDTH_720,   FULL_HEIGHT_720 },
+    { "1080",       0, 0, FULL_WIDTH_1080,  FULL_HEIGHT_1080 },
+    { "4k2k",       0, 0, FULL_WIDTH_4K2K,  FULL_HEIGHT_4K2K },
+};
+#endif
+
+static constexpr int parseInt(const char *text) {
+    int value = 0;
+
+    while (*text >= '0' && *text <= '9')
+        value = value * 10 + (*text++ - '0');
+    return value;
+}
+
+static constexpr const char *findText(const char *text, const char *word) {
+    for (; *text != '\0'; text++) {
+        int i = 0;
+        while (word[i] != '\0' && text[i] == word[i])
+            i++;
+        if (word[i] == '\0')
+            return text;
+    }
+    return nullptr;
+}
+
+static constexpr uint32_t slotOf(const char *mode, uint32_t seed) {
+    uint32_t hash = seed;
+
+    while (*mode != '\0') {
+        hash ^= (uint8_t)*mode++;
+        hash *= 16777619u;
+    }
+    return hash >> (32 - MODE_SLOT_BITS);
+}
+
+static constexpr bool isPerfect(uint32_t seed) {
+    bool used[MODE_SLOTS] = {};
+
+    for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
+        uint32_t slot = slotOf(sModeNames[i], seed);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+static constexpr uint32_t findSeed() {
+    for (uint32_t seed = 2166136261u; seed < 2166136261u + MODE_SEED_TRIES; seed++) {
+        if (isPerfect(seed))
+            return seed;
+    }
+    return 0;
+}
+
+static constexpr uint32_t sSeed = findSeed();
+static_assert(sSeed != 0, "no perfect hash seed for the mode list, raise MODE_SLOT_BITS");
+
+//same fields resolveResolution() parsed at run time, cvbs modes have no frequency
+struct ModeTable {
+    display_mode_record_t records[DISPLAY_MODE_TOTAL];
+    int8_t slots[MODE_SLOTS];
+
+    constexpr ModeTable() : records(), slots() {
+        for (int i = 0; i < MODE_SLOTS; i++)
+            slots[i] = -1;
+
+        for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
+            const char *name = sModeNames[i];
+            display_mode_record_t &record = records[i];
+
+            record.name = name;
+            record.index = i;
+            record.resolution = parseInt(name);
+            record.standard = findText(name, "p") != nullptr ? 'p' : 'i';
+            const char *freq = findText(name, record.standard == 'p' ? "p" : "i");
+            record.frequency = freq != nullptr ? parseInt(freq + 1) : 0;
+            const char *hz = findText(name, "hz");
+            record.deepcolor = hz != nullptr ? parseInt(hz + 2) : 0;
+            //[ 0:15]bit deepcolor, [16:27]bit frequency, [28:31]bit 'p', [32:63]bit resolution
+            record.resolution_num = record.deepcolor + ((int64_t)record.frequency << 16)
+                + ((int64_t)(record.standard == 'p') << 28) + ((int64_t)record.resolution << 32);
+
+            record.width = FULL_WIDTH_1080;
+            record.height = FULL_HEIGHT_1080;
+            for (const size_rule_t &rule : sPositionRules) {
+                if (findText(name, rule.text) != nullptr) {
+                    record.width = rule.width;
+                    record.height = rule.height;
+                    break;
+                }
+            }
+
+            slots[slotOf(name, sSeed)] = i;
+        }
+    }
+};
+
+static constexpr ModeTable sTable;
+
+const display_mode_record_t *DisplayModeRegistry::find(const char *mode) {
+    if (mode == NULL)
+        return NULL;
+
+    int index = sTable.slots[slotOf(mode, sSeed)];
+    if (index < 0 || strcmp(sTable.records[index].name, mode))
+        return NULL;
+    return &sTable.records[index];
+}
+
+const display_mode_record_t *DisplayModeRegistry::get(int index) {
+    if (index < 0 || index >= DISPLAY_MODE_TOTAL)
+        return NULL;
+    return &sTable.records[index];
+}
+
+int64_t DisplayModeRegistry::resolutionValue(const char *mode) {
+    const display_mode_record_t *record = find(mode);
+    return record != NULL ? record->resolution_num : 0;
+}
+
+bool DisplayModeRegistry::getDefaultSize(const char *mode, int *width, int *height) {
+#if defined(ODROID)
+    //the old match cut "60hz" off the mode first
+    int len = strlen(mode) - 4;
+    for (const size_rule_t &rule : sOdroidRules) {
+        int n = strlen(rule.text);
+        if (n <= len && !strncmp(mode, rule.text, n)) {
+            *width = rule.width;
+            *height = rule.height;
+            return true;
+        }
+    }
+    return false;
+#else
+    const display_mode_record_t *record = find(mode);
+    if (record != NULL) {
+        *width = record->width;
+        *height = record->height;
+        return true;
+    }
+
+    for (const size_rule_t &rule : sPositionRules) {
+        if (strstr(mode, rule.text) != NULL) {
+            *width = rule.width;
+            *height = rule.height;
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+bool DisplayModeRegistry::getUiSize(const char *ui, int *width, int *height) {
+#if defined(ODROID)
+    const size_rule_t *rules = sOdroidRules;
+    int count = sizeof(sOdroidRules) / sizeof(sOdroidRules[0]);
+#else
+    const size_rule_t *rules = sUiRules;
+    int count = sizeof(sUiRules) / sizeof(sUiRules[0]);
+#endif
+
+    for (int i = 0; i < count; i++) {
+        if (!strncmp(ui, rules[i].text, strlen(rules[i].text))) {
+            *width = rules[i].uiWidth;
+            *height = rules[i].uiHeight;
+            return true;
+        }
+    }
+    return false;
+}
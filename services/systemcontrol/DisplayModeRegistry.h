@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 the output modes systemcontrol knows, parsed at compile time
+ *  - 2 find the record of a mode with one hash and one string compare
+ *  - 3 default window and UI sizes of a mode
+ */
+
+#ifndef DISPLAY_MODE_REGISTRY_H
+#define DISPLAY_MODE_REGISTRY_H
+
+#include <stdint.h>
+
+#define MODE_480I                       "480i60hz"
+#define MODE_480P                       "480p60hz"
+#define MODE_480CVBS                    "480cvbs"
+#define MODE_576I                       "576i50hz"
+#define MODE_576P                       "576p50hz"
+#define MODE_576CVBS                    "576cvbs"
+#define MODE_720P50HZ                   "720p50hz"
+#define MODE_720P                       "720p60hz"
+#define MODE_768P                       "768p60hz"
+#define MODE_1080P24HZ                  "1080p24hz"
+#define MODE_1080I50HZ                  "1080i50hz"
+#define MODE_1080P50HZ                  "1080p50hz"
+#define MODE_1080I                      "1080i60hz"
+#define MODE_1080P                      "1080p60hz"
+#define MODE_4K2K24HZ                   "2160p24hz"
+#define MODE_4K2K25HZ                   "2160p25hz"
+#define MODE_4K2K30HZ                   "2160p30hz"
+#define MODE_4K2K50HZ                   "2160p50hz"
+#define MODE_4K2K60HZ                   "2160p60hz"
+#define MODE_4K2KSMPTE                  "smpte24hz"
+#define MODE_4K2KSMPTE30HZ              "smpte30hz"
+#define MODE_4K2KSMPTE50HZ              "smpte50hz"
+#define MODE_4K2KSMPTE60HZ              "smpte60hz"
+
+#define MODE_480I_PREFIX                "480i"
+#define MODE_480P_PREFIX                "480p"
+#define MODE_576I_PREFIX                "576i"
+#define MODE_576P_PREFIX                "576p"
+#define MODE_720P_PREFIX                "720p"
+#define MODE_768P_PREFIX                "768p"
+#define MODE_1080I_PREFIX               "1080i"
+#define MODE_1080P_PREFIX               "1080p"
+#define MODE_4K2K_PREFIX                "2160p"
+#define MODE_4K2KSMPTE_PREFIX           "smpte"
+
+#define FULL_WIDTH_480                  720
+#define FULL_HEIGHT_480                 480
+#define FULL_WIDTH_576                  720
+#define FULL_HEIGHT_576                 576
+#define FULL_WIDTH_720                  1280
+#define FULL_HEIGHT_720                 720
+#define FULL_WIDTH_768                  1366
+#define FULL_HEIGHT_768                 768
+#define FULL_WIDTH_1080                 1920
+#define FULL_HEIGHT_1080                1080
+#define FULL_WIDTH_4K2K                 3840
+#define FULL_HEIGHT_4K2K                2160
+#define FULL_WIDTH_4K2KSMPTE            4096
+#define FULL_HEIGHT_4K2KSMPTE           2160
+
+enum {
+    DISPLAY_MODE_480I                   = 0,
+    DISPLAY_MODE_480P                   = 1,
+    DISPLAY_MODE_480CVBS                = 2,
+    DISPLAY_MODE_576I                   = 3,
+    DISPLAY_MODE_576P                   = 4,
+    DISPLAY_MODE_576CVBS                = 5,
+    DISPLAY_MODE_720P50HZ               = 6,
+    DISPLAY_MODE_720P                   = 7,
+    DISPLAY_MODE_1080P24HZ              = 8,
+    DISPLAY_MODE_1080I50HZ              = 9,
+    DISPLAY_MODE_1080P50HZ              = 10,
+    DISPLAY_MODE_1080I                  = 11,
+    DISPLAY_MODE_1080P                  = 12,
+    DISPLAY_MODE_4K2K24HZ               = 13,
+    DISPLAY_MODE_4K2K25HZ               = 14,
+    DISPLAY_MODE_4K2K30HZ               = 15,
+    DISPLAY_MODE_4K2K50HZ               = 16,
+    DISPLAY_MODE_4K2K60HZ               = 17,
+    DISPLAY_MODE_4K2KSMPTE              = 18,
+    DISPLAY_MODE_4K2KSMPTE30HZ          = 19,
+    DISPLAY_MODE_4K2KSMPTE50HZ          = 20,
+    DISPLAY_MODE_4K2KSMPTE60HZ          = 21,
+    DISPLAY_MODE_768P                   = 22,
+    DISPLAY_MODE_TOTAL                  = 23
+};
+
+//what DisplayMode::resolveResolution() used to parse out of the name
+typedef struct display_mode_record {
+    const char *name;
+    int index;                      //position in the mode list
+    int resolution;
+    char standard;                  //'p' or 'i'
+    int frequency;
+    int deepcolor;
+    int64_t resolution_num;         //bigger is a better mode
+    int width;                      //default window size
+    int height;
+} display_mode_record_t;
+
+class DisplayModeRegistry
+{
+public:
+    //NULL when the mode is not in the mode list
+    static const display_mode_record_t *find(const char *mode);
+    static const display_mode_record_t *get(int index);
+    //0 for unknown modes, as resolveResolution() gave
+    static int64_t resolutionValue(const char *mode);
+
+    //default window size of any output mode, false and untouched when nothing matches
+    static bool getDefaultSize(const char *mode, int *width, int *height);
+    //framebuffer size of a default UI as "720", "1080" or "4k2k", false if unknown
+    static bool getUiSize(const char *ui, int *width, int *height);
+};
+
+#endif // DISPLAY_MODE_REGISTRY_H
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 queue the dolby vision core enable and disable writes into a sysfs batch
+ *  - 2 wait for the hdmi tx to report the new hdr status instead of fixed sleeps
+ */
+
+#include <string.h>
+
+#include "DolbyVisionSwitch.h"
+#include "SinkCaps.h"
+
+static const dolby_vision_nodes_t sDefaultNodes = {
+    DOLBY_VISION_ENABLE,
+    DOLBY_VISION_ENABLE_OLD,
+    DOLBY_VISION_MODE,
+    DOLBY_VISION_MODE_OLD,
+    DOLBY_VISION_POLICY,
+    DOLBY_VISION_POLICY_OLD,
+    DISPLAY_HDMI_HDR_STATUS,
+};
+
+const dolby_vision_nodes_t *DolbyVisionSwitch::getDefaultNodes() {
+    return &sDefaultNodes;
+}
+
+const char *DolbyVisionSwitch::getStatus(int state) {
+    switch (state) {
+        case DOLBY_VISION_SET_DISABLE:
+            return DV_STATUS_SDR;
+        case DOLBY_VISION_SET_ENABLE_LL_YUV:
+        case DOLBY_VISION_SET_ENABLE_LL_RGB:
+            return DV_STATUS_LOW_LATENCY;
+        default:
+            return DV_STATUS_STD;
+    }
+}
+
+int DolbyVisionSwitch::getSinkState(int state, const char *dvCaps) {
+    if (DOLBY_VISION_SET_DISABLE == state || DOLBY_VISION_SET_ENABLE == state)
+        return state;
+
+    const char *dvType = SinkCaps::getDolbyVisionType(state);
+    if (dvType == NULL || strstr(dvCaps, dvType) == NULL)
+        return DOLBY_VISION_SET_ENABLE;
+    return state;
+}
+
+DolbyVisionSwitch::DolbyVisionSwitch(const dolby_vision_nodes_t *nodes)
+    :mNodes(*nodes) {
+}
+
+void DolbyVisionSwitch::addEnable(SysfsBatch &writes, int state, int frameUs) const {
+    if (frameUs > 0)
+        writes.addDelay(frameUs);
+    writes.add(mNodes.enableOld, DV_ENABLE);
+    writes.add(mNodes.modeOld, DV_MODE_IPT_TUNNEL);
+    writes.add(mNodes.enable, DV_ENABLE);
+    writes.add(mNodes.mode, DV_MODE_IPT_TUNNEL);
+    writes.addWait(mNodes.status, getStatus(state), DV_ENABLE_CEILING_US);
+}
+
+void DolbyVisionSwitch::addDisable(SysfsBatch &writes) const {
+    writes.add(mNodes.policyOld, DV_POLICY_FORCE_MODE);
+    writes.add(mNodes.modeOld, DV_MODE_BYPASS);
+    writes.add(mNodes.policy, DV_POLICY_FORCE_MODE);
+    writes.add(mNodes.mode, DV_MODE_BYPASS);
+    //the core has to be in bypass before it is switched off
+    writes.addWait(mNodes.status, DV_STATUS_SDR, DV_BYPASS_CEILING_US);
+    writes.add(mNodes.enableOld, DV_DISABLE);
+    writes.add(mNodes.enable, DV_DISABLE);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 queue the dolby vision core enable and disable writes into a sysfs batch
+ *  - 2 wait for the hdmi tx to report the new hdr status instead of fixed sleeps
+ */
+
+#ifndef DOLBY_VISION_SWITCH_H
+#define DOLBY_VISION_SWITCH_H
+
+#include "SysfsBatch.h"
+
+//dolby vision sysfs
+#define DOLBY_VISION_POLICY_OLD         "/sys/module/am_vecm/parameters/dolby_vision_policy"
+#define DOLBY_VISION_HDR10_POLICY_OLD   "/sys/module/am_vecm/parameters/dolby_vision_hdr10_policy"
+#define DOLBY_VISION_ENABLE_OLD         "/sys/module/am_vecm/parameters/dolby_vision_enable"
+#define DOLBY_VISION_MODE_OLD           "/sys/class/amvecm/dv_mode"
+#define DOLBY_VISION_POLICY             "/sys/module/amdolby_vision/parameters/dolby_vision_policy"
+#define DOLBY_VISION_HDR10_POLICY       "/sys/module/amdolby_vision/parameters/dolby_vision_hdr10_policy"
+#define DOLBY_VISION_ENABLE             "/sys/module/amdolby_vision/parameters/dolby_vision_enable"
+#define DOLBY_VISION_MODE               "/sys/class/amdolby_vision/dv_mode"
+#define DOLBY_VISION_IS_SUPPORT         "/sys/class/amhdmitx/amhdmitx0/dv_cap"
+#define DOLBY_VISION_GRAPHICS_PRIORITY_OLD  "/sys/module/am_vecm/parameters/dolby_vision_graphics_priority"
+#define DOLBY_VISION_LL_POLICY_OLD          "/sys/module/am_vecm/parameters/dolby_vision_ll_policy"
+#define DOLBY_VISION_GRAPHICS_PRIORITY  "/sys/module/amdolby_vision/parameters/dolby_vision_graphics_priority"
+#define DOLBY_VISION_LL_POLICY          "/sys/module/amdolby_vision/parameters/dolby_vision_ll_policy"
+
+#define DOLBY_VISION_SET_ENABLE_LL_RGB  3
+#define DOLBY_VISION_SET_ENABLE_LL_YUV  2
+#define DOLBY_VISION_SET_ENABLE         1
+#define DOLBY_VISION_SET_DISABLE        0
+
+#define DV_ENABLE                       "Y"
+#define DV_DISABLE                      "N"
+
+#define DV_POLICY_FOLLOW_SINK           "0"
+#define DV_POLICY_FOLLOW_SOURCE         "1"
+#define DV_POLICY_FORCE_MODE            "2"
+#define DV_HDR10_POLICY                 "3"
+
+#define DV_MODE_BYPASS                  "0x0"
+#define DV_MODE_IPT_TUNNEL              "0x2"
+
+//what the hdmi tx sends, "DolbyVision-Std", "HDR10-GAMMA_ST2084", "SDR" ...
+#define DISPLAY_HDMI_HDR_STATUS         "/sys/class/amhdmitx/amhdmitx0/hdmi_hdr_status"
+
+#define DV_STATUS_STD                   "DolbyVision-Std"
+#define DV_STATUS_LOW_LATENCY           "DolbyVision-Lowlatency"
+#define DV_STATUS_SDR                   "SDR"
+
+//bounds of the status waits, the fixed sleeps they replace: 100ms after
+//the enable writes and 300ms before avmute was cleared
+#define DV_ENABLE_CEILING_US            400000
+//the 100ms between bypass and disable
+#define DV_BYPASS_CEILING_US            100000
+
+//the core is driven through both module paths, only one of them is loaded
+typedef struct dolby_vision_nodes {
+    const char *enable;
+    const char *enableOld;
+    const char *mode;
+    const char *modeOld;
+    const char *policy;
+    const char *policyOld;
+    const char *status;             //unreadable makes every wait its ceiling
+} dolby_vision_nodes_t;
+
+class DolbyVisionSwitch
+{
+public:
+    static const dolby_vision_nodes_t *getDefaultNodes();
+    //the status once the core outputs state, DOLBY_VISION_SET_*
+    static const char *getStatus(int state);
+    //the DOLBY_VISION_SET_* the sink takes for state, standard when dvCaps lacks the low latency type
+    static int getSinkState(int state, const char *dvCaps);
+
+    DolbyVisionSwitch(const dolby_vision_nodes_t *nodes);
+
+    //frameUs lets the sdr mode written before latch on a vsync
+    void addEnable(SysfsBatch &writes, int state, int frameUs) const;
+    void addDisable(SysfsBatch &writes) const;
+
+private:
+    dolby_vision_nodes_t mNodes;
+};
+
+#endif // DOLBY_VISION_SWITCH_H
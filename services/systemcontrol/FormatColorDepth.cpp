@@ -34,57 +34,9 @@
 #include "FormatColorDepth.h"
 #include "common.h"
 
-//this is prior selected list  of 4k2k50hz, 4k2k60hz smpte50hz, smpte60hz
-static const char* COLOR_ATTRIBUTE_LIST1[] = {
-    COLOR_YCBCR420_12BIT,
-    COLOR_YCBCR420_10BIT,
-    COLOR_YCBCR420_8BIT,
-    COLOR_YCBCR422_12BIT,
-    COLOR_YCBCR422_10BIT,
-    COLOR_YCBCR444_8BIT,
-    COLOR_YCBCR422_8BIT,
-    COLOR_RGB_8BIT,
-};
-
-//this is prior selected list  of other display mode
-static const char* COLOR_ATTRIBUTE_LIST2[] = {
-    COLOR_YCBCR444_12BIT,
-    COLOR_YCBCR422_12BIT,
-    COLOR_RGB_12BIT,
-    COLOR_YCBCR444_10BIT,
-    COLOR_YCBCR422_10BIT,
-    COLOR_RGB_10BIT,
-    COLOR_YCBCR444_8BIT,
-    COLOR_YCBCR422_8BIT,
-    COLOR_RGB_8BIT,
-};
-
-//this is prior selected list  of Low Power Mode 4k2k50hz, 4k2k60hz smpte50hz, smpte60hz
-static const char* COLOR_ATTRIBUTE_LIST3[] = {
-    COLOR_YCBCR420_8BIT,
-    COLOR_YCBCR420_10BIT,
-    COLOR_YCBCR420_12BIT,
-    COLOR_YCBCR422_8BIT,
-    COLOR_YCBCR422_10BIT,
-    COLOR_YCBCR422_12BIT,
-    COLOR_YCBCR444_8BIT,
-    COLOR_RGB_8BIT,
-};
-
-//this is prior selected list of Low Power Mode other display mode
-static const char* COLOR_ATTRIBUTE_LIST4[] = {
-    COLOR_YCBCR444_8BIT,
-    COLOR_YCBCR422_8BIT,
-    COLOR_RGB_8BIT,
-    COLOR_YCBCR444_10BIT,
-    COLOR_YCBCR422_10BIT,
-    COLOR_RGB_10BIT,
-    COLOR_YCBCR444_12BIT,
-    COLOR_YCBCR422_12BIT,
-    COLOR_RGB_12BIT,
-};
-
-FormatColorDepth::FormatColorDepth() {
+FormatColorDepth::FormatColorDepth()
+    :mSinkCaps(NULL),
+    mColorTable(NULL) {
 #if defined(ODROID)
     mUbootenv = Ubootenv::getInstance();
 #else
@@ -98,6 +50,14 @@ FormatColorDepth::~FormatColorDepth() {
 #endif
 }
 
+void FormatColorDepth::setSinkCaps(const SinkCaps *caps) {
+    mSinkCaps = caps;
+}
+
+void FormatColorDepth::setColorTable(const DeepColorTable *table) {
+    mColorTable = table;
+}
+
 bool FormatColorDepth::initColorAttribute(char* supportedColorList, int len) {
     int count = 0;
     bool result = false;
@@ -105,6 +65,12 @@ bool FormatColorDepth::initColorAttribute(char* supportedColorList, int len) {
     if (supportedColorList != NULL)
         memset(supportedColorList, 0, len);
 
+    //no need to poll dc_cap again when the sink caps have it
+    if (mSinkCaps != NULL && mSinkCaps->hasDeepColorList()) {
+        strncpy(supportedColorList, mSinkCaps->getDeepColorText(), len - 1);
+        return true;
+    }
+
     while (true) {
         //mSysWrite.readSysfsOriginal(DISPLAY_HDMI_DEEP_COLOR, supportedColorList);
         mSysWrite.readSysfs(DISPLAY_HDMI_DEEP_COLOR, supportedColorList);
@@ -197,30 +163,21 @@ void FormatColorDepth::getBestHdmiDeepColorAttr(const char *outputmode, char* co
     int length = 0;
     const char **colorList = NULL;
     char supportedColorList[MAX_STR_LEN];
-    if (!initColorAttribute(supportedColorList, MAX_STR_LEN)) {
+
+    //worked out when the edid was read
+    const char *best = mColorTable != NULL ? mColorTable->bestColorFor(outputmode) : NULL;
+    if (best != NULL) {
+        if (best[0] != '\0')
+            strcpy(colorAttribute, best);
         return;
     }
 
-    //filter some color value options, aimed at some modes.
-    if (!strcmp(outputmode, MODE_4K2K60HZ) || !strcmp(outputmode, MODE_4K2K50HZ)
-        || !strcmp(outputmode, MODE_4K2KSMPTE60HZ) || !strcmp(outputmode, MODE_4K2KSMPTE50HZ)) {
-        if (mSysWrite.getPropertyBoolean(LOW_POWER_DEFAULT_COLOR, false)) {
-            colorList = COLOR_ATTRIBUTE_LIST3;
-            length = ARRAY_SIZE(COLOR_ATTRIBUTE_LIST3);
-        } else {
-            colorList = COLOR_ATTRIBUTE_LIST1;
-            length = ARRAY_SIZE(COLOR_ATTRIBUTE_LIST1);
-        }
-    } else {
-        if (mSysWrite.getPropertyBoolean(LOW_POWER_DEFAULT_COLOR, false)) {
-            colorList = COLOR_ATTRIBUTE_LIST4;
-            length = ARRAY_SIZE(COLOR_ATTRIBUTE_LIST4);
-        } else {
-            colorList = COLOR_ATTRIBUTE_LIST2;
-            length = ARRAY_SIZE(COLOR_ATTRIBUTE_LIST2);
-        }
+    if (!initColorAttribute(supportedColorList, MAX_STR_LEN)) {
+        return;
     }
 
+    colorList = DeepColorTable::getPriorityList(outputmode,
+        mSysWrite.getPropertyBoolean(LOW_POWER_DEFAULT_COLOR, false), &length);
     for (int i = 0; i < length; i++) {
         if ((pos = strstr(supportedColorList, colorList[i])) != NULL) {
             if (isModeSupportDeepColorAttr(outputmode, colorList[i])) {
@@ -234,13 +191,20 @@ void FormatColorDepth::getBestHdmiDeepColorAttr(const char *outputmode, char* co
 }
 
 bool FormatColorDepth::isModeSupportDeepColorAttr(const char *mode, const char * color) {
+    // custombuilt mode avoid the routine.
+    if(!strcmp(mode, "custombuilt"))
+        return true;
+    int supported = mColorTable != NULL ? mColorTable->supports(mode, color) : -1;
+    if (supported >= 0)
+        return supported != 0;
+    return probeDeepColor(mode, color);
+}
+
+bool FormatColorDepth::probeDeepColor(const char *mode, const char * color) {
     char valueStr[10] = {0};
     char outputmode[MODE_LEN] = {0};
     strcpy(outputmode, mode);
     strcat(outputmode, color);
-    // custombuilt mode avoid the routine.
-    if(!strcmp(mode, "custombuilt"))
-        return true;
     //try support or not
     mSysWrite.writeSysfs(DISPLAY_HDMI_VALID_MODE, outputmode);
     mSysWrite.readSysfs(DISPLAY_HDMI_VALID_MODE, valueStr);
@@ -23,6 +23,8 @@
 #define FORMATCOLORDEPTH_H
 
 #include "SysWrite.h"
+#include "SinkCaps.h"
+#include "DeepColorTable.h"
 #include "ubootenv/Ubootenv.h"
 
 #define DISPLAY_HDMI_COLOR_ATTR         "/sys/class/amhdmitx/amhdmitx0/attr"//set deep color fmt and dept
@@ -32,21 +34,7 @@
 #define UBOOTENV_COLORATTRIBUTE         "ubootenv.var.colorattribute"
 
 
-#define COLOR_YCBCR444_12BIT             "444,12bit"
-#define COLOR_YCBCR444_10BIT             "444,10bit"
-#define COLOR_YCBCR444_8BIT              "444,8bit"
-#define COLOR_YCBCR422_12BIT             "422,12bit"
-#define COLOR_YCBCR422_10BIT             "422,10bit"
-#define COLOR_YCBCR422_8BIT              "422,8bit"
-#define COLOR_YCBCR420_12BIT             "420,12bit"
-#define COLOR_YCBCR420_10BIT             "420,10bit"
-#define COLOR_YCBCR420_8BIT              "420,8bit"
-#define COLOR_RGB_12BIT                  "rgb,12bit"
-#define COLOR_RGB_10BIT                  "rgb,10bit"
-#define COLOR_RGB_8BIT                   "rgb,8bit"
-
-
-class FormatColorDepth
+class FormatColorDepth : public DeepColorTable::Prober
 {
 public:
     FormatColorDepth();
@@ -54,6 +42,11 @@ public:
     void getHdmiColorAttribute(const char *outputmode, char * colorAttribute, int state);
     bool isModeSupportDeepColorAttr(const char *mode, const char * color);
     void getBestHdmiDeepColorAttr(const char *outputmode, char *colorAttribute);
+    //dc_cap parsed already, it must outlive this object
+    void setSinkCaps(const SinkCaps *caps);
+    //built for the same edid, modes it has a row for need no valid_mode probe
+    void setColorTable(const DeepColorTable *table);
+    virtual bool probeDeepColor(const char *mode, const char *color);
 
 private:
     bool getBootEnv(const char* key, char* value);
@@ -65,5 +58,7 @@ private:
     bool initColorAttribute(char* supportedColorList, int len);
 
     SysWrite mSysWrite;
+    const SinkCaps *mSinkCaps;
+    const DeepColorTable *mColorTable;
 };
 #endif //FORMATCOLORDEPTH_H
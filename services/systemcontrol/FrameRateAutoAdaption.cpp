@@ -17,6 +17,8 @@
  *  @date     2014/09/09
  *  @par function description:
  *  - 1 write property or sysfs in daemon
+ *  - 2 match video durations against the sink modes, worked out once per edid
+ *  - 3 hold hints back so a burst at the start of playback is one mode switch
  */
 
 #define LOG_TAG "SystemControl"
@@ -25,125 +27,234 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <fcntl.h>
-#include <errno.h>
-#include <cutils/properties.h>
 #include <stdint.h>
+#include <time.h>
 #include <sys/types.h>
 
-#include "DisplayMode.h"
 #include "FrameRateAutoAdaption.h"
 
+static const frame_rate_config_t sDefaultConfig = {
+    1000,       //minDwellMs
+    500,        //endHintGuardMs
+};
 
-FrameRateAutoAdaption::FrameRateAutoAdaption(Callbak *cb): mCallback(cb){
+//the rates a duration is shown at, bit index of frame_rate_row_t rates
+static const char *FRAME_RATE_HZ[] = {
+    "24hz",
+    "25hz",
+    "30hz",
+    "50hz",
+    "60hz",
+};
+
+typedef struct frame_rate_duration {
+    int duration;
+    int first;                      //FRAME_RATE_HZ index
+    int second;
+    bool pulldown;                  //a 1000/1001 rate
+} frame_rate_duration_t;
+
+static const frame_rate_duration_t sDurations[] = {
+    { FRAME_RATE_DURATION_2397, 0, 4, true },
+    { FRAME_RATE_DURATION_2398, 0, 4, true },
+    { FRAME_RATE_DURATION_24,   0, 4, false },
+    { FRAME_RATE_DURATION_25,   1, 3, false },
+    { FRAME_RATE_DURATION_2997, 2, 4, true },
+    { FRAME_RATE_DURATION_30,   2, 4, false },
+    { FRAME_RATE_DURATION_50,   3, 1, false },
+    { FRAME_RATE_DURATION_5994, 4, 2, true },
+    { FRAME_RATE_DURATION_5992, 4, 2, true },
+    { FRAME_RATE_DURATION_60,   4, 2, false },
+};
+
+static const frame_rate_duration_t *findDuration(int dur) {
+    for (size_t i = 0; i < sizeof(sDurations) / sizeof(sDurations[0]); i++) {
+        if (sDurations[i].duration == dur)
+            return &sDurations[i];
+    }
+    return NULL;
+}
+
+//"1080p" of "1080p60hz", false without the hz keyword
+static bool getResolution(const char *mode, char *resolution, int len) {
+    const char *pos = strstr(mode, "hz");
+    if (NULL == pos || pos - mode < 2 || pos - mode - 2 >= len)
+        return false;
+
+    pos -= 2;//filter 24,30,50,60...
+    memcpy(resolution, mode, pos - mode);
+    resolution[pos - mode] = '\0';
+    return true;
+}
+
+const frame_rate_config_t *FrameRateAutoAdaption::getDefaultConfig() {
+    return &sDefaultConfig;
+}
+
+int64_t FrameRateAutoAdaption::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+FrameRateAutoAdaption::FrameRateAutoAdaption(const frame_rate_config_t *config, Callbak *cb)
+    :mConfig(*config),
+    mCallback(cb),
+    mStarted(false),
+    mExit(false),
+    mBusy(false),
+    mRequest(REQUEST_NONE),
+    mDuration(0),
+    mHintNs(0),
+    mSwitchNs(0),
+    mRowCount(0),
+    mMatrixValid(false),
+    mAdaptedPulldown(false) {
+    pthread_condattr_t attr;
+
+    pthread_mutex_init(&mLock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mCond, &attr);
+    pthread_condattr_destroy(&attr);
+    memset(&mStats, 0, sizeof(mStats));
+    memset(mMatrixCrc, 0, sizeof(mMatrixCrc));
 }
 
 FrameRateAutoAdaption::~FrameRateAutoAdaption() {
+    pthread_mutex_lock(&mLock);
+    mExit = true;
+    pthread_cond_broadcast(&mCond);
+    pthread_mutex_unlock(&mLock);
+    if (mStarted)
+        pthread_join(mThread, NULL);
+
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mLock);
 }
 
-void FrameRateAutoAdaption::readSinkEdid(char *edid) {
-    int count = 0;
-    while (true) {
-        mSysWrite.readSysfsOriginal(DISPLAY_HDMI_EDID, edid);
-        if (strlen(edid) > 0)
-            break;
+bool FrameRateAutoAdaption::start() {
+    if (mStarted)
+        return true;
 
-        if (count >= 5) {
-            strcpy(edid, "null edid");
-            break;
-        }
-        count++;
-        usleep(500000);
+    if (pthread_create(&mThread, NULL, threadLoop, this) != 0) {
+        SYS_LOGE("Create frame rate adaption thread error!\n");
+        return false;
+    }
+    mStarted = true;
+    return true;
+}
+
+void *FrameRateAutoAdaption::threadLoop(void *data) {
+    ((FrameRateAutoAdaption *)data)->run();
+    return NULL;
+}
+
+const frame_rate_row_t *FrameRateAutoAdaption::addRow(const char *resolution) {
+    if (mRowCount >= FRAME_RATE_RESOLUTIONS_MAX)
+        return NULL;
+
+    frame_rate_row_t *row = &mRows[mRowCount++];
+    strcpy(row->resolution, resolution);
+    row->rates = 0;
+    for (size_t r = 0; r < sizeof(FRAME_RATE_HZ) / sizeof(FRAME_RATE_HZ[0]); r++) {
+        char mode[MODE_LEN] = {0};
+        sprintf(mode, "%s%s", resolution, FRAME_RATE_HZ[r]);
+        if (mCaps.mentionsMode(mode))
+            row->rates |= 1u << r;
+    }
+    return row;
+}
+
+//a row for every resolution of the sink modes, others are added when first asked for
+void FrameRateAutoAdaption::buildMatrix() {
+    mRowCount = 0;
+    for (int i = 0; i < mCaps.getModeCount(); i++) {
+        char resolution[FRAME_RATE_RESOLUTION_LEN] = {0};
+        if (getResolution(mCaps.getMode(i)->name, resolution, FRAME_RATE_RESOLUTION_LEN)
+                && findRow(resolution) == NULL)
+            addRow(resolution);
     }
 }
 
-//Get best match display mode and if need pull down 1/1000 as video frame duration
-void FrameRateAutoAdaption::getMatchDurOutputMode (int dur, char *curMode, char *frameRateMode, char *newMode, bool *pulldown) {
+const frame_rate_row_t *FrameRateAutoAdaption::findRow(const char *resolution) const {
+    for (int i = 0; i < mRowCount; i++) {
+        if (!strcmp(mRows[i].resolution, resolution))
+            return &mRows[i];
+    }
+    return NULL;
+}
+
+//the sink modes only change with the edid, no need to read disp_cap for every hint
+void FrameRateAutoAdaption::updateMatrix() {
+    char crc[MODE_LEN] = {0};
+    SinkCaps caps;
+
+    bool hasCrc = mCallback->getFrameRateSinkCaps(&caps, crc, MODE_LEN);
+    if (hasCrc && mMatrixValid && !strcmp(crc, mMatrixCrc))
+        return;
+
+    mCaps = caps;
+    buildMatrix();
+    mMatrixValid = hasCrc;
+    strcpy(mMatrixCrc, crc);
+    pthread_mutex_lock(&mLock);
+    mStats.matrixBuilds++;
+    pthread_mutex_unlock(&mLock);
+    SYS_LOGI("frame rate mode matrix of %d resolutions, crc [%s]\n", mRowCount, crc);
+}
+
+void FrameRateAutoAdaption::getMatchDurOutputMode(int dur, const char *curMode, const char *frameRateMode,
+        char *newMode, bool *pulldown) {
     SYS_LOGD("get match duration outputmode duration: %d\n", dur);
 
     if (strstr(curMode, "smpte")) {
         return;
     }
+    const frame_rate_duration_t *entry = findDuration(dur);
+    bool needPulldown = entry != NULL && entry->pulldown;
     //frame rate adapter mode 1:only need pull down 1/1000
     if (!strcmp(frameRateMode, FRAME_RATE_HDMI_CLK_PULLDOWN)) {
-        if ((dur == FRAME_RATE_DURATION_2397)
-            || (dur == FRAME_RATE_DURATION_2398)
-            || (dur == FRAME_RATE_DURATION_2997)
-            || (dur == FRAME_RATE_DURATION_5992)
-            || (dur == FRAME_RATE_DURATION_5994)) {
-
-            if (strstr(curMode, "24hz")
-                || strstr(curMode, "30hz")
-                || strstr(curMode, "60hz")) {
-                *pulldown = true;
-            }
+        if (needPulldown && (strstr(curMode, "24hz") || strstr(curMode, "30hz") || strstr(curMode, "60hz"))) {
+            *pulldown = true;
         }
     }
     //frame rate adapter mode 2:need change display mode and pull down 1/1000
     else if (!strcmp(frameRateMode, FRAME_RATE_HDMI_SWITCH_FORCE)) {
-        char resolution[10] = {0};
+        char resolution[FRAME_RATE_RESOLUTION_LEN] = {0};
         char firstMode[MODE_LEN] = {0};
         char secondMode[MODE_LEN] = {0};
-        bool needPulldown = false;
-        char sinkEdid[MAX_STR_LEN] = {0};
 
-        readSinkEdid(sinkEdid);
-        char *pos = strstr(curMode, "hz");
-        if (NULL == pos) {
+        if (!getResolution(curMode, resolution, FRAME_RATE_RESOLUTION_LEN)) {
             SYS_LOGD("get match duration outputmode, current display mode: %s do not have hz keyword\n", curMode);
             return;
         }
-
-        pos -= 2;//filter 24,30,50,60...
-        strncpy(resolution, curMode, int(pos - curMode));
-        // if need 1/1000 pull down
-        if ((dur == FRAME_RATE_DURATION_2397)
-            || (dur == FRAME_RATE_DURATION_2398)
-            || (dur == FRAME_RATE_DURATION_2997)
-            || (dur == FRAME_RATE_DURATION_5992)
-            || (dur == FRAME_RATE_DURATION_5994)) {
-            needPulldown = true;
+        //an unknown duration matches nothing
+        if (entry == NULL) {
+            *pulldown = false;
+            return;
         }
 
-        // get first and second mode for this duration
-        if ((dur == FRAME_RATE_DURATION_2397)
-            || (dur == FRAME_RATE_DURATION_2398)
-            || (dur == FRAME_RATE_DURATION_24)) {
-            sprintf(firstMode, "%s%s", resolution, "24hz");
-            sprintf(secondMode, "%s%s", resolution, "60hz");
-        }
-        else if ((dur == FRAME_RATE_DURATION_2997)
-            || (dur == FRAME_RATE_DURATION_30)) {
-            sprintf(firstMode, "%s%s", resolution, "30hz");
-            sprintf(secondMode, "%s%s", resolution, "60hz");
-        }
-        else if ((dur == FRAME_RATE_DURATION_5992)
-            ||(dur == FRAME_RATE_DURATION_5994)
-            || (dur == FRAME_RATE_DURATION_60)) {
-            sprintf(firstMode, "%s%s", resolution, "60hz");
-            sprintf(secondMode, "%s%s", resolution, "30hz");
-        }
-        else if (dur == FRAME_RATE_DURATION_25) {
-            sprintf(firstMode, "%s%s", resolution, "25hz");
-            sprintf(secondMode, "%s%s", resolution, "50hz");
-        }
-        else if (dur == FRAME_RATE_DURATION_50) {
-            sprintf(firstMode, "%s%s", resolution, "50hz");
-            sprintf(secondMode, "%s%s", resolution, "25hz");
-        }
+        updateMatrix();
+        const frame_rate_row_t *row = findRow(resolution);
+        if (row == NULL)
+            row = addRow(resolution);
+        uint32_t rates = row != NULL ? row->rates : 0;
+        sprintf(firstMode, "%s%s", resolution, FRAME_RATE_HZ[entry->first]);
+        sprintf(secondMode, "%s%s", resolution, FRAME_RATE_HZ[entry->second]);
 
         if (!strcmp(firstMode, curMode)) {
             *pulldown = needPulldown;
         }
-        else if (strstr(sinkEdid, firstMode)) {
-            strncpy(newMode, firstMode, strlen(firstMode));
+        else if (rates & (1u << entry->first)) {
+            strcpy(newMode, firstMode);
             *pulldown = needPulldown;
         }
         else if (!strcmp(secondMode, curMode)) {
             *pulldown = needPulldown;
         }
-        else if (strstr(sinkEdid, secondMode)) {
-            strncpy(newMode, secondMode, strlen(firstMode));
+        else if (rates & (1u << entry->second)) {
+            strcpy(newMode, secondMode);
             *pulldown = needPulldown;
         }
         else if (strstr(curMode, "24hz")
@@ -158,54 +269,181 @@ void FrameRateAutoAdaption::getMatchDurOutputMode (int dur, char *curMode, char
 }
 
 void FrameRateAutoAdaption::onTxUeventReceived(uevent_data_t* ueventData){
+    bool end = !strcmp(ueventData->switchName, "end_hint");
+    int duration = 0;
+
+    SYS_LOGD("Video framerate switchName: %s, switchState: %s\n", ueventData->switchName, ueventData->switchState);
+    if (!end) {
+        sscanf(ueventData->switchName, "%d", &duration);
+        if (duration <= 0)
+            return;
+    }
+
+    pthread_mutex_lock(&mLock);
+    int64_t ns = now();
+    if (end) {
+        mStats.endHints++;
+    } else {
+        mStats.hints++;
+        mHintNs = ns;
+    }
+    //a request not due yet is dropped for the newer one, an end hint for the next hint
+    if (REQUEST_NONE != mRequest)
+        mStats.suppressed++;
+    mStats.triggered++;
+    mRequest = end ? REQUEST_END : REQUEST_HINT;
+    mDuration = duration;
+    pthread_cond_broadcast(&mCond);
+    pthread_mutex_unlock(&mLock);
+}
+
+static void toTimespec(int64_t ns, struct timespec *ts) {
+    ts->tv_sec = ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+void FrameRateAutoAdaption::run() {
+    pthread_mutex_lock(&mLock);
+    while (!mExit) {
+        if (REQUEST_NONE == mRequest) {
+            pthread_cond_wait(&mCond, &mLock);
+            continue;
+        }
+
+        int64_t dueNs = 0;
+        if (mSwitchNs > 0)
+            dueNs = mSwitchNs + (int64_t)mConfig.minDwellMs * 1000000;
+        if (REQUEST_END == mRequest && mHintNs > 0) {
+            int64_t guardNs = mHintNs + (int64_t)mConfig.endHintGuardMs * 1000000;
+            if (guardNs > dueNs)
+                dueNs = guardNs;
+        }
+        if (dueNs > now()) {
+            struct timespec deadline;
+            toTimespec(dueNs, &deadline);
+            pthread_cond_timedwait(&mCond, &mLock, &deadline);
+            continue;
+        }
+
+        int request = mRequest;
+        int duration = mDuration;
+        mRequest = REQUEST_NONE;
+        mBusy = true;
+        pthread_mutex_unlock(&mLock);
+
+        apply(request, duration);
+
+        pthread_mutex_lock(&mLock);
+        mBusy = false;
+        pthread_cond_broadcast(&mCond);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void FrameRateAutoAdaption::apply(int request, int duration) {
     char framerateMode[8] ={0};
+    char fracPolicy[8] = {0};
     char curDisplayMode[MODE_LEN] = {0};
+    char newDisplayMode[MODE_LEN] = {0};
+    const char *switchMode = NULL;
+    int reason = FRAME_RATE_SWITCH_MODE;
 
-    mSysWrite.readSysfs(SYSFS_DISPLAY_MODE, curDisplayMode);
-    mSysWrite.readSysfs(HDMI_FRAME_RATE_AUTO, framerateMode);
-
-    SYS_LOGD("Video framerate switchName: %s, switchState: %s, current display mode:%s, frame rate status:%s[0:off 1:pulldown 2:force switch]\n",
-        ueventData->switchName, ueventData->switchState, curDisplayMode, framerateMode);
+    mCallback->getFrameRateOutput(curDisplayMode, framerateMode, fracPolicy);
+    SYS_LOGD("Video framerate %s, current display mode:%s, frame rate status:%s[0:off 1:pulldown 2:force switch]\n",
+        REQUEST_END == request ? "end hint" : "hint", curDisplayMode, framerateMode);
 
-    if (!strcmp(ueventData->switchName, "end_hint")) {
+    if (REQUEST_END == request) {
         autoSwitchFlag = false;
     }
     if (NULL != strstr(curDisplayMode, "cvbs")) {
         SYS_LOGD("CVBS mode do not need auto frame rate\n");
-        return;
+    } else if (!strcmp(framerateMode, FRAME_RATE_HDMI_OFF)) {
+        SYS_LOGD("hdmi frame rate is off\n");
+    } else if (REQUEST_END == request) {
+        //frame rate is in pulldown or switch force mode
+        SYS_LOGD("Video framerate switch end hint last mode: %s\n", mLastVideoMode);
+        if (strlen(mLastVideoMode) > 0) {
+            switchMode = mLastVideoMode;
+            reason = FRAME_RATE_SWITCH_END;
+        }
+    } else {
+        bool pulldown = false;
+
+        getMatchDurOutputMode(duration, curDisplayMode, framerateMode, newDisplayMode, &pulldown);
+        SYS_LOGD("Video framerate switch new display mode: %s, pulldown:%d\n", newDisplayMode, pulldown?1:0);
+        const char *target = (strlen(newDisplayMode) != 0) ? newDisplayMode : curDisplayMode;
+        //the hint of a video already shown at its rate, as a seek or a restart sends it,
+        //unless the mode or the clock offset changed since
+        if ((pulldown || strlen(newDisplayMode) != 0) && (strlen(mLastVideoMode) > 0)
+                && !strcmp(target, mAdaptedMode) && !strcmp(target, curDisplayMode)
+                && (pulldown == mAdaptedPulldown) && (!pulldown || !strcmp(fracPolicy, "1"))) {
+            SYS_LOGD("Video framerate already adapted to %s\n", target);
+        } else if (pulldown || strlen(newDisplayMode) != 0) {
+            autoSwitchFlag = pulldown;
+            //the mode to go back to is the one before the first hint
+            if (strlen(mLastVideoMode) == 0)
+                strcpy(mLastVideoMode, curDisplayMode);
+            strcpy(mAdaptedMode, target);
+            mAdaptedPulldown = pulldown;
+            switchMode = target;
+            reason = pulldown ? FRAME_RATE_SWITCH_PULLDOWN : FRAME_RATE_SWITCH_MODE;
+        }
     }
 
-    if (!strcmp(framerateMode, FRAME_RATE_HDMI_OFF)) {
-        SYS_LOGD("hdmi frame rate is off\n");
+    if (NULL == switchMode) {
+        pthread_mutex_lock(&mLock);
+        mStats.unchanged++;
+        pthread_mutex_unlock(&mLock);
         return;
     }
 
-    //frame rate is in pulldown or switch force mode
-    if (!strcmp(ueventData->switchName, "end_hint")) {
-        SYS_LOGD("Video framerate switch end hint last mode: %s\n", mLastVideoMode);
-        if (strlen(mLastVideoMode) > 0) {
-            mCallback->onDispModeSyncEvent(mLastVideoMode, OUPUT_MODE_STATE_ADAPTER_END);
-            memset(mLastVideoMode, 0, sizeof(mLastVideoMode));
-        }
+    char mode[MODE_LEN] = {0};
+    strcpy(mode, switchMode);
+    if (FRAME_RATE_SWITCH_END == reason) {
+        memset(mLastVideoMode, 0, sizeof(mLastVideoMode));
+        memset(mAdaptedMode, 0, sizeof(mAdaptedMode));
+        mAdaptedPulldown = false;
     }
-    else{
-        char newDisplayMode[MODE_LEN] = {0};
-        bool pulldow = false;
-        int duration = 0;
+    mCallback->onFrameRateSwitch(mode, reason);
 
-        sscanf(ueventData->switchName, "%d", &duration);
-        if (duration > 0)
-            getMatchDurOutputMode(duration, curDisplayMode, framerateMode, newDisplayMode, &pulldow);
-
-        SYS_LOGD("Video framerate switch new display mode: %s, pulldown:%d\n", newDisplayMode, pulldow?1:0);
-        if (pulldow) {
-            autoSwitchFlag = true;
-            strcpy(mLastVideoMode, curDisplayMode);
-            mCallback->onDispModeSyncEvent((strlen(newDisplayMode) != 0)?newDisplayMode:curDisplayMode, OUPUT_MODE_STATE_SWITCH_ADAPTER);
-        }
-        else if (strlen(newDisplayMode) != 0) {
-            strcpy(mLastVideoMode, curDisplayMode);
-            mCallback->onDispModeSyncEvent(newDisplayMode, OUPUT_MODE_STATE_SWITCH);
-        }
+    pthread_mutex_lock(&mLock);
+    mStats.completed++;
+    mSwitchNs = now();
+    pthread_mutex_unlock(&mLock);
+}
+
+bool FrameRateAutoAdaption::waitIdle(int timeoutMs) {
+    struct timespec deadline;
+    bool idle;
+
+    toTimespec(now() + (int64_t)timeoutMs * 1000000, &deadline);
+    pthread_mutex_lock(&mLock);
+    while (REQUEST_NONE != mRequest || mBusy) {
+        if (pthread_cond_timedwait(&mCond, &mLock, &deadline) != 0)
+            break;
     }
-}
\ No newline at end of file
+    idle = REQUEST_NONE == mRequest && !mBusy;
+    pthread_mutex_unlock(&mLock);
+    return idle;
+}
+
+void FrameRateAutoAdaption::getStats(frame_rate_stats_t *stats) {
+    pthread_mutex_lock(&mLock);
+    *stats = mStats;
+    pthread_mutex_unlock(&mLock);
+}
+
+int FrameRateAutoAdaption::dump(char *result) {
+    if (NULL == result)
+        return -1;
+
+    char buf[CC_MAX_LINE_LEN] = {0};
+    pthread_mutex_lock(&mLock);
+    snprintf(buf, sizeof(buf), "\nframe rate hints:%d end hints:%d triggered:%d suppressed:%d unchanged:%d "
+        "completed:%d matrix builds:%d\n",
+        mStats.hints, mStats.endHints, mStats.triggered, mStats.suppressed, mStats.unchanged,
+        mStats.completed, mStats.matrixBuilds);
+    pthread_mutex_unlock(&mLock);
+    strcat(result, buf);
+    return 0;
+}
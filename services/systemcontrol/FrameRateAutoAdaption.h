@@ -17,6 +17,8 @@
  *  @date     2017/01/24
  *  @par function description:
  *  - 1 write property or sysfs in daemon
+ *  - 2 match video durations against the sink modes, worked out once per edid
+ *  - 3 hold hints back so a burst at the start of playback is one mode switch
  */
 
 
@@ -24,9 +26,11 @@
 #ifndef FRAMERATE_ADAPTER_H
 #define FRAMERATE_ADAPTER_H
 
-#include "SysWrite.h"
+#include <pthread.h>
+#include <stdint.h>
 #include "common.h"
-#include "UEventObserver.h"
+#include "SinkCaps.h"
+#include "UeventMatcher.h"
 
 /*
 Duration time base is 1/96000 second.
@@ -75,6 +79,36 @@ enum {
 };
 */
 
+#define FRAME_RATE_RESOLUTIONS_MAX      16
+#define FRAME_RATE_RESOLUTION_LEN       16
+
+enum {
+    FRAME_RATE_SWITCH_MODE              = 0,//another mode of the same resolution
+    FRAME_RATE_SWITCH_PULLDOWN          = 1,//1/1000 clock pull down, the mode may change too
+    FRAME_RATE_SWITCH_END               = 2,//back to the mode before the video
+};
+
+typedef struct frame_rate_config {
+    int minDwellMs;                 //no switch sooner after the last one
+    int endHintGuardMs;             //an end hint this soon after a hint waits for the next hint
+} frame_rate_config_t;
+
+typedef struct frame_rate_stats {
+    int hints;
+    int endHints;
+    int triggered;                  //hints and end hints queued for the worker
+    int suppressed;                 //replaced or cancelled before they were due
+    int unchanged;                  //due, but the output was right already
+    int completed;                  //mode switches done
+    int matrixBuilds;
+} frame_rate_stats_t;
+
+//the rates the sink lists for one resolution, bit per FRAME_RATE_HZ index
+typedef struct frame_rate_row {
+    char resolution[FRAME_RATE_RESOLUTION_LEN];
+    uint32_t rates;
+} frame_rate_row_t;
+
 class FrameRateAutoAdaption
 {
 public:
@@ -82,21 +116,69 @@ public:
     public:
         Callbak() {};
         virtual ~Callbak() {};
-        virtual void onDispModeSyncEvent (const char* outputmode, int state) = 0;
+        //the current output mode, policy_fr_auto and frac_rate_policy
+        virtual void getFrameRateOutput(char *outputmode, char *policy, char *fracPolicy) = 0;
+        //parsed sink caps and the edid crc they are of, false without a crc
+        virtual bool getFrameRateSinkCaps(SinkCaps *caps, char *crc, int len) = 0;
+        //FRAME_RATE_SWITCH_*
+        virtual void onFrameRateSwitch(const char* outputmode, int reason) = 0;
     };
 
-    FrameRateAutoAdaption(Callbak *cb);
+    static const frame_rate_config_t *getDefaultConfig();
+    static int64_t now();
+
+    FrameRateAutoAdaption(const frame_rate_config_t *config, Callbak *cb);
     ~FrameRateAutoAdaption();
 
+    bool start();
     void onTxUeventReceived(uevent_data_t* ueventData);
+    //true once nothing is pending or switching, false on timeout
+    bool waitIdle(int timeoutMs);
+    void getStats(frame_rate_stats_t *stats);
+    int dump(char *result);
+
+    //get best match display mode and if need pull down 1/1000 as video frame duration
+    void getMatchDurOutputMode(int dur, const char *curMode, const char *frameRateMode, char *newMode, bool *pulldown);
     bool autoSwitchFlag = false;
 
 private:
-    void readSinkEdid(char *edid);
-    void getMatchDurOutputMode (int dur, char *curMode, char *frameRateMode, char *newMode, bool *pulldown);
+    enum {
+        REQUEST_NONE,
+        REQUEST_HINT,
+        REQUEST_END,
+    };
 
+    static void *threadLoop(void *data);
+    void run();
+    void apply(int request, int duration);
+    void updateMatrix();
+    void buildMatrix();
+    const frame_rate_row_t *addRow(const char *resolution);
+    const frame_rate_row_t *findRow(const char *resolution) const;
+
+    frame_rate_config_t mConfig;
     Callbak *mCallback;
-    SysWrite mSysWrite;
+
+    pthread_t mThread;
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;
+    bool mStarted;
+    bool mExit;
+    bool mBusy;
+    int mRequest;                   //REQUEST_*, the latest wins
+    int mDuration;
+    int64_t mHintNs;
+    int64_t mSwitchNs;
+    frame_rate_stats_t mStats;
+
+    //the worker only
+    SinkCaps mCaps;
+    frame_rate_row_t mRows[FRAME_RATE_RESOLUTIONS_MAX];
+    int mRowCount;
+    bool mMatrixValid;
+    char mMatrixCrc[MODE_LEN];
     char mLastVideoMode[MODE_LEN] = {0};
+    char mAdaptedMode[MODE_LEN] = {0};
+    bool mAdaptedPulldown;
 };
-#endif // FRAMERATE_ADAPTER_H
\ No newline at end of file
+#endif // FRAMERATE_ADAPTER_H
@@ -189,7 +189,7 @@ void* HDCPRxAuth::RxUenventThreadLoop(void* data) {
     uevent_data_t ueventData;
     memset(&ueventData, 0, sizeof(uevent_data_t));
 
-    UEventObserver ueventObserver;
+    UEventObserver ueventObserver("hdcp_rx");
     ueventObserver.addMatch(HdmiRxPlugEvent);
     ueventObserver.addMatch(HdmiRxAuthEvent);
 
@@ -34,6 +34,7 @@
 #include "HDCPTxAuth.h"
 #include "UEventObserver.h"
 #include "../DisplayMode.h"
+#include "../SysfsBatch.h"
 
 #ifndef RECOVERY_MODE
 #include <binder/IBinder.h>
@@ -305,6 +306,19 @@ void HDCPTxAuth::startVer14() {
     mSysWrite.writeSysfs(DISPLAY_HDMI_HDCP_MODE, DISPLAY_HDMI_HDCP_14);
 }
 
+void HDCPTxAuth::hdrExitReset() {
+    mSysWrite.writeSysfs(DISPLAY_HDMI_AVMUTE, "1");
+    usleep(100000);//100ms
+    stopVerAll();
+    stop();
+    SysfsBatch phy("hdr exit phy reset");
+    phy.add(DISPLAY_HDMI_PHY, "0"); /* Turn off TMDS PHY */
+    phy.addDelay(200000);//200ms
+    phy.add(DISPLAY_HDMI_PHY, "1"); /* Turn on TMDS PHY */
+    phy.commit();
+    start();
+}
+
 void HDCPTxAuth::stopVerAll() {
     char hdcpRxVer[MODE_LEN] = {0};
     //stop hdcp_tx 2.2 & 1.4
@@ -327,7 +341,7 @@ void* HDCPTxAuth::TxUenventThreadLoop(void* data) {
     uevent_data_t ueventData;
     memset(&ueventData, 0, sizeof(uevent_data_t));
 
-    UEventObserver ueventObserver;
+    UEventObserver ueventObserver("hdcp_tx");
     ueventObserver.addMatch(HDMI_TX_POWER_UEVENT);
     ueventObserver.addMatch(HDMI_TX_PLUG_UEVENT);
     ueventObserver.addMatch(VIDEO_LAYER1_UEVENT);
@@ -361,14 +375,10 @@ void* HDCPTxAuth::TxUenventThreadLoop(void* data) {
             char hdrState[MODE_LEN] = {0};
             pThiz->mSysWrite.readSysfs(HDMI_TX_SWITCH_HDR, hdrState);
             if (!strcmp(hdrState, "0")) {
-                pThiz->mSysWrite.writeSysfs(DISPLAY_HDMI_AVMUTE, "1");
-                usleep(100000);//100ms
-                pThiz->stopVerAll();
-                pThiz->stop();
-                pThiz->mSysWrite.writeSysfs(DISPLAY_HDMI_PHY, "0"); /* Turn off TMDS PHY */
-                usleep(200000);//200ms
-                pThiz->mSysWrite.writeSysfs(DISPLAY_HDMI_PHY, "1"); /* Turn on TMDS PHY */
-                pThiz->start();
+                if (NULL != pThiz->mpCallback)
+                    pThiz->mpCallback->onHdrExit();
+                else
+                    pThiz->hdrExitReset();
             }
         }
         else if (!strcmp(ueventData.matchName, HDMI_TX_HDCP_UEVENT) && !strcmp(ueventData.switchName, HDMI_UEVENT_HDCP)) {
@@ -44,6 +44,8 @@ public:
         TxUevntCallbak() {};
         virtual ~TxUevntCallbak() {};
         virtual void onTxEvent (char* switchName, char* hpdstate, int outputState) = 0;
+        //the sink left hdr, hdrExitReset() has to run in step with the mode switches
+        virtual void onHdrExit() = 0;
     };
 
     HDCPTxAuth();
@@ -58,6 +60,8 @@ public:
     int stop();
     void stopVerAll();
     void isAuthSuccess(int *status);
+    //mute, phy off and on again and restart hdcp after the sink left hdr
+    void hdrExitReset();
 
     #ifndef RECOVERY_MODE
     void sfRepaintEverything();
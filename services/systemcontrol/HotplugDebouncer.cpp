@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 debounce hdmi hotplug uevents, a burst ends in at most one mode switch
+ *  - 2 work out the target mode on a worker once the edid holds still
+ *  - 3 skip the switch when the sink wants what is already output
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "HotplugDebouncer.h"
+
+static const hotplug_config_t sDefaultConfig = {
+    150,        //debounceMs
+    2,          //maxRetries
+};
+
+static const char *sStateNames[HOTPLUG_STATE_TOTAL] = {
+    "idle",
+    "debounce",
+    "compute",
+    "switch",
+};
+
+const hotplug_config_t *HotplugDebouncer::getDefaultConfig() {
+    return &sDefaultConfig;
+}
+
+bool HotplugDebouncer::isSameTarget(const hotplug_target_t *target, const hotplug_target_t *current) {
+    if (strcmp(target->mode, current->mode))
+        return false;
+    //the attr sysfs may say more than the attribute itself
+    if (target->colorAttr[0] != '\0' && strstr(current->colorAttr, target->colorAttr) == NULL)
+        return false;
+    //same mode with the phy off is a black screen
+    if (strstr(target->mode, "cvbs") == NULL && !current->linkUp)
+        return false;
+    return target->dolbyVision == current->dolbyVision;
+}
+
+HotplugDebouncer::HotplugDebouncer(const hotplug_config_t *config, Callback *callback)
+    :mConfig(*config),
+    mCallback(callback),
+    mStarted(false),
+    mExit(false),
+    mState(HOTPLUG_STATE_IDLE),
+    mPlugged(false),
+    mForce(false),
+    mGeneration(0),
+    mLastEventNs(0),
+    mBurstStartNs(0) {
+    pthread_condattr_t attr;
+
+    pthread_mutex_init(&mLock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mCond, &attr);
+    pthread_condattr_destroy(&attr);
+    memset(&mLastTarget, 0, sizeof(mLastTarget));
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+HotplugDebouncer::~HotplugDebouncer() {
+    pthread_mutex_lock(&mLock);
+    mExit = true;
+    pthread_cond_broadcast(&mCond);
+    pthread_mutex_unlock(&mLock);
+    if (mStarted)
+        pthread_join(mThread, NULL);
+
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mLock);
+}
+
+int64_t HotplugDebouncer::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+bool HotplugDebouncer::start() {
+    if (mStarted)
+        return true;
+
+    if (pthread_create(&mThread, NULL, threadLoop, this) != 0) {
+        SYS_LOGE("Create hotplug debouncer error!\n");
+        return false;
+    }
+    mStarted = true;
+    return true;
+}
+
+void *HotplugDebouncer::threadLoop(void *data) {
+    ((HotplugDebouncer *)data)->run();
+    return NULL;
+}
+
+void HotplugDebouncer::onHotplug(bool plugged, bool force) {
+    pthread_mutex_lock(&mLock);
+    mStats.events++;
+    mPlugged = plugged;
+    mForce |= force;
+    mGeneration++;
+    mLastEventNs = now();
+    if (mBurstStartNs == 0)
+        mBurstStartNs = mLastEventNs;
+    //a compute or switch in flight sees the generation move when it is done
+    if (HOTPLUG_STATE_IDLE == mState)
+        mState = HOTPLUG_STATE_DEBOUNCE;
+    pthread_cond_broadcast(&mCond);
+    pthread_mutex_unlock(&mLock);
+}
+
+static void toTimespec(int64_t ns, struct timespec *ts) {
+    ts->tv_sec = ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+bool HotplugDebouncer::waitQuietLocked() {
+    while (!mExit) {
+        int64_t quietNs = mLastEventNs + (int64_t)mConfig.debounceMs * 1000000;
+        if (quietNs <= now())
+            return true;
+
+        struct timespec deadline;
+        toTimespec(quietNs, &deadline);
+        pthread_cond_timedwait(&mCond, &mLock, &deadline);
+    }
+    return false;
+}
+
+void HotplugDebouncer::run() {
+    int unstable = 0;
+
+    pthread_mutex_lock(&mLock);
+    while (!mExit) {
+        if (HOTPLUG_STATE_IDLE == mState) {
+            pthread_cond_wait(&mCond, &mLock);
+            continue;
+        }
+
+        if (!waitQuietLocked())
+            break;
+        mStats.bursts++;
+        uint32_t generation = mGeneration;
+        bool plugged = mPlugged;
+        mState = HOTPLUG_STATE_COMPUTE;
+        pthread_mutex_unlock(&mLock);
+
+        hotplug_target_t target;
+        memset(&target, 0, sizeof(target));
+        int64_t start = now();
+        bool stable = mCallback->computeHotplugTarget(plugged, &target);
+        target.plugged = plugged;
+
+        pthread_mutex_lock(&mLock);
+        mStats.computes++;
+        mStats.lastComputeUs = (now() - start) / 1000;
+        if (generation != mGeneration) {
+            //hpd moved while the edid was read, the newer event wins
+            mStats.coalesced++;
+            unstable = 0;
+            mState = HOTPLUG_STATE_DEBOUNCE;
+            continue;
+        }
+        if (!stable && unstable < mConfig.maxRetries) {
+            SYS_LOGI("hotplug edid changed while read, read it again\n");
+            mStats.retries++;
+            unstable++;
+            mLastEventNs = now();
+            mState = HOTPLUG_STATE_DEBOUNCE;
+            continue;
+        }
+        unstable = 0;
+        bool force = mForce;
+        mForce = false;
+        mState = HOTPLUG_STATE_SWITCH;
+        pthread_mutex_unlock(&mLock);
+
+        hotplug_target_t current;
+        memset(&current, 0, sizeof(current));
+        mCallback->getHotplugCurrent(&current);
+        bool same = !force && isSameTarget(&target, &current);
+        SYS_LOGI("hotplug %s%s target:%s %s dv:%d current:%s %s dv:%d phy:%d\n", same ? "keep" : "switch",
+            force ? " forced" : "", target.mode, target.colorAttr, target.dolbyVision,
+            current.mode, current.colorAttr, current.dolbyVision, current.linkUp);
+        if (same)
+            mCallback->onHotplugKeep(&target);
+        else
+            mCallback->onHotplugSwitch(&target);
+
+        pthread_mutex_lock(&mLock);
+        if (same)
+            mStats.kept++;
+        else
+            mStats.switches++;
+        if (force)
+            mStats.forced++;
+        mLastTarget = target;
+        if (generation == mGeneration) {
+            mStats.lastSettleUs = (now() - mBurstStartNs) / 1000;
+            mBurstStartNs = 0;
+            mState = HOTPLUG_STATE_IDLE;
+            pthread_cond_broadcast(&mCond);
+        } else {
+            //events during the switch open the next burst
+            mState = HOTPLUG_STATE_DEBOUNCE;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+bool HotplugDebouncer::waitIdle(int timeoutMs) {
+    struct timespec deadline;
+    bool idle;
+
+    toTimespec(now() + (int64_t)timeoutMs * 1000000, &deadline);
+    pthread_mutex_lock(&mLock);
+    while (HOTPLUG_STATE_IDLE != mState) {
+        if (pthread_cond_timedwait(&mCond, &mLock, &deadline) != 0)
+            break;
+    }
+    idle = HOTPLUG_STATE_IDLE == mState;
+    pthread_mutex_unlock(&mLock);
+    return idle;
+}
+
+void HotplugDebouncer::getStats(hotplug_stats_t *stats) {
+    pthread_mutex_lock(&mLock);
+    *stats = mStats;
+    pthread_mutex_unlock(&mLock);
+}
+
+int HotplugDebouncer::dump(char *result) {
+    if (NULL == result)
+        return -1;
+
+    char buf[CC_MAX_LINE_LEN] = {0};
+    pthread_mutex_lock(&mLock);
+    snprintf(buf, sizeof(buf), "\nhotplug state:%s events:%d bursts:%d computes:%d coalesced:%d retries:%d "
+        "switches:%d kept:%d forced:%d\n"
+        "hotplug last target:%s %s dv:%d compute:%lldus settle:%lldus\n",
+        sStateNames[mState], mStats.events, mStats.bursts, mStats.computes, mStats.coalesced,
+        mStats.retries, mStats.switches, mStats.kept, mStats.forced,
+        mLastTarget.mode, mLastTarget.colorAttr, mLastTarget.dolbyVision,
+        (long long)mStats.lastComputeUs, (long long)mStats.lastSettleUs);
+    pthread_mutex_unlock(&mLock);
+    strcat(result, buf);
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 debounce hdmi hotplug uevents, a burst ends in at most one mode switch
+ *  - 2 work out the target mode on a worker once the edid holds still
+ *  - 3 skip the switch when the sink wants what is already output
+ */
+
+#ifndef HOTPLUG_DEBOUNCER_H
+#define HOTPLUG_DEBOUNCER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "common.h"
+
+enum {
+    HOTPLUG_STATE_IDLE                  = 0,
+    HOTPLUG_STATE_DEBOUNCE              = 1,    //events came in, waiting for them to stop
+    HOTPLUG_STATE_COMPUTE               = 2,    //reading the edid and picking the mode
+    HOTPLUG_STATE_SWITCH                = 3,
+    HOTPLUG_STATE_TOTAL                 = 4
+};
+
+typedef struct hotplug_config {
+    //an avr powering up or a wiggled cable toggles hpd for a few 100ms
+    int debounceMs;
+    //the edid changed while it was read, read it again this many times at most
+    int maxRetries;
+} hotplug_config_t;
+
+//what the output should be, or what it is
+typedef struct hotplug_target {
+    bool plugged;                   //last hpd seen, the sink type decides the mode
+    char mode[MODE_LEN];
+    char colorAttr[MODE_LEN];       //empty for cvbs
+    bool dolbyVision;
+    bool linkUp;                    //current only, the tmds phy is on, the driver turns it off on plugout
+} hotplug_target_t;
+
+typedef struct hotplug_stats {
+    int events;
+    int bursts;                     //debounce windows that ran out
+    int computes;
+    int coalesced;                  //computes dropped for a newer event
+    int retries;                    //computes on an edid that moved
+    int switches;
+    int kept;                       //target was the current output
+    int forced;                     //bursts switched even when the output matched, as on resume
+    int64_t lastComputeUs;
+    int64_t lastSettleUs;           //first event of the burst to the output settled
+} hotplug_stats_t;
+
+class HotplugDebouncer
+{
+public:
+    class Callback {
+    public:
+        Callback() {};
+        virtual ~Callback() {};
+        //on the worker, false when the edid changed under it
+        virtual bool computeHotplugTarget(bool plugged, hotplug_target_t *target) = 0;
+        virtual void getHotplugCurrent(hotplug_target_t *current) = 0;
+        //one full mode switch, the write sequence a burst used to run per event
+        virtual void onHotplugSwitch(const hotplug_target_t *target) = 0;
+        //same output as before, the link still needs hdcp again
+        virtual void onHotplugKeep(const hotplug_target_t *target) = 0;
+    };
+
+    static const hotplug_config_t *getDefaultConfig();
+    static bool isSameTarget(const hotplug_target_t *a, const hotplug_target_t *b);
+
+    HotplugDebouncer(const hotplug_config_t *config, Callback *callback);
+    ~HotplugDebouncer();
+
+    bool start();
+    //from the uevent thread, only takes the lock
+    //force: run the full switch even if the output looks right, the driver reset it on resume
+    void onHotplug(bool plugged, bool force = false);
+    //false when still busy after timeoutMs
+    bool waitIdle(int timeoutMs);
+    void getStats(hotplug_stats_t *stats);
+    int dump(char *result);
+
+    static int64_t now();
+
+private:
+    void run();
+    //with mLock held, false when told to exit
+    bool waitQuietLocked();
+    static void *threadLoop(void *data);
+
+    hotplug_config_t mConfig;
+    Callback *mCallback;
+    pthread_t mThread;
+    bool mStarted;
+    bool mExit;
+
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;
+    int mState;
+    bool mPlugged;
+    bool mForce;                    //for the open burst
+    uint32_t mGeneration;           //bumped by every event
+    int64_t mLastEventNs;
+    int64_t mBurstStartNs;          //0 when no burst is open
+    hotplug_target_t mLastTarget;
+    hotplug_stats_t mStats;
+};
+
+#endif // HOTPLUG_DEBOUNCER_H
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 a mode switch as steps with dependencies and completion conditions
+ *  - 2 steps off the critical path run on one worker thread, in order
+ *  - 3 timeline of every step, for dumps and ordering tests
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ModeSwitchSequencer.h"
+#include "common.h"
+
+pthread_mutex_t ModeSwitchSequencer::sLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ModeSwitchSequencer::sCond = PTHREAD_COND_INITIALIZER;
+std::deque<std::function<void()> > ModeSwitchSequencer::sJobs;
+bool ModeSwitchSequencer::sWorkerStarted = false;
+bool ModeSwitchSequencer::sWorkerBusy = false;
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+ModeSwitchSequencer::ModeSwitchSequencer(const char *name)
+    :mName(name),
+    mStartNs(0),
+    mTracer(NULL),
+    mTraceId(0) {
+}
+
+ModeSwitchSequencer::~ModeSwitchSequencer() {
+}
+
+int ModeSwitchSequencer::add(const char *name, uint32_t deps, bool async, mode_switch_action_t action) {
+    int id = mSteps.size();
+
+    if (id >= MODE_SWITCH_STEPS_MAX) {
+        SYS_LOGE("%s: too many steps, %s dropped\n", mName.c_str(), name);
+        return -1;
+    }
+    for (int i = 0; i < MODE_SWITCH_STEPS_MAX; i++) {
+        if (!(deps & (1u << i)))
+            continue;
+        //the critical path never waits for the worker
+        if (i >= id || (!async && mSteps[i].async)) {
+            SYS_LOGE("%s: %s can not depend on step %d\n", mName.c_str(), name, i);
+            return -1;
+        }
+    }
+
+    step_t step;
+    step.name = name;
+    step.deps = deps;
+    step.async = async;
+    step.action = action;
+    step.batch = std::make_shared<SysfsBatch>(name);
+    step.span = std::make_shared<mode_switch_span_t>();
+    step.span->name = name;
+    step.span->async = async;
+    step.span->done = false;
+    step.span->skipped = false;
+    step.span->queuedNs = 0;
+    step.span->startNs = 0;
+    step.span->endNs = 0;
+    mSteps.push_back(step);
+    return id;
+}
+
+int ModeSwitchSequencer::addStep(const char *name, uint32_t deps, mode_switch_action_t action) {
+    return add(name, deps, false, action);
+}
+
+int ModeSwitchSequencer::addAsyncStep(const char *name, uint32_t deps, mode_switch_action_t action) {
+    return add(name, deps, true, action);
+}
+
+SysfsBatch &ModeSwitchSequencer::writes(int id) {
+    //a step that was not added still takes its writes, nothing issues them
+    static SysfsBatch sDropped("dropped step", true);
+
+    if (id < 0 || id >= (int)mSteps.size()) {
+        sDropped.clear();
+        return sDropped;
+    }
+    return *mSteps[id].batch;
+}
+
+void ModeSwitchSequencer::setTracer(ModeSwitchTracer *tracer, int traceId) {
+    mTracer = tracer;
+    mTraceId = traceId;
+}
+
+void ModeSwitchSequencer::trace(ModeSwitchTracer *tracer, int traceId, const mode_switch_span_t &span,
+        int64_t startNs, const SysfsBatch &batch) {
+    if (tracer == NULL)
+        return;
+
+    tracer->addSpan(traceId, 0, span.async, startNs + span.startNs, startNs + span.endNs, "%s", span.name);
+    const sysfs_batch_result_t &result = batch.getResult();
+    for (size_t i = 0; i < result.ops.size(); i++) {
+        const sysfs_batch_op_t &op = result.ops[i];
+        if (!op.done)
+            continue;
+
+        const char *node = strrchr(op.path.c_str(), '/');
+        node = node != NULL ? node + 1 : op.path.c_str();
+        int64_t endNs = op.startNs + op.latencyNs;
+        if (op.path.empty())
+            tracer->addSpan(traceId, 1, span.async, op.startNs, endNs, "delay %dus", op.delayUs);
+        else if (op.wait)
+            tracer->addSpan(traceId, 1, span.async, op.startNs, endNs, "wait %s %s%s", node,
+                op.value.c_str(), op.timedOut ? " timed out" : "");
+        else
+            tracer->addSpan(traceId, 1, span.async, op.startNs, endNs, "write %s %s%s", node,
+                op.value.c_str(), op.err != 0 ? " failed" : "");
+    }
+}
+
+bool ModeSwitchSequencer::run() {
+    bool stopped = false;
+    //steps that were skipped or stopped, what depends on them is skipped
+    uint32_t notDone = 0;
+
+    mStartNs = nowNs();
+    for (size_t i = 0; i < mSteps.size(); i++) {
+        step_t &step = mSteps[i];
+
+        pthread_mutex_lock(&sLock);
+        step.span->queuedNs = nowNs() - mStartNs;
+        step.span->skipped = (step.deps & notDone) || (stopped && !step.async);
+        pthread_mutex_unlock(&sLock);
+        if (step.span->skipped) {
+            notDone |= after(i);
+            continue;
+        }
+
+        if (step.async) {
+            mode_switch_action_t action = step.action;
+            std::shared_ptr<SysfsBatch> batch = step.batch;
+            std::shared_ptr<mode_switch_span_t> span = step.span;
+            int64_t startNs = mStartNs;
+            ModeSwitchTracer *tracer = mTracer;
+            int traceId = mTraceId;
+
+            post([action, batch, span, startNs, tracer, traceId]() {
+                pthread_mutex_lock(&sLock);
+                span->startNs = nowNs() - startNs;
+                pthread_mutex_unlock(&sLock);
+
+                if (!action || action())
+                    batch->commit();
+
+                pthread_mutex_lock(&sLock);
+                span->endNs = nowNs() - startNs;
+                span->done = true;
+                mode_switch_span_t done = *span;
+                pthread_mutex_unlock(&sLock);
+
+                trace(tracer, traceId, done, startNs, *batch);
+            });
+            continue;
+        }
+
+        step.span->startNs = nowNs() - mStartNs;
+        if (step.action && !step.action()) {
+            SYS_LOGI("%s: stopped at %s\n", mName.c_str(), step.name);
+            stopped = true;
+            notDone |= after(i);
+        } else {
+            step.batch->commit();
+        }
+        pthread_mutex_lock(&sLock);
+        step.span->endNs = nowNs() - mStartNs;
+        step.span->done = true;
+        pthread_mutex_unlock(&sLock);
+
+        trace(mTracer, mTraceId, *step.span, mStartNs, *step.batch);
+    }
+
+    return !stopped;
+}
+
+void ModeSwitchSequencer::post(std::function<void()> job) {
+    pthread_mutex_lock(&sLock);
+    sJobs.push_back(job);
+    if (!sWorkerStarted) {
+        pthread_t id;
+        pthread_attr_t attr;
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&id, &attr, workerLoop, NULL) == 0) {
+            sWorkerStarted = true;
+        } else {
+            //no worker, run it here rather than lose it
+            SYS_LOGE("mode switch worker create fail\n");
+            sJobs.pop_back();
+            pthread_mutex_unlock(&sLock);
+            pthread_attr_destroy(&attr);
+            job();
+            return;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    pthread_cond_broadcast(&sCond);
+    pthread_mutex_unlock(&sLock);
+}
+
+void *ModeSwitchSequencer::workerLoop(void *) {
+    pthread_mutex_lock(&sLock);
+    while (true) {
+        while (sJobs.empty())
+            pthread_cond_wait(&sCond, &sLock);
+
+        std::function<void()> job = sJobs.front();
+        sJobs.pop_front();
+        sWorkerBusy = true;
+        pthread_mutex_unlock(&sLock);
+
+        job();
+
+        pthread_mutex_lock(&sLock);
+        sWorkerBusy = false;
+        pthread_cond_broadcast(&sCond);
+    }
+    return NULL;
+}
+
+void ModeSwitchSequencer::drain() {
+    pthread_mutex_lock(&sLock);
+    while (!sJobs.empty() || sWorkerBusy)
+        pthread_cond_wait(&sCond, &sLock);
+    pthread_mutex_unlock(&sLock);
+}
+
+mode_switch_span_t ModeSwitchSequencer::getSpan(int id) const {
+    mode_switch_span_t span;
+
+    memset(&span, 0, sizeof(span));
+    if (id < 0 || id >= (int)mSteps.size())
+        return span;
+
+    pthread_mutex_lock(&sLock);
+    span = *mSteps[id].span;
+    pthread_mutex_unlock(&sLock);
+    return span;
+}
+
+std::string ModeSwitchSequencer::dump() const {
+    std::string result;
+    char line[CC_MAX_LINE_LEN];
+
+    for (size_t i = 0; i < mSteps.size(); i++) {
+        mode_switch_span_t span = getSpan(i);
+
+        if (span.skipped)
+            snprintf(line, sizeof(line), "%-20s skipped\n", span.name);
+        else if (!span.done)
+            snprintf(line, sizeof(line), "%-20s +%lldus pending%s\n", span.name,
+                (long long)span.queuedNs / 1000, span.async ? " async" : "");
+        else
+            snprintf(line, sizeof(line), "%-20s +%lldus %lldus%s\n", span.name,
+                (long long)span.startNs / 1000, (long long)(span.endNs - span.startNs) / 1000,
+                span.async ? " async" : "");
+        result += line;
+    }
+    return result;
+}
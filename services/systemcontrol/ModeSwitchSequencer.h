@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 a mode switch as steps with dependencies and completion conditions
+ *  - 2 steps off the critical path run on one worker thread, in order
+ *  - 3 timeline of every step, for dumps and ordering tests
+ */
+
+#ifndef MODE_SWITCH_SEQUENCER_H
+#define MODE_SWITCH_SEQUENCER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SysfsBatch.h"
+#include "ModeSwitchTracer.h"
+
+#define MODE_SWITCH_STEPS_MAX           32
+
+//false stops the critical path, the steps after it and whatever depends on it are skipped
+typedef std::function<bool()> mode_switch_action_t;
+
+typedef struct mode_switch_span {
+    const char *name;
+    bool async;
+    bool done;
+    bool skipped;
+    int64_t queuedNs;               //relative to the start of run()
+    int64_t startNs;
+    int64_t endNs;
+} mode_switch_span_t;
+
+class ModeSwitchSequencer
+{
+public:
+    ModeSwitchSequencer(const char *name);
+    ~ModeSwitchSequencer();
+
+    /*
+     * name must be a literal. deps is a mask of after() of earlier steps.
+     * The action runs first, then the writes and waits queued on writes(id),
+     * which are the completion condition of the step. -1 when the step can
+     * not be added. Steps start in the order they were added.
+     */
+    int addStep(const char *name, uint32_t deps, mode_switch_action_t action);
+    //runs on the worker once its deps are done, run() does not wait for it.
+    //only async steps may depend on it, and it must own what it touches
+    int addAsyncStep(const char *name, uint32_t deps, mode_switch_action_t action);
+    static uint32_t after(int id) { return id >= 0 ? 1u << id : 0; }
+    SysfsBatch &writes(int id);
+    //every step and its writes go into the trace, async ones when the worker is done
+    void setTracer(ModeSwitchTracer *tracer, int traceId);
+
+    //the critical path, returns false when a step stopped it
+    bool run();
+    //wait for the async steps of every sequencer so far
+    static void drain();
+
+    int getStepCount() const { return mSteps.size(); }
+    //copy of the span, async ones fill in while the worker runs them
+    mode_switch_span_t getSpan(int id) const;
+    //"name +start dur" lines in microseconds
+    std::string dump() const;
+
+private:
+    typedef struct step {
+        const char *name;
+        uint32_t deps;
+        bool async;
+        mode_switch_action_t action;
+        std::shared_ptr<SysfsBatch> batch;
+        std::shared_ptr<mode_switch_span_t> span;
+    } step_t;
+
+    int add(const char *name, uint32_t deps, bool async, mode_switch_action_t action);
+    static void post(std::function<void()> job);
+    static void trace(ModeSwitchTracer *tracer, int traceId, const mode_switch_span_t &span,
+        int64_t startNs, const SysfsBatch &batch);
+    //pthread entry, the job queue it drains is static, the argument is not used
+    static void *workerLoop(void *);
+
+    std::string mName;
+    std::vector<step_t> mSteps;
+    int64_t mStartNs;
+    ModeSwitchTracer *mTracer;
+    int mTraceId;
+
+    static pthread_mutex_t sLock;
+    static pthread_cond_t sCond;
+    static std::deque<std::function<void()> > sJobs;
+    static bool sWorkerStarted;
+    static bool sWorkerBusy;
+};
+
+#endif // MODE_SWITCH_SEQUENCER_H
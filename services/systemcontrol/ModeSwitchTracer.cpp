@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 ring of the last mode switches, every step and write with its time
+ *  - 2 waterfall of each switch for dumpsys
+ *  - 3 p50/p95 of the switch time per cause
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "ModeSwitchTracer.h"
+
+static const char *sCauseNames[MODE_SWITCH_CAUSE_TOTAL] = {
+    "boot",
+    "hotplug",
+    "user",
+    "dolby vision",
+    "frame rate",
+};
+
+static void append(char *result, int len, const char *fmt, ...) {
+    int used = strlen(result);
+    if (used >= len - 1)
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(result + used, len - used, fmt, ap);
+    va_end(ap);
+}
+
+static void copyText(char *dst, const char *src, int len) {
+    if (src == NULL)
+        src = "";
+    strncpy(dst, src, len - 1);
+    dst[len - 1] = '\0';
+}
+
+//nearest rank, values is sorted
+static int64_t percentile(const int64_t *values, int count, int pct) {
+    int rank = (count * pct + 99) / 100;
+    return values[rank > 0 ? rank - 1 : 0];
+}
+
+ModeSwitchTracer::ModeSwitchTracer(int64_t (*clock)())
+    :mClock(clock),
+    mNextId(1),
+    mHead(0) {
+    pthread_mutex_init(&mLock, NULL);
+    memset(mTraces, 0, sizeof(mTraces));
+    memset(mHistory, 0, sizeof(mHistory));
+    memset(mHistoryCount, 0, sizeof(mHistoryCount));
+}
+
+ModeSwitchTracer::~ModeSwitchTracer() {
+    pthread_mutex_destroy(&mLock);
+}
+
+int64_t ModeSwitchTracer::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+const char *ModeSwitchTracer::getCauseName(int cause) {
+    if (cause < 0 || cause >= MODE_SWITCH_CAUSE_TOTAL)
+        return "unknown";
+    return sCauseNames[cause];
+}
+
+int ModeSwitchTracer::begin(int cause, const char *from) {
+    pthread_mutex_lock(&mLock);
+    mode_switch_trace_t *trace = &mTraces[mHead];
+    mHead = (mHead + 1) % MODE_SWITCH_TRACES;
+
+    trace->id = mNextId++;
+    if (mNextId <= 0)
+        mNextId = 1;
+    trace->cause = cause;
+    copyText(trace->from, from, sizeof(trace->from));
+    trace->to[0] = '\0';
+    trace->startNs = mClock();
+    trace->endNs = 0;
+    trace->spanCount = 0;
+    trace->dropped = 0;
+    int id = trace->id;
+    pthread_mutex_unlock(&mLock);
+    return id;
+}
+
+mode_switch_trace_t *ModeSwitchTracer::findLocked(int id) {
+    if (id <= 0)
+        return NULL;
+    for (int i = 0; i < MODE_SWITCH_TRACES; i++) {
+        if (mTraces[i].id == id)
+            return &mTraces[i];
+    }
+    return NULL;
+}
+
+void ModeSwitchTracer::setTarget(int id, const char *to) {
+    pthread_mutex_lock(&mLock);
+    mode_switch_trace_t *trace = findLocked(id);
+    if (trace != NULL)
+        copyText(trace->to, to, sizeof(trace->to));
+    pthread_mutex_unlock(&mLock);
+}
+
+void ModeSwitchTracer::addSpan(int id, int depth, bool async, int64_t startNs, int64_t endNs, const char *fmt, ...) {
+    pthread_mutex_lock(&mLock);
+    mode_switch_trace_t *trace = findLocked(id);
+    if (trace == NULL) {
+        pthread_mutex_unlock(&mLock);
+        return;
+    }
+    if (trace->spanCount >= MODE_SWITCH_TRACE_SPANS) {
+        trace->dropped++;
+        pthread_mutex_unlock(&mLock);
+        return;
+    }
+
+    mode_switch_trace_span_t *span = &trace->spans[trace->spanCount++];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(span->label, sizeof(span->label), fmt, ap);
+    va_end(ap);
+    span->depth = depth;
+    span->async = async;
+    span->startNs = startNs;
+    span->endNs = endNs;
+    pthread_mutex_unlock(&mLock);
+}
+
+void ModeSwitchTracer::end(int id) {
+    pthread_mutex_lock(&mLock);
+    mode_switch_trace_t *trace = findLocked(id);
+    if (trace != NULL && trace->endNs == 0) {
+        trace->endNs = mClock();
+        int cause = trace->cause;
+        if (cause >= 0 && cause < MODE_SWITCH_CAUSE_TOTAL) {
+            mHistory[cause][mHistoryCount[cause] % MODE_SWITCH_HISTORY] = trace->endNs - trace->startNs;
+            mHistoryCount[cause]++;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void ModeSwitchTracer::cancel(int id) {
+    pthread_mutex_lock(&mLock);
+    mode_switch_trace_t *trace = findLocked(id);
+    if (trace != NULL) {
+        trace->id = 0;
+        //hand the slot to the next switch, unless a newer one is already in the ring
+        int slot = trace - mTraces;
+        if ((slot + 1) % MODE_SWITCH_TRACES == mHead)
+            mHead = slot;
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+bool ModeSwitchTracer::getTrace(int back, mode_switch_trace_t *trace) const {
+    bool found = false;
+
+    pthread_mutex_lock(&mLock);
+    for (int i = 1; i <= MODE_SWITCH_TRACES; i++) {
+        const mode_switch_trace_t &slot = mTraces[(mHead - i + MODE_SWITCH_TRACES) % MODE_SWITCH_TRACES];
+        if (slot.id == 0)
+            continue;
+        if (back-- == 0) {
+            memcpy(trace, &slot, sizeof(*trace));
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+    return found;
+}
+
+bool ModeSwitchTracer::getPercentiles(int cause, int64_t *p50, int64_t *p95, int *count) const {
+    int64_t values[MODE_SWITCH_HISTORY];
+    int n;
+
+    if (cause < 0 || cause >= MODE_SWITCH_CAUSE_TOTAL)
+        return false;
+
+    pthread_mutex_lock(&mLock);
+    n = mHistoryCount[cause] < MODE_SWITCH_HISTORY ? mHistoryCount[cause] : MODE_SWITCH_HISTORY;
+    memcpy(values, mHistory[cause], n * sizeof(values[0]));
+    pthread_mutex_unlock(&mLock);
+
+    if (count != NULL)
+        *count = n;
+    if (n == 0)
+        return false;
+
+    for (int i = 1; i < n; i++) {
+        int64_t v = values[i];
+        int j = i - 1;
+        for (; j >= 0 && values[j] > v; j--)
+            values[j + 1] = values[j];
+        values[j + 1] = v;
+    }
+    *p50 = percentile(values, n, 50);
+    *p95 = percentile(values, n, 95);
+    return true;
+}
+
+int ModeSwitchTracer::dump(char *result, int len) const {
+    if (NULL == result || len <= 0)
+        return -1;
+
+    append(result, len, "\nmode switch time over the last %d of each cause:\n", MODE_SWITCH_HISTORY);
+    for (int cause = 0; cause < MODE_SWITCH_CAUSE_TOTAL; cause++) {
+        int64_t p50 = 0, p95 = 0;
+        int count = 0;
+        if (getPercentiles(cause, &p50, &p95, &count))
+            append(result, len, "  %-12s n:%-3d p50:%.1fms p95:%.1fms\n", getCauseName(cause), count,
+                p50 / 1000000.0, p95 / 1000000.0);
+        else
+            append(result, len, "  %-12s n:0\n", getCauseName(cause));
+    }
+
+    //copied one at a time, a trace is a few kB
+    static mode_switch_trace_t sTrace;
+    static pthread_mutex_t sTraceLock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_lock(&sTraceLock);
+    for (int back = 0; getTrace(back, &sTrace); back++) {
+        const mode_switch_trace_t &trace = sTrace;
+        int64_t scaleNs = (trace.endNs != 0 ? trace.endNs : mClock()) - trace.startNs;
+        for (int i = 0; i < trace.spanCount; i++) {
+            if (trace.spans[i].endNs - trace.startNs > scaleNs)
+                scaleNs = trace.spans[i].endNs - trace.startNs;
+        }
+        if (scaleNs <= 0)
+            scaleNs = 1;
+
+        if (trace.endNs != 0)
+            append(result, len, "#%d %s %s -> %s %.1fms\n", trace.id, getCauseName(trace.cause),
+                trace.from, trace.to, (trace.endNs - trace.startNs) / 1000000.0);
+        else
+            append(result, len, "#%d %s %s -> %s running\n", trace.id, getCauseName(trace.cause),
+                trace.from, trace.to);
+
+        //spans are added when they end, show them by start with a step above what ran inside it
+        int order[MODE_SWITCH_TRACE_SPANS];
+        for (int i = 0; i < trace.spanCount; i++) {
+            const mode_switch_trace_span_t &span = trace.spans[i];
+            int j = i - 1;
+            for (; j >= 0; j--) {
+                const mode_switch_trace_span_t &prev = trace.spans[order[j]];
+                if (prev.startNs < span.startNs || (prev.startNs == span.startNs && prev.depth <= span.depth))
+                    break;
+                order[j + 1] = order[j];
+            }
+            order[j + 1] = i;
+        }
+
+        for (int i = 0; i < trace.spanCount; i++) {
+            const mode_switch_trace_span_t &span = trace.spans[order[i]];
+            char bar[MODE_SWITCH_BAR_LEN + 1];
+            int from = (span.startNs - trace.startNs) * MODE_SWITCH_BAR_LEN / scaleNs;
+            int to = (span.endNs - trace.startNs) * MODE_SWITCH_BAR_LEN / scaleNs;
+            if (from < 0)
+                from = 0;
+            if (to >= MODE_SWITCH_BAR_LEN)
+                to = MODE_SWITCH_BAR_LEN - 1;
+            for (int c = 0; c < MODE_SWITCH_BAR_LEN; c++)
+                bar[c] = (c >= from && c <= to) ? '#' : ' ';
+            bar[MODE_SWITCH_BAR_LEN] = '\0';
+
+            append(result, len, "  %8.1fms %7.1fms |%s| %*s%s%s\n",
+                (span.startNs - trace.startNs) / 1000000.0, (span.endNs - span.startNs) / 1000000.0,
+                bar, span.depth * 2, "", span.label, span.async ? " async" : "");
+        }
+        if (trace.dropped > 0)
+            append(result, len, "  %d spans dropped\n", trace.dropped);
+    }
+    pthread_mutex_unlock(&sTraceLock);
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 ring of the last mode switches, every step and write with its time
+ *  - 2 waterfall of each switch for dumpsys
+ *  - 3 p50/p95 of the switch time per cause
+ */
+
+#ifndef MODE_SWITCH_TRACER_H
+#define MODE_SWITCH_TRACER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define MODE_SWITCH_TRACES              8
+#define MODE_SWITCH_TRACE_SPANS         48
+#define MODE_SWITCH_LABEL_LEN           40
+#define MODE_SWITCH_TRACE_MODE_LEN      24
+#define MODE_SWITCH_HISTORY             32
+//columns of the waterfall bar
+#define MODE_SWITCH_BAR_LEN             24
+
+enum {
+    MODE_SWITCH_CAUSE_BOOT              = 0,
+    MODE_SWITCH_CAUSE_HOTPLUG           = 1,
+    MODE_SWITCH_CAUSE_USER              = 2,
+    MODE_SWITCH_CAUSE_DOLBY_VISION      = 3,
+    MODE_SWITCH_CAUSE_FRAME_RATE        = 4,
+    MODE_SWITCH_CAUSE_TOTAL             = 5
+};
+
+typedef struct mode_switch_trace_span {
+    char label[MODE_SWITCH_LABEL_LEN];
+    int depth;                      //0 for a step, 1 for what runs inside it
+    bool async;                     //ran on the worker, may end after the switch
+    int64_t startNs;                //CLOCK_MONOTONIC
+    int64_t endNs;
+} mode_switch_trace_span_t;
+
+typedef struct mode_switch_trace {
+    int id;                         //0 for a free slot
+    int cause;
+    char from[MODE_SWITCH_TRACE_MODE_LEN];
+    char to[MODE_SWITCH_TRACE_MODE_LEN];
+    int64_t startNs;
+    int64_t endNs;                  //0 until end()
+    int spanCount;
+    int dropped;                    //spans that did not fit
+    mode_switch_trace_span_t spans[MODE_SWITCH_TRACE_SPANS];
+} mode_switch_trace_t;
+
+class ModeSwitchTracer
+{
+public:
+    //clock gives the begin and end times, now() unless a test steps its own
+    ModeSwitchTracer(int64_t (*clock)() = now);
+    ~ModeSwitchTracer();
+
+    static int64_t now();
+    static const char *getCauseName(int cause);
+
+    /*
+     * Nothing below allocates, a switch takes the oldest slot and the labels
+     * are formatted into it. Ids are never 0, calls with an id whose slot was
+     * taken again are dropped.
+     */
+    int begin(int cause, const char *from);
+    void setTarget(int id, const char *to);
+    void addSpan(int id, int depth, bool async, int64_t startNs, int64_t endNs, const char *fmt, ...)
+        __attribute__((format(printf, 7, 8)));
+    //counts the switch in the percentiles of its cause
+    void end(int id);
+    //the switch did nothing, free its slot
+    void cancel(int id);
+
+    //back 0 is the newest trace, false when there is none
+    bool getTrace(int back, mode_switch_trace_t *trace) const;
+    //switch time in ns over the last MODE_SWITCH_HISTORY of the cause, false without any
+    bool getPercentiles(int cause, int64_t *p50, int64_t *p95, int *count) const;
+
+    //appends to result, never past len bytes in total
+    int dump(char *result, int len) const;
+
+private:
+    mode_switch_trace_t *findLocked(int id);
+
+    int64_t (*mClock)();
+    mutable pthread_mutex_t mLock;
+    mode_switch_trace_t mTraces[MODE_SWITCH_TRACES];
+    int mNextId;
+    int mHead;                      //slot of the next trace
+    int64_t mHistory[MODE_SWITCH_CAUSE_TOTAL][MODE_SWITCH_HISTORY];
+    int mHistoryCount[MODE_SWITCH_CAUSE_TOTAL];
+};
+
+#endif // MODE_SWITCH_TRACER_H
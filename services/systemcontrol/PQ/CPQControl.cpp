@@ -22,6 +22,7 @@
 #include <pthread.h>
 #include <errno.h>
 #include <dlfcn.h>
+#include <utils/Timers.h>
 
 #include "CPQControl.h"
 #include "TvServerHidlClient.h"
@@ -41,6 +42,7 @@ CPQControl::CPQControl()
     mInitialized = false;
     mAmvideoFd = -1;
     mDiFd = -1;
+    mVframeChanges = 0;
     //Load config file
     mPQConfigFile = CConfigFile::GetInstance();
     mPQConfigFile->LoadFromFile(PQ_CONFIG_DEFAULT_PATH);
@@ -256,6 +258,12 @@ int CPQControl::AFEDeviceIOCtl ( int request, ... )
 
 void CPQControl::onVframeSizeChange()
 {
+    {
+        Mutex::Autolock _l(mVframeLock);
+        mVframeChanges++;
+        mVframeCond.broadcast();
+    }
+
     source_input_param_t SourceInputParam = GetCurrentSourceInputInfo();
     if (SourceInputParam.source_input == SOURCE_DTV) {
         //set DTV port signal info
@@ -276,6 +284,27 @@ void CPQControl::onVframeSizeChange()
     }
 }
 
+unsigned int CPQControl::getVframeSizeChanges()
+{
+    Mutex::Autolock _l(mVframeLock);
+    return mVframeChanges;
+}
+
+bool CPQControl::waitVframeSizeChange(unsigned int *seen, int timeoutMs)
+{
+    Mutex::Autolock _l(mVframeLock);
+    nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + milliseconds(timeoutMs);
+
+    while (mVframeChanges == *seen) {
+        nsecs_t left = deadline - systemTime(SYSTEM_TIME_MONOTONIC);
+        if (left <= 0)
+            return false;
+        mVframeCond.waitRelative(mVframeLock, left);
+    }
+    *seen = mVframeChanges;
+    return true;
+}
+
 tvin_sig_fmt_t CPQControl::getVideoResolutionToFmt()
 {
     int fd = -1;
@@ -106,6 +106,10 @@ public:
     static CPQControl *GetInstance();
     virtual void onVframeSizeChange();
     virtual void onHDRStatusChange();
+    //the vframe size changes the poll thread saw, amvideo_poll has only one flag for all pollers
+    unsigned int getVframeSizeChanges();
+    //true once the count is past *seen, which it moves up, false after timeoutMs
+    bool waitVframeSizeChange(unsigned int *seen, int timeoutMs);
     virtual void resetAllUserSettingParam();
     virtual void Set_Backlight(int value);
     virtual void GetDynamicBacklighConfig(int *thtf, int *lut_mode, int *heigh_param, int *low_param);
@@ -366,6 +370,9 @@ private:
     SSMAction *mSSMAction;
     static CPQControl *mInstance;
     CDevicePollCheckThread mCDevicePollCheckThread;
+    Mutex mVframeLock;
+    Condition mVframeCond;
+    unsigned int mVframeChanges;
     CDynamicBackLight mDynamicBackLight;
     CConfigFile *mPQConfigFile;
 
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 keep the prop_info and serial of the properties read lately
+ *  - 2 read the value again only when its serial changed
+ *  - 3 parse int, long and boolean values once per change
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+#include <stdlib.h>
+#include <string.h>
+#include "PropertyCache.h"
+
+#if defined(__BIONIC__)
+#include <sys/system_properties.h>
+#endif
+
+#define PARSED_INT      0x01
+#define PARSED_LONG     0x02
+#define PARSED_BOOL     0x04
+
+#if defined(__BIONIC__)
+static int bionicRead(const prop_info *pi, char *value) {
+    return __system_property_read(pi, NULL, value);
+}
+
+static const property_backend_t sBionicBackend = {
+    __system_property_find,
+    __system_property_serial,
+    bionicRead,
+    __system_property_area_serial,
+    __system_property_wait,
+};
+#endif
+
+PropertyCache *PropertyCache::mInstance = NULL;
+
+PropertyCache *PropertyCache::getInstance() {
+    static pthread_mutex_t instanceLock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&instanceLock);
+    if (mInstance == NULL)
+        mInstance = new PropertyCache(getDefaultBackend());
+    pthread_mutex_unlock(&instanceLock);
+    return mInstance;
+}
+
+const property_backend_t *PropertyCache::getDefaultBackend() {
+#if defined(__BIONIC__)
+    return &sBionicBackend;
+#else
+    return NULL;
+#endif
+}
+
+PropertyCache::PropertyCache(const property_backend_t *backend)
+    :mBackend(backend),
+    mBuckets(PROPERTY_CACHE_BUCKETS, (Entry *)NULL),
+    mLruHead(NULL),
+    mLruTail(NULL),
+    mCapacity(PROPERTY_CACHE_CAPACITY) {
+    pthread_mutex_init(&mLock, NULL);
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+PropertyCache::~PropertyCache() {
+    for (size_t i = 0; i < mBuckets.size(); i++) {
+        Entry *entry = mBuckets[i];
+        while (entry != NULL) {
+            Entry *next = entry->next;
+            delete entry;
+            entry = next;
+        }
+    }
+    pthread_mutex_destroy(&mLock);
+}
+
+static uint32_t hashName(const char *name) {
+    uint32_t hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+//called with mLock held
+void PropertyCache::unlinkLru(Entry *entry) {
+    if (entry->lruPrev != NULL)
+        entry->lruPrev->lruNext = entry->lruNext;
+    else
+        mLruHead = entry->lruNext;
+    if (entry->lruNext != NULL)
+        entry->lruNext->lruPrev = entry->lruPrev;
+    else
+        mLruTail = entry->lruPrev;
+    entry->lruPrev = NULL;
+    entry->lruNext = NULL;
+}
+
+//called with mLock held, drops the least recently read entry
+void PropertyCache::evict() {
+    Entry *entry = mLruTail;
+    Entry **link = &mBuckets[entry->hash % mBuckets.size()];
+
+    while (*link != entry)
+        link = &(*link)->next;
+    *link = entry->next;
+    unlinkLru(entry);
+    delete entry;
+    mStats.entries--;
+    mStats.evictions++;
+}
+
+//called with mLock held, the entry stays valid until mLock is released
+PropertyCache::Entry *PropertyCache::lookup(const char *key) {
+    uint32_t hash = hashName(key);
+    Entry **bucket = &mBuckets[hash % mBuckets.size()];
+
+    for (Entry *entry = *bucket; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && entry->name == key) {
+            if (entry != mLruHead) {
+                unlinkLru(entry);
+                entry->lruNext = mLruHead;
+                mLruHead->lruPrev = entry;
+                mLruHead = entry;
+            }
+            return entry;
+        }
+    }
+
+    //keys made up by callers must not grow the table for ever
+    while ((int)mStats.entries >= mCapacity)
+        evict();
+
+    Entry *entry = new Entry();
+    entry->name = key;
+    entry->hash = hash;
+    entry->next = *bucket;
+    entry->pi = NULL;
+    entry->serial = 0;
+    entry->valid = false;
+    entry->len = 0;
+    entry->value[0] = '\0';
+    entry->parsed = 0;
+    *bucket = entry;
+    entry->lruPrev = NULL;
+    entry->lruNext = mLruHead;
+    if (mLruHead != NULL)
+        mLruHead->lruPrev = entry;
+    else
+        mLruTail = entry;
+    mLruHead = entry;
+    mStats.entries++;
+    return entry;
+}
+
+//called with mLock held, no syscall while the serial is unchanged
+void PropertyCache::refresh(Entry *entry) {
+    if (mBackend == NULL) {
+        entry->valid = true;
+        return;
+    }
+
+    if (entry->pi == NULL) {
+        //read before the lookup, so a property added meanwhile is found next time
+        uint32_t area = mBackend->areaSerial();
+        if (entry->valid && entry->serial == area) {
+            mStats.hits++;
+            return;
+        }
+
+        mStats.finds++;
+        entry->pi = mBackend->find(entry->name.c_str());
+        if (entry->pi == NULL) {
+            entry->serial = area;
+            entry->valid = true;
+            entry->len = 0;
+            entry->value[0] = '\0';
+            entry->parsed = 0;
+            return;
+        }
+        entry->valid = false;
+    }
+
+    uint32_t serial = mBackend->serial(entry->pi);
+    if (entry->valid && entry->serial == serial) {
+        mStats.hits++;
+        return;
+    }
+
+    //a write between the read and the serial check makes us read again
+    mStats.reads++;
+    while (true) {
+        int len = mBackend->read(entry->pi, entry->value);
+        uint32_t after = mBackend->serial(entry->pi);
+        if (after == serial) {
+            entry->len = len > 0 ? len : 0;
+            break;
+        }
+        serial = after;
+    }
+    entry->serial = serial;
+    entry->valid = true;
+    entry->parsed = 0;
+}
+
+int PropertyCache::get(const char *key, char *value, const char *def) {
+    int len;
+
+    pthread_mutex_lock(&mLock);
+    Entry *entry = lookup(key);
+    refresh(entry);
+    if (entry->len > 0) {
+        len = entry->len;
+        memcpy(value, entry->value, len + 1);
+    } else if (def != NULL) {
+        len = strlen(def);
+        if (len >= PROPERTY_CACHE_VALUE_LEN)
+            len = PROPERTY_CACHE_VALUE_LEN - 1;
+        memcpy(value, def, len);
+        value[len] = '\0';
+    } else {
+        len = 0;
+        value[0] = '\0';
+    }
+    pthread_mutex_unlock(&mLock);
+    return len;
+}
+
+int32_t PropertyCache::getInt(const char *key, int32_t def) {
+    pthread_mutex_lock(&mLock);
+    Entry *entry = lookup(key);
+    refresh(entry);
+    if (!(entry->parsed & PARSED_INT)) {
+        char *end;
+        entry->intSet = false;
+        if (entry->len > 0) {
+            entry->intValue = strtol(entry->value, &end, 0);
+            entry->intSet = end != entry->value;
+        }
+        entry->parsed |= PARSED_INT;
+    }
+    int32_t result = entry->intSet ? entry->intValue : def;
+    pthread_mutex_unlock(&mLock);
+    return result;
+}
+
+int64_t PropertyCache::getLong(const char *key, int64_t def) {
+    pthread_mutex_lock(&mLock);
+    Entry *entry = lookup(key);
+    refresh(entry);
+    if (!(entry->parsed & PARSED_LONG)) {
+        char *end;
+        entry->longSet = false;
+        if (entry->len > 0) {
+            entry->longValue = strtoll(entry->value, &end, 0);
+            entry->longSet = end != entry->value;
+        }
+        entry->parsed |= PARSED_LONG;
+    }
+    int64_t result = entry->longSet ? entry->longValue : def;
+    pthread_mutex_unlock(&mLock);
+    return result;
+}
+
+static int parseBoolean(const char *value, int len) {
+    if (len == 1) {
+        char ch = value[0];
+        if (ch == '0' || ch == 'n')
+            return 0;
+        else if (ch == '1' || ch == 'y')
+            return 1;
+    } else if (len > 1) {
+        if (!strcmp(value, "no") || !strcmp(value, "false") || !strcmp(value, "off"))
+            return 0;
+        else if (!strcmp(value, "yes") || !strcmp(value, "true") || !strcmp(value, "on"))
+            return 1;
+    }
+    return -1;
+}
+
+bool PropertyCache::getBoolean(const char *key, bool def) {
+    pthread_mutex_lock(&mLock);
+    Entry *entry = lookup(key);
+    refresh(entry);
+    if (!(entry->parsed & PARSED_BOOL)) {
+        entry->boolValue = parseBoolean(entry->value, entry->len);
+        entry->parsed |= PARSED_BOOL;
+    }
+    bool result = entry->boolValue < 0 ? def : entry->boolValue == 1;
+    pthread_mutex_unlock(&mLock);
+    return result;
+}
+
+void PropertyCache::getStats(property_cache_stats_t *stats) {
+    pthread_mutex_lock(&mLock);
+    *stats = mStats;
+    pthread_mutex_unlock(&mLock);
+}
+
+void PropertyCache::setCapacity(int capacity) {
+    pthread_mutex_lock(&mLock);
+    mCapacity = capacity > 0 ? capacity : 1;
+    while ((int)mStats.entries > mCapacity)
+        evict();
+    pthread_mutex_unlock(&mLock);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 keep the prop_info and serial of the properties read lately
+ *  - 2 read the value again only when its serial changed
+ *  - 3 parse int, long and boolean values once per change
+ */
+
+#ifndef PROPERTY_CACHE_H
+#define PROPERTY_CACHE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+//PROP_VALUE_MAX of bionic
+#define PROPERTY_CACHE_VALUE_LEN    92
+#define PROPERTY_CACHE_BUCKETS      256
+//least recently read properties go first past this
+#define PROPERTY_CACHE_CAPACITY     256
+
+struct prop_info;
+
+//the property area access, bionic on the device and a fake one in the tests
+typedef struct property_backend {
+    const prop_info *(*find)(const char *name);
+    uint32_t (*serial)(const prop_info *pi);
+    int (*read)(const prop_info *pi, char *value);
+    //changes whenever a property is added, for names not defined yet
+    uint32_t (*areaSerial)(void);
+    //__system_property_wait(), a NULL pi waits for any property to change.
+    //false on timeout, NULL where waiting is not supported
+    bool (*wait)(const prop_info *pi, uint32_t oldSerial, uint32_t *newSerial,
+        const struct timespec *timeout);
+} property_backend_t;
+
+typedef struct property_cache_stats {
+    unsigned int hits;              //value or parse result reused
+    unsigned int reads;             //value read again after its serial changed
+    unsigned int finds;             //name looked up in the property area
+    unsigned int entries;
+    unsigned int evictions;         //least recently read entry dropped for a new one
+} property_cache_stats_t;
+
+class PropertyCache
+{
+public:
+    static PropertyCache *getInstance();
+    //bionic backend, NULL where there is none
+    static const property_backend_t *getDefaultBackend();
+
+    PropertyCache(const property_backend_t *backend);
+    ~PropertyCache();
+
+    //same results as property_get() and the SysWrite parsers
+    int get(const char *key, char *value, const char *def);
+    int32_t getInt(const char *key, int32_t def);
+    int64_t getLong(const char *key, int64_t def);
+    bool getBoolean(const char *key, bool def);
+    void getStats(property_cache_stats_t *stats);
+    void setCapacity(int capacity);
+
+private:
+    struct Entry {
+        std::string name;
+        uint32_t hash;
+        Entry *next;
+        Entry *lruPrev;             //most recently read first
+        Entry *lruNext;
+        const prop_info *pi;        //NULL while the property is not defined
+        uint32_t serial;            //of pi, or the area serial while pi is NULL
+        bool valid;
+        int len;
+        char value[PROPERTY_CACHE_VALUE_LEN];
+        uint8_t parsed;             //PARSED_* results below are current
+        bool intSet;
+        int32_t intValue;
+        bool longSet;
+        int64_t longValue;
+        int boolValue;              //-1 when the value is no boolean
+    };
+
+    Entry *lookup(const char *key);
+    void refresh(Entry *entry);
+    void unlinkLru(Entry *entry);
+    void evict();
+
+    const property_backend_t *mBackend;
+    pthread_mutex_t mLock;
+    std::vector<Entry *> mBuckets;
+    Entry *mLruHead;
+    Entry *mLruTail;
+    int mCapacity;
+    property_cache_stats_t mStats;
+
+    static PropertyCache *mInstance;
+};
+
+#endif // PROPERTY_CACHE_H
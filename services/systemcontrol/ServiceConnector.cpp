@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 connect to a hal service without blocking the caller
+ *  - 2 resolve again on registration notifications and after the service died
+ *  - 3 bounded wait until the service is connected
+ */
+
+#define LOG_TAG "SystemControlClient"
+//#define LOG_NDEBUG 0
+
+#include <utils/Log.h>
+#include <time.h>
+#include <errno.h>
+#include "ServiceConnector.h"
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void deadlineAfter(struct timespec *ts, int ms) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+ServiceConnector::ServiceConnector(const char *name, service_resolve_t resolve, void *user)
+    :mName(name),
+    mResolve(resolve),
+    mUser(user),
+    mThreadStarted(false),
+    mExit(false),
+    mReady(false),
+    mPending(false),
+    mRetryMs(0),
+    mStartNs(0) {
+    pthread_condattr_t attr;
+
+    pthread_mutex_init(&mLock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mCond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    mStats.readyNs = -1;
+    mStats.connects = 0;
+    mStats.deaths = 0;
+    mStats.attempts = 0;
+}
+
+ServiceConnector::~ServiceConnector() {
+    pthread_mutex_lock(&mLock);
+    mExit = true;
+    pthread_cond_broadcast(&mCond);
+    pthread_mutex_unlock(&mLock);
+
+    if (mThreadStarted)
+        pthread_join(mThread, NULL);
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mLock);
+}
+
+void ServiceConnector::start() {
+    pthread_mutex_lock(&mLock);
+    if (mThreadStarted) {
+        pthread_mutex_unlock(&mLock);
+        return;
+    }
+    mStartNs = nowNs();
+    mThreadStarted = true;
+    pthread_mutex_unlock(&mLock);
+
+    //a service that is already up is connected before start() returns
+    resolve();
+
+    if (pthread_create(&mThread, NULL, threadLoop, this) != 0) {
+        ALOGE("%s: create connector thread fail\n", mName.c_str());
+        pthread_mutex_lock(&mLock);
+        mThreadStarted = false;
+        pthread_mutex_unlock(&mLock);
+    }
+}
+
+void ServiceConnector::onRegistered() {
+    pthread_mutex_lock(&mLock);
+    //a restarted service may register before the old one is reported dead,
+    //the death notification resolves again then
+    if (!mReady) {
+        mPending = true;
+        pthread_cond_broadcast(&mCond);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void ServiceConnector::onDied() {
+    pthread_mutex_lock(&mLock);
+    ALOGE("%s died, reconnect\n", mName.c_str());
+    mReady = false;
+    mStats.deaths++;
+    mPending = true;
+    pthread_cond_broadcast(&mCond);
+    pthread_mutex_unlock(&mLock);
+}
+
+void ServiceConnector::setRetryInterval(int ms) {
+    pthread_mutex_lock(&mLock);
+    mRetryMs = ms > 0 ? ms : 0;
+    pthread_cond_broadcast(&mCond);
+    pthread_mutex_unlock(&mLock);
+}
+
+bool ServiceConnector::isReady() {
+    pthread_mutex_lock(&mLock);
+    bool ready = mReady;
+    pthread_mutex_unlock(&mLock);
+    return ready;
+}
+
+bool ServiceConnector::waitReady(int timeoutMs) {
+    struct timespec deadline;
+
+    pthread_mutex_lock(&mLock);
+    if (timeoutMs > 0)
+        deadlineAfter(&deadline, timeoutMs);
+    while (!mReady && timeoutMs != 0) {
+        if (timeoutMs < 0) {
+            pthread_cond_wait(&mCond, &mLock);
+        } else if (pthread_cond_timedwait(&mCond, &mLock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    bool ready = mReady;
+    pthread_mutex_unlock(&mLock);
+    return ready;
+}
+
+void ServiceConnector::getStats(service_connector_stats_t *stats) {
+    pthread_mutex_lock(&mLock);
+    *stats = mStats;
+    pthread_mutex_unlock(&mLock);
+}
+
+//only the caller of start() and then the connector thread get here, never both
+void ServiceConnector::resolve() {
+    bool ok = mResolve(mUser);
+
+    pthread_mutex_lock(&mLock);
+    mStats.attempts++;
+    if (ok && !mReady) {
+        mReady = true;
+        mStats.connects++;
+        if (mStats.readyNs < 0)
+            mStats.readyNs = nowNs() - mStartNs;
+        ALOGI("%s connected after %d attempts\n", mName.c_str(), mStats.attempts);
+        pthread_cond_broadcast(&mCond);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void *ServiceConnector::threadLoop(void *data) {
+    ServiceConnector *pThiz = (ServiceConnector *)data;
+    struct timespec deadline;
+
+    pthread_mutex_lock(&pThiz->mLock);
+    while (!pThiz->mExit) {
+        if (pThiz->mPending) {
+            pThiz->mPending = false;
+            pthread_mutex_unlock(&pThiz->mLock);
+            pThiz->resolve();
+            pthread_mutex_lock(&pThiz->mLock);
+            continue;
+        }
+
+        if (!pThiz->mReady && pThiz->mRetryMs > 0) {
+            deadlineAfter(&deadline, pThiz->mRetryMs);
+            if (pthread_cond_timedwait(&pThiz->mCond, &pThiz->mLock, &deadline) == ETIMEDOUT)
+                pThiz->mPending = !pThiz->mReady;
+        } else {
+            pthread_cond_wait(&pThiz->mCond, &pThiz->mLock);
+        }
+    }
+    pthread_mutex_unlock(&pThiz->mLock);
+    return NULL;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 connect to a hal service without blocking the caller
+ *  - 2 resolve again on registration notifications and after the service died
+ *  - 3 bounded wait until the service is connected
+ */
+
+#ifndef SERVICE_CONNECTOR_H
+#define SERVICE_CONNECTOR_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+
+//look the service up once without waiting, true when it is connected now
+typedef bool (*service_resolve_t)(void *user);
+
+typedef struct service_connector_stats {
+    int64_t readyNs;                //start() to the first connect, -1 until then
+    int connects;
+    int deaths;
+    int attempts;                   //resolve calls, failed ones included
+} service_connector_stats_t;
+
+class ServiceConnector
+{
+public:
+    ServiceConnector(const char *name, service_resolve_t resolve, void *user);
+    ~ServiceConnector();
+
+    //one resolve on the caller thread, later ones run on the connector thread
+    void start();
+    //the service manager announced the service, resolve again
+    void onRegistered();
+    //the connected service died, resolve again
+    void onDied();
+    //poll while not connected, for when no notifications can be had; 0 disables
+    void setRetryInterval(int ms);
+
+    bool isReady();
+    //-1 waits forever, 0 only checks
+    bool waitReady(int timeoutMs);
+    void getStats(service_connector_stats_t *stats);
+
+private:
+    static void *threadLoop(void *data);
+    void resolve();
+
+    std::string mName;
+    service_resolve_t mResolve;
+    void *mUser;
+
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;           //mReady changed, or work for the thread
+    pthread_t mThread;
+    bool mThreadStarted;
+    bool mExit;
+    bool mReady;
+    bool mPending;                  //a resolve was asked for
+    int mRetryMs;
+    int64_t mStartNs;
+    service_connector_stats_t mStats;
+};
+
+#endif // SERVICE_CONNECTOR_H
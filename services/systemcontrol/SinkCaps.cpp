@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 parse disp_cap, dc_cap, dv_cap and hdr_cap of the sink once
+ *  - 2 answer the mode, deep color and dolby vision questions from the result
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+#include <string.h>
+#include "SinkCaps.h"
+
+#define DV_NOT_SUPPORT                  "The Rx don't support DolbyVision"
+
+static const char* DV_MODE_TYPE[] = {
+    "DV_RGB_444_8BIT",
+    "DV_YCbCr_422_12BIT",
+    "LL_YCbCr_422_12BIT",
+    "LL_RGB_444_12BIT"
+};
+
+void SinkCaps::clear() {
+    mText[0] = '\0';
+    mModeCount = 0;
+    mNative = -1;
+    mListed = 0;
+    mMentioned = 0;
+    mDcText[0] = '\0';
+    mDvSupported = false;
+    mDvCaps[0] = '\0';
+    mHdrFlags = 0;
+}
+
+void SinkCaps::parse(const char *dispCap, const char *dcCap, const char *dvCap, const char *hdrCap) {
+    clear();
+
+    if (dispCap != NULL) {
+        strncpy(mText, dispCap, MAX_STR_LEN - 1);
+        mText[MAX_STR_LEN - 1] = '\0';
+    }
+
+    //a line without its newline was cut off by the read, it is left out
+    for (const char *start = mText; *start != '\0' && mModeCount < SINK_CAPS_MODES_MAX;) {
+        const char *end = strchr(start, '\n');
+        if (end == NULL)
+            break;
+
+        int len = end - start;
+        const char *line = start;
+        bool native = len > 0 && line[len - 1] == '*';
+        start = end + 1;
+        if (native)
+            len--;
+        if (len == 0)
+            continue;
+        if (len > SINK_CAPS_NAME_LEN - 1)
+            len = SINK_CAPS_NAME_LEN - 1;
+
+        if (native && mNative < 0)
+            mNative = mModeCount;
+        sink_mode_t *mode = &mModes[mModeCount++];
+        memcpy(mode->name, line, len);
+        mode->name[len] = '\0';
+        mode->value = DisplayModeRegistry::resolutionValue(mode->name);
+        mode->smpte = strstr(mode->name, MODE_4K2KSMPTE_PREFIX) != NULL;
+        mode->uhd = mode->smpte || strstr(mode->name, "2160") != NULL;
+
+        for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
+            const char *name = DisplayModeRegistry::get(i)->name;
+            if (!strcmp(mode->name, name))
+                mListed |= 1u << i;
+            if (strstr(mode->name, name) != NULL)
+                mMentioned |= 1u << i;
+        }
+    }
+
+    if (dcCap != NULL) {
+        strncpy(mDcText, dcCap, CC_MAX_LINE_LEN - 1);
+        mDcText[CC_MAX_LINE_LEN - 1] = '\0';
+    }
+
+    //the old check, an unreadable dv_cap counts as support without modes
+    const char *dv = dvCap != NULL ? dvCap : "";
+    mDvSupported = strstr(dv, DV_NOT_SUPPORT) == NULL;
+    if (mDvSupported) {
+        for (int i = DISPLAY_MODE_TOTAL - 1; i >= 0; i--) {
+            const char *name = DisplayModeRegistry::get(i)->name;
+            if (strstr(dv, name) != NULL) {
+                strcat(mDvCaps, name);
+                strcat(mDvCaps, ",");
+                break;
+            }
+        }
+        for (size_t i = 0; i < sizeof(DV_MODE_TYPE) / sizeof(DV_MODE_TYPE[0]); i++) {
+            if (strstr(dv, DV_MODE_TYPE[i]) != NULL) {
+                strcat(mDvCaps, DV_MODE_TYPE[i]);
+                strcat(mDvCaps, ",");
+            }
+        }
+    }
+
+    if (hdrCap != NULL) {
+        if (strstr(hdrCap, "2084: 1") != NULL)
+            mHdrFlags |= SINK_HDR_HDR10;
+        if (strstr(hdrCap, "Log-Gamma: 1") != NULL)
+            mHdrFlags |= SINK_HDR_HLG;
+    }
+}
+
+const sink_mode_t *SinkCaps::getMode(int index) const {
+    if (index < 0 || index >= mModeCount)
+        return NULL;
+    return &mModes[index];
+}
+
+int SinkCaps::findMode(const char *mode) const {
+    const display_mode_record_t *record = DisplayModeRegistry::find(mode);
+    return record != NULL ? record->index : -1;
+}
+
+bool SinkCaps::hasMode(const char *mode) const {
+    int index = findMode(mode);
+    if (index >= 0)
+        return (mListed & (1u << index)) != 0;
+
+    for (int i = 0; i < mModeCount; i++) {
+        if (!strcmp(mModes[i].name, mode))
+            return true;
+    }
+    return false;
+}
+
+bool SinkCaps::acceptsMode(const char *mode) const {
+    for (int i = 0; i < mModeCount; i++) {
+        if (!strncmp(mModes[i].name, mode, strlen(mModes[i].name)))
+            return true;
+    }
+    return false;
+}
+
+bool SinkCaps::mentionsMode(const char *mode) const {
+    int index = findMode(mode);
+    if (index >= 0)
+        return (mMentioned & (1u << index)) != 0;
+
+    for (int i = 0; i < mModeCount; i++) {
+        if (strstr(mModes[i].name, mode) != NULL)
+            return true;
+    }
+    return false;
+}
+
+const char *SinkCaps::getNativeMode() const {
+    return mNative >= 0 ? mModes[mNative].name : "";
+}
+
+void SinkCaps::getHighest(const char *def, bool support4k, bool supportOver4k30, char *mode) const {
+    const char *best = def;
+    int64_t bestValue = DisplayModeRegistry::resolutionValue(def);
+    int64_t limit = DisplayModeRegistry::resolutionValue(MODE_4K2K30HZ);
+
+    for (int i = 0; i < mModeCount; i++) {
+        const sink_mode_t *sink = &mModes[i];
+
+        if (!support4k && sink->uhd) {
+            SYS_LOGE("This platform not support : %s\n", sink->name);
+            continue;
+        }
+        if (!supportOver4k30 && (sink->value > limit || sink->smpte)) {
+            SYS_LOGE("This platform not support the mode over 2160p30hz, current mode is:[%s]\n", sink->name);
+            continue;
+        }
+        if (sink->value > bestValue) {
+            bestValue = sink->value;
+            best = sink->name;
+        }
+    }
+    strcpy(mode, best);
+}
+
+bool SinkCaps::hasDeepColor(const char *color) const {
+    return strstr(mDcText, color) != NULL;
+}
+
+const char *SinkCaps::getDolbyVisionType(int type) {
+    if (type < 0 || type >= (int)(sizeof(DV_MODE_TYPE) / sizeof(DV_MODE_TYPE[0])))
+        return NULL;
+    return DV_MODE_TYPE[type];
+}
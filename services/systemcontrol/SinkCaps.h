@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 parse disp_cap, dc_cap, dv_cap and hdr_cap of the sink once
+ *  - 2 answer the mode, deep color and dolby vision questions from the result
+ */
+
+#ifndef SINK_CAPS_H
+#define SINK_CAPS_H
+
+#include <stdint.h>
+#include "common.h"
+#include "DisplayModeRegistry.h"
+
+#define SINK_CAPS_MODES_MAX             64
+#define SINK_CAPS_NAME_LEN              32
+#define SINK_CAPS_DV_LEN                256
+
+#define SINK_HDR_HDR10                  0x01
+#define SINK_HDR_HLG                    0x02
+
+typedef struct sink_mode {
+    char name[SINK_CAPS_NAME_LEN];  //without the '*' of the native mode
+    int64_t value;                  //resolution_num, 0 outside the mode list
+    bool uhd;                       //a 2160 or smpte mode
+    bool smpte;
+} sink_mode_t;
+
+class SinkCaps
+{
+public:
+    //plain data so it can sit in hdmi_data_t, clear() or parse() before use
+    void clear();
+    //the text of the sysfs nodes, any of them can be NULL
+    void parse(const char *dispCap, const char *dcCap, const char *dvCap, const char *hdrCap);
+
+    //disp_cap as it was read
+    const char *getText() const { return mText; }
+    int getModeCount() const { return mModeCount; }
+    const sink_mode_t *getMode(int index) const;
+
+    //listed as it is
+    bool hasMode(const char *mode) const;
+    //a listed mode the given one starts with, a saved mode can carry a deep color suffix
+    bool acceptsMode(const char *mode) const;
+    //a listed mode contains it, as strstr() on the disp_cap text
+    bool mentionsMode(const char *mode) const;
+    //the mode marked with '*', "" when the sink marks none
+    const char *getNativeMode() const;
+    //highest resolution_num of the list, def when none beats it
+    void getHighest(const char *def, bool support4k, bool supportOver4k30, char *mode) const;
+
+    const char *getDeepColorText() const { return mDcText; }
+    bool hasDeepColorList() const { return mDcText[0] != '\0'; }
+    bool hasDeepColor(const char *color) const;
+
+    bool isDolbyVisionSupported() const { return mDvSupported; }
+    //highest dolby vision mode and types, as "2160p60hz,DV_RGB_444_8BIT,"
+    const char *getDolbyVisionCaps() const { return mDvCaps; }
+    static const char *getDolbyVisionType(int type);
+
+    int getHdrFlags() const { return mHdrFlags; }
+
+private:
+    int findMode(const char *mode) const;
+
+    char mText[MAX_STR_LEN];
+    sink_mode_t mModes[SINK_CAPS_MODES_MAX];
+    int mModeCount;
+    int mNative;
+    uint32_t mListed;               //bit per mode list index, listed as it is
+    uint32_t mMentioned;            //bit per mode list index, inside a listed mode
+
+    char mDcText[CC_MAX_LINE_LEN];
+
+    bool mDvSupported;
+    char mDvCaps[SINK_CAPS_DV_LEN];
+    int mHdrFlags;
+};
+
+#endif // SINK_CAPS_H
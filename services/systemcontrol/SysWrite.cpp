@@ -31,6 +31,10 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <SysWrite.h>
+#include <SysfsFdCache.h>
+#include <PropertyCache.h>
+#include <SysfsBatch.h>
+#include <UnifyKeySession.h>
 #include <common.h>
 
 #include <sys/ioctl.h>
@@ -38,14 +42,19 @@
 
 
 SysWrite::SysWrite()
-    :mLogLevel(LOG_LEVEL_DEFAULT){
+    :mLogLevel(LOG_LEVEL_DEFAULT) {
+    pthread_mutex_init(&mKeyLock, NULL);
 }
 
 SysWrite::~SysWrite() {
+    for (std::map<std::string, UnifyKeySession *>::iterator it = mKeySessions.begin();
+        it != mKeySessions.end(); ++it)
+        delete it->second;
+    pthread_mutex_destroy(&mKeyLock);
 }
 
 bool SysWrite::getProperty(const char *key, char *value){
-    property_get(key, value, "");
+    PropertyCache::getInstance()->get(key, value, "");
     /*
     char buf[PROPERTY_VALUE_MAX] = {0};
     property_get(key, buf, "");
@@ -55,67 +64,21 @@ bool SysWrite::getProperty(const char *key, char *value){
 }
 
 bool SysWrite::getPropertyString(const char *key, char *value,  const char *def){
-    property_get(key, value, def);
+    PropertyCache::getInstance()->get(key, value, def);
     return true;
 }
 
+//parsed once per change of the property, see PropertyCache
 int32_t SysWrite::getPropertyInt(const char *key, int32_t def){
-    int len;
-    char* end;
-    char buf[PROPERTY_VALUE_MAX] = {0};
-    int32_t result = def;
-
-    len = property_get(key, buf, "");
-    if (len > 0) {
-        result = strtol(buf, &end, 0);
-        if (end == buf) {
-            result = def;
-        }
-    }
-
-    return result;
+    return PropertyCache::getInstance()->getInt(key, def);
 }
 
 int64_t SysWrite::getPropertyLong(const char *key, int64_t def){
-
-    int len;
-    char buf[PROPERTY_VALUE_MAX] = {0};
-    char* end;
-    int64_t result = def;
-
-    len = property_get(key, buf, "");
-    if (len > 0) {
-        result = strtoll(buf, &end, 0);
-        if (end == buf) {
-            result = def;
-        }
-    }
-
-    return result;
+    return PropertyCache::getInstance()->getLong(key, def);
 }
 
 bool SysWrite::getPropertyBoolean(const char *key, bool def){
-
-    int len;
-    char buf[PROPERTY_VALUE_MAX] = {0};
-    bool result = def;
-
-    len = property_get(key, buf, "");
-    if (len == 1) {
-        char ch = buf[0];
-        if (ch == '0' || ch == 'n')
-            result = false;
-        else if (ch == '1' || ch == 'y')
-            result = true;
-    } else if (len > 1) {
-         if (!strcmp(buf, "no") || !strcmp(buf, "false") || !strcmp(buf, "off")) {
-            result = false;
-        } else if (!strcmp(buf, "yes") || !strcmp(buf, "true") || !strcmp(buf, "on")) {
-            result = true;
-        }
-    }
-
-    return result;
+    return PropertyCache::getInstance()->getBoolean(key, def);
 }
 
 void SysWrite::setProperty(const char *key, const char *value){
@@ -176,6 +139,50 @@ bool SysWrite::writeSysfs(const char *path, const char *value, const int size){
     return true;
 }
 
+int SysWrite::readSysfsBatch(const std::vector<std::string>& paths, std::vector<std::string>& values) {
+    char buf[MAX_STR_LEN+1];
+    int failed = 0;
+
+    values.clear();
+    values.reserve(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        buf[0] = '\0';
+        if (!readSys(paths[i].c_str(), buf, MAX_STR_LEN, false)) {
+            buf[0] = '\0';
+            failed++;
+        }
+        values.push_back(buf);
+    }
+    return failed;
+}
+
+int SysWrite::writeSysfsBatch(const std::vector<std::string>& paths, const std::vector<std::string>& values) {
+    if (paths.size() != values.size()) {
+        SYS_LOGE("writeSysfsBatch, %d paths but %d values\n", (int)paths.size(), (int)values.size());
+        return paths.size();
+    }
+
+    //every node is opened through the fd cache first, then written back to back
+    SysfsBatch batch("writeSysfsBatch");
+    for (size_t i = 0; i < paths.size(); i++)
+        batch.add(paths[i].c_str(), values[i].c_str());
+    return batch.commit();
+}
+
+int SysWrite::getPropertyBatch(const std::vector<std::string>& keys, std::vector<std::string>& values) {
+    char buf[PROPERTY_CACHE_VALUE_LEN];
+    int unset = 0;
+
+    values.clear();
+    values.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (PropertyCache::getInstance()->get(keys[i].c_str(), buf, NULL) == 0)
+            unset++;
+        values.push_back(buf);
+    }
+    return unset;
+}
+
 bool SysWrite::writeUnifyKey(const char *path, const char *value){
     int ret;
     ret = writeUnifyKeyfs(path, value);
@@ -226,48 +233,63 @@ void SysWrite::setLogLevel(int level){
 }
 
 void SysWrite::writeSys(const char *path, const char *val){
-    int fd;
-
-    if((fd = open(path, O_RDWR)) < 0) {
-        SYS_LOGE("writeSysFs, open %s fail.", path);
-        goto exit;
-    }
-
     if (mLogLevel > LOG_LEVEL_1)
         SYS_LOGI("write %s, val:%s\n", path, val);
 
-    write(fd, val, strlen(val));
+    if (SysfsFdCache::getInstance()->write(path, val, strlen(val)) < 0)
+        SYS_LOGE("writeSysFs, write %s fail. Error info [%s]", path, strerror(errno));
 
-exit:
     SYS_LOGI("write %s, val:%s end\n", path, val);
-
-    close(fd);
 }
 
 int SysWrite::writeSys(const char *path, const char *val, const int size){
-    int fd;
-
     if (mLogLevel > LOG_LEVEL_1)
         SYS_LOGI("writeSysFs, size = %d \n", size);
 
-    if ((fd = open(path, O_WRONLY)) < 0) {
-        SYS_LOGE("writeSysFs, open %s fail.", path);
-        return -1;
-    }
-
-    if (write(fd, val, size) != size) {
+    if (SysfsFdCache::getInstance()->write(path, val, size) != size) {
         SYS_LOGE("write %s size:%d failed!\n", path, size);
         return -1;
     }
 
-    close(fd);
     return 0;
 }
 
+//called with mKeyLock held, NULL when the unifykey nodes cannot be opened
+UnifyKeySession *SysWrite::getKeySession(const char *dev) {
+    std::map<std::string, UnifyKeySession *>::iterator it = mKeySessions.find(dev);
+    if (it != mKeySessions.end()) {
+        if (it->second->isOpen())
+            return it->second;
+        delete it->second;
+        mKeySessions.erase(it);
+    }
+
+    UnifyKeySession *session = new UnifyKeySession(UNIFYKEY_DIR, dev);
+    if (session->open() < 0) {
+        delete session;
+        return NULL;
+    }
+    mKeySessions[dev] = session;
+    return session;
+}
+
 int SysWrite::readUnifyKeyfs(const char *path, char *value, int count) {
     int keyLen = 0;
     char existKey[10] = {0};
 
+    pthread_mutex_lock(&mKeyLock);
+    UnifyKeySession *session = getKeySession(UNIFYKEY_DEV);
+    if (session != NULL) {
+        std::string key;
+        if (session->read(path, key) == 0) {
+            keyLen = (int)key.size() < count ? key.size() : count;
+            memcpy(value, key.data(), keyLen);
+        }
+        pthread_mutex_unlock(&mKeyLock);
+        return keyLen;
+    }
+    pthread_mutex_unlock(&mKeyLock);
+
     writeSys(UNIFYKEY_ATTACH, "1");
     writeSys(UNIFYKEY_NAME, path);
 
@@ -294,6 +316,16 @@ int SysWrite::writeUnifyKeyfs(const char *path, const char *value) {
     int ret;
     char lock_str[10] = {0};
     int size = 0;
+
+    pthread_mutex_lock(&mKeyLock);
+    UnifyKeySession *session = getKeySession(UNIFYKEY_DEV);
+    if (session != NULL) {
+        ret = session->write(path, std::string(value));
+        pthread_mutex_unlock(&mKeyLock);
+        return ret;
+    }
+    pthread_mutex_unlock(&mKeyLock);
+
     writeSys(UNIFYKEY_ATTACH, "1");
     writeSys(UNIFYKEY_NAME, path);
     size = strlen(value);
@@ -332,6 +364,16 @@ int SysWrite::writePlayreadyKeyfs(const char *path, const char *value, const int
     char existKey[10] = {0};
     int ret;
     char lock_str[10] = {0};
+
+    pthread_mutex_lock(&mKeyLock);
+    UnifyKeySession *session = getKeySession(UNIFYKEY_DEV);
+    if (session != NULL) {
+        ret = session->write(path, std::string(value, size));
+        pthread_mutex_unlock(&mKeyLock);
+        return ret;
+    }
+    pthread_mutex_unlock(&mKeyLock);
+
     writeSys(UNIFYKEY_ATTACH, "1");
     writeSys(UNIFYKEY_NAME, path);
 
@@ -382,10 +424,22 @@ int SysWrite::readAttestationKeyfs(const char * node, const char *name, char *va
     int fp;
     int i;
     struct key_item_info_t key_item_info;
-    if ((NULL == node) || (NULL == name)) {
+    if ((NULL == node) || (NULL == name) || (NULL == value) || (size <= 0)) {
         SYS_LOGE("%s() %d: invalid param!\n", __func__, __LINE__);
         return -1;
     }
+    if (size > ATTESTATION_KEY_LEN)
+        size = ATTESTATION_KEY_LEN;
+
+    pthread_mutex_lock(&mKeyLock);
+    UnifyKeySession *session = getKeySession(node);
+    if (session != NULL) {
+        readsize = session->readDevice(name, value, size);
+        pthread_mutex_unlock(&mKeyLock);
+        return readsize;
+    }
+    pthread_mutex_unlock(&mKeyLock);
+
     SYS_LOGI("path=%s\n", node);
     fp  = open(node, O_RDWR);
     if (fp < 0) {
@@ -404,7 +458,7 @@ int SysWrite::readAttestationKeyfs(const char * node, const char *name, char *va
     dump_keyitem_info(&key_item_info);
     SYS_LOGI("size =  %d", size);
     if (key_item_info.flag) {
-        readsize = read(fp, value, key_item_info.size);
+        readsize = read(fp, value, (int)key_item_info.size < size ? (int)key_item_info.size : size);
         SYS_LOGI("readsize =  %d", readsize);
     }
 
@@ -424,6 +478,15 @@ int SysWrite::writeAttestationKeyfs(const char * node, const char *name, const c
         return -1;
     }
 
+    pthread_mutex_lock(&mKeyLock);
+    UnifyKeySession *session = getKeySession(node);
+    if (session != NULL) {
+        ret = session->writeDevice(name, buff, size);
+        pthread_mutex_unlock(&mKeyLock);
+        return ret;
+    }
+    pthread_mutex_unlock(&mKeyLock);
+
     SYS_LOGI("path=%s\n", node);
     fp  = open(node, O_RDWR);
     if (fp < 0) {
@@ -453,46 +516,34 @@ int SysWrite::writeAttestationKeyfs(const char * node, const char *name, const c
 
 
 int SysWrite::readSys(const char *path, char *buf, int count) {
-    int fd, len = -1;
+    int len = -1;
 
     if ( NULL == buf ) {
         SYS_LOGE("buf is NULL");
         return len;
     }
 
-    if ((fd = open(path, O_RDONLY)) < 0) {
-        SYS_LOGE("readSys, open %s fail. Error info [%s]", path, strerror(errno));
-        return len;
-    }
-
-    len = read(fd, buf, count);
+    len = SysfsFdCache::getInstance()->read(path, buf, count);
     if (len < 0) {
-        SYS_LOGE("read error: %s, %s\n", path, strerror(errno));
+        SYS_LOGE("readSys, read %s fail. Error info [%s]", path, strerror(errno));
     }
 
-    close(fd);
     return len;
 }
 
 
-void SysWrite::readSys(const char *path, char *buf, int count, bool needOriginalData){
-    int fd, len;
-    char *pos;
+bool SysWrite::readSys(const char *path, char *buf, int count, bool needOriginalData){
+    int len;
 
     if ( NULL == buf ) {
         SYS_LOGE("buf is NULL");
-        return;
-    }
-
-    if ((fd = open(path, O_RDONLY)) < 0) {
-        SYS_LOGE("readSysFs, open %s fail. Error info [%s]", path, strerror(errno));
-        goto exit;
+        return false;
     }
 
-    len = read(fd, buf, count);
+    len = SysfsFdCache::getInstance()->read(path, buf, count);
     if (len < 0) {
-        SYS_LOGE("read error: %s, %s\n", path, strerror(errno));
-        goto exit;
+        SYS_LOGE("readSysFs, read %s fail. Error info [%s]", path, strerror(errno));
+        return false;
     }
 
     if (!needOriginalData) {
@@ -519,9 +570,7 @@ void SysWrite::readSys(const char *path, char *buf, int count, bool needOriginal
 
     if (mLogLevel > LOG_LEVEL_1)
         SYS_LOGI("read %s, result length:%d, val:%s\n", path, len, buf);
-
-exit:
-    close(fd);
+    return true;
 }
 
 #if 0
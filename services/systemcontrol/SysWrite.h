@@ -43,6 +43,13 @@ struct key_item_info_t {
     unsigned int reserve;
 };
 
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+
+class UnifyKeySession;
+
 
 class SysWrite
 {
@@ -62,6 +69,11 @@ public:
     bool readSysfsOriginal(const char *path, char *value);
     bool writeSysfs(const char *path, const char *value);
     bool writeSysfs(const char *path, const char *value, const int size);
+    //a list in one call, values line up with paths or keys. Return the failed
+    //reads or writes, and the keys that are not set
+    int readSysfsBatch(const std::vector<std::string>& paths, std::vector<std::string>& values);
+    int writeSysfsBatch(const std::vector<std::string>& paths, const std::vector<std::string>& values);
+    int getPropertyBatch(const std::vector<std::string>& keys, std::vector<std::string>& values);
     bool writeUnifyKey(const char *path, const char *value);
     bool readUnifyKey(const char *path, char *value);
     bool writePlayreadyKey(const char *path, const char *value, const int size);
@@ -72,7 +84,7 @@ public:
 private:
     void writeSys(const char *path, const char *val);
     int writeSys(const char *path, const char *val, const int size);
-    void readSys(const char *path, char *buf, int count, bool needOriginalData);
+    bool readSys(const char *path, char *buf, int count, bool needOriginalData);
     int readUnifyKeyfs(const char *path, char *value, int count);
     int writeUnifyKeyfs(const char *path, const char *value);
     int writePlayreadyKeyfs(const char *path, const char *value, const int size);
@@ -80,8 +92,12 @@ private:
     void dump_keyitem_info(struct key_item_info_t *info);
     int readAttestationKeyfs(const char * node, const char *name, char *value, int size);
     int writeAttestationKeyfs(const char * node, const char *name, const char *buff, const int size);
+    UnifyKeySession *getKeySession(const char *dev);
 
     int mLogLevel;
+    //one per key device, keeps the unifykey nodes open between keys, guarded by mKeyLock
+    std::map<std::string, UnifyKeySession *> mKeySessions;
+    pthread_mutex_t mKeyLock;
 };
 
 #endif // SYS_WRITE_H
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 queue a sequence of sysfs writes and delays, then issue it at once
+ *  - 2 report latency and errno of every write in one result
+ *  - 3 dry run only records the sequence, for ordering tests
+ *  - 4 wait for a node to read back a state, bounded by the old fixed delay
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "SysfsBatch.h"
+#include "SysfsFdCache.h"
+#include "common.h"
+
+//first poll of a wait, doubled after every miss
+#define SYSFS_WAIT_FIRST_US             1000
+#define SYSFS_WAIT_MAX_STEP_US          8000
+
+bool SysfsBatch::sDryRunAll = false;
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+SysfsBatch::SysfsBatch(const char *name, bool dryRun)
+    :mName(name),
+    mDryRun(dryRun),
+    mAbortOnError(false) {
+    clear();
+}
+
+SysfsBatch::~SysfsBatch() {
+}
+
+void SysfsBatch::setDryRunAll(bool dryRun) {
+    sDryRunAll = dryRun;
+}
+
+void SysfsBatch::add(const char *path, const char *value) {
+    sysfs_batch_op_t op;
+
+    op.path = path;
+    op.value = value;
+    op.delayUs = 0;
+    op.wait = false;
+    op.timedOut = false;
+    op.startNs = 0;
+    op.latencyNs = 0;
+    op.err = 0;
+    op.done = false;
+    mResult.ops.push_back(op);
+}
+
+void SysfsBatch::addDelay(int us) {
+    sysfs_batch_op_t op;
+
+    op.delayUs = us;
+    op.wait = false;
+    op.timedOut = false;
+    op.startNs = 0;
+    op.latencyNs = 0;
+    op.err = 0;
+    op.done = false;
+    mResult.ops.push_back(op);
+}
+
+void SysfsBatch::addWait(const char *path, const char *value, int ceilingUs) {
+    sysfs_batch_op_t op;
+
+    op.path = path;
+    op.value = value;
+    op.delayUs = ceilingUs;
+    op.wait = true;
+    op.timedOut = false;
+    op.startNs = 0;
+    op.latencyNs = 0;
+    op.err = 0;
+    op.done = false;
+    mResult.ops.push_back(op);
+}
+
+//the node matches when it reads value followed by nothing but whitespace
+static bool readsBack(const char *path, const std::string &value, bool *readable) {
+    char buf[CC_MAX_LINE_LEN] = {0};
+    int len = SysfsFdCache::getInstance()->read(path, buf, sizeof(buf) - 1);
+
+    *readable = len >= 0;
+    if (len < (int)value.size() || strncmp(buf, value.c_str(), value.size()))
+        return false;
+    for (int i = value.size(); i < len; i++) {
+        if (buf[i] != ' ' && buf[i] != '\n' && buf[i] != '\0')
+            return false;
+    }
+    return true;
+}
+
+void SysfsBatch::wait(sysfs_batch_op_t &op) {
+    int64_t deadline = nowNs() + (int64_t)op.delayUs * 1000;
+    int stepUs = SYSFS_WAIT_FIRST_US;
+    bool readable = true;
+
+    while (!readsBack(op.path.c_str(), op.value, &readable)) {
+        int64_t leftUs = (deadline - nowNs()) / 1000;
+        if (leftUs <= 0) {
+            op.timedOut = true;
+            SYS_LOGI("%s: %s did not read %s in %dus\n", mName.c_str(), op.path.c_str(),
+                op.value.c_str(), op.delayUs);
+            return;
+        }
+        //nothing to poll, keep the old fixed delay
+        if (!readable) {
+            usleep(leftUs);
+            continue;
+        }
+        usleep(stepUs < leftUs ? stepUs : leftUs);
+        if (stepUs < SYSFS_WAIT_MAX_STEP_US)
+            stepUs *= 2;
+    }
+}
+
+void SysfsBatch::setAbortOnError(bool abort) {
+    mAbortOnError = abort;
+}
+
+int SysfsBatch::commit() {
+    SysfsFdCache *cache = SysfsFdCache::getInstance();
+    bool dryRun = mDryRun || sDryRunAll;
+    int64_t start = nowNs();
+
+    mResult.failed = 0;
+    mResult.firstFailed = -1;
+    for (size_t i = 0; i < mResult.ops.size(); i++) {
+        mResult.ops[i].err = 0;
+        mResult.ops[i].timedOut = false;
+        mResult.ops[i].done = false;
+    }
+
+    //open every node first, so the writes go out back to back
+    if (!dryRun) {
+        for (size_t i = 0; i < mResult.ops.size(); i++) {
+            if (!mResult.ops[i].path.empty())
+                cache->prepare(mResult.ops[i].path.c_str(), !mResult.ops[i].wait);
+        }
+    }
+
+    for (size_t i = 0; i < mResult.ops.size(); i++) {
+        sysfs_batch_op_t &op = mResult.ops[i];
+        int64_t opStart = nowNs();
+
+        if (mAbortOnError && mResult.failed > 0)
+            break;
+        op.startNs = opStart;
+
+        if (op.path.empty()) {
+            if (!dryRun)
+                usleep(op.delayUs);
+        } else if (op.wait) {
+            if (!dryRun)
+                wait(op);
+        } else if (!dryRun) {
+            int len = op.value.size();
+            errno = 0;
+            if (cache->write(op.path.c_str(), op.value.c_str(), len) != len) {
+                op.err = errno != 0 ? errno : EIO;
+                if (mResult.failed++ == 0)
+                    mResult.firstFailed = i;
+            }
+        }
+
+        op.latencyNs = nowNs() - opStart;
+        op.done = true;
+    }
+
+    mResult.totalNs = nowNs() - start;
+    if (mResult.failed > 0) {
+        const sysfs_batch_op_t &op = mResult.ops[mResult.firstFailed];
+        SYS_LOGE("%s: %d of %d writes failed, first %s <- %s: %s\n", mName.c_str(),
+            mResult.failed, (int)mResult.ops.size(), op.path.c_str(), op.value.c_str(),
+            strerror(op.err));
+    }
+
+    return mResult.failed;
+}
+
+const sysfs_batch_result_t &SysfsBatch::getResult() const {
+    return mResult;
+}
+
+std::string SysfsBatch::dump(bool withResult) const {
+    std::string result;
+    char line[CC_MAX_LINE_LEN];
+
+    for (size_t i = 0; i < mResult.ops.size(); i++) {
+        const sysfs_batch_op_t &op = mResult.ops[i];
+
+        if (op.path.empty())
+            snprintf(line, sizeof(line), "delay %d", op.delayUs);
+        else if (op.wait)
+            snprintf(line, sizeof(line), "wait %s %s %d", op.path.c_str(), op.value.c_str(), op.delayUs);
+        else
+            snprintf(line, sizeof(line), "write %s %s", op.path.c_str(), op.value.c_str());
+        result += line;
+
+        if (withResult) {
+            if (!op.done)
+                snprintf(line, sizeof(line), " skipped");
+            else if (op.timedOut)
+                snprintf(line, sizeof(line), " %lldus timed out", (long long)op.latencyNs / 1000);
+            else if (op.err != 0)
+                snprintf(line, sizeof(line), " %lldus %s", (long long)op.latencyNs / 1000,
+                    strerror(op.err));
+            else
+                snprintf(line, sizeof(line), " %lldus", (long long)op.latencyNs / 1000);
+            result += line;
+        }
+        result += "\n";
+    }
+
+    return result;
+}
+
+void SysfsBatch::clear() {
+    mResult.failed = 0;
+    mResult.firstFailed = -1;
+    mResult.totalNs = 0;
+    mResult.ops.clear();
+}
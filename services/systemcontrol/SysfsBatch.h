@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 queue a sequence of sysfs writes and delays, then issue it at once
+ *  - 2 report latency and errno of every write in one result
+ *  - 3 dry run only records the sequence, for ordering tests
+ *  - 4 wait for a node to read back a state, bounded by the old fixed delay
+ */
+
+#ifndef SYSFS_BATCH_H
+#define SYSFS_BATCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+typedef struct sysfs_batch_op {
+    std::string path;               //empty for a delay
+    std::string value;              //written, or waited for when wait is set
+    int delayUs;                    //the delay, or the ceiling of a wait
+    bool wait;
+    bool timedOut;                  //a wait that ran into its ceiling
+    int64_t startNs;                //CLOCK_MONOTONIC when it was issued
+    int64_t latencyNs;              //time spent in the write or the delay
+    int err;                        //errno of a failed write, 0 otherwise
+    bool done;                      //false when skipped after an abort
+} sysfs_batch_op_t;
+
+typedef struct sysfs_batch_result {
+    int failed;                     //number of failed writes
+    int firstFailed;                //index into ops, -1 when all succeeded
+    int64_t totalNs;
+    std::vector<sysfs_batch_op_t> ops;
+} sysfs_batch_result_t;
+
+class SysfsBatch
+{
+public:
+    SysfsBatch(const char *name, bool dryRun = false);
+    ~SysfsBatch();
+
+    void add(const char *path, const char *value);
+    void addDelay(int us);
+    //poll path with backoff until it reads value, at most ceilingUs, an unreadable node sleeps it all
+    void addWait(const char *path, const char *value, int ceilingUs);
+    //skip the remaining operations after the first failed write
+    void setAbortOnError(bool abort);
+    //returns the number of failed writes, details in getResult()
+    int commit();
+    const sysfs_batch_result_t &getResult() const;
+    //"write <path> <value>", "wait <path> <value> <us>" and "delay <us>" lines, with timings when asked
+    std::string dump(bool withResult) const;
+    void clear();
+
+    //every batch runs dry, for tests that record whole mode switches
+    static void setDryRunAll(bool dryRun);
+
+private:
+    void wait(sysfs_batch_op_t &op);
+
+    std::string mName;
+    bool mDryRun;
+    bool mAbortOnError;
+    sysfs_batch_result_t mResult;
+
+    static bool sDryRunAll;
+};
+
+#endif // SYSFS_BATCH_H
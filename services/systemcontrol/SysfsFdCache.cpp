@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 keep sysfs nodes open between reads and writes
+ *  - 2 read with pread() and write with pwrite() at offset 0
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "SysfsFdCache.h"
+#include "common.h"
+
+/*
+ * The unifykey nodes are a small state machine (attach, name, then read
+ * or write) that some kernels reset on release, and device nodes may
+ * carry per open state, so those keep the old open/close per access.
+ */
+static const char *const sFreshOpenNodes[] = {
+    "/sys/class/unifykeys/",
+    "/dev/",
+};
+
+SysfsFdCache *SysfsFdCache::mInstance = NULL;
+
+SysfsFdCache *SysfsFdCache::getInstance() {
+    static pthread_mutex_t instanceLock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&instanceLock);
+    if (mInstance == NULL)
+        mInstance = new SysfsFdCache();
+    pthread_mutex_unlock(&instanceLock);
+    return mInstance;
+}
+
+SysfsFdCache::SysfsFdCache()
+    :mCapacity(SYSFS_FD_CACHE_SIZE) {
+    pthread_mutex_init(&mLock, NULL);
+    memset(&mStats, 0, sizeof(mStats));
+    for (size_t i = 0; i < sizeof(sFreshOpenNodes) / sizeof(sFreshOpenNodes[0]); i++)
+        mFreshOpen.push_back(sFreshOpenNodes[i]);
+}
+
+SysfsFdCache::~SysfsFdCache() {
+    clear();
+    pthread_mutex_destroy(&mLock);
+}
+
+//a stale fd after a driver was unbound or the node went away
+static bool isStale(int err) {
+    return err == ENOENT || err == ENODEV || err == EBADF;
+}
+
+bool SysfsFdCache::isFreshOpen(const char *path) {
+    for (size_t i = 0; i < mFreshOpen.size(); i++) {
+        if (!strncmp(path, mFreshOpen[i].c_str(), mFreshOpen[i].size()))
+            return true;
+    }
+    return false;
+}
+
+//closes an entry out of the cache once no caller does i/o on it
+void SysfsFdCache::releaseEntry(Entry *entry) {
+    entry->dropped = true;
+    if (entry->refs > 0)
+        return;
+    close(entry->fd);
+    delete entry;
+}
+
+void SysfsFdCache::dropEntry(const std::string &path) {
+    std::unordered_map<std::string, Entry *>::iterator it = mEntries.find(path);
+
+    if (it == mEntries.end())
+        return;
+    Entry *entry = it->second;
+    mLru.erase(entry->lru);
+    mEntries.erase(it);
+    releaseEntry(entry);
+}
+
+SysfsFdCache::Entry *SysfsFdCache::findEntry(const std::string &path, int access) {
+    std::unordered_map<std::string, Entry *>::iterator it = mEntries.find(path);
+
+    //opened the other way, the caller reopens it
+    if (it == mEntries.end() || (it->second->access & access) != access)
+        return NULL;
+    mLru.splice(mLru.begin(), mLru, it->second->lru);
+    return it->second;
+}
+
+SysfsFdCache::Entry *SysfsFdCache::pin(const std::string &path, int access) {
+    int wanted = access;
+    bool rdwrDenied = false;
+    Entry *entry;
+    int fd = -1;
+
+    pthread_mutex_lock(&mLock);
+    entry = findEntry(path, access);
+    if (entry != NULL) {
+        entry->refs++;
+        mStats.hits++;
+        mStats.syscallsSaved += 2;
+        pthread_mutex_unlock(&mLock);
+        return entry;
+    }
+    mStats.misses++;
+    //read and written both, one fd for both unless the policy refused it before
+    std::unordered_map<std::string, Entry *>::iterator it = mEntries.find(path);
+    if (it != mEntries.end()) {
+        rdwrDenied = it->second->rdwrDenied;
+        if (!rdwrDenied)
+            wanted |= it->second->access;
+    }
+    pthread_mutex_unlock(&mLock);
+
+    //only the way the node is used, opening a read only node rw logs an avc denial
+    if (wanted == (ACCESS_READ | ACCESS_WRITE)) {
+        fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0 && (errno == EACCES || errno == EROFS || errno == EISDIR)) {
+            rdwrDenied = true;
+            wanted = access;
+        }
+    }
+    if (wanted != (ACCESS_READ | ACCESS_WRITE))
+        fd = open(path.c_str(), (wanted == ACCESS_READ ? O_RDONLY : O_WRONLY) | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    pthread_mutex_lock(&mLock);
+    //another caller opened it meanwhile
+    entry = findEntry(path, access);
+    if (entry != NULL) {
+        entry->refs++;
+        pthread_mutex_unlock(&mLock);
+        close(fd);
+        return entry;
+    }
+    dropEntry(path);
+    while ((int)mEntries.size() >= mCapacity && !mLru.empty()) {
+        dropEntry(mLru.back());
+        mStats.evictions++;
+    }
+
+    entry = new Entry();
+    entry->fd = fd;
+    entry->access = wanted;
+    entry->rdwrDenied = rdwrDenied;
+    entry->refs = 1;
+    entry->dropped = false;
+    mLru.push_front(path);
+    entry->lru = mLru.begin();
+    mEntries[path] = entry;
+    pthread_mutex_unlock(&mLock);
+    return entry;
+}
+
+void SysfsFdCache::unpin(Entry *entry) {
+    pthread_mutex_lock(&mLock);
+    entry->refs--;
+    if (entry->dropped)
+        releaseEntry(entry);
+    pthread_mutex_unlock(&mLock);
+}
+
+int SysfsFdCache::uncachedIo(const char *path, char *rbuf, const char *wbuf, int count) {
+    int fd, ret, err;
+
+    fd = open(path, (rbuf != NULL ? O_RDONLY : O_WRONLY) | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    ret = rbuf != NULL ? ::read(fd, rbuf, count) : ::write(fd, wbuf, count);
+    err = errno;
+    close(fd);
+    errno = err;
+    return ret;
+}
+
+int SysfsFdCache::io(const char *path, char *rbuf, const char *wbuf, int count) {
+    std::string key(path);
+    int access = rbuf != NULL ? ACCESS_READ : ACCESS_WRITE;
+    int ret = -1, err;
+    bool fresh;
+
+    pthread_mutex_lock(&mLock);
+    fresh = isFreshOpen(path);
+    if (fresh)
+        mStats.uncached++;
+    pthread_mutex_unlock(&mLock);
+    if (fresh)
+        return uncachedIo(path, rbuf, wbuf, count);
+
+    for (int retry = 0; retry < 2; retry++) {
+        Entry *entry = pin(key, access);
+        if (entry == NULL)
+            break;
+
+        //a slow driver show() or store() only holds up the callers of this node
+        ret = rbuf != NULL ? pread(entry->fd, rbuf, count, 0) : pwrite(entry->fd, wbuf, count, 0);
+        err = errno;
+        if (ret >= 0 || !isStale(err)) {
+            unpin(entry);
+            errno = err;
+            break;
+        }
+
+        SYS_LOGI("sysfs fd of %s is stale (%s), reopen\n", path, strerror(err));
+        pthread_mutex_lock(&mLock);
+        std::unordered_map<std::string, Entry *>::iterator it = mEntries.find(key);
+        if (it != mEntries.end() && it->second == entry) {
+            dropEntry(key);
+            mStats.reopens++;
+        }
+        pthread_mutex_unlock(&mLock);
+        unpin(entry);
+        errno = err;
+    }
+
+    return ret;
+}
+
+int SysfsFdCache::read(const char *path, char *buf, int count) {
+    return io(path, buf, NULL, count);
+}
+
+int SysfsFdCache::write(const char *path, const char *buf, int count) {
+    return io(path, NULL, buf, count);
+}
+
+int SysfsFdCache::prepare(const char *path, bool forWrite) {
+    bool fresh;
+
+    pthread_mutex_lock(&mLock);
+    fresh = isFreshOpen(path);
+    pthread_mutex_unlock(&mLock);
+    if (fresh)
+        return 0;
+
+    Entry *entry = pin(path, forWrite ? ACCESS_WRITE : ACCESS_READ);
+    if (entry == NULL)
+        return -1;
+    unpin(entry);
+    return 0;
+}
+
+void SysfsFdCache::addFreshOpenNode(const char *prefix) {
+    pthread_mutex_lock(&mLock);
+    mFreshOpen.push_back(prefix);
+    //drop what is already cached under the prefix
+    std::list<std::string>::iterator it = mLru.begin();
+    while (it != mLru.end()) {
+        std::string path = *it++;
+        if (!strncmp(path.c_str(), prefix, strlen(prefix)))
+            dropEntry(path);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void SysfsFdCache::setCapacity(int capacity) {
+    pthread_mutex_lock(&mLock);
+    mCapacity = capacity > 0 ? capacity : 1;
+    while ((int)mEntries.size() > mCapacity) {
+        dropEntry(mLru.back());
+        mStats.evictions++;
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void SysfsFdCache::invalidate(const char *path) {
+    pthread_mutex_lock(&mLock);
+    dropEntry(path);
+    pthread_mutex_unlock(&mLock);
+}
+
+void SysfsFdCache::clear() {
+    pthread_mutex_lock(&mLock);
+    while (!mLru.empty())
+        dropEntry(mLru.back());
+    pthread_mutex_unlock(&mLock);
+}
+
+void SysfsFdCache::getStats(sysfs_fd_stats_t *stats) {
+    pthread_mutex_lock(&mLock);
+    *stats = mStats;
+    pthread_mutex_unlock(&mLock);
+}
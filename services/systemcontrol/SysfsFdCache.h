@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 keep sysfs nodes open between reads and writes
+ *  - 2 read with pread() and write with pwrite() at offset 0
+ *  - 3 open only the way the node is used, the lock is never held across i/o
+ */
+
+#ifndef SYSFS_FD_CACHE_H
+#define SYSFS_FD_CACHE_H
+
+#include <pthread.h>
+#include <list>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#define SYSFS_FD_CACHE_SIZE         64
+
+typedef struct sysfs_fd_stats {
+    unsigned int hits;              //request served by a cached fd
+    unsigned int misses;            //request that had to open the node
+    unsigned int reopens;           //cached fd went stale (driver unplugged)
+    unsigned int evictions;
+    unsigned int uncached;          //request on a node in the fresh open list
+    unsigned int syscallsSaved;     //open() and close() avoided
+} sysfs_fd_stats_t;
+
+class SysfsFdCache
+{
+public:
+    static SysfsFdCache *getInstance();
+
+    //same return values as read()/write(), errno set on failure
+    int read(const char *path, char *buf, int count);
+    int write(const char *path, const char *buf, int count);
+    //open the node ahead of time, returns 0 when it is cached or uncached
+    int prepare(const char *path, bool forWrite);
+
+    //nodes whose driver only acts on open() or release() are never cached
+    void addFreshOpenNode(const char *prefix);
+    void setCapacity(int capacity);
+    void invalidate(const char *path);
+    void clear();
+    void getStats(sysfs_fd_stats_t *stats);
+
+private:
+    enum {
+        ACCESS_READ     = 1,
+        ACCESS_WRITE    = 2,
+    };
+
+    struct Entry {
+        int fd;
+        int access;                 //ACCESS_* the fd was opened for
+        bool rdwrDenied;            //O_RDWR failed, open one way at a time
+        int refs;                   //callers doing i/o on fd
+        bool dropped;               //out of the cache, closed with the last ref
+        std::list<std::string>::iterator lru;
+    };
+
+    SysfsFdCache();
+    ~SysfsFdCache();
+
+    bool isFreshOpen(const char *path);
+    //returns the entry pinned, call with mLock not held, unpin() when done
+    Entry *pin(const std::string &path, int access);
+    void unpin(Entry *entry);
+    Entry *findEntry(const std::string &path, int access);
+    void dropEntry(const std::string &path);
+    void releaseEntry(Entry *entry);
+    int io(const char *path, char *rbuf, const char *wbuf, int count);
+    int uncachedIo(const char *path, char *rbuf, const char *wbuf, int count);
+
+    static SysfsFdCache *mInstance;
+
+    pthread_mutex_t mLock;
+    int mCapacity;
+    std::unordered_map<std::string, Entry *> mEntries;
+    std::list<std::string> mLru;    //most recently used first
+    std::vector<std::string> mFreshOpen;
+    sysfs_fd_stats_t mStats;
+};
+
+#endif // SYSFS_FD_CACHE_H
@@ -744,7 +744,7 @@ status_t SystemControl::dump(int fd, const Vector<String16>& args) {
                 pDisplayMode->dump(displayInfo);
                 result.append(displayInfo);*/
 
-                char buf[4096] = {0};
+                char buf[DISPLAY_MODE_DUMP_LEN] = {0};
                 pDisplayMode->dump(buf);
                 result.append(String8(buf));
                 break;
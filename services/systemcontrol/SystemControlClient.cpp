@@ -30,20 +30,60 @@
 #include <common.h>
 
 #include <SystemControlClient.h>
+#include <hidl/ServiceManagement.h>
 
 namespace android {
 
-SystemControlClient::SystemControlClient() {
-    //mSysCtrl = ISystemControl::getService();
+//the service while connected, or return from the calling api with ret
+#define SYSCTRL_OR_RETURN(ret) \
+    sp<ISystemControl> sysCtrl = getSysCtrl(); \
+    if (sysCtrl == nullptr) \
+        return ret
+
+SystemControlClient::SystemControlClient()
+    :mFailFast(false),
+    mCallWaitMs(SYSCTRL_CALL_WAIT_MS) {
+    pthread_mutex_init(&mLock, NULL);
+    mDeathRecipient = new SystemControlDeathRecipient(this);
+    mConnector = new ServiceConnector("systemcontrol", resolveService, this);
+
+    //the service manager calls back for a running service too, and again
+    //every time systemcontrol registers after a restart
+    mNotification = new SystemControlNotification(mConnector);
+    sp<IServiceManager> manager = ::android::hardware::defaultServiceManager();
+    Return<bool> registered = false;
+    if (manager != nullptr)
+        registered = manager->registerForNotifications(ISystemControl::descriptor, "default", mNotification);
+    if (!registered.isOk() || !registered) {
+        ALOGE("register for system control service notification fail, poll instead");
+        mConnector->setRetryInterval(SYSCTRL_RETRY_MS);
+    }
+
+    mConnector->start();
+}
+
+SystemControlClient::~SystemControlClient() {
+    mNotification->detach();
+
+    pthread_mutex_lock(&mLock);
+    sp<ISystemControl> ctrl = mSysCtrl;
+    pthread_mutex_unlock(&mLock);
+    if (ctrl != nullptr)
+        ctrl->unlinkToDeath(mDeathRecipient);
+
+    //joins the connector thread, nothing resolves after this
+    delete mConnector;
+    pthread_mutex_destroy(&mLock);
+}
+
+bool SystemControlClient::resolveService(void *user) {
+    SystemControlClient *pThiz = (SystemControlClient *)user;
+
     sp<ISystemControl> ctrl = ISystemControl::tryGetService();
-    while (ctrl == nullptr) {
-         usleep(200*1000);//sleep 200ms
-         ctrl = ISystemControl::tryGetService();
-         ALOGE("tryGet system control daemon Service");
-    };
-
-    mDeathRecipient = new SystemControlDeathRecipient();
-    Return<bool> linked = ctrl->linkToDeath(mDeathRecipient, /*cookie*/ 0);
+    if (ctrl == nullptr)
+        return false;
+
+    Return<bool> linked = ctrl->linkToDeath(pThiz->mDeathRecipient, /*cookie*/ 0);
     if (!linked.isOk()) {
         LOG(ERROR) << "Transaction error in linking to system service death: " << linked.description().c_str();
     } else if (!linked) {
@@ -52,11 +92,56 @@ SystemControlClient::SystemControlClient() {
         LOG(INFO) << "Link to system service death notification successful";
     }
 
-    mSysCtrl =ctrl ;
+    pthread_mutex_lock(&pThiz->mLock);
+    pThiz->mSysCtrl = ctrl;
+    sp<ISystemControlCallback> callback = pThiz->mCallback;
+    pthread_mutex_unlock(&pThiz->mLock);
+
+    //a restarted service knows nothing of the listener set before
+    if (callback != nullptr)
+        ctrl->setCallback(callback);
+    return true;
 }
 
+void SystemControlClient::onServiceDied() {
+    pthread_mutex_lock(&mLock);
+    mSysCtrl = nullptr;
+    pthread_mutex_unlock(&mLock);
+
+    mConnector->onDied();
+}
+
+sp<ISystemControl> SystemControlClient::getSysCtrl() {
+    if (!mConnector->isReady()) {
+        if (mFailFast || !mConnector->waitReady(mCallWaitMs)) {
+            ALOGE("system control service not connected");
+            return nullptr;
+        }
+    }
+
+    pthread_mutex_lock(&mLock);
+    sp<ISystemControl> ctrl = mSysCtrl;
+    pthread_mutex_unlock(&mLock);
+    return ctrl;
+}
+
+void SystemControlClient::setConnectPolicy(bool failFast, int waitMs) {
+    mFailFast = failFast;
+    mCallWaitMs = waitMs;
+}
+
+bool SystemControlClient::waitForConnected(int timeoutMs) {
+    return mConnector->waitReady(timeoutMs);
+}
+
+bool SystemControlClient::isConnected() {
+    return mConnector->isReady();
+}
+
+
 bool SystemControlClient::getProperty(const std::string& key, std::string& value) {
-    mSysCtrl->getProperty(key, [&value](const Result &ret, const hidl_string& v) {
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->getProperty(key, [&value](const Result &ret, const hidl_string& v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -66,7 +151,8 @@ bool SystemControlClient::getProperty(const std::string& key, std::string& value
 }
 
 bool SystemControlClient::getPropertyString(const std::string& key, std::string& value, std::string& def) {
-    mSysCtrl->getPropertyString(key, def, [&value](const Result &ret, const hidl_string& v) {
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->getPropertyString(key, def, [&value](const Result &ret, const hidl_string& v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -77,7 +163,8 @@ bool SystemControlClient::getPropertyString(const std::string& key, std::string&
 
 int32_t SystemControlClient::getPropertyInt(const std::string& key, int32_t def) {
     int32_t result;
-    mSysCtrl->getPropertyInt(key, def, [&result](const Result &ret, const int32_t& v) {
+    SYSCTRL_OR_RETURN(def);
+    sysCtrl->getPropertyInt(key, def, [&result](const Result &ret, const int32_t& v) {
         if (Result::OK == ret) {
             result = v;
         }
@@ -87,7 +174,8 @@ int32_t SystemControlClient::getPropertyInt(const std::string& key, int32_t def)
 
 int64_t SystemControlClient::getPropertyLong(const std::string& key, int64_t def) {
     int64_t result;
-    mSysCtrl->getPropertyLong(key, def, [&result](const Result &ret, const int64_t& v) {
+    SYSCTRL_OR_RETURN(def);
+    sysCtrl->getPropertyLong(key, def, [&result](const Result &ret, const int64_t& v) {
         if (Result::OK == ret) {
             result = v;
         }
@@ -97,7 +185,8 @@ int64_t SystemControlClient::getPropertyLong(const std::string& key, int64_t def
 
 bool SystemControlClient::getPropertyBoolean(const std::string& key, bool def) {
     bool result;
-    mSysCtrl->getPropertyBoolean(key, def, [&result](const Result &ret, const bool& v) {
+    SYSCTRL_OR_RETURN(def);
+    sysCtrl->getPropertyBoolean(key, def, [&result](const Result &ret, const bool& v) {
         if (Result::OK == ret) {
             result = v;
         }
@@ -106,11 +195,13 @@ bool SystemControlClient::getPropertyBoolean(const std::string& key, bool def) {
 }
 
 void SystemControlClient::setProperty(const std::string& key, const std::string& value) {
-    mSysCtrl->setProperty(key, value);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setProperty(key, value);
 }
 
 bool SystemControlClient::readSysfs(const std::string& path, std::string& value) {
-    mSysCtrl->readSysfs(path, [&value](const Result &ret, const hidl_string& v) {
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->readSysfs(path, [&value](const Result &ret, const hidl_string& v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -120,7 +211,8 @@ bool SystemControlClient::readSysfs(const std::string& path, std::string& value)
 }
 
 bool SystemControlClient::writeSysfs(const std::string& path, const std::string& value) {
-    Result rtn = mSysCtrl->writeSysfs(path, value);
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->writeSysfs(path, value);
     if (rtn == Result::OK) {
         return true;
     }
@@ -138,7 +230,8 @@ bool SystemControlClient::writeSysfs(const std::string& path, const char *value,
         result[i] = 0;
     }
 
-    Result rtn = mSysCtrl->writeSysfsBin(path, result, size);
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->writeSysfsBin(path, result, size);
     if (rtn == Result::OK) {
         return true;
     }
@@ -146,7 +239,8 @@ bool SystemControlClient::writeSysfs(const std::string& path, const char *value,
 }
 
 bool SystemControlClient::writeUnifyKey(const std::string& key, const std::string& value) {
-    Result rtn = mSysCtrl->writeUnifyKey(key, value);
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->writeUnifyKey(key, value);
     if (rtn == Result::OK) {
         return true;
     }
@@ -154,7 +248,8 @@ bool SystemControlClient::writeUnifyKey(const std::string& key, const std::strin
 }
 
 bool SystemControlClient::readUnifyKey(const std::string& key, std::string& value) {
-    mSysCtrl->readUnifyKey(key, [&value](const Result &ret, const hidl_string& v) {
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->readUnifyKey(key, [&value](const Result &ret, const hidl_string& v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -174,7 +269,8 @@ bool SystemControlClient::writePlayreadyKey(const std::string& key, const char *
         result[i] = 0;
     }
 
-    Result rtn = mSysCtrl->writePlayreadyKey(key, result, size);
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->writePlayreadyKey(key, result, size);
     if (rtn == Result::OK) {
         return true;
     }
@@ -185,7 +281,8 @@ int32_t SystemControlClient::readPlayreadyKey(const std::string& key, char *valu
     hidl_array<int32_t, 4096> result;
     int32_t len;
     int j;
-    mSysCtrl->readPlayreadyKey(key, size, [&result, &len](const Result &ret, const hidl_array<int32_t, 4096> v, const int32_t& l) {
+    SYSCTRL_OR_RETURN(-1);
+    sysCtrl->readPlayreadyKey(key, size, [&result, &len](const Result &ret, const hidl_array<int32_t, 4096> v, const int32_t& l) {
         if (Result::OK == ret) {
             for (int i = 0; i < l; ++i) {
                 result[i] = v[i];
@@ -205,7 +302,8 @@ int32_t SystemControlClient::readAttestationKey(const std::string& node, const s
     hidl_array<int32_t, 10240> result;
     int32_t len;
     int j;
-    mSysCtrl->readAttestationKey(node, name, size, [&result, &len](const Result &ret, const hidl_array<int32_t, 10240> v, const int32_t& l) {
+    SYSCTRL_OR_RETURN(-1);
+    sysCtrl->readAttestationKey(node, name, size, [&result, &len](const Result &ret, const hidl_array<int32_t, 10240> v, const int32_t& l) {
         if (Result::OK == ret) {
             for (int i = 0; i < l; ++i) {
                 result[i] = v[i];
@@ -233,7 +331,8 @@ bool SystemControlClient::writeAttestationKey(const std::string& node, const std
         result[i] = 0;
     }
 
-    Result rtn = mSysCtrl->writeAttestationKey(node, name, result);
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->writeAttestationKey(node, name, result);
     if (rtn == Result::OK) {
         return true;
     }
@@ -242,7 +341,8 @@ bool SystemControlClient::writeAttestationKey(const std::string& node, const std
 
 bool SystemControlClient::checkAttestationKey() {
     LOG(INFO) << "SystemControlClient checkAttestationKey";
-    Result rtn = mSysCtrl->checkAttestationKey();
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->checkAttestationKey();
     if (rtn == Result::OK) {
         return true;
     }
@@ -253,7 +353,8 @@ int32_t SystemControlClient::readHdcpRX22Key(char *value, int size) {
     hidl_array<int32_t, 4096> result;
     int32_t len;
     int j;
-    mSysCtrl->readHdcpRX22Key(size, [&result, &len](const Result &ret, const hidl_array<int32_t, 4096> v, const int32_t& l) {
+    SYSCTRL_OR_RETURN(-1);
+    sysCtrl->readHdcpRX22Key(size, [&result, &len](const Result &ret, const hidl_array<int32_t, 4096> v, const int32_t& l) {
         if (Result::OK == ret) {
             for (int i = 0; i < l; ++i) {
                 result[i] = v[i];
@@ -280,7 +381,8 @@ bool SystemControlClient::writeHdcpRX22Key(const char *value, const int size) {
         result[i] = 0;
     }
 
-    Result rtn = mSysCtrl->writeHdcpRX22Key(result, size);
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->writeHdcpRX22Key(result, size);
     if (rtn == Result::OK) {
         return true;
     }
@@ -291,7 +393,8 @@ int32_t SystemControlClient::readHdcpRX14Key(char *value, int size) {
     hidl_array<int32_t, 4096> result;
     int32_t len;
     int j;
-    mSysCtrl->readHdcpRX14Key(size, [&result, &len](const Result &ret, const hidl_array<int32_t, 4096> v, const int32_t& l) {
+    SYSCTRL_OR_RETURN(-1);
+    sysCtrl->readHdcpRX14Key(size, [&result, &len](const Result &ret, const hidl_array<int32_t, 4096> v, const int32_t& l) {
         if (Result::OK == ret) {
             for (int i = 0; i < l; ++i) {
                 result[i] = v[i];
@@ -317,7 +420,8 @@ bool SystemControlClient::writeHdcpRX14Key(const char *value, const int size) {
     for (; i < 4096; ++i) {
         result[i] = 0;
     }
-    Result rtn = mSysCtrl->writeHdcpRX14Key(result, size);
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->writeHdcpRX14Key(result, size);
     if (rtn == Result::OK) {
         return true;
     }
@@ -325,7 +429,8 @@ bool SystemControlClient::writeHdcpRX14Key(const char *value, const int size) {
 }
 
 bool SystemControlClient::writeHdcpRXImg(const std::string& path) {
-    Result rtn = mSysCtrl->writeHdcpRXImg(path);
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->writeHdcpRXImg(path);
     if (rtn == Result::OK) {
         return true;
     }
@@ -333,7 +438,8 @@ bool SystemControlClient::writeHdcpRXImg(const std::string& path) {
 }
 
 bool SystemControlClient::getBootEnv(const std::string& key, std::string& value) {
-    mSysCtrl->getBootEnv(key, [&value](const Result &ret, const hidl_string& v) {
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->getBootEnv(key, [&value](const Result &ret, const hidl_string& v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -342,7 +448,8 @@ bool SystemControlClient::getBootEnv(const std::string& key, std::string& value)
 }
 
 void SystemControlClient::setBootEnv(const std::string& key, const std::string& value) {
-    mSysCtrl->setBootEnv(key, value);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setBootEnv(key, value);
 }
 
 void SystemControlClient::getDroidDisplayInfo(int &type __unused, std::string& socType __unused, std::string& defaultUI __unused,
@@ -367,35 +474,43 @@ void SystemControlClient::getDroidDisplayInfo(int &type __unused, std::string& s
 }
 
 void SystemControlClient::loopMountUnmount(int &isMount, const std::string& path)  {
-    mSysCtrl->loopMountUnmount(isMount, path);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->loopMountUnmount(isMount, path);
 }
 
 void SystemControlClient::setMboxOutputMode(const std::string& mode) {
-    mSysCtrl->setSourceOutputMode(mode);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setSourceOutputMode(mode);
 }
 
 void SystemControlClient::setSinkOutputMode(const std::string& mode) {
-    mSysCtrl->setSinkOutputMode(mode);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setSinkOutputMode(mode);
 }
 
 void SystemControlClient::setDigitalMode(const std::string& mode) {
-    mSysCtrl->setDigitalMode(mode);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setDigitalMode(mode);
 }
 
 void SystemControlClient::setOsdMouseMode(const std::string& mode) {
-    mSysCtrl->setOsdMouseMode(mode);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setOsdMouseMode(mode);
 }
 
 void SystemControlClient::setOsdMousePara(int x, int y, int w, int h) {
-    mSysCtrl->setOsdMousePara(x, y, w, h);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setOsdMousePara(x, y, w, h);
 }
 
 void SystemControlClient::setPosition(int left, int top, int width, int height)  {
-    mSysCtrl->setPosition(left, top, width, height);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setPosition(left, top, width, height);
 }
 
 void SystemControlClient::getPosition(const std::string& mode, int &outx, int &outy, int &outw, int &outh) {
-    mSysCtrl->getPosition(mode, [&outx, &outy, &outw, &outh](const Result &ret,
+    SYSCTRL_OR_RETURN();
+    sysCtrl->getPosition(mode, [&outx, &outy, &outw, &outh](const Result &ret,
         const int32_t& x, const int32_t& y, const int32_t& w, const int32_t& h) {
         if (Result::OK == ret) {
             outx = x;
@@ -407,11 +522,13 @@ void SystemControlClient::getPosition(const std::string& mode, int &outx, int &o
 }
 
 void SystemControlClient::saveDeepColorAttr(const std::string& mode, const std::string& dcValue) {
-    mSysCtrl->saveDeepColorAttr(mode, dcValue);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->saveDeepColorAttr(mode, dcValue);
 }
 
 void SystemControlClient::getDeepColorAttr(const std::string& mode, std::string& value) {
-    mSysCtrl->getDeepColorAttr(mode, [&value](const Result &ret, const hidl_string& v) {
+    SYSCTRL_OR_RETURN();
+    sysCtrl->getDeepColorAttr(mode, [&value](const Result &ret, const hidl_string& v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -419,12 +536,14 @@ void SystemControlClient::getDeepColorAttr(const std::string& mode, std::string&
 }
 
 void SystemControlClient::setDolbyVisionEnable(int state) {
-    mSysCtrl->setDolbyVisionState(state);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setDolbyVisionState(state);
 }
 
 bool SystemControlClient::isTvSupportDolbyVision(std::string& mode) {
     bool supported = false;
-    mSysCtrl->sinkSupportDolbyVision([&mode, &supported](const Result &ret, const hidl_string& sinkMode, const bool &isSupport) {
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->sinkSupportDolbyVision([&mode, &supported](const Result &ret, const hidl_string& sinkMode, const bool &isSupport) {
         if (Result::OK == ret) {
             mode = sinkMode;
             supported = isSupport;
@@ -436,7 +555,8 @@ bool SystemControlClient::isTvSupportDolbyVision(std::string& mode) {
 
 int32_t SystemControlClient::getDolbyVisionType() {
     int32_t result;
-    mSysCtrl->getDolbyVisionType([&result](const Result &ret, const int32_t& v) {
+    SYSCTRL_OR_RETURN(-1);
+    sysCtrl->getDolbyVisionType([&result](const Result &ret, const int32_t& v) {
         if (Result::OK == ret) {
             result = v;
         }
@@ -445,11 +565,13 @@ int32_t SystemControlClient::getDolbyVisionType() {
 }
 
 void SystemControlClient::setGraphicsPriority(const std::string& mode) {
-   mSysCtrl->setGraphicsPriority(mode);
+   SYSCTRL_OR_RETURN();
+   sysCtrl->setGraphicsPriority(mode);
 }
 
 void SystemControlClient::getGraphicsPriority(std::string& mode) {
-    mSysCtrl->getGraphicsPriority([&mode](const Result &ret, const hidl_string& tempmode) {
+    SYSCTRL_OR_RETURN();
+    sysCtrl->getGraphicsPriority([&mode](const Result &ret, const hidl_string& tempmode) {
         if (Result::OK == ret)
             mode = tempmode.c_str();
         else
@@ -463,7 +585,8 @@ void SystemControlClient::getGraphicsPriority(std::string& mode) {
 
 int64_t SystemControlClient::resolveResolutionValue(const std::string& mode) {
     int64_t value = 0;
-    mSysCtrl->resolveResolutionValue(mode, [&value](const Result &ret, const int64_t &v) {
+    SYSCTRL_OR_RETURN(0);
+    sysCtrl->resolveResolutionValue(mode, [&value](const Result &ret, const int64_t &v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -472,19 +595,28 @@ int64_t SystemControlClient::resolveResolutionValue(const std::string& mode) {
 }
 
 void SystemControlClient::setHdrMode(const std::string& mode) {
-    mSysCtrl->setHdrMode(mode);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setHdrMode(mode);
 }
 
 void SystemControlClient::setSdrMode(const std::string& mode) {
-    mSysCtrl->setSdrMode(mode);
+    SYSCTRL_OR_RETURN();
+    sysCtrl->setSdrMode(mode);
 }
 
 void SystemControlClient::setListener(const sp<ISystemControlCallback> callback) {
-    Return<void> ret = mSysCtrl->setCallback(callback);
+    pthread_mutex_lock(&mLock);
+    mCallback = callback;
+    pthread_mutex_unlock(&mLock);
+
+    //set again on every reconnect
+    SYSCTRL_OR_RETURN();
+    Return<void> ret = sysCtrl->setCallback(callback);
 }
 
 bool SystemControlClient::getSupportDispModeList(std::vector<std::string>& supportDispModes) {
-    mSysCtrl->getSupportDispModeList([&supportDispModes](const Result &ret, const hidl_vec<hidl_string> list) {
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->getSupportDispModeList([&supportDispModes](const Result &ret, const hidl_vec<hidl_string> list) {
         if (Result::OK == ret) {
             for (size_t i = 0; i < list.size(); i++) {
                 supportDispModes.push_back(list[i]);
@@ -503,7 +635,8 @@ bool SystemControlClient::getSupportDispModeList(std::vector<std::string>& suppo
 }
 
 bool SystemControlClient::getActiveDispMode(std::string& activeDispMode) {
-    mSysCtrl->getActiveDispMode([&activeDispMode](const Result &ret, const hidl_string& mode) {
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->getActiveDispMode([&activeDispMode](const Result &ret, const hidl_string& mode) {
         if (Result::OK == ret)
             activeDispMode = mode.c_str();
         else
@@ -519,7 +652,8 @@ bool SystemControlClient::getActiveDispMode(std::string& activeDispMode) {
 }
 
 bool SystemControlClient::setActiveDispMode(std::string& activeDispMode) {
-    Result rtn = mSysCtrl->setActiveDispMode(activeDispMode);
+    SYSCTRL_OR_RETURN(false);
+    Result rtn = sysCtrl->setActiveDispMode(activeDispMode);
     if (rtn == Result::OK) {
         return true;
     }
@@ -527,7 +661,8 @@ bool SystemControlClient::setActiveDispMode(std::string& activeDispMode) {
 }
 
 void SystemControlClient::isHDCPTxAuthSuccess(int &status) {
-    Result rtn = mSysCtrl->isHDCPTxAuthSuccess();
+    SYSCTRL_OR_RETURN();
+    Result rtn = sysCtrl->isHDCPTxAuthSuccess();
     if (rtn == Result::OK) {
         status = 1;
     }
@@ -538,17 +673,20 @@ void SystemControlClient::isHDCPTxAuthSuccess(int &status) {
 
 //3D
 int32_t SystemControlClient::set3DMode(const std::string& mode3d) {
-    mSysCtrl->set3DMode(mode3d);
+    SYSCTRL_OR_RETURN(-1);
+    sysCtrl->set3DMode(mode3d);
     return 0;
 }
 
 void SystemControlClient::init3DSetting(void) {
-    mSysCtrl->init3DSetting();
+    SYSCTRL_OR_RETURN();
+    sysCtrl->init3DSetting();
 }
 
 int SystemControlClient::getVideo3DFormat(void) {
     int32_t value = 0;
-    mSysCtrl->getVideo3DFormat([&value](const Result &ret, const int32_t &v) {
+    SYSCTRL_OR_RETURN(-1);
+    sysCtrl->getVideo3DFormat([&value](const Result &ret, const int32_t &v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -558,7 +696,8 @@ int SystemControlClient::getVideo3DFormat(void) {
 
 int SystemControlClient::getDisplay3DTo2DFormat(void) {
     int32_t value = 0;
-    mSysCtrl->getDisplay3DTo2DFormat([&value](const Result &ret, const int32_t &v) {
+    SYSCTRL_OR_RETURN(-1);
+    sysCtrl->getDisplay3DTo2DFormat([&value](const Result &ret, const int32_t &v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -567,18 +706,21 @@ int SystemControlClient::getDisplay3DTo2DFormat(void) {
 }
 
 bool SystemControlClient::setDisplay3DTo2DFormat(int format) {
-    mSysCtrl->setDisplay3DTo2DFormat(format);
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->setDisplay3DTo2DFormat(format);
     return true;
 }
 
 bool SystemControlClient::setDisplay3DFormat(int format) {
-    mSysCtrl->setDisplay3DFormat(format);
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->setDisplay3DFormat(format);
     return true;
 }
 
 int SystemControlClient::getDisplay3DFormat(void) {
     int32_t value = 0;
-    mSysCtrl->getDisplay3DFormat([&value](const Result &ret, const int32_t &v) {
+    SYSCTRL_OR_RETURN(-1);
+    sysCtrl->getDisplay3DFormat([&value](const Result &ret, const int32_t &v) {
         if (Result::OK == ret) {
             value = v;
         }
@@ -587,185 +729,227 @@ int SystemControlClient::getDisplay3DFormat(void) {
 }
 
 bool SystemControlClient::setOsd3DFormat(int format) {
-    mSysCtrl->setOsd3DFormat(format);
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->setOsd3DFormat(format);
     return true;
 }
 
 bool SystemControlClient::switch3DTo2D(int format) {
-    mSysCtrl->switch3DTo2D(format);
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->switch3DTo2D(format);
     return true;
 }
 
 bool SystemControlClient::switch2DTo3D(int format) {
-    mSysCtrl->switch2DTo3D(format);
+    SYSCTRL_OR_RETURN(false);
+    sysCtrl->switch2DTo3D(format);
     return true;
 }
 
 void SystemControlClient::autoDetect3DForMbox() {
-    mSysCtrl->autoDetect3DForMbox();
+    SYSCTRL_OR_RETURN();
+    sysCtrl->autoDetect3DForMbox();
 }
 //3D end
 //PQ
 int SystemControlClient::loadPQSettings(source_input_param_t srcInputParam) {
     SourceInputParam hidlSrcInput;
     memcpy(&hidlSrcInput, &srcInputParam, sizeof(source_input_param_t));
-    return mSysCtrl->loadPQSettings(hidlSrcInput);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->loadPQSettings(hidlSrcInput);
 }
 
 int SystemControlClient::setPQmode(int mode, int isSave, int is_autoswitch) {
-    return mSysCtrl->setPQmode(mode, isSave, is_autoswitch);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setPQmode(mode, isSave, is_autoswitch);
 }
 
 int SystemControlClient::getPQmode(void) {
-    return mSysCtrl->getPQmode();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getPQmode();
 }
 
 int SystemControlClient::savePQmode(int mode) {
-    return mSysCtrl->savePQmode(mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->savePQmode(mode);
 }
 
 int SystemControlClient::setColorTemperature(int mode, int isSave) {
-    return mSysCtrl->setColorTemperature(mode, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setColorTemperature(mode, isSave);
 }
 
 int SystemControlClient::getColorTemperature(void) {
-    return mSysCtrl->getColorTemperature();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getColorTemperature();
 }
 
 int SystemControlClient::saveColorTemperature(int mode) {
-    return mSysCtrl->saveColorTemperature(mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveColorTemperature(mode);
 }
 
 int SystemControlClient::setBrightness(int value, int isSave) {
-    return mSysCtrl->setBrightness(value, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setBrightness(value, isSave);
 }
 
 int SystemControlClient::getBrightness(void) {
-    return mSysCtrl->getBrightness();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getBrightness();
 }
 
 int SystemControlClient::saveBrightness(int value) {
-    return mSysCtrl->saveBrightness(value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveBrightness(value);
 }
 
 int SystemControlClient::setContrast(int value, int isSave) {
-    return mSysCtrl->setContrast(value, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setContrast(value, isSave);
 }
 
 int SystemControlClient::getContrast(void) {
-    return mSysCtrl->getContrast();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getContrast();
 }
 
 int SystemControlClient::saveContrast(int value) {
-    return mSysCtrl->saveContrast(value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveContrast(value);
 }
 
 int SystemControlClient::setSaturation(int value, int isSave) {
-    return mSysCtrl->setSaturation(value, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setSaturation(value, isSave);
 }
 
 int SystemControlClient::getSaturation(void) {
-    return mSysCtrl->getSaturation();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getSaturation();
 }
 
 int SystemControlClient::saveSaturation(int value) {
-    return mSysCtrl->saveSaturation(value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveSaturation(value);
 }
 
 int SystemControlClient::setHue(int value, int isSave) {
-    return mSysCtrl->setHue(value, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setHue(value, isSave);
 }
 
 int SystemControlClient::getHue(void) {
-    return mSysCtrl->getHue();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getHue();
 }
 
 int SystemControlClient::saveHue(int value) {
-    return mSysCtrl->saveHue(value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveHue(value);
 }
 
 int SystemControlClient::setSharpness(int value, int is_enable, int isSave) {
-    return mSysCtrl->setSharpness(value, is_enable, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setSharpness(value, is_enable, isSave);
 }
 
 int SystemControlClient::getSharpness(void) {
-    return mSysCtrl->getSharpness();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getSharpness();
 }
 
 int SystemControlClient::saveSharpness(int value) {
-    return mSysCtrl->saveSharpness(value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveSharpness(value);
 }
 
 int SystemControlClient::setNoiseReductionMode(int nr_mode, int isSave) {
-    return mSysCtrl->setNoiseReductionMode(nr_mode, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setNoiseReductionMode(nr_mode, isSave);
 }
 
 int SystemControlClient::getNoiseReductionMode(void) {
-    return mSysCtrl->getNoiseReductionMode();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getNoiseReductionMode();
 }
 
 int SystemControlClient::saveNoiseReductionMode(int nr_mode) {
-    return mSysCtrl->saveNoiseReductionMode(nr_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveNoiseReductionMode(nr_mode);
 }
 
 int SystemControlClient::setEyeProtectionMode(int source_input, int enable, int isSave) {
-    return mSysCtrl->setEyeProtectionMode(source_input, enable, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setEyeProtectionMode(source_input, enable, isSave);
 }
 
 int SystemControlClient::getEyeProtectionMode(int source_input) {
-    return mSysCtrl->getEyeProtectionMode(source_input);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getEyeProtectionMode(source_input);
 }
 
 int SystemControlClient::setGammaValue(int gamma_curve, int isSave) {
-    return mSysCtrl->setGammaValue(gamma_curve, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setGammaValue(gamma_curve, isSave);
 }
 
 int SystemControlClient::getGammaValue(void) {
-    return mSysCtrl->getGammaValue();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getGammaValue();
 }
 
 int SystemControlClient::setDisplayMode(int source_input, int mode, int isSave)
 {
-    return mSysCtrl->setDisplayMode(source_input, mode, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setDisplayMode(source_input, mode, isSave);
 }
 
 int SystemControlClient::getDisplayMode(int source_input) {
-    return mSysCtrl->getDisplayMode(source_input);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getDisplayMode(source_input);
 }
 
 int SystemControlClient::saveDisplayMode(int source_input, int mode)
 {
-    return mSysCtrl->saveDisplayMode(source_input, mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveDisplayMode(source_input, mode);
 }
 
 int SystemControlClient::setBacklight(int value, int isSave)
 {
-    return mSysCtrl->setBacklight(value, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setBacklight(value, isSave);
 }
 
 int SystemControlClient::getBacklight(void)
 {
-    return mSysCtrl->getBacklight();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getBacklight();
 }
 
 int SystemControlClient::saveBacklight(int value)
 {
-    return mSysCtrl->saveBacklight(value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveBacklight(value);
 }
 
 int SystemControlClient::setDynamicBacklight(int mode, int isSave)
 {
-    return mSysCtrl->setDynamicBacklight(mode, isSave);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setDynamicBacklight(mode, isSave);
 }
 
 int SystemControlClient::getDynamicBacklight(void)
 {
-    return mSysCtrl->getDynamicBacklight();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getDynamicBacklight();
 }
 
 bool SystemControlClient::checkLdimExist(void)
 {
-    int ret = mSysCtrl->checkLdimExist();
+    SYSCTRL_OR_RETURN(false);
+    int ret = sysCtrl->checkLdimExist();
     if (ret == 0) {
         return false;
     } else {
@@ -774,59 +958,73 @@ bool SystemControlClient::checkLdimExist(void)
 }
 
 int SystemControlClient::factoryResetPQMode(void) {
-    return mSysCtrl->factoryResetPQMode();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryResetPQMode();
 }
 int SystemControlClient::factorySetPQMode_Brightness(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode, int value) {
-    return mSysCtrl->factorySetPQMode_Brightness(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetPQMode_Brightness(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
 }
 
 int SystemControlClient::factoryGetPQMode_Brightness(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode) {
-    return mSysCtrl->factoryGetPQMode_Brightness(inputSrc, sig_fmt, trans_fmt, pq_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetPQMode_Brightness(inputSrc, sig_fmt, trans_fmt, pq_mode);
 }
 
 int SystemControlClient::factorySetPQMode_Contrast(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode, int value) {
-    return mSysCtrl->factorySetPQMode_Contrast(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetPQMode_Contrast(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
 }
 
 int SystemControlClient::factoryGetPQMode_Contrast(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode) {
-    return mSysCtrl->factoryGetPQMode_Contrast(inputSrc, sig_fmt, trans_fmt, pq_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetPQMode_Contrast(inputSrc, sig_fmt, trans_fmt, pq_mode);
 }
 
 int SystemControlClient::factorySetPQMode_Saturation(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode, int value) {
-    return mSysCtrl->factorySetPQMode_Saturation(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetPQMode_Saturation(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
 }
 
 int SystemControlClient::factoryGetPQMode_Saturation(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode) {
-    return mSysCtrl->factoryGetPQMode_Saturation(inputSrc, sig_fmt, trans_fmt, pq_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetPQMode_Saturation(inputSrc, sig_fmt, trans_fmt, pq_mode);
 }
 
 int SystemControlClient::factorySetPQMode_Hue(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode, int value) {
-    return mSysCtrl->factorySetPQMode_Hue(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetPQMode_Hue(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
 }
 
 int SystemControlClient::factoryGetPQMode_Hue(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode) {
-    return mSysCtrl->factoryGetPQMode_Hue(inputSrc, sig_fmt, trans_fmt, pq_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetPQMode_Hue(inputSrc, sig_fmt, trans_fmt, pq_mode);
 }
 
 int SystemControlClient::factorySetPQMode_Sharpness(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode, int value) {
-    return mSysCtrl->factorySetPQMode_Sharpness(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetPQMode_Sharpness(inputSrc, sig_fmt, trans_fmt, pq_mode, value);
 }
 int SystemControlClient::factoryGetPQMode_Sharpness(int inputSrc, int sig_fmt, int trans_fmt, int pq_mode) {
-    return mSysCtrl->factoryGetPQMode_Sharpness(inputSrc, sig_fmt, trans_fmt, pq_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetPQMode_Sharpness(inputSrc, sig_fmt, trans_fmt, pq_mode);
 }
 
 int SystemControlClient::factoryResetColorTemp(void) {
-    return mSysCtrl->factoryResetColorTemp();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryResetColorTemp();
 }
 
 int SystemControlClient::factorySetOverscan(int inputSrc, int sigFmt, int transFmt, int he_value, int hs_value, int ve_value, int vs_value) {
-    return mSysCtrl->factorySetOverscan(inputSrc, sigFmt, transFmt, he_value, hs_value, ve_value, vs_value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetOverscan(inputSrc, sigFmt, transFmt, he_value, hs_value, ve_value, vs_value);
 }
 
 tvin_cutwin_t SystemControlClient::factoryGetOverscan(int inputSrc, int sigFmt, int transFmt) {
     tvin_cutwin_t overscanParam;
     memset(&overscanParam, 0, sizeof(tvin_cutwin_t));
-    mSysCtrl->factoryGetOverscan(inputSrc, sigFmt, transFmt, [&](const OverScanParam& param) {
+    SYSCTRL_OR_RETURN(overscanParam);
+    sysCtrl->factoryGetOverscan(inputSrc, sigFmt, transFmt, [&](const OverScanParam& param) {
         overscanParam.he = param.he;
         overscanParam.hs = param.hs;
         overscanParam.ve = param.ve;
@@ -838,14 +1036,16 @@ tvin_cutwin_t SystemControlClient::factoryGetOverscan(int inputSrc, int sigFmt,
 
 int SystemControlClient::factorySetNolineParams(int inputSrc, int sigFmt, int transFmt, int type, int osd0_value, int osd25_value,
                             int osd50_value, int osd75_value, int osd100_value) {
-    return mSysCtrl->factorySetNolineParams(inputSrc, sigFmt, transFmt, type, osd0_value, osd25_value,
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetNolineParams(inputSrc, sigFmt, transFmt, type, osd0_value, osd25_value,
                                             osd50_value, osd75_value, osd100_value);
 }
 
 noline_params_t SystemControlClient::factoryGetNolineParams(int inputSrc, int sigFmt, int transFmt, int type) {
     noline_params_t nolineParam;
     memset(&nolineParam, 0, sizeof(noline_params_t));
-    mSysCtrl->factoryGetNolineParams(inputSrc, sigFmt, transFmt, type, [&](const NolineParam& param) {
+    SYSCTRL_OR_RETURN(nolineParam);
+    sysCtrl->factoryGetNolineParams(inputSrc, sigFmt, transFmt, type, [&](const NolineParam& param) {
         nolineParam.osd0 = param.osd0;
         nolineParam.osd25 = param.osd25;
         nolineParam.osd50 = param.osd50;
@@ -857,66 +1057,81 @@ noline_params_t SystemControlClient::factoryGetNolineParams(int inputSrc, int si
 }
 
 int SystemControlClient::factoryfactoryGetColorTemperatureParams(int colorTemp_mode){
-    return mSysCtrl->factoryfactoryGetColorTemperatureParams(colorTemp_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryfactoryGetColorTemperatureParams(colorTemp_mode);
 }
 
 int SystemControlClient::factorySetParamsDefault(void) {
-    return mSysCtrl->factorySetParamsDefault();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetParamsDefault();
 }
 
 int SystemControlClient::factorySSMRestore(void) {
-    return mSysCtrl->factorySSMRestore();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySSMRestore();
 }
 
 int SystemControlClient::factoryResetNonlinear(void) {
-    return mSysCtrl->factoryResetNonlinear();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryResetNonlinear();
 }
 
 int SystemControlClient::factorySetGamma(int gamma_r, int gamma_g, int gamma_b) {
-    return mSysCtrl->factorySetGamma(gamma_r, gamma_g, gamma_b);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetGamma(gamma_r, gamma_g, gamma_b);
 }
 
 int SystemControlClient::sysSSMReadNTypes(int id, int data_len, int offset) {
-    return mSysCtrl->sysSSMReadNTypes(id, data_len, offset);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->sysSSMReadNTypes(id, data_len, offset);
 }
 
 int SystemControlClient::sysSSMWriteNTypes(int id, int data_len, int data_buf, int offset) {
-    return mSysCtrl->sysSSMWriteNTypes(id, data_len, data_buf, offset);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->sysSSMWriteNTypes(id, data_len, data_buf, offset);
 }
 
 int SystemControlClient::getActualAddr(int id) {
-    return mSysCtrl->getActualAddr(id);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getActualAddr(id);
 }
 
 int SystemControlClient::getActualSize(int id) {
-    return mSysCtrl->getActualSize(id);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getActualSize(id);
 }
 
 int SystemControlClient::SSMRecovery(void) {
-    return mSysCtrl->SSMRecovery();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->SSMRecovery();
 }
 
 int SystemControlClient::setPLLValues(source_input_param_t srcInputParam) {
     SourceInputParam hidlSrcInput;
     memcpy(&hidlSrcInput, &srcInputParam, sizeof(source_input_param_t));
-    return mSysCtrl->setPLLValues(hidlSrcInput);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setPLLValues(hidlSrcInput);
 }
 
 int SystemControlClient::setCVD2Values(void) {
-    return mSysCtrl->setCVD2Values();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setCVD2Values();
 }
 
 int SystemControlClient::getSSMStatus(void) {
-    return mSysCtrl->getSSMStatus();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getSSMStatus();
 }
 
 int SystemControlClient::setCurrentSourceInfo(int32_t sourceInput, int32_t sigFmt, int32_t transFmt) {
-    return mSysCtrl->setCurrentSourceInfo(sourceInput, sigFmt, transFmt);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setCurrentSourceInfo(sourceInput, sigFmt, transFmt);
 }
 
 void SystemControlClient::getCurrentSourceInfo(int32_t &sourceInput, int32_t &sigFmt, int32_t &transFmt)
 {
-    mSysCtrl->getCurrentSourceInfo([&](const Result &ret, const SourceInputParam &hidlSrcInput) {
+    SYSCTRL_OR_RETURN();
+    sysCtrl->getCurrentSourceInfo([&](const Result &ret, const SourceInputParam &hidlSrcInput) {
         if (Result::OK == ret) {
             sourceInput = hidlSrcInput.sourceInput;
             sigFmt = hidlSrcInput.sigFmt;
@@ -926,172 +1141,235 @@ void SystemControlClient::getCurrentSourceInfo(int32_t &sourceInput, int32_t &si
 }
 
 int SystemControlClient::setwhiteBalanceGainRed(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode, int32_t value) {
-    return mSysCtrl->setwhiteBalanceGainRed(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setwhiteBalanceGainRed(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
 }
 
 int SystemControlClient::setwhiteBalanceGainGreen(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode, int32_t value) {
-    return mSysCtrl->setwhiteBalanceGainGreen(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setwhiteBalanceGainGreen(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
 }
 
 int SystemControlClient::setwhiteBalanceGainBlue(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode, int32_t value) {
-    return mSysCtrl->setwhiteBalanceGainBlue(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setwhiteBalanceGainBlue(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
 }
 
 int SystemControlClient::setwhiteBalanceOffsetRed(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode, int32_t value) {
-    return mSysCtrl->setwhiteBalanceOffsetRed(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setwhiteBalanceOffsetRed(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
 }
 
 int SystemControlClient::setwhiteBalanceOffsetGreen(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode, int32_t value) {
-    return mSysCtrl->setwhiteBalanceOffsetGreen(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setwhiteBalanceOffsetGreen(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
 }
 
 int SystemControlClient::setwhiteBalanceOffsetBlue(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode, int32_t value) {
-    return mSysCtrl->setwhiteBalanceOffsetBlue(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setwhiteBalanceOffsetBlue(inputSrc, sig_fmt, trans_fmt, colortemp_mode, value);
 }
 
 int SystemControlClient::getwhiteBalanceGainRed(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode) {
-    return mSysCtrl->getwhiteBalanceGainRed(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getwhiteBalanceGainRed(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
 }
 
 int SystemControlClient::getwhiteBalanceGainGreen(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode) {
-    return mSysCtrl->getwhiteBalanceGainGreen(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getwhiteBalanceGainGreen(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
 }
 
 int SystemControlClient::getwhiteBalanceGainBlue(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode) {
-    return mSysCtrl->getwhiteBalanceGainBlue(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getwhiteBalanceGainBlue(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
 }
 
 int SystemControlClient::getwhiteBalanceOffsetRed(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode) {
-    return mSysCtrl->getwhiteBalanceOffsetRed(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getwhiteBalanceOffsetRed(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
 }
 
 int SystemControlClient::getwhiteBalanceOffsetGreen(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode) {
-    return mSysCtrl->getwhiteBalanceOffsetGreen(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getwhiteBalanceOffsetGreen(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
 }
 
 int SystemControlClient::getwhiteBalanceOffsetBlue(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colortemp_mode) {
-    return mSysCtrl->getwhiteBalanceOffsetBlue(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getwhiteBalanceOffsetBlue(inputSrc, sig_fmt, trans_fmt, colortemp_mode);
 }
 
 int SystemControlClient:: saveWhiteBalancePara(int32_t inputSrc, int sig_fmt, int trans_fmt, int32_t colorTemp_mode,
                                                        int32_t r_gain, int32_t g_gain, int32_t b_gain, int32_t r_offset, int32_t g_offset, int32_t b_offset) {
-    return mSysCtrl->saveWhiteBalancePara(inputSrc, sig_fmt, trans_fmt, colorTemp_mode, r_gain, g_gain, b_gain, r_offset, g_offset, b_offset);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->saveWhiteBalancePara(inputSrc, sig_fmt, trans_fmt, colorTemp_mode, r_gain, g_gain, b_gain, r_offset, g_offset, b_offset);
 }
 
 int SystemControlClient::getRGBPattern() {
-    return mSysCtrl->getRGBPattern();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getRGBPattern();
 }
 
 int SystemControlClient::setRGBPattern(int32_t r, int32_t g, int32_t b) {
-    return mSysCtrl->setRGBPattern(r, g, b);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setRGBPattern(r, g, b);
 }
 
 int SystemControlClient::factorySetDDRSSC(int32_t step) {
-    return mSysCtrl->factorySetDDRSSC(step);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetDDRSSC(step);
 }
 
 int SystemControlClient::factoryGetDDRSSC() {
-    return mSysCtrl->factoryGetDDRSSC();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetDDRSSC();
 }
 
 int SystemControlClient::factorySetLVDSSSC(int32_t step) {
-    return mSysCtrl->factorySetLVDSSSC(step);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetLVDSSSC(step);
 }
 
 int SystemControlClient::factoryGetLVDSSSC() {
-    return mSysCtrl->factoryGetLVDSSSC();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetLVDSSSC();
 }
 
 int SystemControlClient::whiteBalanceGrayPatternClose() {
-    return mSysCtrl->whiteBalanceGrayPatternClose();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->whiteBalanceGrayPatternClose();
 }
 
 int SystemControlClient::whiteBalanceGrayPatternOpen() {
-    return mSysCtrl->whiteBalanceGrayPatternOpen();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->whiteBalanceGrayPatternOpen();
 }
 
 int SystemControlClient::whiteBalanceGrayPatternSet(int32_t value) {
-    return mSysCtrl->whiteBalanceGrayPatternSet(value);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->whiteBalanceGrayPatternSet(value);
 }
 
 int SystemControlClient::whiteBalanceGrayPatternGet() {
-    return mSysCtrl->whiteBalanceGrayPatternGet();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->whiteBalanceGrayPatternGet();
 }
 
 int SystemControlClient::factorySetHdrMode(int mode) {
-    return mSysCtrl->factorySetHdrMode(mode);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetHdrMode(mode);
 }
 
 int SystemControlClient::factoryGetHdrMode(void) {
-    return mSysCtrl->factoryGetHdrMode();
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetHdrMode();
 }
 
 int SystemControlClient::setDnlpParams(int inputSrc, int32_t sigFmt, int32_t transFmt, int level) {
-    return mSysCtrl->setDnlpParams(inputSrc, sigFmt, transFmt, level);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->setDnlpParams(inputSrc, sigFmt, transFmt, level);
 }
 
 int SystemControlClient::getDnlpParams(int inputSrc, int32_t sigFmt, int32_t transFmt) {
-    return mSysCtrl->getDnlpParams(inputSrc, sigFmt, transFmt);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->getDnlpParams(inputSrc, sigFmt, transFmt);
 }
 
 int SystemControlClient::factorySetDnlpParams(int inputSrc, int32_t sigFmt, int32_t transFmt, int level, int final_gain) {
-    return mSysCtrl->factorySetDnlpParams(inputSrc, sigFmt, transFmt, level, final_gain);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetDnlpParams(inputSrc, sigFmt, transFmt, level, final_gain);
 }
 
 int SystemControlClient::factoryGetDnlpParams(int inputSrc, int32_t sigFmt, int32_t transFmt, int level) {
-    return mSysCtrl->factoryGetDnlpParams(inputSrc, sigFmt, transFmt, level);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetDnlpParams(inputSrc, sigFmt, transFmt, level);
 }
 
 int SystemControlClient::factorySetBlackExtRegParams(int inputSrc, int32_t sigFmt, int32_t transFmt, int val) {
-    return mSysCtrl->factorySetBlackExtRegParams(inputSrc, sigFmt, transFmt, val);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetBlackExtRegParams(inputSrc, sigFmt, transFmt, val);
 }
 
 int SystemControlClient::factoryGetBlackExtRegParams(int inputSrc, int32_t sigFmt, int32_t transFmt) {
-    return mSysCtrl->factoryGetBlackExtRegParams(inputSrc, sigFmt, transFmt);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetBlackExtRegParams(inputSrc, sigFmt, transFmt);
 }
 
 int SystemControlClient::factorySetColorParams(int inputSrc, int32_t sigFmt, int32_t transFmt, int color_type, int color_param, int val) {
-    return mSysCtrl->factorySetColorParams(inputSrc, sigFmt, transFmt, color_type, color_param, val);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetColorParams(inputSrc, sigFmt, transFmt, color_type, color_param, val);
 }
 int SystemControlClient::factoryGetColorParams(int inputSrc, int32_t sigFmt, int32_t transFmt, int color_type, int color_param) {
-    return mSysCtrl->factoryGetColorParams(inputSrc, sigFmt, transFmt, color_type, color_param);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetColorParams(inputSrc, sigFmt, transFmt, color_type, color_param);
 }
 
 int SystemControlClient::factorySetNoiseReductionParams(int inputSrc, int sig_fmt, int trans_fmt, int nr_mode, int param_type, int val) {
-    return mSysCtrl->factorySetNoiseReductionParams(inputSrc, sig_fmt, trans_fmt, nr_mode, param_type, val);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetNoiseReductionParams(inputSrc, sig_fmt, trans_fmt, nr_mode, param_type, val);
 }
 
 int SystemControlClient::factoryGetNoiseReductionParams(int inputSrc, int sig_fmt, int trans_fmt, int nr_mode, int param_type) {
-    return mSysCtrl->factoryGetNoiseReductionParams(inputSrc, sig_fmt, trans_fmt, nr_mode, param_type);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetNoiseReductionParams(inputSrc, sig_fmt, trans_fmt, nr_mode, param_type);
 }
 
 int SystemControlClient::factorySetCTIParams(int inputSrc, int sig_fmt, int trans_fmt, int param_type, int val) {
-    return mSysCtrl->factorySetCTIParams(inputSrc, sig_fmt, trans_fmt, param_type, val);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetCTIParams(inputSrc, sig_fmt, trans_fmt, param_type, val);
 }
 
 int SystemControlClient::factoryGetCTIParams(int inputSrc, int sig_fmt, int trans_fmt, int param_type) {
-    return mSysCtrl->factoryGetCTIParams(inputSrc, sig_fmt, trans_fmt, param_type);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetCTIParams(inputSrc, sig_fmt, trans_fmt, param_type);
 }
 
 int SystemControlClient::factorySetDecodeLumaParams(int inputSrc, int sig_fmt, int trans_fmt, int param_type, int val) {
-    return mSysCtrl->factorySetDecodeLumaParams(inputSrc, sig_fmt, trans_fmt, param_type, val);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetDecodeLumaParams(inputSrc, sig_fmt, trans_fmt, param_type, val);
 }
 int SystemControlClient::factoryGetDecodeLumaParams(int inputSrc, int sig_fmt, int trans_fmt, int param_type) {
-    return mSysCtrl->factoryGetDecodeLumaParams(inputSrc, sig_fmt, trans_fmt, param_type);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetDecodeLumaParams(inputSrc, sig_fmt, trans_fmt, param_type);
 }
 
 int SystemControlClient::factorySetSharpnessParams(int inputSrc, int sig_fmt, int trans_fmt, int isHD, int param_type, int val) {
-    return mSysCtrl->factorySetSharpnessParams(inputSrc, sig_fmt, trans_fmt, isHD, param_type, val);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factorySetSharpnessParams(inputSrc, sig_fmt, trans_fmt, isHD, param_type, val);
 }
 
 int SystemControlClient::factoryGetSharpnessParams(int inputSrc, int sig_fmt, int trans_fmt, int isHD,int param_type) {
-    return mSysCtrl->factoryGetSharpnessParams(inputSrc, sig_fmt, trans_fmt, isHD, param_type);
+    SYSCTRL_OR_RETURN(-1);
+    return sysCtrl->factoryGetSharpnessParams(inputSrc, sig_fmt, trans_fmt, isHD, param_type);
 }
 //PQ end
 
 void SystemControlClient::SystemControlDeathRecipient::serviceDied(uint64_t cookie,
         const ::android::wp<::android::hidl::base::V1_0::IBase>& who) {
     LOG(ERROR) << "system control service died. need release some resources";
+    mClient->onServiceDied();
+}
+
+SystemControlClient::SystemControlNotification::SystemControlNotification(ServiceConnector *connector)
+    :mConnector(connector) {
+    pthread_mutex_init(&mLock, NULL);
+}
+
+//the service manager keeps the notification after the client is gone
+void SystemControlClient::SystemControlNotification::detach() {
+    pthread_mutex_lock(&mLock);
+    mConnector = NULL;
+    pthread_mutex_unlock(&mLock);
+}
+
+Return<void> SystemControlClient::SystemControlNotification::onRegistration(const hidl_string& fqName,
+        const hidl_string& name, bool preexisting) {
+    pthread_mutex_lock(&mLock);
+    if (mConnector != NULL)
+        mConnector->onRegistered();
+    pthread_mutex_unlock(&mLock);
+    return Void();
 }
 
 }; // namespace android
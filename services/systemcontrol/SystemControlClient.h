@@ -23,12 +23,16 @@
 #define ANDROID_SYSTEMCONTROLCLIENT_H
 
 #include <utils/Errors.h>
+#include <pthread.h>
 #include "ISystemControlNotify.h"
+#include "ServiceConnector.h"
 #include <string>
 #include <vector>
 
 #include "PQType.h"
 #include <vendor/amlogic/hardware/systemcontrol/1.1/ISystemControl.h>
+#include <android/hidl/manager/1.0/IServiceManager.h>
+#include <android/hidl/manager/1.0/IServiceNotification.h>
 using ::vendor::amlogic::hardware::systemcontrol::V1_1::ISystemControl;
 using ::vendor::amlogic::hardware::systemcontrol::V1_0::ISystemControlCallback;
 using ::vendor::amlogic::hardware::systemcontrol::V1_0::Result;
@@ -41,12 +45,26 @@ using ::android::hardware::hidl_vec;
 using ::android::hardware::hidl_string;
 using ::android::hardware::hidl_array;
 using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::android::hidl::manager::V1_0::IServiceManager;
+using ::android::hidl::manager::V1_0::IServiceNotification;
+
+//how long a call made before the service is connected waits for it
+#define SYSCTRL_CALL_WAIT_MS        5000
+//lookup interval when the service manager takes no notification
+#define SYSCTRL_RETRY_MS            200
 
 namespace android {
 
 class SystemControlClient  : virtual public RefBase {
 public:
     SystemControlClient();
+    ~SystemControlClient();
+
+    //calls made while not connected fail at once, or wait up to waitMs (-1 forever)
+    void setConnectPolicy(bool failFast, int waitMs);
+    bool waitForConnected(int timeoutMs);
+    bool isConnected();
 
     bool getProperty(const std::string& key, std::string& value);
     bool getPropertyString(const std::string& key, std::string& value, std::string& def);
@@ -236,13 +254,39 @@ public:
 
  private:
     struct SystemControlDeathRecipient : public android::hardware::hidl_death_recipient  {
+        SystemControlDeathRecipient(SystemControlClient *client) : mClient(client) {}
         // hidl_death_recipient interface
         virtual void serviceDied(uint64_t cookie,
             const ::android::wp<::android::hidl::base::V1_0::IBase>& who) override;
+
+        SystemControlClient *mClient;
     };
     sp<SystemControlDeathRecipient> mDeathRecipient = nullptr;
 
+    struct SystemControlNotification : public IServiceNotification {
+        SystemControlNotification(ServiceConnector *connector);
+        void detach();
+        // IServiceNotification interface
+        virtual Return<void> onRegistration(const hidl_string& fqName,
+            const hidl_string& name, bool preexisting) override;
+
+        pthread_mutex_t mLock;
+        ServiceConnector *mConnector;
+    };
+    sp<SystemControlNotification> mNotification;
+
+    static bool resolveService(void *user);
+    void onServiceDied();
+    //the connected service, or nullptr as the connect policy says
+    sp<ISystemControl> getSysCtrl();
+
+    ServiceConnector *mConnector;
+    bool mFailFast;
+    int mCallWaitMs;
+
+    pthread_mutex_t mLock;
     sp<ISystemControl> mSysCtrl;
+    sp<ISystemControlCallback> mCallback;
 
 };
 
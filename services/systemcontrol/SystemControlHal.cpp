@@ -194,6 +194,51 @@ Return<Result> SystemControlHal::writeSysfs(const hidl_string &path, const hidl_
     return mSysControl->writeSysfs(path, value)?Result::OK:Result::FAIL;
 }
 
+static std::vector<std::string> toStdList(const hidl_vec<hidl_string> &list) {
+    std::vector<std::string> out;
+    out.reserve(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+        out.push_back(list[i]);
+    }
+    return out;
+}
+
+static hidl_vec<hidl_string> toHidlList(const std::vector<std::string> &list) {
+    hidl_vec<hidl_string> out;
+    out.resize(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+        out[i] = list[i];
+    }
+    return out;
+}
+
+Return<void> SystemControlHal::readSysfsBatch(const hidl_vec<hidl_string> &paths, batchValues_cb _hidl_cb) {
+    std::vector<std::string> values;
+    int failed = mSysControl->readSysfsBatch(toStdList(paths), values);
+
+    if (ENABLE_LOG_PRINT)
+        ALOGI("readSysfsBatch %d paths, %d failed", (int)paths.size(), failed);
+    _hidl_cb(failed == 0 ? Result::OK : Result::FAIL, failed, toHidlList(values));
+    return Void();
+}
+
+Return<Result> SystemControlHal::writeSysfsBatch(const hidl_vec<hidl_string> &paths, const hidl_vec<hidl_string> &values) {
+    int failed = mSysControl->writeSysfsBatch(toStdList(paths), toStdList(values));
+
+    if (ENABLE_LOG_PRINT)
+        ALOGI("writeSysfsBatch %d paths, %d failed", (int)paths.size(), failed);
+    return failed == 0 ? Result::OK : Result::FAIL;
+}
+
+Return<void> SystemControlHal::getPropertyBatch(const hidl_vec<hidl_string> &keys, batchValues_cb _hidl_cb) {
+    std::vector<std::string> values;
+    int unset = mSysControl->getPropertyBatch(toStdList(keys), values);
+
+    //a key not set is no failure, as for getProperty
+    _hidl_cb(Result::OK, unset, toHidlList(values));
+    return Void();
+}
+
 Return<Result> SystemControlHal::writeSysfsBin(const hidl_string &path, const hidl_array<int32_t, 4096>& key, int32_t size) {
     if (ENABLE_LOG_PRINT)
         ALOGI("writeSysfs bin");
@@ -68,6 +68,14 @@ class SystemControlHal : public ISystemControl, public SystemControlNotify {
     Return<void> readSysfs(const hidl_string &path, readSysfs_cb _hidl_cb) override;
     Return<Result> writeSysfs(const hidl_string &path, const hidl_string &value) override;
     Return<Result> writeSysfsBin(const hidl_string &path, const hidl_array<int32_t, 4096>& key, int32_t size) override;
+    /*
+     * ISystemControl@1.1 has no list transactions, these take the shape they get
+     * in the .hal and become overrides with it. Until then in process callers only
+     */
+    typedef std::function<void(Result result, int32_t failed, const hidl_vec<hidl_string>& values)> batchValues_cb;
+    Return<void> readSysfsBatch(const hidl_vec<hidl_string> &paths, batchValues_cb _hidl_cb);
+    Return<Result> writeSysfsBatch(const hidl_vec<hidl_string> &paths, const hidl_vec<hidl_string> &values);
+    Return<void> getPropertyBatch(const hidl_vec<hidl_string> &keys, batchValues_cb _hidl_cb);
     Return<void> readHdcpRX22Key(int32_t size, readHdcpRX22Key_cb _hidl_cb) override;
     Return<Result> writeHdcpRX22Key(const hidl_array<int32_t, 4096>& key, int32_t size) override;
     Return<void> readHdcpRX14Key(int32_t size, readHdcpRX14Key_cb _hidl_cb) override;
@@ -230,6 +230,33 @@ bool SystemControlService::writeSysfs(const std::string& path, const char *value
     return false;
 }
 
+int SystemControlService::readSysfsBatch(const std::vector<std::string>& paths,
+    std::vector<std::string>& values) {
+    values.clear();
+    if (NO_ERROR != permissionCheck())
+        return paths.size();
+
+    int failed = pSysWrite->readSysfsBatch(paths, values);
+    for (size_t i = 0; i < paths.size(); i++)
+        traceValue("readSysfsBatch", paths[i], values[i]);
+    return failed;
+}
+
+int SystemControlService::writeSysfsBatch(const std::vector<std::string>& paths,
+    const std::vector<std::string>& values) {
+    if (NO_ERROR != permissionCheck())
+        return paths.size();
+
+    for (size_t i = 0; i < paths.size() && i < values.size(); i++)
+        traceValue("writeSysfsBatch", paths[i], values[i]);
+    return pSysWrite->writeSysfsBatch(paths, values);
+}
+
+int SystemControlService::getPropertyBatch(const std::vector<std::string>& keys,
+    std::vector<std::string>& values) {
+    return pSysWrite->getPropertyBatch(keys, values);
+}
+
 bool SystemControlService::writeUnifyKey(const std::string& key, const std::string& value) {
     if (NO_ERROR == permissionCheck()) {
         traceValue("writeUnifyKey", key, value);
@@ -1564,7 +1591,7 @@ status_t SystemControlService::dump(int fd, const Vector<String16>& args) {
             pDisplayMode->dump(displayInfo);
             result.append(displayInfo);*/
 
-            char buf[4096] = {0};
+            char buf[DISPLAY_MODE_DUMP_LEN] = {0};
             pDisplayMode->dump(buf);
             result.append(String8(buf));
             break;
@@ -68,6 +68,10 @@ public:
     bool readSysfs(const std::string& path, std::string& value);
     bool writeSysfs(const std::string& path, const std::string& value);
     bool writeSysfs(const std::string& path, const char *value, const int size);
+    //one permission check for the whole list, returns the failed reads or writes, or the keys not set
+    int readSysfsBatch(const std::vector<std::string>& paths, std::vector<std::string>& values);
+    int writeSysfsBatch(const std::vector<std::string>& paths, const std::vector<std::string>& values);
+    int getPropertyBatch(const std::vector<std::string>& keys, std::vector<std::string>& values);
     int32_t readHdcpRX22Key(char *value __attribute__((unused)), int size __attribute__((unused)));
     bool writeHdcpRX22Key(const char *value, const int size);
     int32_t readHdcpRX14Key(char *value __attribute__((unused)), int size __attribute__((unused)));
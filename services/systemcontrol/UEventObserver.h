@@ -30,53 +30,24 @@
 using namespace android;
 #endif
 
-typedef struct uevent_data {
-    int len;
-    char buf[1024];
-    char matchName[256];
-    char switchName[64];
-    char switchState[64];
-} uevent_data_t;
-
-typedef struct _match_node{
-    char *buf;
-	struct _match_node *next;
-} match_node_t;
-
-typedef struct {
-    int num; //match string item number
-    match_node_t strList;
-} match_item_t;
+#include "UeventHub.h"
 
 // ----------------------------------------------------------------------------
 class UEventObserver
 {
 public:
-    UEventObserver();
+    UEventObserver(const char *name = "observer");
     ~UEventObserver();
 
-    void addMatch(const char *matchStr);
+    void addMatch(const char *matchStr, const char *devType = NULL);
     void removeMatch(const char *matchStr);
     void waitForNextEvent(uevent_data_t* ueventData);
     int ueventGetFd();
     void setLogLevel(int level);
 
 private:
-    int ueventInit();
-    bool isMatch(const char* buffer, size_t length, uevent_data_t* ueventData, const char *matchStr);
-    bool isMatch(const char* buffer, size_t length, uevent_data_t* ueventData);
-    int ueventNextEvent(char* buffer, int buffer_length);
-    void ueventPrint(char* ueventBuf, int len);
-
-    int mFd;
-    int mLogLevel;
-
-    match_item_t mMatchStr;//for none recovery mode
-
-#ifndef RECOVERY_MODE
-    Mutex gMatchesMutex;
-    Vector<String8> gMatches;
-#endif
+    //a queue on the process wide hub, the socket is shared
+    UeventSubscriber *mSubscriber;
 };
 // ----------------------------------------------------------------------------
 #endif /*_SYSTEM_CONTROL_UEVENT_OBSERVER_H*/
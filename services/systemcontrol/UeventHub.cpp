@@ -0,0 +1,488 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 one netlink uevent socket and one epoll thread for the whole process
+ *  - 2 parse every message once, hand it only to the subscribers it matches
+ *  - 3 count deliveries, queue depth and receive to handling latency per subscriber
+ *  - 4 drain the socket with recvmmsg, a batch of messages per system call
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "common.h"
+#include "UeventHub.h"
+
+UeventHub *UeventHub::mInstance = NULL;
+
+//reused for every read, page sized buffers so long uevents are not cut
+struct uevent_batch {
+    char buffers[UEVENT_BATCH_SIZE][UEVENT_MSG_LEN];
+    char control[UEVENT_BATCH_SIZE][CMSG_SPACE(sizeof(struct ucred))];
+    struct sockaddr_storage addrs[UEVENT_BATCH_SIZE];
+    struct iovec iovs[UEVENT_BATCH_SIZE];
+    struct mmsghdr msgs[UEVENT_BATCH_SIZE];
+};
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ----------------------------------------------------------------------------
+UeventSubscriber::UeventSubscriber(const char *name, uevent_callback_t callback, void *user)
+    :mName(name),
+    mCallback(callback),
+    mUser(user) {
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mCond, NULL);
+    mStats.name = name;
+    mStats.delivered = 0;
+    mStats.maxQueued = 0;
+    mStats.coalesced = 0;
+    mStats.dropped = 0;
+    mStats.totalLatencyNs = 0;
+    mStats.maxLatencyNs = 0;
+}
+
+UeventSubscriber::~UeventSubscriber() {
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mLock);
+}
+
+void UeventSubscriber::addMatch(const char *matchStr, const char *devType) {
+    mMatcher.addMatch(matchStr, devType);
+}
+
+void UeventSubscriber::removeMatch(const char *matchStr) {
+    mMatcher.removeMatch(matchStr);
+}
+
+//called with mLock held
+void UeventSubscriber::account(int64_t recvNs) {
+    int64_t latency = nowNs() - recvNs;
+
+    mStats.delivered++;
+    mStats.totalLatencyNs += latency;
+    if (latency > mStats.maxLatencyNs)
+        mStats.maxLatencyNs = latency;
+}
+
+//called with mLock held on a full queue. The newest state of a switch is what
+//its subscriber acts on, so an older one of the same switch goes first
+void UeventSubscriber::makeRoom(const uevent_data_t *data) {
+    for (std::deque<queued_event_t>::iterator it = mQueue.begin(); it != mQueue.end(); ++it) {
+        if (!strcmp(it->data.matchName, data->matchName)
+            && !strcmp(it->data.switchName, data->switchName)) {
+            mQueue.erase(it);
+            mStats.coalesced++;
+            return;
+        }
+    }
+
+    mQueue.pop_front();
+    mStats.dropped++;
+}
+
+void UeventSubscriber::deliver(const uevent_view_t *view, const char *buffer, int length,
+    int64_t recvNs) {
+    queued_event_t event;
+
+    memset(&event.data, 0, sizeof(event.data));
+    if (!mMatcher.match(view, buffer, length, &event.data))
+        return;
+
+    if (mCallback != NULL) {
+        pthread_mutex_lock(&mLock);
+        account(recvNs);
+        pthread_mutex_unlock(&mLock);
+        mCallback(&event.data, mUser);
+        return;
+    }
+
+    event.recvNs = recvNs;
+    pthread_mutex_lock(&mLock);
+    //a plug out and in again both matter, events only go once the queue is full
+    if (mQueue.size() >= UEVENT_QUEUE_MAX) {
+        if (mStats.coalesced + mStats.dropped == 0)
+            SYS_LOGE("uevent subscriber %s is behind, %d queued\n", mName.c_str(), UEVENT_QUEUE_MAX);
+        makeRoom(&event.data);
+    }
+    mQueue.push_back(event);
+    if ((int64_t)mQueue.size() > mStats.maxQueued)
+        mStats.maxQueued = mQueue.size();
+    pthread_cond_signal(&mCond);
+    pthread_mutex_unlock(&mLock);
+}
+
+bool UeventSubscriber::waitForNextEvent(uevent_data_t *ueventData, int timeoutMs) {
+    struct timespec deadline;
+
+    if (timeoutMs >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeoutMs / 1000;
+        deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&mLock);
+    while (mQueue.empty()) {
+        if (timeoutMs < 0) {
+            pthread_cond_wait(&mCond, &mLock);
+        } else if (pthread_cond_timedwait(&mCond, &mLock, &deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&mLock);
+            return false;
+        }
+    }
+
+    const queued_event_t &event = mQueue.front();
+    memcpy(ueventData, &event.data, sizeof(uevent_data_t));
+    account(event.recvNs);
+    mQueue.pop_front();
+    pthread_mutex_unlock(&mLock);
+    return true;
+}
+
+void UeventSubscriber::getStats(uevent_sub_stats_t *stats) {
+    pthread_mutex_lock(&mLock);
+    *stats = mStats;
+    pthread_mutex_unlock(&mLock);
+}
+
+// ----------------------------------------------------------------------------
+UeventHub *UeventHub::getInstance() {
+    static pthread_mutex_t instanceLock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&instanceLock);
+    if (mInstance == NULL)
+        mInstance = new UeventHub(openNetlink());
+    pthread_mutex_unlock(&instanceLock);
+    return mInstance;
+}
+
+int UeventHub::openNetlink() {
+    struct sockaddr_nl addr;
+    int sz = 64*1024;
+    int s;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    //one socket per process now, let the kernel pick the port id
+    addr.nl_pid = 0;
+    addr.nl_groups = 0xffffffff;
+
+    s = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (s < 0) {
+        SYS_LOGE("uevent socket create fail: %s\n", strerror(errno));
+        return -1;
+    }
+
+    setsockopt(s, SOL_SOCKET, SO_RCVBUFFORCE, &sz, sizeof(sz));
+
+    if (bind(s, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        SYS_LOGE("uevent socket bind fail: %s\n", strerror(errno));
+        close(s);
+        return -1;
+    }
+
+    return s;
+}
+
+UeventHub::UeventHub(int fd, uid_t trustedUid)
+    :mFd(fd),
+    mEpollFd(-1),
+    mThreadStarted(false),
+    mLogLevel(LOG_LEVEL_DEFAULT),
+    mTrustedUid(trustedUid),
+    mBatch(NULL) {
+    struct epoll_event ev;
+    int on = 1;
+
+    pthread_mutex_init(&mLock, NULL);
+    memset(&mHubStats, 0, sizeof(mHubStats));
+    mWakeFd[0] = mWakeFd[1] = -1;
+    if (mFd < 0)
+        return;
+
+    fcntl(mFd, F_SETFL, fcntl(mFd, F_GETFL) | O_NONBLOCK);
+    setsockopt(mFd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+    mBatch = new uevent_batch;
+
+    if (pipe2(mWakeFd, O_CLOEXEC | O_NONBLOCK) < 0
+        || (mEpollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        SYS_LOGE("uevent hub init fail: %s\n", strerror(errno));
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = mFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mFd, &ev);
+    ev.data.fd = mWakeFd[0];
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd[0], &ev);
+
+    if (pthread_create(&mThread, NULL, threadLoop, this) != 0)
+        SYS_LOGE("create uevent hub thread fail\n");
+    else
+        mThreadStarted = true;
+}
+
+UeventHub::~UeventHub() {
+    if (mThreadStarted) {
+        write(mWakeFd[1], "x", 1);
+        pthread_join(mThread, NULL);
+    }
+
+    if (mEpollFd >= 0)
+        close(mEpollFd);
+    for (int i = 0; i < 2; i++) {
+        if (mWakeFd[i] >= 0)
+            close(mWakeFd[i]);
+    }
+    if (mFd >= 0)
+        close(mFd);
+
+    for (size_t i = 0; i < mSubscribers.size(); i++)
+        delete mSubscribers[i];
+    delete mBatch;
+    pthread_mutex_destroy(&mLock);
+}
+
+UeventSubscriber *UeventHub::subscribe(const char *name, uevent_callback_t callback, void *user) {
+    UeventSubscriber *sub = new UeventSubscriber(name, callback, user);
+
+    pthread_mutex_lock(&mLock);
+    mSubscribers.push_back(sub);
+    pthread_mutex_unlock(&mLock);
+    return sub;
+}
+
+void UeventHub::unsubscribe(UeventSubscriber *sub) {
+    pthread_mutex_lock(&mLock);
+    for (size_t i = 0; i < mSubscribers.size(); i++) {
+        if (mSubscribers[i] == sub) {
+            mSubscribers.erase(mSubscribers.begin() + i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+    //dispatch holds mLock, so no message is being delivered to sub anymore
+    delete sub;
+}
+
+int UeventHub::getFd() {
+    return mFd;
+}
+
+void UeventHub::setLogLevel(int level) {
+    mLogLevel = level;
+}
+
+int64_t UeventHub::getReceived() {
+    pthread_mutex_lock(&mLock);
+    int64_t received = mHubStats.received;
+    pthread_mutex_unlock(&mLock);
+    return received;
+}
+
+void UeventHub::getHubStats(uevent_hub_stats_t *stats) {
+    pthread_mutex_lock(&mLock);
+    *stats = mHubStats;
+    pthread_mutex_unlock(&mLock);
+}
+
+void UeventHub::getStats(std::vector<uevent_sub_stats_t> &stats) {
+    pthread_mutex_lock(&mLock);
+    stats.resize(mSubscribers.size());
+    for (size_t i = 0; i < mSubscribers.size(); i++)
+        mSubscribers[i]->getStats(&stats[i]);
+    pthread_mutex_unlock(&mLock);
+}
+
+int UeventHub::dump(char *result) {
+    if (NULL == result)
+        return -1;
+
+    std::vector<uevent_sub_stats_t> stats;
+    uevent_hub_stats_t hubStats;
+    char buf[CC_MAX_LINE_LEN] = {0};
+
+    getStats(stats);
+    getHubStats(&hubStats);
+    sprintf(buf, "\nuevent hub received: %lld in %lld reads, rejected: %lld\n",
+        (long long)hubStats.received, (long long)hubStats.reads, (long long)hubStats.rejected);
+    strcat(result, buf);
+    for (size_t i = 0; i < stats.size(); i++) {
+        const uevent_sub_stats_t &s = stats[i];
+        snprintf(buf, sizeof(buf), "  %s delivered:%lld max queued:%lld coalesced:%lld dropped:%lld"
+            " latency avg:%lldus max:%lldus\n",
+            s.name.c_str(), (long long)s.delivered, (long long)s.maxQueued,
+            (long long)s.coalesced, (long long)s.dropped,
+            s.delivered > 0 ? (long long)(s.totalLatencyNs / s.delivered / 1000) : 0LL,
+            (long long)(s.maxLatencyNs / 1000));
+        strcat(result, buf);
+    }
+    return 0;
+}
+
+void *UeventHub::threadLoop(void *data) {
+    UeventHub *pThiz = (UeventHub *)data;
+    struct epoll_event events[2];
+
+    while (true) {
+        int nr = epoll_wait(pThiz->mEpollFd, events, 2, -1);
+        if (nr < 0) {
+            if (errno == EINTR)
+                continue;
+            SYS_LOGE("uevent hub epoll_wait fail: %s\n", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < nr; i++) {
+            if (events[i].data.fd == pThiz->mWakeFd[0])
+                return NULL;
+            pThiz->receive();
+        }
+    }
+
+    return NULL;
+}
+
+void UeventHub::receive() {
+    struct uevent_batch *batch = mBatch;
+
+    //drain the socket, one wakeup may cover a burst of messages
+    while (true) {
+        for (int i = 0; i < UEVENT_BATCH_SIZE; i++) {
+            struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+
+            batch->iovs[i].iov_base = batch->buffers[i];
+            batch->iovs[i].iov_len = UEVENT_MSG_LEN - 1;
+            memset(hdr, 0, sizeof(*hdr));
+            hdr->msg_name = &batch->addrs[i];
+            hdr->msg_namelen = sizeof(batch->addrs[i]);
+            hdr->msg_iov = &batch->iovs[i];
+            hdr->msg_iovlen = 1;
+            hdr->msg_control = batch->control[i];
+            hdr->msg_controllen = sizeof(batch->control[i]);
+        }
+
+        int count = recvmmsg(mFd, batch->msgs, UEVENT_BATCH_SIZE, MSG_DONTWAIT, NULL);
+        if (count <= 0) {
+            if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                SYS_LOGE("uevent hub recvmmsg fail: %s\n", strerror(errno));
+            return;
+        }
+
+        dispatch(count, nowNs());
+        //a short batch emptied the socket, skip the read that would say EAGAIN
+        if (count < UEVENT_BATCH_SIZE)
+            return;
+    }
+}
+
+//same checks as libcutils uevent_kernel_recv()
+bool UeventHub::validate(int index) {
+    const struct msghdr *hdr = &mBatch->msgs[index].msg_hdr;
+    const struct sockaddr_storage *addr = &mBatch->addrs[index];
+    struct cmsghdr *cmsg;
+    struct ucred *cred = NULL;
+
+    if (hdr->msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        SYS_LOGE("uevent message truncated, %u bytes\n", mBatch->msgs[index].msg_len);
+        return false;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR((struct msghdr *)hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
+            cred = (struct ucred *)CMSG_DATA(cmsg);
+            break;
+        }
+    }
+    if (cred == NULL || (cred->uid != 0 && cred->uid != mTrustedUid)) {
+        SYS_LOGE("ignore uevent from uid %d\n", cred != NULL ? (int)cred->uid : -1);
+        return false;
+    }
+
+    //unicast or from a user space process, not the kernel
+    if (addr->ss_family == AF_NETLINK) {
+        const struct sockaddr_nl *nl = (const struct sockaddr_nl *)addr;
+        if (nl->nl_groups == 0 || nl->nl_pid != 0)
+            return false;
+    }
+    return true;
+}
+
+void UeventHub::dispatch(int count, int64_t recvNs) {
+    uevent_view_t views[UEVENT_BATCH_SIZE];
+    bool valid[UEVENT_BATCH_SIZE];
+    int rejected = 0;
+
+    for (int i = 0; i < count; i++) {
+        char *buffer = mBatch->buffers[i];
+        int length = mBatch->msgs[i].msg_len;
+
+        valid[i] = validate(i);
+        if (!valid[i]) {
+            rejected++;
+            continue;
+        }
+        buffer[length] = '\0';
+        print(buffer, length);
+        ueventParse(buffer, length, &views[i]);
+    }
+
+    //one pass under the lock for the whole batch
+    pthread_mutex_lock(&mLock);
+    mHubStats.reads++;
+    mHubStats.rejected += rejected;
+    mHubStats.received += count - rejected;
+    for (int i = 0; i < count; i++) {
+        if (!valid[i])
+            continue;
+        for (size_t j = 0; j < mSubscribers.size(); j++)
+            mSubscribers[j]->deliver(&views[i], mBatch->buffers[i], mBatch->msgs[i].msg_len, recvNs);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void UeventHub::print(const char *buffer, int length) {
+    if (mLogLevel > LOG_LEVEL_1) {
+        //change@/devices/virtual/switch/hdmi ACTION=change DEVPATH=/devices/virtual/switch/hdmi
+        //SUBSYSTEM=switch SWITCH_NAME=hdmi SWITCH_STATE=0 SEQNUM=2791
+        char printBuf[UEVENT_MSG_LEN] = {0};
+        memcpy(printBuf, buffer, length);
+        for (int i = 0; i < length; i++) {
+            if (printBuf[i] == 0x0)
+                printBuf[i] = ' ';
+        }
+
+        SYS_LOGI("Received uevent message: %s", printBuf);
+    }
+}
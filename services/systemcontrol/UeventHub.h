@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 one netlink uevent socket and one epoll thread for the whole process
+ *  - 2 parse every message once, hand it only to the subscribers it matches
+ *  - 3 count deliveries, queue depth and receive to handling latency per subscriber
+ *  - 5 bound each queue, a stalled subscriber loses its oldest states first
+ *  - 4 drain the socket with recvmmsg, a batch of messages per system call
+ */
+
+#ifndef _SYSTEM_CONTROL_UEVENT_HUB_H
+#define _SYSTEM_CONTROL_UEVENT_HUB_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "UeventMatcher.h"
+
+//about 4.4KB an event, past this many a queued subscriber is behind and loses events
+#define UEVENT_QUEUE_MAX            64
+#define UEVENT_BATCH_SIZE           16
+
+//called on the hub thread, must not block nor (un)subscribe
+typedef void (*uevent_callback_t)(const uevent_data_t *ueventData, void *user);
+
+typedef struct uevent_sub_stats {
+    std::string name;
+    int64_t delivered;
+    int64_t maxQueued;              //deepest the queue got, at most UEVENT_QUEUE_MAX
+    int64_t coalesced;              //older state of the same switch replaced in a full queue
+    int64_t dropped;                //oldest event of another switch thrown out of a full queue
+    int64_t totalLatencyNs;         //receive to callback or dequeue
+    int64_t maxLatencyNs;
+} uevent_sub_stats_t;
+
+typedef struct uevent_hub_stats {
+    int64_t received;               //messages handed to the subscribers
+    int64_t reads;                  //recvmmsg calls
+    int64_t rejected;               //not from the kernel, or truncated
+} uevent_hub_stats_t;
+
+class UeventHub;
+struct uevent_batch;
+
+// ----------------------------------------------------------------------------
+class UeventSubscriber
+{
+public:
+    void addMatch(const char *matchStr, const char *devType = NULL);
+    void removeMatch(const char *matchStr);
+    //queue subscribers only, false on timeout, timeoutMs < 0 waits forever
+    bool waitForNextEvent(uevent_data_t *ueventData, int timeoutMs = -1);
+    void getStats(uevent_sub_stats_t *stats);
+
+private:
+    friend class UeventHub;
+
+    typedef struct queued_event {
+        uevent_data_t data;
+        int64_t recvNs;
+    } queued_event_t;
+
+    UeventSubscriber(const char *name, uevent_callback_t callback, void *user);
+    ~UeventSubscriber();
+    void deliver(const uevent_view_t *view, const char *buffer, int length, int64_t recvNs);
+    void account(int64_t recvNs);
+    void makeRoom(const uevent_data_t *data);
+
+    std::string mName;
+    UeventMatcher mMatcher;
+    uevent_callback_t mCallback;
+    void *mUser;
+
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;
+    std::deque<queued_event_t> mQueue;
+    uevent_sub_stats_t mStats;
+};
+
+// ----------------------------------------------------------------------------
+class UeventHub
+{
+public:
+    static UeventHub *getInstance();
+
+    //takes over fd, a netlink socket or a test stand in for one. Besides the
+    //kernel's, messages sent by trustedUid pass, tests inject as themselves
+    UeventHub(int fd, uid_t trustedUid = 0);
+    ~UeventHub();
+
+    //messages go to callback when given, otherwise to a queue drained
+    //through UeventSubscriber::waitForNextEvent()
+    UeventSubscriber *subscribe(const char *name, uevent_callback_t callback = NULL,
+        void *user = NULL);
+    //deletes sub, nobody may still be waiting on its queue
+    void unsubscribe(UeventSubscriber *sub);
+
+    int getFd();
+    void setLogLevel(int level);
+    int64_t getReceived();
+    void getHubStats(uevent_hub_stats_t *stats);
+    void getStats(std::vector<uevent_sub_stats_t> &stats);
+    int dump(char *result);
+
+    static int openNetlink();
+
+private:
+    static void *threadLoop(void *data);
+    void receive();
+    bool validate(int index);
+    void dispatch(int count, int64_t recvNs);
+    void print(const char *buffer, int length);
+
+    int mFd;
+    int mEpollFd;
+    int mWakeFd[2];
+    pthread_t mThread;
+    bool mThreadStarted;
+    int mLogLevel;
+    uid_t mTrustedUid;
+    struct uevent_batch *mBatch;
+    uevent_hub_stats_t mHubStats;
+
+    pthread_mutex_t mLock;
+    std::vector<UeventSubscriber *> mSubscribers;
+
+    static UeventHub *mInstance;
+};
+
+#endif /*_SYSTEM_CONTROL_UEVENT_HUB_H*/
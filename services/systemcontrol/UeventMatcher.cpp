@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 split a uevent message into key/value fields in one pass
+ *  - 2 match the fields against the registered patterns through a hash set
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+#include "common.h"
+#include "UeventMatcher.h"
+
+#define FNV_OFFSET                  2166136261u
+#define FNV_PRIME                   16777619u
+
+uint32_t ueventHash(const char *str, size_t len) {
+    uint32_t h = FNV_OFFSET;
+
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)str[i]) * FNV_PRIME;
+    return h;
+}
+
+int ueventParse(const char *buffer, size_t length, uevent_view_t *view) {
+    const char *field = buffer;
+    const char *end = buffer + length;
+
+    view->num = 0;
+    while (field < end && view->num < UEVENT_MAX_FIELDS) {
+        uevent_field_t *f = &view->fields[view->num];
+        const char *p = field;
+        uint32_t h = FNV_OFFSET;
+
+        f->key = field;
+        f->value = NULL;
+        //the key hash is the whole field hash taken at the first '='
+        while (p < end && *p != '\0') {
+            if (*p == '=' && f->value == NULL) {
+                f->keyHash = h;
+                f->keyLen = p - field;
+                f->value = p + 1;
+            }
+            h = (h ^ (unsigned char)*p) * FNV_PRIME;
+            p++;
+        }
+        f->hash = h;
+        f->len = p - field;
+        if (f->value == NULL) {
+            f->keyHash = h;
+            f->keyLen = f->len;
+        }
+
+        if (f->len > 0)
+            view->num++;
+        field = p + 1;
+    }
+
+    return view->num;
+}
+
+const char *ueventGetValue(const uevent_view_t *view, const char *key) {
+    size_t len = strlen(key);
+    uint32_t h = ueventHash(key, len);
+
+    for (int i = 0; i < view->num; i++) {
+        const uevent_field_t *f = &view->fields[i];
+        if (f->keyHash == h && f->keyLen == len && f->value != NULL
+            && !memcmp(f->key, key, len))
+            return f->value;
+    }
+    return NULL;
+}
+
+// ----------------------------------------------------------------------------
+UeventMatchSet::UeventMatchSet(const std::vector<uevent_pattern_t> &patterns)
+    :mPatterns(patterns) {
+    size_t size = 8;
+
+    while (size < patterns.size() * 2)
+        size *= 2;
+    mMask = size - 1;
+    mSlots.resize(size);
+    for (size_t i = 0; i < size; i++)
+        mSlots[i].order = -1;
+    mNext.assign(mPatterns.size(), -1);
+
+    for (size_t i = 0; i < mPatterns.size(); i++) {
+        const std::string &match = mPatterns[i].match;
+        uint32_t h = ueventHash(match.c_str(), match.size());
+        uint32_t slot = h & mMask;
+        bool duplicate = false;
+
+        while (mSlots[slot].order >= 0) {
+            int order = mSlots[slot].order;
+            if (mPatterns[order].match == match) {
+                //chain it behind the first one, in registration order
+                while (mNext[order] >= 0)
+                    order = mNext[order];
+                mNext[order] = i;
+                duplicate = true;
+                break;
+            }
+            slot = (slot + 1) & mMask;
+        }
+        if (duplicate)
+            continue;
+        mSlots[slot].hash = h;
+        mSlots[slot].order = i;
+    }
+}
+
+int UeventMatchSet::find(const uevent_field_t *field) const {
+    uint32_t slot = field->hash & mMask;
+
+    while (mSlots[slot].order >= 0) {
+        const Slot &s = mSlots[slot];
+        const std::string &p = mPatterns[s.order].match;
+        if (s.hash == field->hash && p.size() == field->len
+            && !memcmp(p.c_str(), field->key, field->len))
+            return s.order;
+        slot = (slot + 1) & mMask;
+    }
+    return -1;
+}
+
+int UeventMatchSet::next(int order) const {
+    return mNext[order];
+}
+
+const uevent_pattern_t &UeventMatchSet::pattern(int order) const {
+    return mPatterns[order];
+}
+
+// ----------------------------------------------------------------------------
+UeventMatcher::UeventMatcher()
+    :mSet(NULL),
+    mHazard(NULL) {
+    pthread_mutex_init(&mLock, NULL);
+    publish();
+}
+
+UeventMatcher::~UeventMatcher() {
+    delete mSet.load();
+    for (size_t i = 0; i < mRetired.size(); i++)
+        delete mRetired[i];
+    pthread_mutex_destroy(&mLock);
+}
+
+//called with mLock held, or from the constructor
+void UeventMatcher::publish() {
+    UeventMatchSet *set = new UeventMatchSet(mPatterns);
+    UeventMatchSet *old = mSet.exchange(set);
+
+    if (old != NULL)
+        mRetired.push_back(old);
+
+    //free everything the reader is not on right now
+    const UeventMatchSet *inUse = mHazard.load();
+    for (size_t i = 0; i < mRetired.size(); ) {
+        if (mRetired[i] != inUse) {
+            delete mRetired[i];
+            mRetired.erase(mRetired.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+int UeventMatcher::getRetiredCount() {
+    pthread_mutex_lock(&mLock);
+    int count = mRetired.size();
+    pthread_mutex_unlock(&mLock);
+    return count;
+}
+
+void UeventMatcher::addMatch(const char *matchStr, const char *devType) {
+    uevent_pattern_t pattern;
+
+    pattern.match = matchStr;
+    if (devType != NULL)
+        pattern.devType = devType;
+    pthread_mutex_lock(&mLock);
+    mPatterns.push_back(pattern);
+    publish();
+    pthread_mutex_unlock(&mLock);
+}
+
+void UeventMatcher::removeMatch(const char *matchStr) {
+    pthread_mutex_lock(&mLock);
+    for (size_t i = 0; i < mPatterns.size(); i++) {
+        if (mPatterns[i].match == matchStr) {
+            mPatterns.erase(mPatterns.begin() + i);
+            publish();
+            break; // only remove first occurrence
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+bool UeventMatcher::match(const char *buffer, size_t length, uevent_data_t *ueventData) {
+    uevent_view_t view;
+
+    ueventParse(buffer, length, &view);
+    return match(&view, buffer, length, ueventData);
+}
+
+bool UeventMatcher::match(const uevent_view_t *view, const char *buffer, size_t length,
+    uevent_data_t *ueventData) {
+    const UeventMatchSet *set = mSet.load();
+
+    //publish the hazard, then make sure the set was not retired meanwhile
+    while (true) {
+        mHazard.store(set);
+        const UeventMatchSet *current = mSet.load();
+        if (current == set)
+            break;
+        set = current;
+    }
+
+    bool matched = match(set, view, buffer, length, ueventData);
+    mHazard.store(NULL);
+    return matched;
+}
+
+bool UeventMatcher::match(const UeventMatchSet *set, const uevent_view_t *view,
+    const char *buffer, size_t length, uevent_data_t *ueventData) {
+    const char *devType = NULL;
+    bool devTypeParsed = false;
+    int best = -1;
+
+    for (int i = 0; i < view->num; i++) {
+        const uevent_field_t *f = &view->fields[i];
+        int order = set->find(f);
+
+        if (order >= 0) {
+            for (; order >= 0; order = set->next(order)) {
+                const std::string &want = set->pattern(order).devType;
+                if (want.empty())
+                    break;
+                if (!devTypeParsed) {
+                    devType = ueventGetValue(view, "DEVTYPE");
+                    devTypeParsed = true;
+                }
+                if (devType != NULL && want == devType)
+                    break;
+            }
+            //the pattern registered first wins, as the old list walk did
+            if (order >= 0 && (best < 0 || order < best))
+                best = order;
+            continue;
+        }
+        if (f->keyLen == 19 && !memcmp(f->key, "FRAME_RATE_END_HINT", 19)) {
+            strcpy(ueventData->switchName, "end_hint");
+            continue;
+        }
+        if (f->value == NULL)
+            continue;
+
+        //SWITCH_STATE=1, SWITCH_NAME=hdmi
+        if (f->keyLen == 5 && !memcmp(f->key, "STATE", 5) && !strncmp(f->value, "HDMI=", 5))
+            strncpy(ueventData->switchState, f->value + 5, sizeof(ueventData->switchState) - 1);
+        else if (f->keyLen == 7 && !memcmp(f->key, "DEVTYPE", 7))
+            strncpy(ueventData->switchName, f->value, sizeof(ueventData->switchName) - 1);
+        else if (f->keyLen == 15 && !memcmp(f->key, "FRAME_RATE_HINT", 15))
+            strncpy(ueventData->switchName, f->value, sizeof(ueventData->switchName) - 1);
+    }
+
+    if (best < 0)
+        return false;
+
+    const char *matchName = set->pattern(best).match.c_str();
+    SYS_LOGI("Matched uevent message with pattern: %s", matchName);
+    strncpy(ueventData->matchName, matchName, sizeof(ueventData->matchName) - 1);
+    ueventData->len = length;
+    memcpy(ueventData->buf, buffer, length < sizeof(ueventData->buf) ? length : sizeof(ueventData->buf));
+    return true;
+}
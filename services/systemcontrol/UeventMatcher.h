@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 split a uevent message into key/value fields in one pass
+ *  - 2 match the fields against the registered patterns through a hash set
+ *  - 3 free a replaced pattern set as soon as the matching thread left it
+ */
+
+#ifndef _SYSTEM_CONTROL_UEVENT_MATCHER_H
+#define _SYSTEM_CONTROL_UEVENT_MATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#define UEVENT_MAX_FIELDS           64
+//a page, the kernel uevent buffer is half of it
+#define UEVENT_MSG_LEN              4096
+
+typedef struct uevent_data {
+    int len;
+    char buf[UEVENT_MSG_LEN];
+    char matchName[256];
+    char switchName[64];
+    char switchState[64];
+} uevent_data_t;
+
+//points into the message buffer, nothing is copied
+typedef struct uevent_field {
+    const char *key;                //whole field, "KEY=value"
+    const char *value;              //after the first '=', NULL without one
+    uint16_t keyLen;
+    uint16_t len;
+    uint32_t keyHash;
+    uint32_t hash;                  //of the whole field
+} uevent_field_t;
+
+typedef struct uevent_view {
+    int num;
+    uevent_field_t fields[UEVENT_MAX_FIELDS];
+} uevent_view_t;
+
+//returns the number of fields, the first one is the "action@devpath" header
+int ueventParse(const char *buffer, size_t length, uevent_view_t *view);
+uint32_t ueventHash(const char *str, size_t len);
+//value of key, NULL when the message has no such field
+const char *ueventGetValue(const uevent_view_t *view, const char *key);
+
+typedef struct uevent_pattern {
+    std::string match;              //whole field, "DEVPATH=/devices/..."
+    std::string devType;            //DEVTYPE value the message must carry, empty for any
+} uevent_pattern_t;
+
+// ----------------------------------------------------------------------------
+//immutable set of patterns, rebuilt on every addMatch()/removeMatch()
+class UeventMatchSet
+{
+public:
+    UeventMatchSet(const std::vector<uevent_pattern_t> &patterns);
+
+    //registration order of the first pattern equal to the field, -1 for none
+    int find(const uevent_field_t *field) const;
+    //next pattern with the same match string but another DEVTYPE, -1 for none
+    int next(int order) const;
+    const uevent_pattern_t &pattern(int order) const;
+
+private:
+    struct Slot {
+        uint32_t hash;
+        int order;                  //-1 for an empty slot
+    };
+
+    std::vector<uevent_pattern_t> mPatterns;
+    std::vector<int> mNext;
+    std::vector<Slot> mSlots;
+    uint32_t mMask;
+};
+
+// ----------------------------------------------------------------------------
+class UeventMatcher
+{
+public:
+    UeventMatcher();
+    ~UeventMatcher();
+
+    void addMatch(const char *matchStr, const char *devType = NULL);
+    void removeMatch(const char *matchStr);
+    //lock free, safe against concurrent addMatch()/removeMatch(). Only one
+    //thread may match, the set it reads is guarded by a single hazard pointer
+    bool match(const char *buffer, size_t length, uevent_data_t *ueventData);
+    //same for a message already split by ueventParse()
+    bool match(const uevent_view_t *view, const char *buffer, size_t length,
+        uevent_data_t *ueventData);
+    //replaced sets not freed yet, at most the one the reader is on
+    int getRetiredCount();
+
+private:
+    void publish();
+    bool match(const UeventMatchSet *set, const uevent_view_t *view, const char *buffer,
+        size_t length, uevent_data_t *ueventData);
+
+    pthread_mutex_t mLock;
+    std::vector<uevent_pattern_t> mPatterns;
+    std::atomic<UeventMatchSet *> mSet;
+    std::atomic<const UeventMatchSet *> mHazard;
+    //replaced sets the reader may still hold
+    std::vector<UeventMatchSet *> mRetired;
+};
+
+#endif /*_SYSTEM_CONTROL_UEVENT_MATCHER_H*/
@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 keep the unifykey nodes and the key device open for many keys
+ *  - 2 select each key name once, then read or write its value
+ *  - 3 query the key_item_info_t of a key once
+ */
+
+#define LOG_TAG "SystemControl"
+//#define LOG_NDEBUG 0
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "UnifyKeySession.h"
+#include "common.h"
+
+typedef struct unifykey_node {
+    const char *name;               //under the unifykey dir, NULL for the device
+    int flags;
+    bool optional;                  //not every kernel has it
+} unifykey_node_t;
+
+static const unifykey_node_t sNodes[UNIFYKEY_NODE_COUNT] = {
+    { "attach", O_WRONLY, false },
+    { "name",   O_WRONLY, false },
+    { "exist",  O_RDONLY, false },
+    { "read",   O_RDONLY, false },
+    { "write",  O_WRONLY, false },
+    { "lock",   O_RDWR,   true },
+    { "list",   O_RDONLY, true },
+    { NULL,     O_RDWR,   true },
+};
+
+static int sysRead(int node, int fd, char *buf, int count, off_t offset) {
+    return pread(fd, buf, count, offset);
+}
+
+static int sysWrite(int node, int fd, const char *buf, int count, off_t offset) {
+    return pwrite(fd, buf, count, offset);
+}
+
+static int sysGetInfo(int fd, struct key_item_info_t *info) {
+    return ioctl(fd, KEYUNIFY_GET_INFO, info);
+}
+
+static const unifykey_io_t sSysIo = {
+    sysRead,
+    sysWrite,
+    sysGetInfo,
+};
+
+UnifyKeySession::UnifyKeySession(const char *dir, const char *dev, const unifykey_io_t *io)
+    :mDir(dir),
+    mDev(dev),
+    mIo(io != NULL ? io : &sSysIo) {
+    for (int i = 0; i < UNIFYKEY_NODE_COUNT; i++)
+        mFds[i] = -1;
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+UnifyKeySession::~UnifyKeySession() {
+    close();
+}
+
+int UnifyKeySession::open() {
+    if (isOpen())
+        return 0;
+
+    for (int i = 0; i < UNIFYKEY_NODE_COUNT; i++) {
+        std::string path = sNodes[i].name != NULL ? mDir + "/" + sNodes[i].name : mDev;
+
+        mFds[i] = ::open(path.c_str(), sNodes[i].flags | O_CLOEXEC);
+        if (mFds[i] < 0) {
+            int err = errno;
+            if (sNodes[i].optional)
+                continue;
+            SYS_LOGE("unifykey session open %s fail: %s\n", path.c_str(), strerror(err));
+            close();
+            return -err;
+        }
+        mStats.opens++;
+    }
+
+    if (writeNode(UNIFYKEY_NODE_ATTACH, "1", 1) != 1) {
+        SYS_LOGE("unifykey session attach fail: %s\n", strerror(errno));
+        close();
+        return -EIO;
+    }
+    return 0;
+}
+
+void UnifyKeySession::close() {
+    for (int i = 0; i < UNIFYKEY_NODE_COUNT; i++) {
+        if (mFds[i] >= 0)
+            ::close(mFds[i]);
+        mFds[i] = -1;
+    }
+    mInfo.clear();
+}
+
+bool UnifyKeySession::isOpen() const {
+    return mFds[UNIFYKEY_NODE_NAME] >= 0;
+}
+
+int UnifyKeySession::readNode(int node, char *buf, int count) {
+    if (mFds[node] < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    return mIo->read(node, mFds[node], buf, count, 0);
+}
+
+int UnifyKeySession::writeNode(int node, const char *buf, int count) {
+    if (mFds[node] < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    return mIo->write(node, mFds[node], buf, count, 0);
+}
+
+int UnifyKeySession::select(const char *name) {
+    int len = strlen(name);
+
+    if (!isOpen())
+        return -1;
+
+    mStats.selects++;
+    if (writeNode(UNIFYKEY_NODE_NAME, name, len) != len) {
+        SYS_LOGE("unifykey select %s fail: %s\n", name, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+bool UnifyKeySession::selectedExists() {
+    char buf[16] = {0};
+
+    if (readNode(UNIFYKEY_NODE_EXIST, buf, sizeof(buf) - 1) <= 0)
+        return false;
+    return atoi(buf) != 0;
+}
+
+//kernels without the lock node have nothing to wait for
+bool UnifyKeySession::waitUnlocked() {
+    char buf[16];
+
+    if (mFds[UNIFYKEY_NODE_LOCK] < 0)
+        return true;
+
+    for (int waited = 0; waited < UNIFYKEY_LOCK_WAIT_MS; waited += 5) {
+        memset(buf, 0, sizeof(buf));
+        if (readNode(UNIFYKEY_NODE_LOCK, buf, sizeof(buf) - 1) <= 0 || atoi(buf) == 0)
+            return true;
+        usleep(5 * 1000);
+    }
+    return false;
+}
+
+int UnifyKeySession::list(std::vector<std::string> &names) {
+    char buf[UNIFYKEY_VALUE_LEN + 1] = {0};
+
+    names.clear();
+    int len = readNode(UNIFYKEY_NODE_LIST, buf, UNIFYKEY_VALUE_LEN);
+    if (len < 0)
+        return -1;
+
+    //one key per line, the name is the last word ("usid" or "0: usid")
+    char *save = NULL;
+    for (char *line = strtok_r(buf, "\n", &save); line != NULL; line = strtok_r(NULL, "\n", &save)) {
+        char *word = strrchr(line, ' ');
+        word = word != NULL ? word + 1 : line;
+        if (*word != '\0')
+            names.push_back(word);
+    }
+    return names.size();
+}
+
+bool UnifyKeySession::exists(const char *name) {
+    if (select(name) < 0)
+        return false;
+    return selectedExists();
+}
+
+int UnifyKeySession::getInfo(const char *name, struct key_item_info_t *info) {
+    std::map<std::string, struct key_item_info_t>::iterator it = mInfo.find(name);
+
+    if (it != mInfo.end()) {
+        *info = it->second;
+        return 0;
+    }
+    if (mFds[UNIFYKEY_NODE_DEV] < 0 || strlen(name) >= KEY_UNIFY_NAME_LEN)
+        return -1;
+
+    memset(info, 0, sizeof(*info));
+    strcpy(info->name, name);
+    mStats.infoQueries++;
+    int ret = mIo->getInfo(mFds[UNIFYKEY_NODE_DEV], info);
+    if (ret < 0) {
+        SYS_LOGE("unifykey get info of %s fail: %s\n", name, strerror(errno));
+        return ret;
+    }
+    mInfo[name] = *info;
+    return 0;
+}
+
+int UnifyKeySession::read(const char *name, std::string &value) {
+    char buf[UNIFYKEY_VALUE_LEN];
+
+    value.clear();
+    if (select(name) < 0)
+        return -1;
+    if (!selectedExists()) {
+        SYS_LOGE("unifykey %s is not in the storage\n", name);
+        return -1;
+    }
+
+    int len = readNode(UNIFYKEY_NODE_READ, buf, sizeof(buf));
+    if (len < 1) {
+        SYS_LOGE("unifykey read %s fail, len = %d\n", name, len);
+        return -1;
+    }
+    value.assign(buf, len);
+    return 0;
+}
+
+int UnifyKeySession::write(const char *name, const std::string &value) {
+    int len = value.size();
+    int ret = 0;
+
+    if (select(name) < 0)
+        return -1;
+    if (!waitUnlocked()) {
+        SYS_LOGE("unifykey storage stays locked, skip %s\n", name);
+        return -1;
+    }
+
+    writeNode(UNIFYKEY_NODE_LOCK, "1", 1);
+    if (writeNode(UNIFYKEY_NODE_WRITE, value.data(), len) != len) {
+        SYS_LOGE("unifykey write %s fail: %s\n", name, strerror(errno));
+        ret = -1;
+    } else if (!selectedExists()) {
+        SYS_LOGE("unifykey %s did not reach the storage\n", name);
+        ret = -1;
+    }
+    writeNode(UNIFYKEY_NODE_LOCK, "0", 1);
+
+    //size and flag of the key changed
+    mInfo.erase(name);
+    return ret;
+}
+
+int UnifyKeySession::readMany(const std::vector<std::string> &names,
+    std::vector<std::string> &values) {
+    int failed = 0;
+
+    values.assign(names.size(), std::string());
+    for (size_t i = 0; i < names.size(); i++) {
+        if (read(names[i].c_str(), values[i]) < 0)
+            failed++;
+    }
+    return failed;
+}
+
+int UnifyKeySession::writeMany(const std::vector<std::string> &names,
+    const std::vector<std::string> &values) {
+    int failed = 0;
+
+    if (names.size() != values.size())
+        return names.size();
+
+    for (size_t i = 0; i < names.size(); i++) {
+        if (write(names[i].c_str(), values[i]) < 0)
+            failed++;
+    }
+    return failed;
+}
+
+int UnifyKeySession::readDevice(const char *name, char *buf, int size) {
+    struct key_item_info_t info;
+
+    int ret = getInfo(name, &info);
+    if (ret < 0)
+        return ret;
+    if (!info.flag)
+        return 0;
+
+    int count = (int)info.size < size ? (int)info.size : size;
+    return mIo->read(UNIFYKEY_NODE_DEV, mFds[UNIFYKEY_NODE_DEV], buf, count, info.id);
+}
+
+int UnifyKeySession::writeDevice(const char *name, const char *buf, int size) {
+    struct key_item_info_t info;
+
+    int ret = getInfo(name, &info);
+    if (ret < 0)
+        return ret;
+
+    int written = mIo->write(UNIFYKEY_NODE_DEV, mFds[UNIFYKEY_NODE_DEV], buf, size, info.id);
+    mInfo.erase(name);
+    if (written != size) {
+        SYS_LOGE("unifykey write %s to the device fail: %d of %d\n", name, written, size);
+        return -1;
+    }
+    return 0;
+}
+
+void UnifyKeySession::getStats(unifykey_session_stats_t *stats) {
+    *stats = mStats;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 keep the unifykey nodes and the key device open for many keys
+ *  - 2 select each key name once, then read or write its value
+ *  - 3 query the key_item_info_t of a key once
+ */
+
+#ifndef UNIFY_KEY_SESSION_H
+#define UNIFY_KEY_SESSION_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "SysWrite.h"
+
+#define UNIFYKEY_DIR            "/sys/class/unifykeys"
+#define UNIFYKEY_DEV            "/dev/unifykeys"
+#define UNIFYKEY_VALUE_LEN      4096
+//how long a write waits for another writer to unlock the key storage
+#define UNIFYKEY_LOCK_WAIT_MS   1000
+
+enum {
+    UNIFYKEY_NODE_ATTACH,
+    UNIFYKEY_NODE_NAME,
+    UNIFYKEY_NODE_EXIST,
+    UNIFYKEY_NODE_READ,
+    UNIFYKEY_NODE_WRITE,
+    UNIFYKEY_NODE_LOCK,
+    UNIFYKEY_NODE_LIST,
+    UNIFYKEY_NODE_DEV,
+    UNIFYKEY_NODE_COUNT,
+};
+
+//node access, the syscalls on the device and an emulation in the tests
+typedef struct unifykey_io {
+    int (*read)(int node, int fd, char *buf, int count, off_t offset);
+    int (*write)(int node, int fd, const char *buf, int count, off_t offset);
+    int (*getInfo)(int fd, struct key_item_info_t *info);
+} unifykey_io_t;
+
+typedef struct unifykey_session_stats {
+    unsigned int opens;
+    unsigned int selects;           //key names written to the name node
+    unsigned int infoQueries;       //KEYUNIFY_GET_INFO ioctls
+} unifykey_session_stats_t;
+
+class UnifyKeySession
+{
+public:
+    UnifyKeySession(const char *dir = UNIFYKEY_DIR, const char *dev = UNIFYKEY_DEV,
+        const unifykey_io_t *io = NULL);
+    ~UnifyKeySession();
+
+    //opens every node and attaches once, 0 or -errno
+    int open();
+    void close();
+    bool isOpen() const;
+    const char *getDevice() const { return mDev.c_str(); }
+
+    int list(std::vector<std::string> &names);
+    bool exists(const char *name);
+    //the first query goes to the device, later ones are answered from memory
+    int getInfo(const char *name, struct key_item_info_t *info);
+
+    //through the sysfs nodes, one name select per key, 0 or -1
+    int read(const char *name, std::string &value);
+    int write(const char *name, const std::string &value);
+    //returns the number of failed keys
+    int readMany(const std::vector<std::string> &names, std::vector<std::string> &values);
+    int writeMany(const std::vector<std::string> &names, const std::vector<std::string> &values);
+
+    //through the key device at the offset of the key, as the attestation keys
+    int readDevice(const char *name, char *buf, int size);
+    int writeDevice(const char *name, const char *buf, int size);
+
+    void getStats(unifykey_session_stats_t *stats);
+
+private:
+    int select(const char *name);
+    int readNode(int node, char *buf, int count);
+    int writeNode(int node, const char *buf, int count);
+    bool selectedExists();
+    bool waitUnlocked();
+
+    std::string mDir;
+    std::string mDev;
+    const unifykey_io_t *mIo;
+    int mFds[UNIFYKEY_NODE_COUNT];
+    std::map<std::string, struct key_item_info_t> mInfo;
+    unifykey_session_stats_t mStats;
+};
+
+#endif // UNIFY_KEY_SESSION_H
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 sample the source 3d format of the video when its frame info changes
+ *  - 2 decide once the same format comes twice in a row, stop sampling then
+ *  - 3 vote on what was sampled when that does not happen within a second
+ */
+
+#define LOG_TAG "Dimension"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "Video3DDetector.h"
+#include "common.h"
+
+static const detect_3d_config_t sDefaultConfig = {
+    2,          //confirmSamples
+    5,          //maxSamples, the samples detect3DThread() took
+    20,         //minIntervalMs
+    200,        //sampleIntervalMs, the sleep between those samples
+    1000,       //deadlineMs
+};
+
+const detect_3d_config_t *Video3DDetector::getDefaultConfig() {
+    return &sDefaultConfig;
+}
+
+int64_t Video3DDetector::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+Video3DDetector::Video3DDetector(const detect_3d_config_t *config, Source *source)
+    :mConfig(*config),
+    mSource(source) {
+    if (mConfig.maxSamples > DETECT_3D_SAMPLES_MAX)
+        mConfig.maxSamples = DETECT_3D_SAMPLES_MAX;
+    reset();
+}
+
+void Video3DDetector::reset() {
+    memset(mSamples, 0, sizeof(mSamples));
+    mCount = 0;
+    mRun = 0;
+    mDecided = false;
+    mFormat = DETECT_3D_FORMAT_OFF;
+}
+
+bool Video3DDetector::addSample(int format) {
+    if (mDecided)
+        return true;
+
+    if (mCount > 0 && mSamples[mCount - 1] == format)
+        mRun++;
+    else
+        mRun = 1;
+    if (mCount < DETECT_3D_SAMPLES_MAX)
+        mSamples[mCount++] = format;
+
+    if (mRun >= mConfig.confirmSamples) {
+        mFormat = format;
+        mDecided = true;
+    } else if (mCount >= mConfig.maxSamples) {
+        mFormat = vote();
+        mDecided = true;
+    }
+    return mDecided;
+}
+
+//the format more than half of the samples agree on, 3d off without one
+int Video3DDetector::vote() const {
+    for (int i = 0; i < mCount; i++) {
+        int times = 0;
+        for (int j = 0; j < mCount; j++) {
+            if (mSamples[j] == mSamples[i])
+                times++;
+        }
+        if (times * 2 > mCount)
+            return mSamples[i];
+    }
+    return DETECT_3D_FORMAT_OFF;
+}
+
+int Video3DDetector::detect(detect_3d_result_t *result) {
+    int64_t startNs = now();
+    int64_t deadlineNs = startNs + (int64_t)mConfig.deadlineMs * 1000000;
+    int frameChanges = 0;
+
+    reset();
+    while (!addSample(mSource->sample3DFormat())) {
+        int64_t sampleNs = now();
+        int leftMs = (int)((deadlineNs - sampleNs + 999999) / 1000000);
+        if (leftMs <= 0)
+            break;
+
+        bool changed = mSource->waitFrameChange(leftMs < mConfig.sampleIntervalMs ? leftMs : mConfig.sampleIntervalMs);
+        if (changed) {
+            frameChanges++;
+            //the decoder may report a few frames at once, let the format settle
+            int64_t holdUs = (sampleNs + (int64_t)mConfig.minIntervalMs * 1000000 - now()) / 1000;
+            if (holdUs > 0)
+                usleep(holdUs);
+        }
+        if (now() >= deadlineNs)
+            break;
+    }
+    if (!mDecided) {
+        mFormat = vote();
+        mDecided = true;
+    }
+
+    bool confirmed = mRun >= mConfig.confirmSamples;
+    int64_t latencyUs = (now() - startNs) / 1000;
+    SYS_LOGI("3d format %d %s after %d samples, %d on frame changes, %lldms\n", mFormat,
+        confirmed ? "confirmed" : "voted", mCount, frameChanges, (long long)latencyUs / 1000);
+    if (result != NULL) {
+        result->format = mFormat;
+        result->samples = mCount;
+        result->frameChanges = frameChanges;
+        result->confirmed = confirmed;
+        result->latencyUs = latencyUs;
+    }
+    return mFormat;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *  @par function description:
+ *  - 1 sample the source 3d format of the video when its frame info changes
+ *  - 2 decide once the same format comes twice in a row, stop sampling then
+ *  - 3 vote on what was sampled when that does not happen within a second
+ */
+
+#ifndef VIDEO_3D_DETECTOR_H
+#define VIDEO_3D_DETECTOR_H
+
+#include <stdint.h>
+
+#define DETECT_3D_SAMPLES_MAX           16
+//FORMAT_3D_OFF of Dimension.h, what a vote with no majority gives
+#define DETECT_3D_FORMAT_OFF            0
+
+typedef struct detect_3d_config {
+    int confirmSamples;             //the same format this many times in a row decides
+    int maxSamples;                 //vote after this many samples
+    int minIntervalMs;              //frame changes closer than this are one sample
+    int sampleIntervalMs;           //sample anyway when no frame change comes
+    int deadlineMs;                 //vote on what was sampled by then
+} detect_3d_config_t;
+
+typedef struct detect_3d_result {
+    int format;
+    int samples;
+    int frameChanges;               //samples taken on a frame change, the others on the timer
+    bool confirmed;                 //by samples in a row, false when it was voted
+    int64_t latencyUs;
+} detect_3d_result_t;
+
+class Video3DDetector
+{
+public:
+    class Source {
+    public:
+        Source() {};
+        virtual ~Source() {};
+        //FORMAT_3D_*, what the video decoder reports now
+        virtual int sample3DFormat() = 0;
+        //true when the frame info changed within timeoutMs, false on timeout
+        virtual bool waitFrameChange(int timeoutMs) = 0;
+    };
+
+    static const detect_3d_config_t *getDefaultConfig();
+    static int64_t now();
+
+    Video3DDetector(const detect_3d_config_t *config, Source *source);
+
+    //blocks the caller until a format is decided, never longer than deadlineMs
+    int detect(detect_3d_result_t *result);
+
+    //the filter detect() runs, true once decided
+    void reset();
+    bool addSample(int format);
+    //decide on the samples so far
+    int vote() const;
+    bool isDecided() const { return mDecided; }
+    int getFormat() const { return mFormat; }
+
+private:
+    detect_3d_config_t mConfig;
+    Source *mSource;
+
+    int mSamples[DETECT_3D_SAMPLES_MAX];
+    int mCount;
+    int mRun;                       //the last sample and the ones equal to it before
+    bool mDecided;
+    int mFormat;
+};
+
+#endif // VIDEO_3D_DETECTOR_H
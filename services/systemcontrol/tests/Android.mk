@@ -29,3 +29,346 @@ LOCAL_PROPRIETARY_MODULE := true
 endif
 
 include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	systemcontrolbatchtest.cpp \
+	../SysWrite.cpp \
+	../SysfsFdCache.cpp \
+	../SysfsBatch.cpp \
+	../PropertyCache.cpp \
+	../UnifyKeySession.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	libutils  \
+	liblog \
+	libsystemcontrolservice
+
+LOCAL_SHARED_LIBRARIES += \
+  vendor.amlogic.hardware.systemcontrol@1.1 \
+  libbase \
+  libhidlbase \
+  libhidltransport
+
+LOCAL_C_INCLUDES += \
+  $(BOARD_AML_VENDOR_PATH)/frameworks/services/systemcontrol/PQ/include
+
+LOCAL_MODULE:= test-systemcontrol-batch
+
+LOCAL_MODULE_TAGS := optional
+
+ifeq ($(shell test $(PLATFORM_SDK_VERSION) -ge 26 && echo OK),OK)
+LOCAL_PROPRIETARY_MODULE := true
+endif
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	sysfsfdcachetest.cpp \
+	../SysfsFdCache.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-sysfs-fd-cache
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	sysfsbatchtest.cpp \
+	../SysfsBatch.cpp \
+	../SysfsFdCache.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-sysfs-batch
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	ueventmatchertest.cpp \
+	../UeventMatcher.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-uevent-matcher
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	ueventhubtest.cpp \
+	../UeventHub.cpp \
+	../UeventMatcher.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-uevent-hub
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	serviceconnectortest.cpp \
+	../ServiceConnector.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-service-connector
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	propertycachetest.cpp \
+	../PropertyCache.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-property-cache
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	unifykeysessiontest.cpp \
+	../UnifyKeySession.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-unifykey-session
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	displaymoderegistrytest.cpp \
+	../DisplayModeRegistry.cpp \
+	../SinkCaps.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-display-mode-registry
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	sinkcapstest.cpp \
+	../SinkCaps.cpp \
+	../DisplayModeRegistry.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-sink-caps
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	modeswitchsequencertest.cpp \
+	../ModeSwitchSequencer.cpp \
+	../ModeSwitchTracer.cpp \
+	../SysfsBatch.cpp \
+	../SysfsFdCache.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-mode-switch-sequencer
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	modeswitchtracertest.cpp \
+	../ModeSwitchTracer.cpp \
+	../ModeSwitchSequencer.cpp \
+	../SysfsBatch.cpp \
+	../SysfsFdCache.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-mode-switch-tracer
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	bootwatchertest.cpp \
+	../BootWatcher.cpp \
+	../PropertyCache.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-boot-watcher
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	hotplugdebouncertest.cpp \
+	../HotplugDebouncer.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-hotplug-debouncer
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	dolbyvisionswitchtest.cpp \
+	../DolbyVisionSwitch.cpp \
+	../SinkCaps.cpp \
+	../DisplayModeRegistry.cpp \
+	../SysfsBatch.cpp \
+	../SysfsFdCache.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-dolby-vision-switch
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	deepcolortabletest.cpp \
+	../DeepColorTable.cpp \
+	../SinkCaps.cpp \
+	../DisplayModeRegistry.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-deep-color-table
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	framerateautoadaptiontest.cpp \
+	../FrameRateAutoAdaption.cpp \
+	../SinkCaps.cpp \
+	../DisplayModeRegistry.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-frame-rate-auto-adaption
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	video3ddetectortest.cpp \
+	../Video3DDetector.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog
+
+LOCAL_CPPFLAGS += -std=c++14
+
+LOCAL_MODULE:= test-video-3d-detector
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Runs the BootWatcher over a fake property area whose wait blocks on a
+ * condition like __system_property_wait() does on its futex. A script thread
+ * plays a boot: boot animation starting early, late and never, boot video
+ * stopping in time and never, recovery, and a property defined only after
+ * the watcher started looking for it. Checks the order of the callbacks,
+ * the milestone times and that the watcher only wakes on changes, then
+ * prints its wakeups against the 100ms polls of the old detect threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../BootWatcher.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+struct prop_info {
+    char value[PROPERTY_CACHE_VALUE_LEN];
+    uint32_t serial;
+};
+
+static pthread_mutex_t gAreaLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gAreaCond = PTHREAD_COND_INITIALIZER;
+static std::map<std::string, prop_info *> gArea;
+//bumped on every set, what a NULL pi waits on
+static uint32_t gGlobalSerial = 1;
+
+static const prop_info *fakeFind(const char *name) {
+    pthread_mutex_lock(&gAreaLock);
+    std::map<std::string, prop_info *>::iterator it = gArea.find(name);
+    prop_info *pi = it == gArea.end() ? NULL : it->second;
+    pthread_mutex_unlock(&gAreaLock);
+    return pi;
+}
+
+static uint32_t fakeSerial(const prop_info *pi) {
+    pthread_mutex_lock(&gAreaLock);
+    uint32_t serial = pi->serial;
+    pthread_mutex_unlock(&gAreaLock);
+    return serial;
+}
+
+static int fakeRead(const prop_info *pi, char *value) {
+    pthread_mutex_lock(&gAreaLock);
+    strcpy(value, pi->value);
+    pthread_mutex_unlock(&gAreaLock);
+    return strlen(value);
+}
+
+static uint32_t fakeAreaSerial(void) {
+    pthread_mutex_lock(&gAreaLock);
+    uint32_t serial = gGlobalSerial;
+    pthread_mutex_unlock(&gAreaLock);
+    return serial;
+}
+
+static bool fakeWait(const prop_info *pi, uint32_t oldSerial, uint32_t *newSerial,
+        const struct timespec *timeout) {
+    struct timespec deadline;
+    bool changed = true;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout->tv_sec;
+    deadline.tv_nsec += timeout->tv_nsec;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&gAreaLock);
+    while ((pi != NULL ? pi->serial : gGlobalSerial) == oldSerial) {
+        if (pthread_cond_timedwait(&gAreaCond, &gAreaLock, &deadline) != 0) {
+            changed = false;
+            break;
+        }
+    }
+    *newSerial = pi != NULL ? pi->serial : gGlobalSerial;
+    pthread_mutex_unlock(&gAreaLock);
+    return changed;
+}
+
+static const property_backend_t sFakeBackend = {
+    fakeFind,
+    fakeSerial,
+    fakeRead,
+    fakeAreaSerial,
+    fakeWait,
+};
+
+static void setProp(const char *name, const char *value) {
+    pthread_mutex_lock(&gAreaLock);
+    std::map<std::string, prop_info *>::iterator it = gArea.find(name);
+    prop_info *pi;
+    if (it == gArea.end()) {
+        pi = new prop_info();
+        pi->serial = 0;
+        gArea[name] = pi;
+    } else {
+        pi = it->second;
+    }
+    strcpy(pi->value, value);
+    pi->serial += 2;
+    gGlobalSerial++;
+    pthread_cond_broadcast(&gAreaCond);
+    pthread_mutex_unlock(&gAreaLock);
+}
+
+static void clearProps() {
+    pthread_mutex_lock(&gAreaLock);
+    for (std::map<std::string, prop_info *>::iterator it = gArea.begin(); it != gArea.end(); ++it)
+        delete it->second;
+    gArea.clear();
+    gGlobalSerial++;
+    pthread_mutex_unlock(&gAreaLock);
+}
+
+typedef struct boot_event {
+    int atMs;
+    const char *name;
+    const char *value;
+} boot_event_t;
+
+typedef struct boot_script {
+    const boot_event_t *events;
+    int count;
+    int64_t startNs;
+} boot_script_t;
+
+static void *playScript(void *data) {
+    boot_script_t *script = (boot_script_t *)data;
+
+    for (int i = 0; i < script->count; i++) {
+        int64_t atNs = script->startNs + (int64_t)script->events[i].atMs * 1000000;
+        int64_t leftNs = atNs - BootWatcher::now();
+        if (leftNs > 0)
+            usleep(leftNs / 1000);
+        setProp(script->events[i].name, script->events[i].value);
+    }
+    return NULL;
+}
+
+class Recorder : public BootWatcher::Callback {
+public:
+    Recorder(int64_t originNs) : mOriginNs(originNs) {}
+    virtual void onBootanimStatus(int status) {
+        record("status");
+    }
+    virtual void onLogoHandover(bool bootvideo) {
+        record(bootvideo ? "handover video" : "handover");
+    }
+    virtual void onBootAnimFinished() {
+        record("finished");
+    }
+
+    std::string mOrder;
+    std::vector<int64_t> mAtMs;
+
+private:
+    void record(const char *what) {
+        if (!mOrder.empty())
+            mOrder += ", ";
+        mOrder += what;
+        mAtMs.push_back((BootWatcher::now() - mOriginNs) / 1000000);
+    }
+    int64_t mOriginNs;
+};
+
+//the default config shrunk 20 times, the order of things is what matters
+static const boot_watch_config_t sConfig = {
+    200,        //bootanimStartMs
+    50,         //firstFrameMs
+    5,          //defaultDelayMs
+    50,         //logoHandoverMs
+    600,        //bootvideoMaxMs
+};
+
+typedef struct boot_case {
+    const char *name;
+    boot_event_t events[6];
+    int count;
+    const char *order;
+    int minDoneMs;                  //earliest the watcher may be done
+    int maxDoneMs;
+} boot_case_t;
+
+static const boot_case_t sCases[] = {
+    {
+        "bootanim at 30ms",
+        { { 0, "const.bootanim.delay", "10" }, { 30, "init.svc.bootanim", "running" } }, 2,
+        "status, finished",
+        30 + 10 + 50, 30 + 10 + 50 + 30,
+    },
+    {
+        //delay unset, the watcher looked up a name that is not defined yet
+        "bootanim defined late",
+        { { 120, "init.svc.bootanim", "running" } }, 1,
+        "status, finished",
+        120 + 5 + 50, 120 + 5 + 50 + 30,
+    },
+    {
+        "bootanim never",
+        { { 0, "init.svc.bootanim", "stopped" } }, 1,
+        "status, finished",
+        200 + 5 + 50, 200 + 5 + 50 + 30,
+    },
+    {
+        "bootvideo stops at 400ms",
+        { { 0, "service.bootvideo", "1" }, { 0, "init.svc.bootvideo", "running" },
+            { 400, "init.svc.bootvideo", "stopped" } }, 3,
+        "handover video, finished, status",
+        400, 400 + 30,
+    },
+    {
+        //the video ends before the watcher looks at it
+        "bootvideo stops at 20ms",
+        { { 0, "service.bootvideo", "1" }, { 0, "init.svc.bootvideo", "running" },
+            { 10, "init.svc.bootanim", "running" }, { 20, "init.svc.bootvideo", "stopped" } }, 4,
+        "handover video, finished, status",
+        10 + 5 + 50 + 50, 10 + 5 + 50 + 50 + 30,
+    },
+    {
+        "bootvideo never stops",
+        { { 0, "service.bootvideo", "1" }, { 0, "init.svc.bootvideo", "running" },
+            { 10, "init.svc.bootanim", "running" } }, 3,
+        "handover video, finished, status",
+        10 + 5 + 50 + 50 + 600, 10 + 5 + 50 + 50 + 600 + 30,
+    },
+    {
+        "recovery",
+        { { 0, "const.filesystem.mode", "recovery" } }, 1,
+        "status, handover, finished",
+        50, 50 + 30,
+    },
+};
+
+static void runCase(const boot_case_t &test) {
+    clearProps();
+
+    int64_t originNs = BootWatcher::now();
+    boot_script_t script = { test.events, test.count, originNs };
+    pthread_t player;
+    //the filesystem mode is there before anything runs
+    if (test.count > 0 && test.events[0].atMs == 0 && !strcmp(test.events[0].name, "const.filesystem.mode"))
+        setProp(test.events[0].name, test.events[0].value);
+    pthread_create(&player, NULL, playScript, &script);
+
+    Recorder recorder(originNs);
+    BootWatcher watcher(&sFakeBackend, &sConfig, &recorder, originNs);
+    watcher.run();
+    pthread_join(player, NULL);
+
+    boot_watch_stats_t stats;
+    watcher.getStats(&stats);
+    printf("%-26s %-36s done %4lldms wakeups %d hold %dms\n", test.name, recorder.mOrder.c_str(),
+        (long long)stats.doneMs, stats.wakeups, stats.holdMs);
+
+    CHECK(recorder.mOrder == test.order);
+    CHECK(stats.doneMs >= test.minDoneMs && stats.doneMs <= test.maxDoneMs);
+    CHECK(stats.finishedMs >= 0 && stats.finishedMs <= stats.doneMs);
+    CHECK(stats.statusMs >= 0);
+    //one wake for each property set the watcher waited through, and one for each deadline
+    CHECK(stats.wakeups <= test.count + 2);
+}
+
+static void testCases() {
+    for (size_t i = 0; i < sizeof(sCases) / sizeof(sCases[0]); i++)
+        runCase(sCases[i]);
+}
+
+static void testDump() {
+    clearProps();
+    setProp("const.filesystem.mode", "recovery");
+
+    int64_t originNs = BootWatcher::now();
+    Recorder recorder(originNs);
+    BootWatcher watcher(&sFakeBackend, &sConfig, &recorder, originNs);
+    char result[1024] = {0};
+
+    watcher.dump(result);
+    CHECK(strstr(result, "finished -1ms") != NULL);
+    watcher.run();
+    result[0] = '\0';
+    watcher.dump(result);
+    printf("%s", result);
+    CHECK(strstr(result, "bootanim running -1ms") != NULL);
+    CHECK(strstr(result, "hold:50ms") != NULL);
+}
+
+//no wait in the backend, the watcher polls as the old threads did
+static void testPolling() {
+    property_backend_t polling = sFakeBackend;
+    polling.wait = NULL;
+
+    clearProps();
+    int64_t originNs = BootWatcher::now();
+    boot_event_t events[] = { { 250, "init.svc.bootanim", "running" } };
+    boot_script_t script = { events, 1, originNs };
+    boot_watch_config_t config = sConfig;
+    config.bootanimStartMs = 1000;
+    pthread_t player;
+    pthread_create(&player, NULL, playScript, &script);
+
+    Recorder recorder(originNs);
+    BootWatcher watcher(&polling, &config, &recorder, originNs);
+    watcher.run();
+    pthread_join(player, NULL);
+
+    boot_watch_stats_t stats;
+    watcher.getStats(&stats);
+    CHECK(recorder.mOrder == "status, finished");
+    CHECK(stats.bootanimRunningMs >= 250 && stats.bootanimRunningMs < 250 + BOOT_WATCH_POLL_MS + 30);
+    printf("polling: bootanim running seen at %lldms after %d wakeups, "
+        "property wait needs 1\n", (long long)stats.bootanimRunningMs, stats.wakeups);
+}
+
+int main(int argc, char **argv) {
+    testCases();
+    testDump();
+    testPolling();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Builds the deep color table of a few sinks, a 4K TV with 420 modes, an AVR
+ * repeater, a 4K30 monitor behind an HDMI 1.4 link and a sink without dc_cap,
+ * against a fake valid_mode that checks the TMDS clock of mode and color
+ * against the link. Compares every mode of the mode list, in both priority
+ * orders, with FormatColorDepth::getBestHdmiDeepColorAttr() as it was, copied
+ * below, and counts the valid_mode probes each way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../DeepColorTable.h"
+#include "../common.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+typedef struct sink_fixture {
+    const char *name;
+    const char *dispCap;
+    const char *dcCap;
+    int maxTmdsKhz;                 //what the link carries
+    int rows;
+} sink_fixture_t;
+
+static const sink_fixture_t sSinks[] = {
+    {
+        "4k tv",
+        "480p60hz\n576p50hz\n720p60hz\n1080i60hz\n1080p60hz\n720p50hz\n1080i50hz\n1080p50hz\n"
+        "1080p24hz\n2160p30hz\n2160p25hz\n2160p24hz\nsmpte24hz\nsmpte30hz\n2160p50hz\n"
+        "2160p60hz*\n2160p50hz420\n2160p60hz420\nsmpte50hz420\nsmpte60hz420\n",
+        "420,12bit420,10bit420,8bit422,12bit422,10bit444,12bit444,10bit444,8bitrgb,12bitrgb,10bitrgb,8bit",
+        600000,
+        18,
+    },
+    {
+        "avr repeater",
+        "480p60hz\n576p50hz\n720p60hz\n1080i60hz\n1080p60hz*\n720p50hz\n1080i50hz\n1080p50hz\n"
+        "1080p24hz\n",
+        "444,12bit444,10bit444,8bitrgb,12bitrgb,10bitrgb,8bit",
+        340000,
+        9,
+    },
+    {
+        "4k30 monitor",
+        "720p60hz\n1080p60hz\n1080p50hz\n2160p24hz\n2160p25hz\n2160p30hz*\n",
+        "422,12bit444,10bit444,8bitrgb,10bitrgb,8bit",
+        340000,
+        6,
+    },
+    {
+        "no dc_cap",
+        "720p60hz\n1080p60hz*\n",
+        "",
+        340000,
+        0,
+    },
+};
+
+//pixel clock of the modes, 420 halves it, 422 carries 12bit in the 8bit clock
+static int pixelClockKhz(const char *mode) {
+    if (strstr(mode, "2160p50") || strstr(mode, "2160p60") || strstr(mode, "smpte50") || strstr(mode, "smpte60"))
+        return 594000;
+    if (strstr(mode, "2160p") || strstr(mode, "smpte"))
+        return 297000;
+    if (strstr(mode, "1080p50") || strstr(mode, "1080p60"))
+        return 148500;
+    if (strstr(mode, "1080") || strstr(mode, "720p"))
+        return 74250;
+    return 27000;
+}
+
+class FakeValidMode : public DeepColorTable::Prober {
+public:
+    FakeValidMode(int maxTmdsKhz)
+        :mMaxTmdsKhz(maxTmdsKhz),
+        mProbes(0) {
+    }
+
+    virtual bool probeDeepColor(const char *mode, const char *color) {
+        mProbes++;
+        int clock = pixelClockKhz(mode);
+        bool uhd60 = clock >= 594000;
+        if (!strncmp(color, "420", 3)) {
+            if (!uhd60)
+                return false;
+            clock /= 2;
+        }
+        if (strncmp(color, "422", 3)) {
+            if (strstr(color, "10bit"))
+                clock = clock * 5 / 4;
+            else if (strstr(color, "12bit"))
+                clock = clock * 3 / 2;
+        }
+        return clock <= mMaxTmdsKhz;
+    }
+
+    int mMaxTmdsKhz;
+    int mProbes;
+};
+
+//FormatColorDepth::getBestHdmiDeepColorAttr() before the table, the lists moved with it
+static void oldBestColor(const char *supportedColorList, bool lowPower, FakeValidMode *validMode,
+        const char *outputmode, char *colorAttribute) {
+    static const char* LIST1[] = {
+        COLOR_YCBCR420_12BIT, COLOR_YCBCR420_10BIT, COLOR_YCBCR420_8BIT, COLOR_YCBCR422_12BIT,
+        COLOR_YCBCR422_10BIT, COLOR_YCBCR444_8BIT, COLOR_YCBCR422_8BIT, COLOR_RGB_8BIT,
+    };
+    static const char* LIST2[] = {
+        COLOR_YCBCR444_12BIT, COLOR_YCBCR422_12BIT, COLOR_RGB_12BIT, COLOR_YCBCR444_10BIT,
+        COLOR_YCBCR422_10BIT, COLOR_RGB_10BIT, COLOR_YCBCR444_8BIT, COLOR_YCBCR422_8BIT, COLOR_RGB_8BIT,
+    };
+    static const char* LIST3[] = {
+        COLOR_YCBCR420_8BIT, COLOR_YCBCR420_10BIT, COLOR_YCBCR420_12BIT, COLOR_YCBCR422_8BIT,
+        COLOR_YCBCR422_10BIT, COLOR_YCBCR422_12BIT, COLOR_YCBCR444_8BIT, COLOR_RGB_8BIT,
+    };
+    static const char* LIST4[] = {
+        COLOR_YCBCR444_8BIT, COLOR_YCBCR422_8BIT, COLOR_RGB_8BIT, COLOR_YCBCR444_10BIT,
+        COLOR_YCBCR422_10BIT, COLOR_RGB_10BIT, COLOR_YCBCR444_12BIT, COLOR_YCBCR422_12BIT, COLOR_RGB_12BIT,
+    };
+    const char **colorList = NULL;
+    int length = 0;
+
+    if (supportedColorList[0] == '\0')
+        return;
+
+    if (!strcmp(outputmode, MODE_4K2K60HZ) || !strcmp(outputmode, MODE_4K2K50HZ)
+        || !strcmp(outputmode, MODE_4K2KSMPTE60HZ) || !strcmp(outputmode, MODE_4K2KSMPTE50HZ)) {
+        colorList = lowPower ? LIST3 : LIST1;
+        length = lowPower ? sizeof(LIST3) / sizeof(LIST3[0]) : sizeof(LIST1) / sizeof(LIST1[0]);
+    } else {
+        colorList = lowPower ? LIST4 : LIST2;
+        length = lowPower ? sizeof(LIST4) / sizeof(LIST4[0]) : sizeof(LIST2) / sizeof(LIST2[0]);
+    }
+
+    for (int i = 0; i < length; i++) {
+        if (strstr(supportedColorList, colorList[i]) != NULL) {
+            if (validMode->probeDeepColor(outputmode, colorList[i])) {
+                strcpy(colorAttribute, colorList[i]);
+                break;
+            }
+        }
+    }
+}
+
+static void testParity() {
+    for (size_t s = 0; s < sizeof(sSinks) / sizeof(sSinks[0]); s++) {
+        const sink_fixture_t &sink = sSinks[s];
+        SinkCaps caps;
+        caps.parse(sink.dispCap, sink.dcCap, NULL, NULL);
+
+        for (int lowPower = 0; lowPower < 2; lowPower++) {
+            FakeValidMode build(sink.maxTmdsKhz);
+            DeepColorTable table;
+            table.build(&caps, lowPower, &build);
+            CHECK(table.getRowCount() == sink.rows);
+            CHECK(build.mProbes == table.getProbeCount());
+
+            FakeValidMode old(sink.maxTmdsKhz);
+            int evaluations = 0;
+            for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
+                const char *mode = DisplayModeRegistry::get(i)->name;
+                const char *best = table.bestColorFor(mode);
+                if (!caps.mentionsMode(mode) || !caps.hasDeepColorList()) {
+                    //FormatColorDepth asks valid_mode as before
+                    CHECK(best == NULL);
+                    CHECK(table.supports(mode, COLOR_YCBCR444_8BIT) == -1);
+                    continue;
+                }
+
+                char expect[MODE_LEN] = "untouched";
+                char color[MODE_LEN] = "untouched";
+                oldBestColor(sink.dcCap, lowPower, &old, mode, expect);
+                evaluations++;
+                CHECK(best != NULL);
+                if (best != NULL && best[0] != '\0')
+                    strcpy(color, best);
+                if (strcmp(color, expect))
+                    printf("%s %s lowPower:%d table:[%s] before:[%s]\n", sink.name, mode, lowPower, color, expect);
+                CHECK(!strcmp(color, expect));
+
+                if (best != NULL && best[0] != '\0')
+                    CHECK(table.supports(mode, best) == 1);
+
+                //what was asked is kept as valid_mode said, the rest is left to it
+                FakeValidMode probe(sink.maxTmdsKhz);
+                for (int c = 0; c < DEEP_COLOR_TOTAL; c++) {
+                    const char *name = DeepColorTable::getColor(c);
+                    int supported = table.supports(mode, name);
+                    CHECK(supported == -1 || supported == (probe.probeDeepColor(mode, name) ? 1 : 0));
+                    if (strstr(sink.dcCap, name) == NULL)
+                        CHECK(supported == -1);
+                }
+                CHECK(table.supports(mode, "444,8bitx") == -1);
+            }
+
+            //the same valid_mode questions a switch to each mode asked before, once
+            CHECK(table.getProbeCount() == old.mProbes);
+            if (!lowPower) {
+                printf("%-14s %2d modes: %3d probes to pick them all, again on every switch, now %3d once per edid\n",
+                    sink.name, evaluations, old.mProbes, table.getProbeCount());
+            }
+        }
+    }
+}
+
+static void testGolden() {
+    SinkCaps caps;
+    caps.parse(sSinks[0].dispCap, sSinks[0].dcCap, NULL, NULL);
+    FakeValidMode validMode(sSinks[0].maxTmdsKhz);
+    DeepColorTable table;
+    table.build(&caps, false, &validMode);
+
+    CHECK(!strcmp(table.bestColorFor(MODE_4K2K60HZ), COLOR_YCBCR420_12BIT));
+    CHECK(!strcmp(table.bestColorFor(MODE_4K2K30HZ), COLOR_YCBCR444_12BIT));
+    CHECK(!strcmp(table.bestColorFor(MODE_1080P), COLOR_YCBCR444_12BIT));
+    //a saved mode with its deep color suffix is no mode of the list
+    CHECK(table.bestColorFor("2160p60hz420,8bit") == NULL);
+
+    table.build(&caps, true, &validMode);
+    CHECK(!strcmp(table.bestColorFor(MODE_4K2K60HZ), COLOR_YCBCR420_8BIT));
+    CHECK(!strcmp(table.bestColorFor(MODE_1080P), COLOR_YCBCR444_8BIT));
+
+    //nothing in the 4k30 monitor's dc_cap fits 2160p60hz, were it listed
+    caps.parse("2160p60hz\n", sSinks[2].dcCap, NULL, NULL);
+    FakeValidMode slow(sSinks[2].maxTmdsKhz);
+    table.build(&caps, false, &slow);
+    CHECK(table.getRowCount() == 1);
+    CHECK(!strcmp(table.bestColorFor(MODE_4K2K60HZ), ""));
+    CHECK(table.supports(MODE_4K2K60HZ, COLOR_YCBCR422_12BIT) == 0);
+
+    //a mode the sink only takes in 420 has a row too
+    caps.parse("2160p60hz420\n1080p60hz\n", sSinks[0].dcCap, NULL, NULL);
+    FakeValidMode tv(sSinks[0].maxTmdsKhz);
+    table.build(&caps, false, &tv);
+    CHECK(table.getRowCount() == 2);
+    CHECK(!strcmp(table.bestColorFor(MODE_4K2K60HZ), COLOR_YCBCR420_12BIT));
+
+    caps.parse("1080p60hz*\n720p60hz\n", "444,12bit444,10bit444,8bitrgb,8bit", NULL, NULL);
+    FakeValidMode avr(340000);
+    table.build(&caps, false, &avr);
+    char result[1024] = {0};
+    table.dump(result);
+    printf("%s", result);
+    CHECK(!strcmp(result, "\ndeep color table: 2 modes, 2 probes\n"
+        "  720p60hz: 444,12bit, 1 probed\n"
+        "  1080p60hz: 444,12bit, 1 probed\n"));
+
+    table.clear();
+    CHECK(!table.isValid());
+    CHECK(table.bestColorFor(MODE_1080P) == NULL);
+}
+
+int main(int argc, char **argv) {
+    testParity();
+    testGolden();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Checks DisplayModeRegistry against the string scans DisplayMode used
+ * before, copied below: resolveResolution(), the getPosition() and
+ * updateDefaultUI() chains and the getHighestHdmiMode() loop. Every mode of
+ * the list and a set of malformed names must give the same results, and
+ * disp_cap lists parsed by SinkCaps must give the same highest mode. Prints
+ * the cost of picking the highest mode both ways.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../DisplayModeRegistry.h"
+#include "../SinkCaps.h"
+#include "../common.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+static const char* DISPLAY_MODE_LIST[DISPLAY_MODE_TOTAL] = {
+    MODE_480I,
+    MODE_480P,
+    MODE_480CVBS,
+    MODE_576I,
+    MODE_576P,
+    MODE_576CVBS,
+    MODE_720P,
+    MODE_720P50HZ,
+    MODE_1080P24HZ,
+    MODE_1080I50HZ,
+    MODE_1080P50HZ,
+    MODE_1080I,
+    MODE_1080P,
+    MODE_4K2K24HZ,
+    MODE_4K2K25HZ,
+    MODE_4K2K30HZ,
+    MODE_4K2K50HZ,
+    MODE_4K2K60HZ,
+    MODE_4K2KSMPTE,
+    MODE_4K2KSMPTE30HZ,
+    MODE_4K2KSMPTE50HZ,
+    MODE_4K2KSMPTE60HZ,
+    MODE_768P,
+};
+
+typedef struct resolution {
+    int resolution;
+    char standard;
+    int frequency;
+    int deepcolor;
+    int64_t resolution_num;
+} resolution_t;
+
+static const char *sMalformed[] = {
+    "", "1080p", "1080p60", "1080p60hz*", " 1080p60hz", "1080P60HZ", "1080p60hz\n",
+    "2160p60hz420", "2160p50hz420", "smpte", "smpte60hz420", "1080p60hz10bit",
+    "abc", "panel", "custombuilt", "4k2k", "480x320p60hz", "576cvbs ",
+    "2160p60hz2160p60hz2160p60hz2160p60hz2160p60hz2160p60hz2160p60hz",
+};
+
+//DisplayMode::resolveResolution() before the registry, cvbs names crash it
+static void oldResolveResolution(const char *mode, resolution_t* resol_t) {
+    memset(resol_t, 0, sizeof(resolution_t));
+    bool validMode = false;
+    if (strlen(mode) != 0) {
+        for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
+            if (strcmp(mode, DISPLAY_MODE_LIST[i]) == 0) {
+                validMode = true;
+                break;
+            }
+        }
+    }
+    if (!validMode)
+        return;
+
+    resol_t->resolution = atoi(mode);
+    resol_t->standard = strstr(mode, "p") == NULL ? 'i' : 'p';
+    char* position = (char *)strstr(mode, resol_t->standard == 'p' ? "p" : "i");
+    resol_t->frequency = atoi(position + 1);
+    position = (char *)strstr(mode, "hz");
+    resol_t->deepcolor = strlen(position + 2) == 0 ? 0 : atoi(position + 2);
+
+    int i = strstr(mode, "p") == NULL ? 0 : 1;
+    resol_t->resolution_num = resol_t->deepcolor + (resol_t->frequency<< 16)
+        + (((int64_t)i) << 28) + (((int64_t)resol_t->resolution) << 32);
+}
+
+static int64_t oldResolveResolutionValue(const char *mode) {
+    resolution_t resol_t;
+    oldResolveResolution(mode, &resol_t);
+    return resol_t.resolution_num;
+}
+
+//the getPosition() chain without ODROID
+static void oldDefaultSize(const char* curMode, int *defaultWidth, int *defaultHeight) {
+    if (strstr(curMode, "480")) {
+        *defaultWidth = FULL_WIDTH_480;
+        *defaultHeight = FULL_HEIGHT_480;
+    } else if (strstr(curMode, "576")) {
+        *defaultWidth = FULL_WIDTH_576;
+        *defaultHeight = FULL_HEIGHT_576;
+    } else if (strstr(curMode, MODE_720P_PREFIX)) {
+        *defaultWidth = FULL_WIDTH_720;
+        *defaultHeight = FULL_HEIGHT_720;
+    } else if (strstr(curMode, MODE_768P_PREFIX)) {
+        *defaultWidth = FULL_WIDTH_768;
+        *defaultHeight = FULL_HEIGHT_768;
+    } else if (strstr(curMode, MODE_1080I_PREFIX)) {
+        *defaultWidth = FULL_WIDTH_1080;
+        *defaultHeight = FULL_HEIGHT_1080;
+    } else if (strstr(curMode, MODE_1080P_PREFIX)) {
+        *defaultWidth = FULL_WIDTH_1080;
+        *defaultHeight = FULL_HEIGHT_1080;
+    } else if (strstr(curMode, MODE_4K2K_PREFIX)) {
+        *defaultWidth = FULL_WIDTH_4K2K;
+        *defaultHeight = FULL_HEIGHT_4K2K;
+    } else if (strstr(curMode, MODE_4K2KSMPTE_PREFIX)) {
+        *defaultWidth = FULL_WIDTH_4K2KSMPTE;
+        *defaultHeight = FULL_HEIGHT_4K2KSMPTE;
+    } else {
+        *defaultWidth = FULL_WIDTH_1080;
+        *defaultHeight = FULL_HEIGHT_1080;
+    }
+}
+
+//the updateDefaultUI() chain without ODROID
+static void oldUiSize(const char *defaultUI, int *width, int *height) {
+    if (!strncmp(defaultUI, "720", 3)) {
+        *width = FULL_WIDTH_720;
+        *height = FULL_HEIGHT_720;
+    } else if (!strncmp(defaultUI, "1080", 4)) {
+        *width = FULL_WIDTH_1080;
+        *height = FULL_HEIGHT_1080;
+    } else if (!strncmp(defaultUI, "4k2k", 4)) {
+        *width = FULL_WIDTH_4K2K;
+        *height = FULL_HEIGHT_4K2K;
+    }
+}
+
+//the getHighestHdmiMode() loop, the properties passed in
+static void oldHighest(const char *edid, bool support4k, bool supportOver4k30, char *mode) {
+    char value[MODE_LEN] = {0};
+    char tempMode[MODE_LEN] = {0};
+    const char* startpos = edid;
+    const char* destpos;
+
+    strcpy(value, "480p60hz");
+    while (strlen(startpos) > 0) {
+        destpos = strstr(startpos, "\n");
+        if (NULL == destpos)
+            break;
+        memset(tempMode, 0, MODE_LEN);
+        strncpy(tempMode, startpos, destpos - startpos);
+        startpos = destpos + 1;
+        if (!support4k && (strstr(tempMode, "2160") || strstr(tempMode, "smpte")))
+            continue;
+
+        if (tempMode[strlen(tempMode) - 1] == '*')
+            tempMode[strlen(tempMode) - 1] = '\0';
+
+        if (!supportOver4k30
+                && (oldResolveResolutionValue(tempMode) > oldResolveResolutionValue("2160p30hz")
+                    || strstr(tempMode, "smpte")))
+            continue;
+        if (oldResolveResolutionValue(tempMode) > oldResolveResolutionValue(value)) {
+            memset(value, 0, MODE_LEN);
+            strcpy(value, tempMode);
+        }
+    }
+    strcpy(mode, value);
+}
+
+static const char *sEdids[] = {
+    "480i60hz\n480p60hz\n576i50hz\n576p50hz\n720p60hz\n1080i60hz\n1080p60hz*\n720p50hz\n"
+    "1080i50hz\n1080p30hz\n1080p50hz\n1080p25hz\n1080p24hz\n2160p30hz\n2160p25hz\n"
+    "2160p24hz\nsmpte24hz\nsmpte25hz\nsmpte30hz\n2160p50hz420\n2160p60hz420\n"
+    "smpte50hz420\nsmpte60hz420\n2160p50hz\n2160p60hz\n",
+    "480p60hz\n720p60hz*\n1080i60hz\n",
+    "smpte24hz\nsmpte60hz\n",
+    "1080p60hz",
+    "",
+    "768p60hz\n576p50hz*\n720p50hz\n",
+};
+
+static void testRecords() {
+    resolution_t old;
+
+    for (int i = 0; i < DISPLAY_MODE_TOTAL; i++) {
+        const char *name = DISPLAY_MODE_LIST[i];
+        const display_mode_record_t *record = DisplayModeRegistry::find(name);
+
+        CHECK(record != NULL && record == DisplayModeRegistry::get(i));
+        if (record == NULL)
+            continue;
+        CHECK(!strcmp(record->name, name) && record->index == i);
+
+        int oldWidth, oldHeight;
+        oldDefaultSize(name, &oldWidth, &oldHeight);
+        CHECK(record->width == oldWidth && record->height == oldHeight);
+
+        if (!strcmp(name, MODE_480CVBS) || !strcmp(name, MODE_576CVBS)) {
+            CHECK(record->resolution == atoi(name) && record->frequency == 0);
+            continue;
+        }
+        oldResolveResolution(name, &old);
+        CHECK(record->resolution == old.resolution);
+        CHECK(record->standard == old.standard);
+        CHECK(record->frequency == old.frequency);
+        CHECK(record->deepcolor == old.deepcolor);
+        CHECK(record->resolution_num == old.resolution_num);
+        CHECK(DisplayModeRegistry::resolutionValue(name) == old.resolution_num);
+    }
+    CHECK(DisplayModeRegistry::get(-1) == NULL);
+    CHECK(DisplayModeRegistry::get(DISPLAY_MODE_TOTAL) == NULL);
+    CHECK(DisplayModeRegistry::find(NULL) == NULL);
+}
+
+static void testMalformed() {
+    for (size_t i = 0; i < sizeof(sMalformed) / sizeof(sMalformed[0]); i++) {
+        const char *name = sMalformed[i];
+        int width = 0, height = 0, oldWidth = 0, oldHeight = 0;
+
+        CHECK(DisplayModeRegistry::find(name) == NULL);
+        CHECK(DisplayModeRegistry::resolutionValue(name) == oldResolveResolutionValue(name));
+
+        if (!DisplayModeRegistry::getDefaultSize(name, &width, &height)) {
+            width = FULL_WIDTH_1080;
+            height = FULL_HEIGHT_1080;
+        }
+        oldDefaultSize(name, &oldWidth, &oldHeight);
+        CHECK(width == oldWidth && height == oldHeight);
+
+        width = height = oldWidth = oldHeight = -1;
+        DisplayModeRegistry::getUiSize(name, &width, &height);
+        oldUiSize(name, &oldWidth, &oldHeight);
+        CHECK(width == oldWidth && height == oldHeight);
+    }
+
+    const char *uis[] = { "720p", "1080p", "4k2k", "1080", "576p" };
+    for (size_t i = 0; i < sizeof(uis) / sizeof(uis[0]); i++) {
+        int width = -1, height = -1, oldWidth = -1, oldHeight = -1;
+        DisplayModeRegistry::getUiSize(uis[i], &width, &height);
+        oldUiSize(uis[i], &oldWidth, &oldHeight);
+        CHECK(width == oldWidth && height == oldHeight);
+    }
+}
+
+//getHighestHdmiMode() now, the disp_cap parsed into SinkCaps first
+static void highest(const char *edid, bool support4k, bool supportOver4k30, char *mode) {
+    static SinkCaps caps;
+
+    caps.parse(edid, NULL, NULL, NULL);
+    caps.getHighest("480p60hz", support4k, supportOver4k30, mode);
+}
+
+static void testHighest() {
+    char mode[MODE_LEN], oldMode[MODE_LEN];
+
+    for (size_t i = 0; i < sizeof(sEdids) / sizeof(sEdids[0]); i++) {
+        for (int flags = 0; flags < 4; flags++) {
+            highest(sEdids[i], flags & 1, flags & 2, mode);
+            oldHighest(sEdids[i], flags & 1, flags & 2, oldMode);
+            CHECK(!strcmp(mode, oldMode));
+        }
+    }
+    highest(sEdids[0], true, true, mode);
+    CHECK(!strcmp(mode, MODE_4K2K60HZ));
+    highest(sEdids[0], true, false, mode);
+    CHECK(!strcmp(mode, MODE_4K2K30HZ));
+    highest(sEdids[0], false, true, mode);
+    CHECK(!strcmp(mode, MODE_1080P));
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void benchmark() {
+    char mode[MODE_LEN];
+    int rounds = 20000;
+    volatile int sink = 0;
+
+    int64_t start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        oldHighest(sEdids[0], true, true, mode);
+        sink += mode[0];
+    }
+    int64_t oldNs = nowNs() - start;
+
+    //the list is parsed once per sink, only the pick runs per call
+    static SinkCaps caps;
+    caps.parse(sEdids[0], NULL, NULL, NULL);
+    start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        caps.getHighest("480p60hz", true, true, mode);
+        sink += mode[0];
+    }
+    int64_t newNs = nowNs() - start;
+
+    printf("disp_cap of 25 modes: string scans %.2f us, parsed list %.2f us\n",
+        oldNs / (double)rounds / 1000, newNs / (double)rounds / 1000);
+}
+
+int main(int argc, char **argv) {
+    testRecords();
+    testMalformed();
+    testHighest();
+    benchmark();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Switches the dolby vision core on and off against a fake sysfs tree where
+ * a driver thread reports the hdr status some time after the core mode was
+ * written, as the hdmi tx does once it sends the new infoframes. Checks the
+ * order of the writes, that each switch waits for the status the driver
+ * reports between the core mode write and the writes after it, the time it
+ * takes against the fixed sleeps it replaced, that a sink without the low
+ * latency type is waited for in the standard one, and that a driver that
+ * never answers or a status node that is not there costs no more than
+ * those sleeps did.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <string>
+
+#include "../DolbyVisionSwitch.h"
+
+static char gRoot[64];
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+//one frame of 60hz, what DisplayMode::getMuteHoldUs() gives for it
+#define FRAME_US        16666
+//setDolbyVisionEnable() slept 100ms + 100ms + 300ms to enable, 100ms + 300ms to disable
+#define OLD_ENABLE_US   500000
+#define OLD_DISABLE_US  400000
+
+static const char *sEnableGolden =
+    "delay 16666\n"
+    "write @enable_old Y\n"
+    "write @mode_old 0x2\n"
+    "write @enable Y\n"
+    "write @mode 0x2\n"
+    "wait @status DolbyVision-Std 400000\n";
+
+static const char *sDisableGolden =
+    "write @policy_old 2\n"
+    "write @mode_old 0x0\n"
+    "write @policy 2\n"
+    "write @mode 0x0\n"
+    "wait @status SDR 100000\n"
+    "write @enable_old N\n"
+    "write @enable N\n";
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static std::string node(const char *name) {
+    return std::string(gRoot) + "/" + name;
+}
+
+static std::string readNode(const char *name) {
+    char buf[64] = {0};
+    FILE *fp = fopen(node(name).c_str(), "r");
+    if (fp == NULL)
+        return "";
+    size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[len] = '\0';
+    return buf;
+}
+
+static void writeNode(const char *name, const char *value) {
+    FILE *fp = fopen(node(name).c_str(), "w");
+    if (fp != NULL) {
+        fputs(value, fp);
+        fclose(fp);
+    }
+}
+
+//only the new module is loaded, the _old nodes are missing
+static std::string sPaths[7];
+static dolby_vision_nodes_t sNodes;
+
+static void makeTree(bool withStatus) {
+    strcpy(gRoot, "/tmp/dvswitchXXXXXX");
+    if (mkdtemp(gRoot) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    writeNode("enable", "N");
+    writeNode("mode", "0x0");
+    writeNode("policy", "0");
+    if (withStatus)
+        writeNode("status", "SDR");
+
+    const char *names[7] = { "enable", "enable_old", "mode", "mode_old", "policy", "policy_old", "status" };
+    for (int i = 0; i < 7; i++)
+        sPaths[i] = node(names[i]);
+    sNodes.enable = sPaths[0].c_str();
+    sNodes.enableOld = sPaths[1].c_str();
+    sNodes.mode = sPaths[2].c_str();
+    sNodes.modeOld = sPaths[3].c_str();
+    sNodes.policy = sPaths[4].c_str();
+    sNodes.policyOld = sPaths[5].c_str();
+    sNodes.status = sPaths[6].c_str();
+}
+
+static void removeTree() {
+    const char *names[4] = { "enable", "mode", "policy", "status" };
+    for (int i = 0; i < 4; i++)
+        unlink(node(names[i]).c_str());
+    rmdir(gRoot);
+}
+
+//the hdmi tx: reports the status latencyUs after the core mode changed, never when negative
+typedef struct fake_driver {
+    int latencyUs;
+    const char *onStatus;
+    std::string mode;               //read before the switch starts
+    volatile bool exit;
+    int reports;                    //status writes
+    int64_t reportNs;               //just before the last one
+} fake_driver_t;
+
+static void *driverLoop(void *data) {
+    fake_driver_t *driver = (fake_driver_t *)data;
+    std::string last = driver->mode;
+
+    while (!driver->exit) {
+        std::string mode = readNode("mode");
+        if (mode != last) {
+            last = mode;
+            if (driver->latencyUs >= 0) {
+                usleep(driver->latencyUs);
+                driver->reports++;
+                driver->reportNs = nowNs();
+                writeNode("status", mode == DV_MODE_IPT_TUNNEL ? driver->onStatus : DV_STATUS_SDR);
+            }
+        }
+        usleep(1000);
+    }
+    return NULL;
+}
+
+static std::string relative(const std::string &dump) {
+    std::string out = dump;
+    std::string root = std::string(gRoot) + "/";
+    size_t pos;
+    while ((pos = out.find(root)) != std::string::npos)
+        out.replace(pos, root.size(), "@");
+    return out;
+}
+
+static void testGolden() {
+    makeTree(true);
+    DolbyVisionSwitch dv(&sNodes);
+
+    SysfsBatch enable("dv on", true);
+    dv.addEnable(enable, DOLBY_VISION_SET_ENABLE, FRAME_US);
+    CHECK(relative(enable.dump(false)) == sEnableGolden);
+
+    SysfsBatch disable("dv off", true);
+    dv.addDisable(disable);
+    CHECK(relative(disable.dump(false)) == sDisableGolden);
+
+    CHECK(!strcmp(DolbyVisionSwitch::getStatus(DOLBY_VISION_SET_ENABLE_LL_YUV), DV_STATUS_LOW_LATENCY));
+    CHECK(!strcmp(DolbyVisionSwitch::getStatus(DOLBY_VISION_SET_ENABLE_LL_RGB), DV_STATUS_LOW_LATENCY));
+    CHECK(!strcmp(DolbyVisionSwitch::getStatus(DOLBY_VISION_SET_DISABLE), DV_STATUS_SDR));
+    removeTree();
+}
+
+typedef struct switch_run {
+    int64_t tookUs;
+    bool timedOut;
+    int reports;                    //of the fake driver
+    int64_t reportNs;
+    sysfs_batch_result_t result;
+} switch_run_t;
+
+static void runSwitch(bool enable, int state, int latencyUs, bool withStatus, switch_run_t *run) {
+    makeTree(withStatus);
+    if (!enable) {
+        writeNode("enable", "Y");
+        writeNode("mode", DV_MODE_IPT_TUNNEL);
+        if (withStatus)
+            writeNode("status", DV_STATUS_STD);
+    }
+
+    fake_driver_t driver = { latencyUs, DolbyVisionSwitch::getStatus(state), readNode("mode"), false, 0, 0 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, driverLoop, &driver);
+
+    DolbyVisionSwitch dv(&sNodes);
+    SysfsBatch writes(enable ? "dv on" : "dv off");
+    if (enable)
+        dv.addEnable(writes, state, FRAME_US);
+    else
+        dv.addDisable(writes);
+    int64_t start = nowNs();
+    int failed = writes.commit();
+    run->tookUs = (nowNs() - start) / 1000;
+
+    driver.exit = true;
+    pthread_join(thread, NULL);
+
+    //the old module is not there
+    CHECK(failed == (enable ? 2 : 3));
+    CHECK(readNode("enable") == (enable ? DV_ENABLE : DV_DISABLE));
+    run->result = writes.getResult();
+    run->timedOut = false;
+    for (size_t i = 0; i < run->result.ops.size(); i++) {
+        if (run->result.ops[i].timedOut)
+            run->timedOut = true;
+    }
+    run->reports = driver.reports;
+    run->reportNs = driver.reportNs;
+    removeTree();
+}
+
+static bool endsWith(const std::string &path, const char *name) {
+    size_t len = strlen(name);
+    return path.size() >= len && path.compare(path.size() - len, len, name) == 0;
+}
+
+//the core mode write, then the wait for the status the driver reported, then the rest
+static void checkWaitSequence(const switch_run_t &run, const char *status) {
+    const std::vector<sysfs_batch_op_t> &ops = run.result.ops;
+    int wait = -1;
+    int mode = -1;
+
+    for (size_t i = 0; i < ops.size(); i++) {
+        CHECK(ops[i].done);
+        if (ops[i].wait) {
+            CHECK(wait < 0);
+            wait = i;
+        } else if (endsWith(ops[i].path, "/mode")) {
+            mode = i;
+        }
+    }
+    CHECK(mode >= 0 && wait == mode + 1);
+    if (mode < 0 || wait != mode + 1)
+        return;
+
+    const sysfs_batch_op_t &op = ops[wait];
+    int64_t waitEndNs = op.startNs + op.latencyNs;
+    CHECK(op.value == status);
+    CHECK(!op.timedOut);
+    CHECK(op.startNs >= ops[mode].startNs + ops[mode].latencyNs);
+    //the driver answered once, and the wait only ended on that answer
+    CHECK(run.reports == 1);
+    CHECK(waitEndNs >= run.reportNs);
+    for (size_t i = wait + 1; i < ops.size(); i++)
+        CHECK(ops[i].startNs >= waitEndNs);
+}
+
+static void testTiming() {
+    switch_run_t on, ll, off, never, blind;
+
+    //driver answers after 30ms, one frame after the sdr mode
+    runSwitch(true, DOLBY_VISION_SET_ENABLE, 30000, true, &on);
+    printf("enable, driver at 30ms:     %6lldus, fixed sleeps %dus\n", (long long)on.tookUs, OLD_ENABLE_US);
+    checkWaitSequence(on, DV_STATUS_STD);
+    CHECK(on.result.ops[0].path.empty() && on.result.ops[0].latencyNs >= FRAME_US * 1000LL);
+
+    runSwitch(true, DOLBY_VISION_SET_ENABLE_LL_YUV, 30000, true, &ll);
+    printf("enable ll, driver at 30ms:  %6lldus\n", (long long)ll.tookUs);
+    checkWaitSequence(ll, DV_STATUS_LOW_LATENCY);
+
+    runSwitch(false, DOLBY_VISION_SET_DISABLE, 20000, true, &off);
+    printf("disable, driver at 20ms:    %6lldus, fixed sleeps %dus\n", (long long)off.tookUs, OLD_DISABLE_US);
+    checkWaitSequence(off, DV_STATUS_SDR);
+
+    //a toggle on and off again, what a user flipping the setting waits for the core
+    printf("on and off: %lldus instead of %dus\n", (long long)(on.tookUs + off.tookUs),
+        OLD_ENABLE_US + OLD_DISABLE_US);
+    CHECK(on.tookUs + off.tookUs < (OLD_ENABLE_US + OLD_DISABLE_US) / 5);
+
+    //a driver that never reports is bounded by the ceilings
+    runSwitch(true, DOLBY_VISION_SET_ENABLE, -1, true, &never);
+    printf("enable, no report:          %6lldus\n", (long long)never.tookUs);
+    CHECK(never.timedOut);
+    CHECK(never.reports == 0);
+    CHECK(never.tookUs >= FRAME_US + DV_ENABLE_CEILING_US);
+    CHECK(FRAME_US + DV_ENABLE_CEILING_US <= OLD_ENABLE_US);
+
+    //no status node, the old delays
+    runSwitch(false, DOLBY_VISION_SET_DISABLE, 20000, false, &blind);
+    printf("disable, no status node:    %6lldus\n", (long long)blind.tookUs);
+    CHECK(blind.tookUs >= DV_BYPASS_CEILING_US);
+}
+
+//a sink without the low latency type takes the standard one, the switch waits for that status
+static void testSinkState() {
+    const char *stdCaps = "DV_RGB_444_8BIT,DV_YCbCr_422_12BIT,";
+    const char *llCaps = "DV_RGB_444_8BIT,LL_YCbCr_422_12BIT,LL_RGB_444_12BIT,";
+
+    CHECK(DolbyVisionSwitch::getSinkState(DOLBY_VISION_SET_ENABLE_LL_YUV, stdCaps) == DOLBY_VISION_SET_ENABLE);
+    CHECK(DolbyVisionSwitch::getSinkState(DOLBY_VISION_SET_ENABLE_LL_RGB, stdCaps) == DOLBY_VISION_SET_ENABLE);
+    CHECK(DolbyVisionSwitch::getSinkState(DOLBY_VISION_SET_ENABLE_LL_YUV, llCaps) == DOLBY_VISION_SET_ENABLE_LL_YUV);
+    CHECK(DolbyVisionSwitch::getSinkState(DOLBY_VISION_SET_ENABLE_LL_RGB, llCaps) == DOLBY_VISION_SET_ENABLE_LL_RGB);
+    CHECK(DolbyVisionSwitch::getSinkState(DOLBY_VISION_SET_ENABLE, stdCaps) == DOLBY_VISION_SET_ENABLE);
+    CHECK(DolbyVisionSwitch::getSinkState(DOLBY_VISION_SET_DISABLE, "") == DOLBY_VISION_SET_DISABLE);
+
+    int state = DolbyVisionSwitch::getSinkState(DOLBY_VISION_SET_ENABLE_LL_YUV, stdCaps);
+    makeTree(true);
+    DolbyVisionSwitch dv(&sNodes);
+    SysfsBatch enable("dv on", true);
+    dv.addEnable(enable, state, FRAME_US);
+    CHECK(relative(enable.dump(false)) == sEnableGolden);
+    removeTree();
+
+    //the driver reports the standard status, no ceiling is run into
+    switch_run_t run;
+    runSwitch(true, state, 30000, true, &run);
+    printf("enable ll, sink without ll: %6lldus\n", (long long)run.tookUs);
+    checkWaitSequence(run, DV_STATUS_STD);
+}
+
+int main(int argc, char **argv) {
+    testGolden();
+    testTiming();
+    testSinkState();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
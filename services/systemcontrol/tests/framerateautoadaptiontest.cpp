@@ -0,0 +1,534 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Feeds FrameRateAutoAdaption the frame rate hints the video decoder sends
+ * through the hdmi tx uevent against a fake output: a single video, the
+ * hint, end hint, hint burst a player sends when it starts, a hint too soon
+ * after the last switch, a second hint of another rate, the same hint after
+ * the mode or the clock offset changed, an end hint with no hint before it,
+ * the policy off and cvbs. Checks the mode switches each one issues, and that
+ * the mode picked from the matrix is the one the old disp_cap search picked
+ * for every duration, output mode, policy and sink.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../FrameRateAutoAdaption.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+static const frame_rate_config_t sConfig = {
+    60,         //minDwellMs
+    40,         //endHintGuardMs
+};
+
+static const char *sTvCap =
+    "480i60hz\n480p60hz\n576i50hz\n576p50hz\n720p60hz\n1080i60hz\n1080p60hz\n720p50hz\n"
+    "1080i50hz\n1080p30hz\n1080p50hz\n1080p25hz\n1080p24hz\n2160p30hz\n2160p25hz\n"
+    "2160p24hz\nsmpte24hz\nsmpte25hz\nsmpte30hz\n2160p50hz\n2160p60hz*\n2160p50hz420\n"
+    "2160p60hz420\nsmpte50hz420\nsmpte60hz420\n";
+static const char *sAvrCap =
+    "480p60hz\n576p50hz\n720p60hz\n1080i60hz\n1080p60hz*\n720p50hz\n1080i50hz\n1080p50hz\n"
+    "1080p24hz\n";
+static const char *sMonitorCap =
+    "480p60hz\n576p50hz\n720p60hz*\n720p50hz\n";
+
+#define MAX_SWITCHES    8
+
+typedef struct switch_record {
+    char mode[MODE_LEN];
+    int reason;
+    int64_t atNs;
+} switch_record_t;
+
+//the output the hints switch and the sink behind it
+class FakeOutput : public FrameRateAutoAdaption::Callbak {
+public:
+    FakeOutput(const char *outputMode, const char *policy, const char *dispCap)
+        :mCapsReads(0),
+        mSwitches(0),
+        mHold(false) {
+        pthread_mutex_init(&mLock, NULL);
+        pthread_cond_init(&mCond, NULL);
+        strcpy(mOutputMode, outputMode);
+        strcpy(mPolicy, policy);
+        strcpy(mFracPolicy, "0");
+        strcpy(mCrc, "0x1e2d3c4b");
+        mDispCap = dispCap;
+    }
+    ~FakeOutput() {
+        pthread_cond_destroy(&mCond);
+        pthread_mutex_destroy(&mLock);
+    }
+
+    //a switch started while held blocks until released
+    void hold(bool hold) {
+        pthread_mutex_lock(&mLock);
+        mHold = hold;
+        pthread_cond_broadcast(&mCond);
+        pthread_mutex_unlock(&mLock);
+    }
+    void waitSwitches(int switches) {
+        pthread_mutex_lock(&mLock);
+        while (mSwitches < switches)
+            pthread_cond_wait(&mCond, &mLock);
+        pthread_mutex_unlock(&mLock);
+    }
+
+    virtual void getFrameRateOutput(char *outputmode, char *policy, char *fracPolicy) {
+        pthread_mutex_lock(&mLock);
+        strcpy(outputmode, mOutputMode);
+        strcpy(policy, mPolicy);
+        strcpy(fracPolicy, mFracPolicy);
+        pthread_mutex_unlock(&mLock);
+    }
+    virtual bool getFrameRateSinkCaps(SinkCaps *caps, char *crc, int len) {
+        pthread_mutex_lock(&mLock);
+        mCapsReads++;
+        caps->parse(mDispCap, "", "", "");
+        strncpy(crc, mCrc, len - 1);
+        pthread_mutex_unlock(&mLock);
+        return true;
+    }
+    virtual void onFrameRateSwitch(const char* outputmode, int reason) {
+        pthread_mutex_lock(&mLock);
+        strcpy(mOutputMode, outputmode);
+        //the 0.1% clock offset goes with a pulldown switch
+        strcpy(mFracPolicy, (FRAME_RATE_SWITCH_PULLDOWN == reason) ? "1" : "0");
+        if (mSwitches < MAX_SWITCHES) {
+            strcpy(mRecords[mSwitches].mode, outputmode);
+            mRecords[mSwitches].reason = reason;
+            mRecords[mSwitches].atNs = FrameRateAutoAdaption::now();
+        }
+        mSwitches++;
+        pthread_cond_broadcast(&mCond);
+        while (mHold)
+            pthread_cond_wait(&mCond, &mLock);
+        pthread_mutex_unlock(&mLock);
+    }
+
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;
+    char mOutputMode[MODE_LEN];
+    char mPolicy[8];
+    char mFracPolicy[8];
+    char mCrc[MODE_LEN];
+    const char *mDispCap;
+    int mCapsReads;
+    int mSwitches;
+    switch_record_t mRecords[MAX_SWITCHES];
+    bool mHold;
+};
+
+static void sendHint(FrameRateAutoAdaption *adaption, const char *name) {
+    uevent_data_t data;
+    memset(&data, 0, sizeof(data));
+    strcpy(data.switchName, name);
+    strcpy(data.switchState, "1");
+    adaption->onTxUeventReceived(&data);
+}
+
+static bool checkStats(FrameRateAutoAdaption *adaption, int triggered, int suppressed, int unchanged,
+        int completed) {
+    frame_rate_stats_t stats;
+    adaption->getStats(&stats);
+    printf("  triggered:%d suppressed:%d unchanged:%d completed:%d\n",
+        stats.triggered, stats.suppressed, stats.unchanged, stats.completed);
+    //nothing is lost on the way
+    CHECK(stats.triggered == stats.suppressed + stats.unchanged + stats.completed);
+    return stats.triggered == triggered && stats.suppressed == suppressed
+        && stats.unchanged == unchanged && stats.completed == completed;
+}
+
+//a 23.976 video played and stopped
+static void testSingleVideo() {
+    FakeOutput output("1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE, sTvCap);
+    FrameRateAutoAdaption adaption(&sConfig, &output);
+    CHECK(adaption.start());
+
+    printf("single video\n");
+    sendHint(&adaption, "4004");
+    CHECK(adaption.waitIdle(2000));
+    CHECK(output.mSwitches == 1);
+    CHECK(!strcmp(output.mRecords[0].mode, "1080p24hz"));
+    CHECK(output.mRecords[0].reason == FRAME_RATE_SWITCH_PULLDOWN);
+    CHECK(adaption.autoSwitchFlag);
+
+    usleep((sConfig.minDwellMs + 10) * 1000);
+    sendHint(&adaption, "end_hint");
+    CHECK(adaption.waitIdle(2000));
+    CHECK(output.mSwitches == 2);
+    CHECK(!strcmp(output.mRecords[1].mode, "1080p60hz"));
+    CHECK(output.mRecords[1].reason == FRAME_RATE_SWITCH_END);
+    CHECK(!adaption.autoSwitchFlag);
+    CHECK(checkStats(&adaption, 2, 0, 0, 2));
+}
+
+//a player starting: hint, end hint of the probe, hint again, one switch instead of three
+static void testStartBurst() {
+    FakeOutput output("1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE, sTvCap);
+    FrameRateAutoAdaption adaption(&sConfig, &output);
+    adaption.start();
+
+    printf("start burst\n");
+    //the rest of the burst comes while the first switch runs, however slow the worker is
+    output.hold(true);
+    sendHint(&adaption, "4004");
+    output.waitSwitches(1);
+    sendHint(&adaption, "end_hint");
+    sendHint(&adaption, "4004");
+    output.hold(false);
+    CHECK(adaption.waitIdle(2000));
+    printf("  mode switches before:3 now:%d\n", output.mSwitches);
+    CHECK(output.mSwitches == 1);
+    CHECK(!strcmp(output.mOutputMode, "1080p24hz"));
+    //the end hint is dropped, the second hint finds the mode already right
+    CHECK(checkStats(&adaption, 3, 1, 1, 1));
+}
+
+//no switch sooner than minDwellMs after the last one
+static void testDwell() {
+    FakeOutput output("1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE, sTvCap);
+    FrameRateAutoAdaption adaption(&sConfig, &output);
+    adaption.start();
+
+    printf("dwell\n");
+    sendHint(&adaption, "4004");
+    usleep(sConfig.endHintGuardMs * 1000 + 5000);
+    sendHint(&adaption, "end_hint");
+    CHECK(adaption.waitIdle(2000));
+    CHECK(output.mSwitches == 2);
+    int64_t gapMs = (output.mRecords[1].atNs - output.mRecords[0].atNs) / 1000000;
+    printf("  end hint applied %lldms after the switch\n", (long long)gapMs);
+    CHECK(gapMs >= sConfig.minDwellMs);
+    CHECK(gapMs < sConfig.minDwellMs + 30);
+    CHECK(checkStats(&adaption, 2, 0, 0, 2));
+}
+
+//a second video of another rate, the end hint goes back to the mode before the first
+static void testSecondVideo() {
+    FakeOutput output("1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE, sTvCap);
+    FrameRateAutoAdaption adaption(&sConfig, &output);
+    adaption.start();
+
+    printf("second video\n");
+    sendHint(&adaption, "4004");
+    CHECK(adaption.waitIdle(2000));
+    sendHint(&adaption, "3200");
+    CHECK(adaption.waitIdle(2000));
+    sendHint(&adaption, "end_hint");
+    CHECK(adaption.waitIdle(2000));
+    CHECK(output.mSwitches == 3);
+    CHECK(!strcmp(output.mRecords[0].mode, "1080p24hz"));
+    CHECK(!strcmp(output.mRecords[1].mode, "1080p30hz"));
+    CHECK(output.mRecords[1].reason == FRAME_RATE_SWITCH_MODE);
+    CHECK(!strcmp(output.mRecords[2].mode, "1080p60hz"));
+    CHECK(checkStats(&adaption, 3, 0, 0, 3));
+}
+
+//the same hint again only switches when the output moved away from the adapted mode
+static void testAdapted() {
+    FakeOutput output("1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE, sTvCap);
+    FrameRateAutoAdaption adaption(&sConfig, &output);
+    adaption.start();
+
+    printf("already adapted\n");
+    sendHint(&adaption, "4004");
+    CHECK(adaption.waitIdle(2000));
+    usleep((sConfig.minDwellMs + 10) * 1000);
+    sendHint(&adaption, "4004");
+    CHECK(adaption.waitIdle(2000));
+    CHECK(output.mSwitches == 1);
+
+    //the user set the mode back meanwhile
+    pthread_mutex_lock(&output.mLock);
+    strcpy(output.mOutputMode, "1080p60hz");
+    pthread_mutex_unlock(&output.mLock);
+    sendHint(&adaption, "4004");
+    CHECK(adaption.waitIdle(2000));
+    CHECK(output.mSwitches == 2);
+    CHECK(!strcmp(output.mRecords[1].mode, "1080p24hz"));
+
+    //the mode is right but the clock offset is gone
+    usleep((sConfig.minDwellMs + 10) * 1000);
+    pthread_mutex_lock(&output.mLock);
+    strcpy(output.mFracPolicy, "0");
+    pthread_mutex_unlock(&output.mLock);
+    sendHint(&adaption, "4004");
+    CHECK(adaption.waitIdle(2000));
+    CHECK(output.mSwitches == 3);
+    CHECK(output.mRecords[2].reason == FRAME_RATE_SWITCH_PULLDOWN);
+    CHECK(checkStats(&adaption, 4, 0, 1, 3));
+}
+
+static void testNoSwitch() {
+    printf("end hint alone\n");
+    {
+        FakeOutput output("1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE, sTvCap);
+        FrameRateAutoAdaption adaption(&sConfig, &output);
+        adaption.start();
+        sendHint(&adaption, "end_hint");
+        CHECK(adaption.waitIdle(2000));
+        CHECK(output.mSwitches == 0);
+        CHECK(checkStats(&adaption, 1, 0, 1, 0));
+    }
+
+    printf("policy off\n");
+    {
+        FakeOutput output("1080p60hz", FRAME_RATE_HDMI_OFF, sTvCap);
+        FrameRateAutoAdaption adaption(&sConfig, &output);
+        adaption.start();
+        sendHint(&adaption, "4004");
+        CHECK(adaption.waitIdle(2000));
+        CHECK(output.mSwitches == 0);
+        CHECK(!adaption.autoSwitchFlag);
+        CHECK(checkStats(&adaption, 1, 0, 1, 0));
+    }
+
+    printf("cvbs\n");
+    {
+        FakeOutput output("576cvbs", FRAME_RATE_HDMI_SWITCH_FORCE, sTvCap);
+        FrameRateAutoAdaption adaption(&sConfig, &output);
+        adaption.start();
+        sendHint(&adaption, "4004");
+        CHECK(adaption.waitIdle(2000));
+        CHECK(output.mSwitches == 0);
+        CHECK(checkStats(&adaption, 1, 0, 1, 0));
+    }
+
+    printf("no duration\n");
+    {
+        FakeOutput output("1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE, sTvCap);
+        FrameRateAutoAdaption adaption(&sConfig, &output);
+        adaption.start();
+        sendHint(&adaption, "hdmi");
+        CHECK(adaption.waitIdle(2000));
+        frame_rate_stats_t stats;
+        adaption.getStats(&stats);
+        CHECK(stats.hints == 0 && stats.triggered == 0);
+    }
+}
+
+//policy 1 only pulls the clock down, the mode stays
+static void testPulldownOnly() {
+    FakeOutput output("1080p60hz", FRAME_RATE_HDMI_CLK_PULLDOWN, sTvCap);
+    FrameRateAutoAdaption adaption(&sConfig, &output);
+    adaption.start();
+
+    printf("pulldown only\n");
+    sendHint(&adaption, "1601");
+    CHECK(adaption.waitIdle(2000));
+    CHECK(output.mSwitches == 1);
+    CHECK(!strcmp(output.mRecords[0].mode, "1080p60hz"));
+    CHECK(output.mRecords[0].reason == FRAME_RATE_SWITCH_PULLDOWN);
+    CHECK(adaption.autoSwitchFlag);
+    //policy 1 reads no sink caps
+    CHECK(output.mCapsReads == 0);
+
+    usleep((sConfig.minDwellMs + 10) * 1000);
+    sendHint(&adaption, "end_hint");
+    CHECK(adaption.waitIdle(2000));
+    CHECK(output.mSwitches == 2);
+    CHECK(output.mRecords[1].reason == FRAME_RATE_SWITCH_END);
+    CHECK(!adaption.autoSwitchFlag);
+}
+
+//getMatchDurOutputMode() before the matrix, the sink edid searched for every hint
+static void oldMatchDurOutputMode(int dur, const char *curMode, const char *frameRateMode,
+        const char *sinkEdid, char *newMode, bool *pulldown) {
+    if (strstr(curMode, "smpte")) {
+        return;
+    }
+    if (!strcmp(frameRateMode, FRAME_RATE_HDMI_CLK_PULLDOWN)) {
+        if ((dur == FRAME_RATE_DURATION_2397)
+            || (dur == FRAME_RATE_DURATION_2398)
+            || (dur == FRAME_RATE_DURATION_2997)
+            || (dur == FRAME_RATE_DURATION_5992)
+            || (dur == FRAME_RATE_DURATION_5994)) {
+
+            if (strstr(curMode, "24hz")
+                || strstr(curMode, "30hz")
+                || strstr(curMode, "60hz")) {
+                *pulldown = true;
+            }
+        }
+    }
+    else if (!strcmp(frameRateMode, FRAME_RATE_HDMI_SWITCH_FORCE)) {
+        char resolution[10] = {0};
+        char firstMode[MODE_LEN] = {0};
+        char secondMode[MODE_LEN] = {0};
+        bool needPulldown = false;
+
+        const char *pos = strstr(curMode, "hz");
+        if (NULL == pos) {
+            return;
+        }
+
+        pos -= 2;
+        strncpy(resolution, curMode, int(pos - curMode));
+        if ((dur == FRAME_RATE_DURATION_2397)
+            || (dur == FRAME_RATE_DURATION_2398)
+            || (dur == FRAME_RATE_DURATION_2997)
+            || (dur == FRAME_RATE_DURATION_5992)
+            || (dur == FRAME_RATE_DURATION_5994)) {
+            needPulldown = true;
+        }
+
+        if ((dur == FRAME_RATE_DURATION_2397)
+            || (dur == FRAME_RATE_DURATION_2398)
+            || (dur == FRAME_RATE_DURATION_24)) {
+            sprintf(firstMode, "%s%s", resolution, "24hz");
+            sprintf(secondMode, "%s%s", resolution, "60hz");
+        }
+        else if ((dur == FRAME_RATE_DURATION_2997)
+            || (dur == FRAME_RATE_DURATION_30)) {
+            sprintf(firstMode, "%s%s", resolution, "30hz");
+            sprintf(secondMode, "%s%s", resolution, "60hz");
+        }
+        else if ((dur == FRAME_RATE_DURATION_5992)
+            ||(dur == FRAME_RATE_DURATION_5994)
+            || (dur == FRAME_RATE_DURATION_60)) {
+            sprintf(firstMode, "%s%s", resolution, "60hz");
+            sprintf(secondMode, "%s%s", resolution, "30hz");
+        }
+        else if (dur == FRAME_RATE_DURATION_25) {
+            sprintf(firstMode, "%s%s", resolution, "25hz");
+            sprintf(secondMode, "%s%s", resolution, "50hz");
+        }
+        else if (dur == FRAME_RATE_DURATION_50) {
+            sprintf(firstMode, "%s%s", resolution, "50hz");
+            sprintf(secondMode, "%s%s", resolution, "25hz");
+        }
+
+        if (!strcmp(firstMode, curMode)) {
+            *pulldown = needPulldown;
+        }
+        else if (strstr(sinkEdid, firstMode)) {
+            strncpy(newMode, firstMode, strlen(firstMode));
+            *pulldown = needPulldown;
+        }
+        else if (!strcmp(secondMode, curMode)) {
+            *pulldown = needPulldown;
+        }
+        else if (strstr(sinkEdid, secondMode)) {
+            strncpy(newMode, secondMode, strlen(firstMode));
+            *pulldown = needPulldown;
+        }
+        else if (strstr(curMode, "24hz")
+            ||strstr(curMode, "30hz")
+            ||strstr(curMode, "60hz"))
+            *pulldown = needPulldown;
+        else
+            *pulldown = false;
+    }
+}
+
+static void testParity() {
+    const int durations[] = {
+        FRAME_RATE_DURATION_2397, FRAME_RATE_DURATION_2398, FRAME_RATE_DURATION_24,
+        FRAME_RATE_DURATION_25, FRAME_RATE_DURATION_2997, FRAME_RATE_DURATION_30,
+        FRAME_RATE_DURATION_50, FRAME_RATE_DURATION_5994, FRAME_RATE_DURATION_5992,
+        FRAME_RATE_DURATION_60, 1234,
+    };
+    const char *modes[] = {
+        "480i60hz", "480p60hz", "576p50hz", "720p60hz", "720p50hz", "1080i60hz", "1080i50hz",
+        "1080p60hz", "1080p50hz", "1080p30hz", "1080p25hz", "1080p24hz", "2160p60hz",
+        "2160p50hz", "2160p30hz", "2160p24hz", "2160p60hz420", "smpte24hz", "576cvbs",
+    };
+    const char *policies[] = {
+        FRAME_RATE_HDMI_OFF, FRAME_RATE_HDMI_CLK_PULLDOWN, FRAME_RATE_HDMI_SWITCH_FORCE,
+    };
+    const char *sinks[] = { sTvCap, sAvrCap, sMonitorCap };
+    int checked = 0;
+    int mismatched = 0;
+
+    for (size_t s = 0; s < sizeof(sinks) / sizeof(sinks[0]); s++) {
+        FakeOutput output("1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE, sinks[s]);
+        FrameRateAutoAdaption adaption(&sConfig, &output);
+        for (size_t d = 0; d < sizeof(durations) / sizeof(durations[0]); d++) {
+            for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+                for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+                    char oldMode[MODE_LEN] = {0};
+                    char newMode[MODE_LEN] = {0};
+                    bool oldPulldown = false;
+                    bool newPulldown = false;
+
+                    oldMatchDurOutputMode(durations[d], modes[m], policies[p], sinks[s], oldMode, &oldPulldown);
+                    adaption.getMatchDurOutputMode(durations[d], modes[m], policies[p], newMode, &newPulldown);
+                    checked++;
+                    if (strcmp(oldMode, newMode) || oldPulldown != newPulldown) {
+                        printf("  %d %s policy %s: old [%s] %d, matrix [%s] %d\n", durations[d], modes[m],
+                            policies[p], oldMode, oldPulldown, newMode, newPulldown);
+                        mismatched++;
+                    }
+                }
+            }
+        }
+        //the sink caps are read and the matrix built once for the edid
+        frame_rate_stats_t stats;
+        adaption.getStats(&stats);
+        CHECK(stats.matrixBuilds == 1);
+
+        strcpy(output.mCrc, "0x5a6b7c8d");
+        char newMode[MODE_LEN] = {0};
+        bool pulldown = false;
+        adaption.getMatchDurOutputMode(FRAME_RATE_DURATION_24, "1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE,
+            newMode, &pulldown);
+        adaption.getStats(&stats);
+        CHECK(stats.matrixBuilds == 2);
+    }
+    printf("parity: %d cases, %d mismatched\n", checked, mismatched);
+    CHECK(mismatched == 0);
+}
+
+static void testDump() {
+    FakeOutput output("1080p60hz", FRAME_RATE_HDMI_SWITCH_FORCE, sTvCap);
+    FrameRateAutoAdaption adaption(&sConfig, &output);
+    char result[1024] = {0};
+
+    adaption.start();
+    sendHint(&adaption, "4004");
+    adaption.waitIdle(2000);
+    adaption.dump(result);
+    printf("%s", result);
+    CHECK(strstr(result, "frame rate hints:1 end hints:0 triggered:1") != NULL);
+    CHECK(strstr(result, "completed:1 matrix builds:1") != NULL);
+}
+
+int main(int argc, char **argv) {
+    testSingleVideo();
+    testStartBurst();
+    testDwell();
+    testSecondVideo();
+    testAdapted();
+    testNoSwitch();
+    testPulldownOnly();
+    testParity();
+    testDump();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
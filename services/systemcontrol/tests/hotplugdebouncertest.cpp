@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Feeds the HotplugDebouncer timed hpd sequences against a fake sink and
+ * output: a single plug, an avr powering up, a wiggled cable that ends where
+ * it began, events landing while the edid is read and while the switch runs,
+ * an edid that moves under the read and an unplug. Checks how many full mode
+ * switch write sequences each one issues, against one per event before.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../HotplugDebouncer.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+#define COMPUTE_MS      20
+#define SWITCH_MS       60
+
+static const hotplug_config_t sConfig = {
+    40,         //debounceMs
+    2,          //maxRetries
+};
+
+//the sink behind the cable and what the output is set to
+class FakeDisplay : public HotplugDebouncer::Callback {
+public:
+    FakeDisplay(const char *sinkMode, const char *outputMode)
+        :mHpd(false),
+        mPhy(strstr(outputMode, "cvbs") == NULL),
+        mUnstableReads(0),
+        mSwitches(0),
+        mKept(0) {
+        pthread_mutex_init(&mLock, NULL);
+        strcpy(mSinkMode, sinkMode);
+        strcpy(mOutputMode, outputMode);
+    }
+    ~FakeDisplay() {
+        pthread_mutex_destroy(&mLock);
+    }
+
+    virtual bool computeHotplugTarget(bool plugged, hotplug_target_t *target) {
+        usleep(COMPUTE_MS * 1000);
+        pthread_mutex_lock(&mLock);
+        bool cvbs = !mHpd;
+        strcpy(target->mode, cvbs ? "576cvbs" : mSinkMode);
+        strcpy(target->colorAttr, cvbs ? "" : "444,8bit");
+        target->dolbyVision = false;
+        bool stable = true;
+        if (mUnstableReads > 0) {
+            mUnstableReads--;
+            stable = false;
+        }
+        pthread_mutex_unlock(&mLock);
+        return stable;
+    }
+    virtual void getHotplugCurrent(hotplug_target_t *current) {
+        pthread_mutex_lock(&mLock);
+        strcpy(current->mode, mOutputMode);
+        strcpy(current->colorAttr, strstr(mOutputMode, "cvbs") ? "default" : "444,8bit");
+        current->dolbyVision = false;
+        current->linkUp = mPhy;
+        pthread_mutex_unlock(&mLock);
+    }
+    virtual void onHotplugSwitch(const hotplug_target_t *target) {
+        usleep(SWITCH_MS * 1000);
+        pthread_mutex_lock(&mLock);
+        strcpy(mOutputMode, target->mode);
+        mPhy = strstr(target->mode, "cvbs") == NULL;
+        mSwitches++;
+        pthread_mutex_unlock(&mLock);
+    }
+    virtual void onHotplugKeep(const hotplug_target_t *target) {
+        pthread_mutex_lock(&mLock);
+        if (strstr(target->mode, "cvbs") == NULL)
+            mPhy = true;
+        mKept++;
+        pthread_mutex_unlock(&mLock);
+    }
+
+    //the driver turns the phy off on plugout
+    void setHpd(bool hpd) {
+        pthread_mutex_lock(&mLock);
+        mHpd = hpd;
+        if (!hpd)
+            mPhy = false;
+        pthread_mutex_unlock(&mLock);
+    }
+
+    pthread_mutex_t mLock;
+    bool mHpd;
+    bool mPhy;
+    int mUnstableReads;
+    char mSinkMode[MODE_LEN];
+    char mOutputMode[MODE_LEN];
+    int mSwitches;
+    int mKept;
+};
+
+typedef struct plug_event {
+    int atMs;
+    bool hpd;
+} plug_event_t;
+
+typedef struct plug_case {
+    const char *name;
+    const char *sinkMode;
+    const char *outputMode;
+    int unstableReads;
+    plug_event_t events[8];
+    int count;
+    int switches;                   //write sequences expected
+    int kept;
+    int coalesced;
+    int retries;
+    const char *finalMode;
+} plug_case_t;
+
+static const plug_case_t sCases[] = {
+    {
+        "single plug", "1080p60hz", "576cvbs", 0,
+        { { 0, true } }, 1,
+        1, 0, 0, 0, "1080p60hz",
+    },
+    {
+        "avr power-up", "2160p60hz", "1080p60hz", 0,
+        { { 0, false }, { 15, true }, { 30, false }, { 45, true }, { 60, false }, { 75, true } }, 6,
+        1, 0, 0, 0, "2160p60hz",
+    },
+    {
+        //the plugout turned the phy off, the same mode still needs the whole switch
+        "cable wiggle", "1080p60hz", "1080p60hz", 0,
+        { { 0, false }, { 10, true }, { 25, false }, { 30, true } }, 4,
+        1, 0, 0, 0, "1080p60hz",
+    },
+    {
+        //the compute runs from 40 to 60ms
+        "event during compute", "1080p60hz", "576cvbs", 0,
+        { { 0, true }, { 50, true } }, 2,
+        1, 0, 1, 0, "1080p60hz",
+    },
+    {
+        //the switch runs from 60 to 120ms, the sink is back before it ends
+        "event during switch", "1080p60hz", "576cvbs", 0,
+        { { 0, true }, { 80, false }, { 90, true } }, 3,
+        1, 1, 0, 0, "1080p60hz",
+    },
+    {
+        "edid moving", "2160p50hz", "1080p60hz", 2,
+        { { 0, true } }, 1,
+        1, 0, 0, 2, "2160p50hz",
+    },
+    {
+        //switched anyway after maxRetries
+        "edid never still", "2160p50hz", "1080p60hz", 5,
+        { { 0, true } }, 1,
+        1, 0, 0, 2, "2160p50hz",
+    },
+    {
+        "unplug", "1080p60hz", "1080p60hz", 0,
+        { { 0, false } }, 1,
+        1, 0, 0, 0, "576cvbs",
+    },
+};
+
+static void runCase(const plug_case_t &test) {
+    FakeDisplay display(test.sinkMode, test.outputMode);
+    display.setHpd(true);
+    display.mUnstableReads = test.unstableReads;
+    HotplugDebouncer debouncer(&sConfig, &display);
+    CHECK(debouncer.start());
+
+    int64_t startNs = HotplugDebouncer::now();
+    for (int i = 0; i < test.count; i++) {
+        int64_t leftNs = startNs + (int64_t)test.events[i].atMs * 1000000 - HotplugDebouncer::now();
+        if (leftNs > 0)
+            usleep(leftNs / 1000);
+        display.setHpd(test.events[i].hpd);
+        debouncer.onHotplug(test.events[i].hpd);
+    }
+    CHECK(debouncer.waitIdle(2000));
+
+    hotplug_stats_t stats;
+    debouncer.getStats(&stats);
+    printf("%-22s events:%d write sequences before:%d now:%d kept:%d coalesced:%d retries:%d settle:%lldms\n",
+        test.name, stats.events, test.count, display.mSwitches, display.mKept, stats.coalesced,
+        stats.retries, (long long)stats.lastSettleUs / 1000);
+
+    CHECK(stats.events == test.count);
+    CHECK(display.mSwitches == test.switches);
+    CHECK(stats.switches == test.switches);
+    CHECK(display.mKept == test.kept);
+    CHECK(stats.coalesced == test.coalesced);
+    CHECK(stats.retries == test.retries);
+    CHECK(!strcmp(display.mOutputMode, test.finalMode));
+}
+
+static void testCases() {
+    for (size_t i = 0; i < sizeof(sCases) / sizeof(sCases[0]); i++)
+        runCase(sCases[i]);
+}
+
+//a quiet window of debounceMs after the last event, then the compute and the switch
+static void testTiming() {
+    FakeDisplay display("1080p60hz", "576cvbs");
+    HotplugDebouncer debouncer(&sConfig, &display);
+    debouncer.start();
+
+    display.setHpd(true);
+    int64_t startNs = HotplugDebouncer::now();
+    debouncer.onHotplug(true);
+    usleep(30 * 1000);
+    debouncer.onHotplug(true);
+    //the window starts again at 30ms, nothing is read before 70ms
+    usleep(30 * 1000);
+    hotplug_stats_t stats;
+    debouncer.getStats(&stats);
+    CHECK(stats.computes == 0);
+    CHECK(debouncer.waitIdle(2000));
+    int64_t settleMs = (HotplugDebouncer::now() - startNs) / 1000000;
+    debouncer.getStats(&stats);
+    CHECK(stats.bursts == 1 && stats.computes == 1);
+    CHECK(settleMs >= 30 + sConfig.debounceMs + COMPUTE_MS + SWITCH_MS);
+    CHECK(settleMs < 30 + sConfig.debounceMs + COMPUTE_MS + SWITCH_MS + 50);
+    CHECK(stats.lastComputeUs >= COMPUTE_MS * 1000);
+
+    //idle again, the next plug is a burst of its own
+    debouncer.onHotplug(true);
+    CHECK(debouncer.waitIdle(2000));
+    debouncer.getStats(&stats);
+    CHECK(stats.bursts == 2 && stats.switches == 1 && stats.kept == 1);
+}
+
+static void testSameTarget() {
+    hotplug_target_t target;
+    hotplug_target_t current;
+
+    memset(&target, 0, sizeof(target));
+    memset(&current, 0, sizeof(current));
+    strcpy(target.mode, "2160p60hz");
+    strcpy(target.colorAttr, "422,12bit");
+    strcpy(current.mode, "2160p60hz");
+    strcpy(current.colorAttr, "422,12bit");
+    current.linkUp = true;
+    CHECK(HotplugDebouncer::isSameTarget(&target, &current));
+    //the right mode with the phy off shows nothing
+    current.linkUp = false;
+    CHECK(!HotplugDebouncer::isSameTarget(&target, &current));
+    current.linkUp = true;
+    //the attr sysfs may carry more text
+    strcpy(current.colorAttr, "422,12bit\n");
+    CHECK(HotplugDebouncer::isSameTarget(&target, &current));
+    strcpy(current.colorAttr, "444,10bit");
+    CHECK(!HotplugDebouncer::isSameTarget(&target, &current));
+    strcpy(current.colorAttr, "422,12bit");
+    current.dolbyVision = true;
+    CHECK(!HotplugDebouncer::isSameTarget(&target, &current));
+    current.dolbyVision = false;
+    strcpy(current.mode, "2160p50hz");
+    CHECK(!HotplugDebouncer::isSameTarget(&target, &current));
+
+    //cvbs has no color attribute to match
+    strcpy(target.mode, "576cvbs");
+    strcpy(current.mode, "576cvbs");
+    target.colorAttr[0] = '\0';
+    current.linkUp = false;
+    CHECK(HotplugDebouncer::isSameTarget(&target, &current));
+}
+
+//resume: the output looks right, the driver reset it on suspend anyway
+static void testResume() {
+    FakeDisplay display("1080p60hz", "1080p60hz");
+    HotplugDebouncer debouncer(&sConfig, &display);
+    hotplug_stats_t stats;
+
+    debouncer.start();
+    display.setHpd(true);
+    debouncer.onHotplug(true, true);
+    //a plug event in the same burst does not drop the resume
+    debouncer.onHotplug(true);
+    CHECK(debouncer.waitIdle(2000));
+    debouncer.getStats(&stats);
+    CHECK(display.mSwitches == 1);
+    CHECK(display.mKept == 0);
+    CHECK(stats.forced == 1);
+
+    //the next plug with the link up keeps the output
+    debouncer.onHotplug(true);
+    CHECK(debouncer.waitIdle(2000));
+    debouncer.getStats(&stats);
+    CHECK(display.mSwitches == 1);
+    CHECK(display.mKept == 1);
+    CHECK(stats.forced == 1);
+}
+
+static void testDump() {
+    FakeDisplay display("1080p60hz", "576cvbs");
+    HotplugDebouncer debouncer(&sConfig, &display);
+    char result[1024] = {0};
+
+    debouncer.start();
+    display.setHpd(true);
+    debouncer.onHotplug(true);
+    debouncer.waitIdle(2000);
+    debouncer.dump(result);
+    printf("%s", result);
+    CHECK(strstr(result, "hotplug state:idle events:1 bursts:1") != NULL);
+    CHECK(strstr(result, "last target:1080p60hz 444,8bit") != NULL);
+}
+
+int main(int argc, char **argv) {
+    testCases();
+    testTiming();
+    testSameTarget();
+    testResume();
+    testDump();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Builds the step graph of DisplayMode::setSourceOutputMode() over a fake
+ * sysfs tree and checks from inside the steps that avmute is set before the
+ * phy goes down, the mode is written with the phy down, avmute clears only
+ * after the phy is back and the bootenv save sees the new mode. Then checks
+ * skipping after a stopped step, rejected dependencies and the worker, and
+ * prints the fixed delay sequence against the sequenced one, which keeps the
+ * phy settle times.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../ModeSwitchSequencer.h"
+
+static char gRoot[64];
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+static const char *sNodes[] = {"avmute", "hdcp_mode", "phy", "mode", "aud_mute", "attr"};
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static std::string node(const char *name) {
+    return std::string(gRoot) + "/" + name;
+}
+
+static std::string readNode(const char *name) {
+    char buf[64] = {0};
+    int fd = open(node(name).c_str(), O_RDONLY);
+
+    if (fd >= 0) {
+        read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+    }
+    return buf;
+}
+
+static void writeNode(const char *name, const char *value) {
+    int fd = open(node(name).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd >= 0) {
+        write(fd, value, strlen(value));
+        close(fd);
+    }
+}
+
+static void resetNodes() {
+    //the batches write without truncating, start from values no longer than what comes
+    writeNode("avmute", "0");
+    writeNode("hdcp_mode", "1");
+    writeNode("phy", "1");
+    writeNode("mode", "1080p60hz");
+    writeNode("aud_mute", "0");
+    writeNode("attr", "444,8bit");
+}
+
+//what the fixed delays of setSourceOutputMode() were before the sequencer
+static void runFixedSwitch(const char *mode) {
+    SysfsBatch mute("mute");
+    mute.add(node("avmute").c_str(), "1");
+    mute.addDelay(50000);
+    mute.add(node("hdcp_mode").c_str(), "-1");
+    mute.add(node("phy").c_str(), "0");
+    mute.addDelay(50000);
+    mute.commit();
+
+    writeNode("mode", mode);
+
+    SysfsBatch unmute("unmute");
+    unmute.add(node("phy").c_str(), "1");
+    unmute.addDelay(20000);
+    unmute.add(node("aud_mute").c_str(), "1");
+    unmute.add(node("aud_mute").c_str(), "0");
+    unmute.addDelay(20000);
+    unmute.add(node("avmute").c_str(), "-1");
+    unmute.commit();
+}
+
+//the steps setSourceOutputMode() adds for a switch from 1080p60hz with dolby vision on
+static bool runSequencedSwitch(const char *mode, std::string *timeline) {
+    static std::string sMode;
+    sMode = mode;
+
+    ModeSwitchSequencer seq("mode switch");
+
+    int mute = seq.addStep("mute", 0, NULL);
+    SysfsBatch &muteWrites = seq.writes(mute);
+    muteWrites.add(node("avmute").c_str(), "1");
+    muteWrites.addDelay(16666);
+    muteWrites.add(node("hdcp_mode").c_str(), "-1");
+    muteWrites.add(node("phy").c_str(), "0");
+    muteWrites.addDelay(50000);
+
+    int hdcpStop = seq.addStep("hdcp stop", ModeSwitchSequencer::after(mute), [&]() {
+        CHECK(readNode("avmute") == "1");
+        CHECK(readNode("phy") == "0");
+        return true;
+    });
+
+    int color = seq.addStep("deep color", ModeSwitchSequencer::after(hdcpStop), [&]() {
+        writeNode("attr", "444,10bit");
+        return true;
+    });
+
+    int modeSet = seq.addStep("output mode", ModeSwitchSequencer::after(color), [&]() {
+        CHECK(readNode("phy") == "0");
+        CHECK(readNode("attr") == "444,10bit");
+        writeNode("mode", sMode.c_str());
+        return true;
+    });
+
+    seq.addAsyncStep("display size", ModeSwitchSequencer::after(modeSet), [&]() {
+        return readNode("mode") == sMode;
+    });
+
+    int phyOn = seq.addStep("phy on", ModeSwitchSequencer::after(modeSet), NULL);
+    seq.writes(phyOn).add(node("phy").c_str(), "1");
+
+    int axis = seq.addStep("axis", ModeSwitchSequencer::after(modeSet), [&]() {
+        //hidden behind avmute
+        CHECK(readNode("avmute") == "1");
+        return true;
+    });
+
+    int unmute = seq.addStep("unmute", ModeSwitchSequencer::after(phyOn)
+            | ModeSwitchSequencer::after(axis), NULL);
+    SysfsBatch &unmuteWrites = seq.writes(unmute);
+    unmuteWrites.addDelay(20000);
+    unmuteWrites.add(node("aud_mute").c_str(), "1");
+    unmuteWrites.add(node("aud_mute").c_str(), "0");
+    unmuteWrites.addDelay(20000);
+    unmuteWrites.add(node("avmute").c_str(), "-1");
+
+    int shown = seq.addStep("hdcp start", ModeSwitchSequencer::after(axis)
+            | ModeSwitchSequencer::after(unmute), [&]() {
+        CHECK(readNode("phy") == "1");
+        CHECK(readNode("avmute") == "-1");
+        return true;
+    });
+
+    seq.addAsyncStep("save bootenv", ModeSwitchSequencer::after(shown), [&]() {
+        CHECK(readNode("mode") == sMode);
+        return true;
+    });
+
+    bool ret = seq.run();
+    ModeSwitchSequencer::drain();
+
+    //every step ran, the critical ones back to back in order
+    for (int i = 0; i < seq.getStepCount(); i++) {
+        mode_switch_span_t span = seq.getSpan(i);
+        CHECK(span.done && !span.skipped);
+        if (i > 0 && !span.async && !seq.getSpan(i - 1).async)
+            CHECK(span.startNs >= seq.getSpan(i - 1).endNs);
+    }
+    CHECK(seq.getSpan(unmute).startNs >= seq.getSpan(phyOn).endNs);
+    //the phy settles off and on as long as it did with the fixed delays
+    CHECK(seq.getSpan(mute).endNs - seq.getSpan(mute).startNs >= (16666 + 50000) * 1000LL);
+    CHECK(seq.getSpan(unmute).endNs - seq.getSpan(unmute).startNs >= (20000 + 20000) * 1000LL);
+
+    if (timeline != NULL)
+        *timeline = seq.dump();
+    return ret;
+}
+
+static void testModeSwitch() {
+    std::string timeline;
+
+    resetNodes();
+    CHECK(runSequencedSwitch("2160p60hz", &timeline));
+    CHECK(readNode("mode") == "2160p60hz");
+    CHECK(readNode("avmute") == "-1");
+    CHECK(readNode("aud_mute") == "0");
+    CHECK(timeline.find("save bootenv") != std::string::npos);
+    CHECK(timeline.find("async") != std::string::npos);
+    CHECK(timeline.find("pending") == std::string::npos);
+    printf("%s", timeline.c_str());
+}
+
+static void testStop() {
+    resetNodes();
+    writeNode("attr", "");
+    ModeSwitchSequencer seq("quiescent");
+
+    int color = seq.addStep("deep color", 0, NULL);
+    seq.writes(color).add(node("attr").c_str(), "default");
+    //reboot_mode quiescent blanks the output and stops
+    int modeSet = seq.addStep("output mode", ModeSwitchSequencer::after(color), [&]() {
+        writeNode("mode", "null");
+        return false;
+    });
+    seq.writes(modeSet).add(node("mode").c_str(), "2160p60hz");
+    int phyOn = seq.addStep("phy on", 0, NULL);
+    seq.writes(phyOn).add(node("phy").c_str(), "0");
+    int size = seq.addAsyncStep("display size", ModeSwitchSequencer::after(modeSet), NULL);
+    int save = seq.addAsyncStep("save bootenv", ModeSwitchSequencer::after(color), [&]() {
+        CHECK(readNode("attr") == "default");
+        return true;
+    });
+
+    CHECK(!seq.run());
+    ModeSwitchSequencer::drain();
+    //a stopped step does not issue its writes, the ones after it do not run
+    CHECK(readNode("mode") == "null");
+    CHECK(readNode("phy") == "1");
+    CHECK(seq.getSpan(phyOn).skipped);
+    CHECK(seq.getSpan(size).skipped);
+    CHECK(seq.getSpan(save).done);
+    CHECK(seq.dump().find("skipped") != std::string::npos);
+
+    //later steps only, and the critical path never waits for the worker
+    ModeSwitchSequencer bad("bad");
+    int async = bad.addAsyncStep("async", 0, NULL);
+    CHECK(bad.addStep("after async", ModeSwitchSequencer::after(async), NULL) < 0);
+    CHECK(bad.addStep("ahead", 1u << 5, NULL) < 0);
+    CHECK(bad.addAsyncStep("after async", ModeSwitchSequencer::after(async), NULL) == 1);
+    CHECK(ModeSwitchSequencer::after(-1) == 0);
+
+    //writes of a step that was not added go nowhere
+    bad.writes(-1).add(node("avmute").c_str(), "1");
+    CHECK(bad.run());
+    ModeSwitchSequencer::drain();
+    CHECK(readNode("avmute") == "0");
+
+    ModeSwitchSequencer full("full");
+    for (int i = 0; i < MODE_SWITCH_STEPS_MAX; i++)
+        full.addStep("step", 0, NULL);
+    CHECK(full.addStep("one too many", 0, NULL) < 0);
+}
+
+static void testWorker() {
+    static pthread_t sCaller;
+    static pthread_t sWorker;
+    static std::string sOrder;
+
+    sCaller = pthread_self();
+    sOrder.clear();
+
+    ModeSwitchSequencer seq("worker");
+    int slow = seq.addAsyncStep("slow", 0, [&]() {
+        sWorker = pthread_self();
+        usleep(30000);
+        sOrder += "slow ";
+        return true;
+    });
+    seq.addAsyncStep("next", ModeSwitchSequencer::after(slow), [&]() {
+        sOrder += "next ";
+        return true;
+    });
+    seq.addStep("critical", 0, [&]() {
+        sOrder += "critical ";
+        return true;
+    });
+
+    int64_t start = nowNs();
+    CHECK(seq.run());
+    //run() only posted the slow one
+    CHECK(nowNs() - start < 20000000LL);
+    ModeSwitchSequencer::drain();
+    CHECK(nowNs() - start >= 30000000LL);
+    CHECK(sOrder == "critical slow next ");
+    CHECK(!pthread_equal(sWorker, sCaller));
+    CHECK(seq.getSpan(slow).done);
+}
+
+static void benchmark() {
+    const int loops = 5;
+    int64_t fixedNs = 0, sequencedNs = 0;
+
+    for (int i = 0; i < loops; i++) {
+        resetNodes();
+        int64_t start = nowNs();
+        runFixedSwitch("2160p60hz");
+        fixedNs += nowNs() - start;
+
+        resetNodes();
+        start = nowNs();
+        runSequencedSwitch("2160p60hz", NULL);
+        sequencedNs += nowNs() - start;
+    }
+
+    printf("mode switch fixed delays %lldus, sequenced %lldus\n",
+        (long long)fixedNs / loops / 1000, (long long)sequencedNs / loops / 1000);
+    CHECK(sequencedNs < fixedNs);
+}
+
+int main(int argc, char **argv) {
+    snprintf(gRoot, sizeof(gRoot), "%s/sysfs_XXXXXX",
+        getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp");
+    if (mkdtemp(gRoot) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    testModeSwitch();
+    testStop();
+    testWorker();
+    benchmark();
+
+    for (const char *name : sNodes)
+        unlink(node(name).c_str());
+    rmdir(gRoot);
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
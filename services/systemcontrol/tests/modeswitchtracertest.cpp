@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Fills the trace ring past its size, overflows the spans of one trace and
+ * checks ids of overwritten and cancelled traces are dropped. Checks the
+ * percentiles per cause against known switch times, that tracing does not
+ * allocate, the waterfall text and its bound, and the steps and writes a
+ * sequencer puts into a trace.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+
+#include "../ModeSwitchTracer.h"
+#include "../ModeSwitchSequencer.h"
+
+static int gFailed = 0;
+static int gAllocs = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+void *operator new(size_t size) {
+    gAllocs++;
+    void *p = malloc(size);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept {
+    free(p);
+}
+
+static ModeSwitchTracer gTracer;
+static int64_t gClockNs = 0;
+
+//stepped by the test, not by the time sleeping
+static int64_t fakeClock() {
+    return gClockNs;
+}
+
+static void testRing() {
+    int first = gTracer.begin(MODE_SWITCH_CAUSE_BOOT, "576cvbs");
+    gTracer.setTarget(first, "1080p60hz");
+    gTracer.end(first);
+
+    mode_switch_trace_t trace;
+    CHECK(gTracer.getTrace(0, &trace));
+    CHECK(trace.id == first);
+    CHECK(!strcmp(trace.from, "576cvbs") && !strcmp(trace.to, "1080p60hz"));
+    CHECK(trace.endNs >= trace.startNs);
+    CHECK(!gTracer.getTrace(1, &trace));
+
+    //a longer mode name is cut, not overrun
+    int ids[MODE_SWITCH_TRACES];
+    for (int i = 0; i < MODE_SWITCH_TRACES; i++) {
+        ids[i] = gTracer.begin(MODE_SWITCH_CAUSE_USER, "a mode name far longer than any real one");
+        gTracer.end(ids[i]);
+    }
+    CHECK(gTracer.getTrace(0, &trace) && trace.id == ids[MODE_SWITCH_TRACES - 1]);
+    CHECK(strlen(trace.from) == MODE_SWITCH_TRACE_MODE_LEN - 1);
+    CHECK(gTracer.getTrace(MODE_SWITCH_TRACES - 1, &trace) && trace.id == ids[0]);
+    CHECK(!gTracer.getTrace(MODE_SWITCH_TRACES, &trace));
+
+    //the first slot went to a newer switch, late spans of the old one go nowhere
+    int64_t now = ModeSwitchTracer::now();
+    gTracer.addSpan(first, 0, true, now, now, "save bootenv");
+    for (int back = 0; gTracer.getTrace(back, &trace); back++)
+        CHECK(trace.spanCount == 0);
+
+    //a switch that did nothing leaves no trace, the oldest was already given up for it
+    int same = gTracer.begin(MODE_SWITCH_CAUSE_USER, "1080p60hz");
+    gTracer.cancel(same);
+    CHECK(gTracer.getTrace(0, &trace) && trace.id == ids[MODE_SWITCH_TRACES - 1]);
+    CHECK(gTracer.getTrace(MODE_SWITCH_TRACES - 2, &trace) && trace.id == ids[1]);
+    CHECK(!gTracer.getTrace(MODE_SWITCH_TRACES - 1, &trace));
+
+    int full = gTracer.begin(MODE_SWITCH_CAUSE_HOTPLUG, "1080p60hz");
+    for (int i = 0; i < MODE_SWITCH_TRACE_SPANS + 3; i++)
+        gTracer.addSpan(full, 1, false, now + i, now + i + 1, "write phy %d", i & 1);
+    gTracer.end(full);
+    CHECK(gTracer.getTrace(0, &trace));
+    CHECK(trace.spanCount == MODE_SWITCH_TRACE_SPANS);
+    CHECK(trace.dropped == 3);
+    CHECK(!strcmp(trace.spans[1].label, "write phy 1"));
+}
+
+static void testPercentiles() {
+    ModeSwitchTracer tracer(fakeClock);
+    int64_t p50 = 0, p95 = 0;
+    int count = 0;
+
+    CHECK(!tracer.getPercentiles(MODE_SWITCH_CAUSE_FRAME_RATE, &p50, &p95, &count));
+    CHECK(count == 0);
+    CHECK(!tracer.getPercentiles(MODE_SWITCH_CAUSE_TOTAL, &p50, &p95, &count));
+
+    //switches of 1 to 20ms out of order, nearest rank gives the 10th and 19th
+    for (int i = 0; i < 20; i++) {
+        int id = tracer.begin(MODE_SWITCH_CAUSE_FRAME_RATE, "2160p60hz");
+        gClockNs += ((i * 7) % 20 + 1) * 1000000LL;
+        tracer.end(id);
+    }
+    CHECK(tracer.getPercentiles(MODE_SWITCH_CAUSE_FRAME_RATE, &p50, &p95, &count));
+    CHECK(count == 20);
+    CHECK(p50 == 10000000LL);
+    CHECK(p95 == 19000000LL);
+
+    //the history is a ring of MODE_SWITCH_HISTORY per cause
+    for (int i = 0; i < MODE_SWITCH_HISTORY + 5; i++)
+        tracer.end(tracer.begin(MODE_SWITCH_CAUSE_DOLBY_VISION, "2160p60hz"));
+    CHECK(tracer.getPercentiles(MODE_SWITCH_CAUSE_DOLBY_VISION, &p50, &p95, &count));
+    CHECK(count == MODE_SWITCH_HISTORY);
+    CHECK(!tracer.getPercentiles(MODE_SWITCH_CAUSE_USER, &p50, &p95, &count));
+
+    //a trace ends once
+    int id = tracer.begin(MODE_SWITCH_CAUSE_USER, "1080p60hz");
+    tracer.end(id);
+    tracer.end(id);
+    CHECK(tracer.getPercentiles(MODE_SWITCH_CAUSE_USER, &p50, &p95, &count) && count == 1);
+}
+
+static void testNoAllocation() {
+    ModeSwitchTracer *tracer = new ModeSwitchTracer();
+    int64_t now = ModeSwitchTracer::now();
+
+    int allocs = gAllocs;
+    for (int i = 0; i < 100; i++) {
+        int id = tracer->begin(MODE_SWITCH_CAUSE_HOTPLUG, "1080p60hz");
+        tracer->setTarget(id, "2160p60hz");
+        for (int s = 0; s < 10; s++)
+            tracer->addSpan(id, s & 1, false, now, now + 1000, "write %s %d", "avmute", s);
+        tracer->end(id);
+    }
+    CHECK(gAllocs == allocs);
+    delete tracer;
+}
+
+static void testDump() {
+    ModeSwitchTracer tracer;
+    char result[8192] = {0};
+    int64_t start;
+
+    int id = tracer.begin(MODE_SWITCH_CAUSE_HOTPLUG, "1080p60hz");
+    tracer.setTarget(id, "2160p60hz");
+    mode_switch_trace_t trace;
+    tracer.getTrace(0, &trace);
+    start = trace.startNs;
+    //added in the order they end, an inner span before its step
+    tracer.addSpan(id, 1, false, start + 1000000, start + 2000000, "write avmute 1");
+    tracer.addSpan(id, 0, false, start + 1000000, start + 10000000, "mute");
+    tracer.addSpan(id, 0, false, start + 10000000, start + 20000000, "output mode");
+    tracer.end(id);
+    tracer.addSpan(id, 0, true, start + 20000000, start + 40000000, "save bootenv");
+    tracer.dump(result, sizeof(result));
+    printf("%s", result);
+
+    CHECK(strstr(result, "hotplug      n:1") != NULL);
+    CHECK(strstr(result, "boot         n:0") != NULL);
+    CHECK(strstr(result, "1080p60hz -> 2160p60hz") != NULL);
+    const char *mute = strstr(result, "| mute");
+    const char *inner = strstr(result, "|   write avmute 1");
+    const char *mode = strstr(result, "| output mode");
+    CHECK(mute != NULL && inner != NULL && mode != NULL);
+    CHECK(mute < inner && inner < mode);
+    //the async save ends the bar, the switch itself the half before it
+    const char *save = strstr(result, "| save bootenv async");
+    CHECK(save != NULL);
+    CHECK(save != NULL && save[-1] == '#');
+    CHECK(strstr(result, "     1.0ms     9.0ms |") != NULL);
+
+    //a small buffer is filled, not overrun
+    char small[64 + 8];
+    memset(small, 'x', sizeof(small));
+    small[0] = '\0';
+    tracer.dump(small, 64);
+    CHECK(strlen(small) == 63);
+    CHECK(small[64] == 'x');
+}
+
+static void testSequencer() {
+    ModeSwitchTracer tracer;
+    ModeSwitchSequencer seq("traced");
+    int id = tracer.begin(MODE_SWITCH_CAUSE_USER, "1080p60hz");
+
+    seq.setTracer(&tracer, id);
+    int mute = seq.addStep("mute", 0, NULL);
+    seq.writes(mute).addDelay(2000);
+    seq.writes(mute).addWait("/nonexistent/phy", "0", 1000);
+    seq.addAsyncStep("save bootenv", ModeSwitchSequencer::after(mute), NULL);
+    seq.run();
+    tracer.end(id);
+    ModeSwitchSequencer::drain();
+
+    mode_switch_trace_t trace;
+    CHECK(tracer.getTrace(0, &trace));
+    CHECK(trace.spanCount == 4);
+    CHECK(!strcmp(trace.spans[0].label, "mute") && trace.spans[0].depth == 0);
+    CHECK(!strcmp(trace.spans[1].label, "delay 2000us") && trace.spans[1].depth == 1);
+    CHECK(trace.spans[1].endNs - trace.spans[1].startNs >= 2000000LL);
+    CHECK(!strcmp(trace.spans[2].label, "wait phy 0 timed out"));
+    CHECK(!strcmp(trace.spans[3].label, "save bootenv") && trace.spans[3].async);
+    CHECK(trace.spans[3].startNs >= trace.spans[0].endNs);
+}
+
+int main(int argc, char **argv) {
+    testRing();
+    testPercentiles();
+    testNoAllocation();
+    testDump();
+    testSequencer();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Runs a PropertyCache over a fake property area with bionic's serial
+ * rules: a property's serial changes on every write and the area serial
+ * when a property is added. Checks that the cache gives what property_get()
+ * and the SysWrite parsers give, that an unchanged property is neither
+ * looked up nor read again, and that changes and late definitions are seen
+ * on the next read, and that the least recently read keys go once the
+ * table is full. Prints the cost of cached and uncached typed reads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <string>
+
+#include "../PropertyCache.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+struct prop_info {
+    char value[PROPERTY_CACHE_VALUE_LEN];
+    uint32_t serial;
+};
+
+static std::map<std::string, prop_info *> gArea;
+static uint32_t gAreaSerial = 1;
+static int gFinds = 0;
+static int gReads = 0;
+
+static const prop_info *fakeFind(const char *name) {
+    gFinds++;
+    std::map<std::string, prop_info *>::iterator it = gArea.find(name);
+    return it == gArea.end() ? NULL : it->second;
+}
+
+static uint32_t fakeSerial(const prop_info *pi) {
+    return pi->serial;
+}
+
+static int fakeRead(const prop_info *pi, char *value) {
+    gReads++;
+    strcpy(value, pi->value);
+    return strlen(value);
+}
+
+static uint32_t fakeAreaSerial(void) {
+    return gAreaSerial;
+}
+
+static const property_backend_t sFakeBackend = {
+    fakeFind,
+    fakeSerial,
+    fakeRead,
+    fakeAreaSerial,
+    NULL,
+};
+
+static void setProp(const char *name, const char *value) {
+    std::map<std::string, prop_info *>::iterator it = gArea.find(name);
+    prop_info *pi;
+
+    if (it == gArea.end()) {
+        pi = new prop_info();
+        pi->serial = 0;
+        gArea[name] = pi;
+        gAreaSerial++;
+    } else {
+        pi = it->second;
+    }
+    strcpy(pi->value, value);
+    pi->serial += 2;
+}
+
+//property_get() followed by the old SysWrite::getPropertyInt() parse
+static int32_t uncachedInt(const char *key, int32_t def) {
+    char buf[PROPERTY_CACHE_VALUE_LEN] = {0};
+    char *end;
+    int32_t result = def;
+    const prop_info *pi = fakeFind(key);
+
+    if (pi != NULL && fakeRead(pi, buf) > 0) {
+        result = strtol(buf, &end, 0);
+        if (end == buf)
+            result = def;
+    }
+    return result;
+}
+
+static void testValues() {
+    PropertyCache cache(&sFakeBackend);
+    char value[PROPERTY_CACHE_VALUE_LEN];
+
+    setProp("persist.vendor.sys.cec.enable", "true");
+    setProp("ubootenv.var.outputmode", "1080p60hz");
+    setProp("vendor.sys.hdr.policy", "0x10");
+    setProp("vendor.sys.empty", "");
+    setProp("vendor.sys.word", "abc");
+
+    CHECK(cache.get("ubootenv.var.outputmode", value, "576cvbs") == 9);
+    CHECK(!strcmp(value, "1080p60hz"));
+    CHECK(cache.get("vendor.sys.empty", value, "def") == 3);
+    CHECK(!strcmp(value, "def"));
+    CHECK(cache.get("vendor.sys.missing", value, "") == 0);
+    CHECK(!strcmp(value, ""));
+
+    CHECK(cache.getInt("vendor.sys.hdr.policy", -1) == 16);
+    CHECK(cache.getLong("vendor.sys.hdr.policy", -1) == 16);
+    CHECK(cache.getInt("vendor.sys.word", 7) == 7);
+    CHECK(cache.getInt("vendor.sys.missing", 7) == 7);
+    //the parse result is kept, not the default
+    CHECK(cache.getInt("vendor.sys.word", 8) == 8);
+
+    CHECK(cache.getBoolean("persist.vendor.sys.cec.enable", false));
+    CHECK(cache.getBoolean("vendor.sys.word", true));
+    CHECK(!cache.getBoolean("vendor.sys.word", false));
+    setProp("vendor.sys.flag", "n");
+    CHECK(!cache.getBoolean("vendor.sys.flag", true));
+    setProp("vendor.sys.flag", "off");
+    CHECK(!cache.getBoolean("vendor.sys.flag", true));
+    setProp("vendor.sys.flag", "y");
+    CHECK(cache.getBoolean("vendor.sys.flag", false));
+}
+
+static void testRevalidation() {
+    PropertyCache cache(&sFakeBackend);
+    property_cache_stats_t stats;
+
+    setProp("vendor.sys.mode.count", "3");
+    CHECK(cache.getInt("vendor.sys.mode.count", 0) == 3);
+    gFinds = 0;
+    gReads = 0;
+    for (int i = 0; i < 100; i++)
+        CHECK(cache.getInt("vendor.sys.mode.count", 0) == 3);
+    //only the serial was looked at
+    CHECK(gFinds == 0);
+    CHECK(gReads == 0);
+
+    setProp("vendor.sys.mode.count", "4");
+    CHECK(cache.getInt("vendor.sys.mode.count", 0) == 4);
+    CHECK(gReads == 1);
+    CHECK(gFinds == 0);
+
+    //undefined: looked up again only after a property was added
+    CHECK(cache.getInt("vendor.sys.late", 5) == 5);
+    CHECK(cache.getInt("vendor.sys.late", 5) == 5);
+    CHECK(gFinds == 1);
+    setProp("vendor.sys.other", "1");
+    CHECK(cache.getInt("vendor.sys.late", 5) == 5);
+    CHECK(gFinds == 2);
+    setProp("vendor.sys.late", "9");
+    CHECK(cache.getInt("vendor.sys.late", 5) == 9);
+
+    cache.getStats(&stats);
+    CHECK(stats.entries == 2);
+    CHECK(stats.hits >= 100);
+    printf("stats: %u hits, %u reads, %u finds, %u entries\n", stats.hits, stats.reads,
+        stats.finds, stats.entries);
+}
+
+static void testEviction() {
+    PropertyCache cache(&sFakeBackend);
+    property_cache_stats_t stats;
+    char key[PROPERTY_CACHE_VALUE_LEN];
+
+    cache.setCapacity(4);
+    setProp("vendor.sys.hot", "1");
+    for (int i = 0; i < 100; i++) {
+        //one key read all along, among keys read only once
+        CHECK(cache.getInt("vendor.sys.hot", 0) == 1);
+        snprintf(key, sizeof(key), "vendor.sys.once.%d", i);
+        CHECK(cache.getInt(key, i) == i);
+    }
+
+    cache.getStats(&stats);
+    CHECK(stats.entries == 4);
+    CHECK(stats.evictions == 97);
+
+    //the hot key stayed, neither looked up nor read again
+    gFinds = 0;
+    gReads = 0;
+    CHECK(cache.getInt("vendor.sys.hot", 0) == 1);
+    CHECK(gFinds == 0);
+    CHECK(gReads == 0);
+    //an evicted key is looked up again, with the same result
+    CHECK(cache.getInt("vendor.sys.once.0", 7) == 7);
+    CHECK(gFinds == 1);
+
+    cache.setCapacity(2);
+    cache.getStats(&stats);
+    CHECK(stats.entries == 2);
+    CHECK(stats.evictions == 100);
+    gFinds = 0;
+    CHECK(cache.getInt("vendor.sys.hot", 0) == 1);
+    CHECK(cache.getInt("vendor.sys.once.0", 7) == 7);
+    CHECK(gFinds == 0);
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void benchmark() {
+    PropertyCache cache(&sFakeBackend);
+    const char *keys[] = {
+        "persist.vendor.sys.hdmi.keep_fb",
+        "ro.vendor.platform.has.tvuimode",
+        "persist.vendor.sys.dolbyvision.enable",
+        "vendor.sys.hdr.policy",
+    };
+    int count = sizeof(keys) / sizeof(keys[0]);
+    int rounds = 200000;
+    volatile int64_t sink = 0;
+
+    for (int i = 0; i < count; i++)
+        setProp(keys[i], "1");
+
+    int64_t start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++)
+            sink += uncachedInt(keys[i], 0);
+    }
+    int64_t uncachedNs = nowNs() - start;
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++)
+            sink += cache.getInt(keys[i], 0);
+    }
+    int64_t cachedNs = nowNs() - start;
+
+    double total = (double)rounds * count;
+    printf("getPropertyInt: uncached %.1f ns, cached %.1f ns per read\n",
+        uncachedNs / total, cachedNs / total);
+}
+
+int main(int argc, char **argv) {
+    testValues();
+    testRevalidation();
+    testEviction();
+    benchmark();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Drives a ServiceConnector with a mock service lookup in place of
+ * ISystemControl::tryGetService(). A service that is already up must be
+ * connected before start() returns, a late one as soon as its registration
+ * is announced, a bounded wait must give up on time, and a service that died
+ * must be connected again once it registers. The time to ready is printed
+ * next to what the old 200 ms lookup loop would have taken.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+
+#include "../ServiceConnector.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+#define LEGACY_POLL_MS      200
+
+//the mock service manager
+static std::atomic<bool> gRegistered(false);
+static std::atomic<int> gLookups(0);
+
+static bool mockResolve(void *user) {
+    gLookups++;
+    return gRegistered;
+}
+
+static int64_t nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void testAlreadyUp() {
+    service_connector_stats_t stats;
+
+    gRegistered = true;
+    ServiceConnector connector("mock", mockResolve, NULL);
+    connector.start();
+    CHECK(connector.isReady());
+    CHECK(connector.waitReady(0));
+
+    connector.getStats(&stats);
+    CHECK(stats.connects == 1);
+    CHECK(stats.attempts == 1);
+    printf("already up: ready after %.3f ms\n", stats.readyNs / 1000000.0);
+}
+
+typedef struct {
+    ServiceConnector *connector;
+    int delayMs;
+} late_start_t;
+
+//what the service manager does when systemcontrol registers
+static void *registerLater(void *data) {
+    late_start_t *late = (late_start_t *)data;
+
+    usleep(late->delayMs * 1000);
+    gRegistered = true;
+    late->connector->onRegistered();
+    return NULL;
+}
+
+static void testLateStart(int delayMs) {
+    service_connector_stats_t stats;
+    pthread_t thread;
+
+    gRegistered = false;
+    gLookups = 0;
+    ServiceConnector connector("mock", mockResolve, NULL);
+    int64_t start = nowMs();
+    connector.start();
+    //start() never waits for the service
+    CHECK(nowMs() - start < 20);
+    CHECK(!connector.isReady());
+
+    late_start_t late = { &connector, delayMs };
+    pthread_create(&thread, NULL, registerLater, &late);
+    CHECK(connector.waitReady(2000));
+    pthread_join(thread, NULL);
+
+    connector.getStats(&stats);
+    CHECK(stats.connects == 1);
+    //one lookup at start, one on the notification, none in between
+    CHECK(gLookups == 2);
+    int legacyMs = (delayMs + LEGACY_POLL_MS - 1) / LEGACY_POLL_MS * LEGACY_POLL_MS;
+    printf("up after %3d ms: ready after %6.1f ms, 200 ms loop %3d ms, %d lookups\n",
+        delayMs, stats.readyNs / 1000000.0, legacyMs, (int)gLookups);
+    CHECK(stats.readyNs / 1000000 < delayMs + 50);
+}
+
+static void testBoundedWait() {
+    gRegistered = false;
+    ServiceConnector connector("mock", mockResolve, NULL);
+    connector.start();
+
+    int64_t start = nowMs();
+    CHECK(!connector.waitReady(50));
+    int64_t waited = nowMs() - start;
+    CHECK(waited >= 45 && waited < 150);
+    //fail fast
+    start = nowMs();
+    CHECK(!connector.waitReady(0));
+    CHECK(nowMs() - start < 5);
+}
+
+static void testReconnect() {
+    service_connector_stats_t stats;
+    pthread_t thread;
+
+    gRegistered = true;
+    ServiceConnector connector("mock", mockResolve, NULL);
+    connector.start();
+    CHECK(connector.isReady());
+
+    //systemcontrol crashed and is not back yet
+    gRegistered = false;
+    connector.onDied();
+    CHECK(!connector.waitReady(30));
+
+    late_start_t late = { &connector, 60 };
+    pthread_create(&thread, NULL, registerLater, &late);
+    CHECK(connector.waitReady(2000));
+    pthread_join(thread, NULL);
+
+    connector.getStats(&stats);
+    CHECK(stats.connects == 2);
+    CHECK(stats.deaths == 1);
+
+    //an announcement while connected changes nothing
+    int lookups = gLookups;
+    connector.onRegistered();
+    usleep(20000);
+    CHECK(gLookups == lookups);
+}
+
+static void testRetry() {
+    service_connector_stats_t stats;
+
+    gRegistered = false;
+    gLookups = 0;
+    ServiceConnector connector("mock", mockResolve, NULL);
+    connector.setRetryInterval(20);
+    connector.start();
+    usleep(70000);
+    //no notification, the lookups keep going at the retry interval
+    CHECK(gLookups >= 3);
+    gRegistered = true;
+    CHECK(connector.waitReady(200));
+
+    int lookups = gLookups;
+    usleep(60000);
+    CHECK(gLookups == lookups);
+    connector.getStats(&stats);
+    CHECK(stats.connects == 1);
+}
+
+int main(int argc, char **argv) {
+    testAlreadyUp();
+    testLateStart(30);
+    testLateStart(150);
+    testLateStart(450);
+    testBoundedWait();
+    testReconnect();
+    testRetry();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Parses the disp_cap, dc_cap, dv_cap and hdr_cap text of a few sinks, a 4K
+ * TV with 420 modes and dolby vision, an AVR repeater, an old 720p TV with no
+ * native mode and a 4K30 monitor, and checks the answers against golden
+ * values and against the edid scans DisplayMode did before, copied below:
+ * getBestHdmiMode(), filterHdmiMode(), getHighestPriorityMode() and
+ * isTvSupportDolbyVision(). Prints the cost of answering a mode switch both
+ * ways.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../SinkCaps.h"
+#include "../common.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+typedef struct sink_fixture {
+    const char *name;
+    const char *dispCap;            //as readSysfsOriginal() gives it
+    const char *dcCap;              //as readSysfs() gives it, newlines dropped
+    const char *dvCap;
+    const char *hdrCap;
+    const char *native;
+    const char *highest[4];         //bit 0 4k allowed, bit 1 over 2160p30hz allowed
+    const char *dvCaps;             //NULL when dolby vision is not supported
+    int hdrFlags;
+} sink_fixture_t;
+
+static const sink_fixture_t sSinks[] = {
+    {
+        "4k tv",
+        "480i60hz\n480p60hz\n576i50hz\n576p50hz\n720p60hz\n1080i60hz\n1080p60hz\n720p50hz\n"
+        "1080i50hz\n1080p30hz\n1080p50hz\n1080p25hz\n1080p24hz\n2160p30hz\n2160p25hz\n"
+        "2160p24hz\nsmpte24hz\nsmpte25hz\nsmpte30hz\n2160p50hz\n2160p60hz*\n2160p50hz420\n"
+        "2160p60hz420\nsmpte50hz420\nsmpte60hz420\n",
+        "420,12bit420,10bit420,8bit422,12bit422,10bit444,12bit444,10bit444,8bitrgb,12bitrgb,10bitrgb,8bit",
+        "DolbyVision RX support list:  2160p60hz  DV_RGB_444_8BIT  LL_YCbCr_422_12BIT",
+        "Supported EOTF:\n    Traditional SDR: 1\n    Traditional HDR: 0\n    SMPTE ST 2084: 1\n"
+        "    Hybrif Log-Gamma: 1\n",
+        "2160p60hz",
+        { "1080p60hz", "2160p30hz", "1080p60hz", "2160p60hz" },
+        "2160p60hz,DV_RGB_444_8BIT,LL_YCbCr_422_12BIT,",
+        SINK_HDR_HDR10 | SINK_HDR_HLG,
+    },
+    {
+        "avr repeater",
+        "480p60hz\n576p50hz\n720p60hz\n1080i60hz\n1080p60hz*\n720p50hz\n1080i50hz\n1080p50hz\n"
+        "1080p24hz\n",
+        "444,12bit444,10bit444,8bitrgb,12bitrgb,10bitrgb,8bit",
+        "The Rx don't support DolbyVision",
+        "Supported EOTF:\n    Traditional SDR: 1\n    Traditional HDR: 0\n    SMPTE ST 2084: 0\n"
+        "    Hybrif Log-Gamma: 0\n",
+        "1080p60hz",
+        { "1080p60hz", "1080p60hz", "1080p60hz", "1080p60hz" },
+        NULL,
+        0,
+    },
+    {
+        "720p tv",
+        "480i60hz\n480p60hz\n576i50hz\n576p50hz\n720p50hz\n720p60hz\n1080i60hz\n1080i50hz\n",
+        "",
+        "The Rx don't support DolbyVision",
+        "",
+        "",
+        { "1080i60hz", "1080i60hz", "1080i60hz", "1080i60hz" },
+        NULL,
+        0,
+    },
+    {
+        "4k30 monitor",
+        "480p60hz\n720p60hz\n1080p60hz\n1080p30hz\n2160p24hz\n2160p25hz\n2160p30hz*\nsmpte24hz\n",
+        "444,10bit444,8bitrgb,10bitrgb,8bit",
+        "DolbyVision RX support list:  1080p60hz  LL_RGB_444_12BIT",
+        "Supported EOTF:\n    Traditional SDR: 1\n    Traditional HDR: 1\n    SMPTE ST 2084: 1\n"
+        "    Hybrif Log-Gamma: 0\n",
+        "2160p30hz",
+        { "1080p60hz", "2160p30hz", "1080p60hz", "2160p30hz" },
+        "1080p60hz,LL_RGB_444_12BIT,",
+        SINK_HDR_HDR10,
+    },
+};
+
+static const char* MODES_SINK[] = {
+    "2160p60hz",
+    "2160p50hz",
+    "2160p30hz",
+    "2160p25hz",
+    "2160p24hz",
+    "1080p60hz",
+    "1080p50hz",
+    "1080p30hz",
+    "1080p25hz",
+    "1080p24hz",
+    "720p60hz",
+    "720p50hz",
+    "480p60hz",
+    "576p50hz",
+};
+
+//the saved modes filterHdmiMode() gets from ubootenv
+static const char *sSavedModes[] = {
+    "1080p60hz", "2160p60hz", "2160p60hz420", "2160p60hz10bit", "720p60hz", "576cvbs",
+    "1080p", "smpte24hz", "2160p50hz420", "",
+};
+
+static const char* DV_MODE_TYPE[] = {
+    "DV_RGB_444_8BIT",
+    "DV_YCbCr_422_12BIT",
+    "LL_YCbCr_422_12BIT",
+    "LL_RGB_444_12BIT"
+};
+
+//the getBestHdmiMode() scan, the newline in front stands for the byte it read before the edid
+static void oldBest(const char *dispCap, char *mode) {
+    char buf[MAX_STR_LEN + 1] = {0};
+    char *edid = buf + 1;
+
+    buf[0] = '\n';
+    strcpy(edid, dispCap);
+    memset(mode, 0, MODE_LEN);
+    char* pos = strchr(edid, '*');
+    if (pos != NULL) {
+        char* findReturn = pos;
+        while (*findReturn != 0x0a && findReturn >= edid) {
+            findReturn--;
+        }
+        findReturn = findReturn + 1;
+        strncpy(mode, findReturn, pos - findReturn);
+    }
+}
+
+//the filterHdmiMode() scan, true when the saved mode is kept
+static bool oldFilter(const char *edid, const char *saved) {
+    const char *pCmp = edid;
+    while ((pCmp - edid) < (int)strlen(edid)) {
+        const char *pos = strchr(pCmp, 0x0a);
+        if (NULL == pos)
+            break;
+
+        int step = 1;
+        if (*(pos - 1) == '*') {
+            pos -= 1;
+            step += 1;
+        }
+        if (!strncmp(pCmp, saved, pos - pCmp))
+            return true;
+        pCmp = pos + step;
+    }
+    return false;
+}
+
+//the isTvSupportDolbyVision() string building
+static bool oldDolbyVision(const char *dv_cap, char *mode) {
+    strcpy(mode, "");
+    if (strstr(dv_cap, "The Rx don't support DolbyVision")) {
+        return false;
+    }
+    for (int i = DISPLAY_MODE_TOTAL - 1; i >= 0; i--) {
+        const char *name = DisplayModeRegistry::get(i)->name;
+        if (strstr(dv_cap, name) != NULL) {
+            strcat(mode, name);
+            strcat(mode, ",");
+            break;
+        }
+    }
+    for (size_t i = 0; i < sizeof(DV_MODE_TYPE)/sizeof(DV_MODE_TYPE[0]); i++) {
+        if (strstr(dv_cap, DV_MODE_TYPE[i])) {
+            strcat(mode, DV_MODE_TYPE[i]);
+            strcat(mode, ",");
+        }
+    }
+    return true;
+}
+
+static SinkCaps sCaps;
+
+static void testGolden() {
+    char mode[MODE_LEN];
+
+    for (size_t i = 0; i < sizeof(sSinks) / sizeof(sSinks[0]); i++) {
+        const sink_fixture_t *sink = &sSinks[i];
+
+        sCaps.parse(sink->dispCap, sink->dcCap, sink->dvCap, sink->hdrCap);
+        printf("%s: %d modes, native [%s]\n", sink->name, sCaps.getModeCount(), sCaps.getNativeMode());
+
+        CHECK(!strcmp(sCaps.getText(), sink->dispCap));
+        CHECK(!strcmp(sCaps.getNativeMode(), sink->native));
+        for (int flags = 0; flags < 4; flags++) {
+            sCaps.getHighest("480p60hz", flags & 1, flags & 2, mode);
+            CHECK(!strcmp(mode, sink->highest[flags]));
+        }
+
+        CHECK(sCaps.isDolbyVisionSupported() == (sink->dvCaps != NULL));
+        if (sink->dvCaps != NULL)
+            CHECK(!strcmp(sCaps.getDolbyVisionCaps(), sink->dvCaps));
+        CHECK(sCaps.getHdrFlags() == sink->hdrFlags);
+
+        CHECK(sCaps.hasDeepColorList() == (strlen(sink->dcCap) > 0));
+        CHECK(sCaps.hasDeepColor("444,8bit") == (strstr(sink->dcCap, "444,8bit") != NULL));
+        CHECK(sCaps.hasDeepColor("420,12bit") == (strstr(sink->dcCap, "420,12bit") != NULL));
+
+        for (int m = 0; m < sCaps.getModeCount(); m++) {
+            CHECK(sCaps.hasMode(sCaps.getMode(m)->name));
+            CHECK(strchr(sCaps.getMode(m)->name, '*') == NULL);
+        }
+    }
+
+    sCaps.parse(sSinks[0].dispCap, NULL, NULL, NULL);
+    CHECK(sCaps.hasMode("2160p60hz420") && sCaps.hasMode("2160p60hz"));
+    CHECK(!sCaps.hasMode("2160p60hz4") && !sCaps.hasMode("768p60hz"));
+    CHECK(!sCaps.hasDeepColorList() && sCaps.getHdrFlags() == 0);
+    //an unreadable dv_cap passed the old check
+    CHECK(sCaps.isDolbyVisionSupported() && !strcmp(sCaps.getDolbyVisionCaps(), ""));
+
+    sCaps.clear();
+    CHECK(sCaps.getModeCount() == 0 && !strcmp(sCaps.getNativeMode(), ""));
+    CHECK(!sCaps.acceptsMode("1080p60hz") && !sCaps.mentionsMode("1080p60hz"));
+
+    CHECK(!strcmp(SinkCaps::getDolbyVisionType(0), "DV_RGB_444_8BIT"));
+    CHECK(!strcmp(SinkCaps::getDolbyVisionType(3), "LL_RGB_444_12BIT"));
+    CHECK(SinkCaps::getDolbyVisionType(-1) == NULL && SinkCaps::getDolbyVisionType(4) == NULL);
+}
+
+static void testOldScans() {
+    char oldMode[MAX_STR_LEN];
+
+    for (size_t i = 0; i < sizeof(sSinks) / sizeof(sSinks[0]); i++) {
+        const sink_fixture_t *sink = &sSinks[i];
+        sCaps.parse(sink->dispCap, sink->dcCap, sink->dvCap, sink->hdrCap);
+
+        oldBest(sink->dispCap, oldMode);
+        CHECK(!strcmp(sCaps.getNativeMode(), oldMode));
+
+        for (size_t s = 0; s < sizeof(sSavedModes) / sizeof(sSavedModes[0]); s++)
+            CHECK(sCaps.acceptsMode(sSavedModes[s]) == oldFilter(sink->dispCap, sSavedModes[s]));
+
+        for (size_t s = 0; s < sizeof(MODES_SINK) / sizeof(MODES_SINK[0]); s++)
+            CHECK(sCaps.mentionsMode(MODES_SINK[s]) == (strstr(sink->dispCap, MODES_SINK[s]) != NULL));
+        for (int s = 0; s < DISPLAY_MODE_TOTAL; s++) {
+            const char *name = DisplayModeRegistry::get(s)->name;
+            CHECK(sCaps.mentionsMode(name) == (strstr(sink->dispCap, name) != NULL));
+        }
+
+        bool oldDv = oldDolbyVision(sink->dvCap, oldMode);
+        CHECK(sCaps.isDolbyVisionSupported() == oldDv);
+        CHECK(!strcmp(sCaps.getDolbyVisionCaps(), oldMode));
+    }
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//one mode switch asked for the native mode, the saved mode and the dolby vision caps
+static void benchmark() {
+    const sink_fixture_t *sink = &sSinks[0];
+    char mode[MAX_STR_LEN];
+    int rounds = 20000;
+    volatile int sum = 0;
+
+    int64_t start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        oldBest(sink->dispCap, mode);
+        sum += oldFilter(sink->dispCap, "2160p60hz420");
+        sum += oldDolbyVision(sink->dvCap, mode);
+        for (size_t s = 0; s < sizeof(MODES_SINK) / sizeof(MODES_SINK[0]); s++)
+            sum += strstr(sink->dispCap, MODES_SINK[s]) != NULL;
+    }
+    int64_t oldNs = nowNs() - start;
+
+    sCaps.parse(sink->dispCap, sink->dcCap, sink->dvCap, sink->hdrCap);
+    start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        sum += sCaps.getNativeMode()[0];
+        sum += sCaps.acceptsMode("2160p60hz420");
+        sum += sCaps.isDolbyVisionSupported() + sCaps.getDolbyVisionCaps()[0];
+        for (size_t s = 0; s < sizeof(MODES_SINK) / sizeof(MODES_SINK[0]); s++)
+            sum += sCaps.mentionsMode(MODES_SINK[s]);
+    }
+    int64_t newNs = nowNs() - start;
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++)
+        sCaps.parse(sink->dispCap, sink->dcCap, sink->dvCap, sink->hdrCap);
+    int64_t parseNs = nowNs() - start;
+
+    printf("mode switch questions: edid scans %.2f us, parsed caps %.2f us, parse once %.2f us\n",
+        oldNs / (double)rounds / 1000, newNs / (double)rounds / 1000, parseNs / (double)rounds / 1000);
+}
+
+int main(int argc, char **argv) {
+    testGolden();
+    testOldScans();
+    benchmark();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Records the mode switch mute sequence in dry run and compares it with
+ * its golden text, then commits batches against a fake sysfs tree with a
+ * missing node to check the error report. Waits are timed against nodes
+ * that already match, never match and can not be read.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+#include "../SysfsBatch.h"
+
+static char gRoot[64];
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+//DisplayMode::setSourceOutputMode() mute step for OUPUT_MODE_STATE_SWITCH from 1080p60hz
+static const char *sMuteGolden =
+    "write /sys/devices/virtual/amhdmitx/amhdmitx0/avmute 1\n"
+    "delay 16666\n"
+    "write /sys/class/amhdmitx/amhdmitx0/hdcp_mode -1\n"
+    "write /sys/class/amhdmitx/amhdmitx0/phy 0\n"
+    "delay 50000\n";
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static std::string node(const char *name) {
+    return std::string(gRoot) + "/" + name;
+}
+
+static std::string readNode(const char *name) {
+    char buf[64] = {0};
+    int fd = open(node(name).c_str(), O_RDONLY);
+
+    if (fd >= 0) {
+        read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+    }
+    return buf;
+}
+
+static void testDryRun() {
+    SysfsBatch mute("mute", true);
+
+    mute.add("/sys/devices/virtual/amhdmitx/amhdmitx0/avmute", "1");
+    mute.addDelay(16666);
+    mute.add("/sys/class/amhdmitx/amhdmitx0/hdcp_mode", "-1");
+    mute.add("/sys/class/amhdmitx/amhdmitx0/phy", "0");
+    mute.addDelay(50000);
+    CHECK(mute.commit() == 0);
+    CHECK(mute.dump(false) == sMuteGolden);
+    //nothing was slept or written
+    CHECK(mute.getResult().totalNs < 10000000LL);
+
+    //the global switch covers batches built deep inside DisplayMode
+    SysfsBatch::setDryRunAll(true);
+    SysfsBatch other("other");
+    other.add(node("never").c_str(), "1");
+    CHECK(other.commit() == 0);
+    CHECK(access(node("never").c_str(), F_OK) != 0);
+    SysfsBatch::setDryRunAll(false);
+}
+
+static void testCommit() {
+    for (const char *name : {"avmute", "phy", "aud_mute"}) {
+        int fd = open(node(name).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        close(fd);
+    }
+
+    SysfsBatch unmute("unmute");
+    unmute.add(node("phy").c_str(), "1");
+    unmute.addDelay(20000);
+    unmute.add(node("aud_mute").c_str(), "1");
+    unmute.add(node("missing").c_str(), "0");
+    unmute.add(node("avmute").c_str(), "-1");
+    CHECK(unmute.commit() == 1);
+
+    const sysfs_batch_result_t &result = unmute.getResult();
+    CHECK(result.failed == 1);
+    CHECK(result.firstFailed == 3);
+    CHECK(result.ops[3].err == ENOENT);
+    CHECK(result.ops[1].latencyNs >= 20000000LL);
+    CHECK(result.ops[4].done && result.ops[4].err == 0);
+    CHECK(readNode("phy") == "1");
+    CHECK(readNode("avmute") == "-1");
+    printf("%s", unmute.dump(true).c_str());
+
+    //abort leaves the rest untouched
+    SysfsBatch abort("abort");
+    abort.setAbortOnError(true);
+    abort.add(node("missing").c_str(), "1");
+    abort.add(node("phy").c_str(), "0");
+    CHECK(abort.commit() == 1);
+    CHECK(!abort.getResult().ops[1].done);
+    CHECK(readNode("phy") == "1");
+    CHECK(abort.dump(true).find("skipped") != std::string::npos);
+
+    for (const char *name : {"avmute", "phy", "aud_mute"})
+        unlink(node(name).c_str());
+}
+
+static void testWait() {
+    int fd = open(node("phy").c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    close(fd);
+
+    //the driver already reports the new state, no delay is left
+    SysfsBatch on("phy on");
+    on.add(node("phy").c_str(), "1");
+    on.addWait(node("phy").c_str(), "1", 20000);
+    int64_t start = nowNs();
+    CHECK(on.commit() == 0);
+    int64_t onNs = nowNs() - start;
+    CHECK(!on.getResult().ops[1].timedOut);
+    CHECK(onNs < 5000000LL);
+
+    //"10" is not "1", the ceiling bounds the wait
+    SysfsBatch never("never");
+    never.add(node("phy").c_str(), "10");
+    never.addWait(node("phy").c_str(), "1", 20000);
+    CHECK(never.commit() == 0);
+    CHECK(never.getResult().ops[1].timedOut);
+    CHECK(never.getResult().ops[1].latencyNs >= 20000000LL);
+    CHECK(never.dump(true).find("timed out") != std::string::npos);
+
+    //a node that can not be read keeps the old fixed delay
+    SysfsBatch missing("missing");
+    missing.addWait(node("missing").c_str(), "1", 20000);
+    CHECK(missing.commit() == 0);
+    CHECK(missing.getResult().ops[0].latencyNs >= 20000000LL);
+
+    printf("wait on a matching node %lldus, fixed delay 20000us\n", (long long)onNs / 1000);
+    unlink(node("phy").c_str());
+}
+
+int main(int argc, char **argv) {
+    snprintf(gRoot, sizeof(gRoot), "%s/sysfs_XXXXXX",
+        getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp");
+    if (mkdtemp(gRoot) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    testDryRun();
+    testCommit();
+    testWait();
+    rmdir(gRoot);
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Runs SysfsFdCache against a fake sysfs tree under $TMPDIR, from one thread
+ * and from several that evict each other's nodes mid i/o, then compares the
+ * cost of the DisplayMode style read/write pattern with open/close per
+ * access.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "../SysfsFdCache.h"
+
+#define BENCH_LOOPS         20000
+#define STRESS_THREADS      4
+#define STRESS_LOOPS        5000
+
+static char gRoot[64];
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+static const char *node(const char *name) {
+    static char path[4][128];
+    static int idx = 0;
+
+    idx = (idx + 1) % 4;
+    snprintf(path[idx], sizeof(path[idx]), "%s/%s", gRoot, name);
+    return path[idx];
+}
+
+static void createNode(const char *name, const char *value, mode_t mode) {
+    const char *path = node(name);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    write(fd, value, strlen(value));
+    close(fd);
+    chmod(path, mode);
+}
+
+static int countOpenFds(const char *path) {
+    char link[PATH_MAX], target[PATH_MAX];
+    DIR *dir = opendir("/proc/self/fd");
+    struct dirent *ent;
+    int count = 0;
+
+    while ((ent = readdir(dir)) != NULL) {
+        snprintf(link, sizeof(link), "/proc/self/fd/%s", ent->d_name);
+        int len = readlink(link, target, sizeof(target) - 1);
+        if (len <= 0)
+            continue;
+        target[len] = '\0';
+        if (!strcmp(target, path))
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+//O_ACCMODE of the cached fd, -1 when it is not open
+static int cachedFdAccess(const char *path) {
+    char link[PATH_MAX], target[PATH_MAX];
+
+    for (int fd = 3; fd < 1024; fd++) {
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        int len = readlink(link, target, sizeof(target) - 1);
+        if (len <= 0)
+            continue;
+        target[len] = '\0';
+        if (!strcmp(target, path))
+            return fcntl(fd, F_GETFL) & O_ACCMODE;
+    }
+    return -1;
+}
+
+//close the cached fd behind the cache back, as an unbound driver would
+static void closeCachedFd(const char *path) {
+    char link[PATH_MAX], target[PATH_MAX];
+
+    for (int fd = 3; fd < 1024; fd++) {
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        int len = readlink(link, target, sizeof(target) - 1);
+        if (len <= 0)
+            continue;
+        target[len] = '\0';
+        if (!strcmp(target, path))
+            close(fd);
+    }
+}
+
+static void testCache(SysfsFdCache *cache) {
+    sysfs_fd_stats_t stats;
+    char buf[64];
+
+    createNode("mode", "1080p60hz\n", 0644);
+    createNode("disp_cap", "480p60hz\n720p60hz\n", 0444);
+
+    createNode("hdcp_mode", "", 0644);
+
+    //read first: O_RDONLY, the first write reopens it O_RDWR for good
+    memset(buf, 0, sizeof(buf));
+    CHECK(cache->read(node("mode"), buf, sizeof(buf) - 1) == 10);
+    CHECK(!strcmp(buf, "1080p60hz\n"));
+    CHECK(cachedFdAccess(node("mode")) == O_RDONLY);
+    CHECK(cache->write(node("mode"), "720p60hz\n", 9) == 9);
+    CHECK(cachedFdAccess(node("mode")) == O_RDWR);
+    memset(buf, 0, sizeof(buf));
+    //tmpfs keeps the tail of the longer value, sysfs store() would not
+    CHECK(cache->read(node("mode"), buf, 9) == 9);
+    CHECK(!strncmp(buf, "720p60hz\n", 9));
+    CHECK(cache->write(node("mode"), "720p60hz\n", 9) == 9);
+    CHECK(countOpenFds(node("mode")) == 1);
+
+    cache->getStats(&stats);
+    CHECK(stats.misses == 2);
+    CHECK(stats.hits == 2);
+    CHECK(stats.syscallsSaved == 4);
+
+    //only written: O_WRONLY
+    CHECK(cache->write(node("hdcp_mode"), "1", 1) == 1);
+    CHECK(cachedFdAccess(node("hdcp_mode")) == O_WRONLY);
+
+    //read only node: cached O_RDONLY, a write still fails
+    memset(buf, 0, sizeof(buf));
+    CHECK(cache->read(node("disp_cap"), buf, sizeof(buf) - 1) > 0);
+    CHECK(!strcmp(buf, "480p60hz\n720p60hz\n"));
+    CHECK(cachedFdAccess(node("disp_cap")) == O_RDONLY);
+    if (geteuid() != 0) {
+        CHECK(cache->write(node("disp_cap"), "1", 1) < 0);
+        //the read fd stays
+        CHECK(cachedFdAccess(node("disp_cap")) == O_RDONLY);
+
+        //write only node: no rw open, reads fail without dropping the write fd
+        createNode("avmute", "", 0200);
+        CHECK(cache->write(node("avmute"), "-1", 2) == 2);
+        CHECK(cachedFdAccess(node("avmute")) == O_WRONLY);
+        CHECK(cache->read(node("avmute"), buf, sizeof(buf)) < 0);
+        CHECK(cache->write(node("avmute"), "1", 1) == 1);
+        unlink(node("avmute"));
+    }
+
+    //driver unbound: EBADF, reopened and served
+    closeCachedFd(node("mode"));
+    memset(buf, 0, sizeof(buf));
+    CHECK(cache->read(node("mode"), buf, 9) == 9);
+    cache->getStats(&stats);
+    CHECK(stats.reopens == 1);
+
+    //node gone for good
+    closeCachedFd(node("mode"));
+    unlink(node("mode"));
+    CHECK(cache->read(node("mode"), buf, 9) < 0);
+    CHECK(errno == ENOENT);
+    createNode("mode", "576p50hz\n", 0644);
+    memset(buf, 0, sizeof(buf));
+    CHECK(cache->read(node("mode"), buf, sizeof(buf) - 1) == 9);
+    CHECK(!strcmp(buf, "576p50hz\n"));
+
+    //fresh open nodes are never kept open
+    cache->addFreshOpenNode(node("unifykeys"));
+    mkdir(node("unifykeys"), 0755);
+    createNode("unifykeys/name", "", 0644);
+    CHECK(cache->write(node("unifykeys/name"), "hdcp22_fw_private", 17) == 17);
+    CHECK(countOpenFds(node("unifykeys/name")) == 0);
+    cache->getStats(&stats);
+    CHECK(stats.uncached == 1);
+
+    //LRU bound
+    cache->setCapacity(2);
+    createNode("a", "a", 0644);
+    createNode("b", "b", 0644);
+    createNode("c", "c", 0644);
+    cache->read(node("a"), buf, 1);
+    cache->read(node("b"), buf, 1);
+    cache->read(node("a"), buf, 1);
+    cache->read(node("c"), buf, 1);
+    CHECK(countOpenFds(node("a")) == 1);
+    CHECK(countOpenFds(node("b")) == 0);
+    CHECK(countOpenFds(node("c")) == 1);
+
+    cache->clear();
+    CHECK(countOpenFds(node("a")) == 0);
+    cache->setCapacity(SYSFS_FD_CACHE_SIZE);
+
+    unlink(node("unifykeys/name"));
+    rmdir(node("unifykeys"));
+    unlink(node("hdcp_mode"));
+    unlink(node("disp_cap"));
+    unlink(node("a"));
+    unlink(node("b"));
+    unlink(node("c"));
+}
+
+static int gStressErrors = 0;
+static char gStressNodes[2][128];
+
+static void *stressThread(void *arg) {
+    SysfsFdCache *cache = SysfsFdCache::getInstance();
+    long id = (long)arg;
+    char buf[16];
+
+    for (int i = 0; i < STRESS_LOOPS; i++) {
+        const char *path = gStressNodes[(i + id) % 2];
+        int ret = (i % 3) ? cache->read(path, buf, 1) : cache->write(path, "1", 1);
+        if (ret != 1)
+            __sync_fetch_and_add(&gStressErrors, 1);
+        if (id == 0 && i % 7 == 0)
+            cache->invalidate(path);
+    }
+    return NULL;
+}
+
+//a node dropped while another thread reads it keeps its fd until that read ends
+static void testThreads(SysfsFdCache *cache) {
+    pthread_t threads[STRESS_THREADS];
+
+    createNode("x", "0", 0644);
+    createNode("y", "0", 0644);
+    //node() is not thread safe
+    strcpy(gStressNodes[0], node("x"));
+    strcpy(gStressNodes[1], node("y"));
+    cache->setCapacity(1);
+    for (long i = 0; i < STRESS_THREADS; i++)
+        pthread_create(&threads[i], NULL, stressThread, (void *)i);
+    for (int i = 0; i < STRESS_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    CHECK(gStressErrors == 0);
+    CHECK(countOpenFds(node("x")) + countOpenFds(node("y")) == 1);
+    cache->clear();
+    CHECK(countOpenFds(node("x")) + countOpenFds(node("y")) == 0);
+    cache->setCapacity(SYSFS_FD_CACHE_SIZE);
+    unlink(node("x"));
+    unlink(node("y"));
+}
+
+static double nowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+//one mode switch touches roughly these nodes, reads dominate
+static const char *const sSwitchNodes[] = {
+    "mode", "disp_cap", "dc_cap", "attr", "hdr_cap", "hdcp_mode", "rawedid",
+    "free_scale", "window_axis", "blank",
+};
+
+static void benchmark(SysfsFdCache *cache) {
+    const int nodes = sizeof(sSwitchNodes) / sizeof(sSwitchNodes[0]);
+    sysfs_fd_stats_t before, after;
+    char buf[256];
+    double start, direct, cached;
+
+    for (int i = 0; i < nodes; i++)
+        createNode(sSwitchNodes[i], "0\n", 0644);
+
+    start = nowUs();
+    for (int loop = 0; loop < BENCH_LOOPS; loop++) {
+        for (int i = 0; i < nodes; i++) {
+            int fd = open(node(sSwitchNodes[i]), i % 3 ? O_RDONLY : O_RDWR);
+            if (i % 3)
+                read(fd, buf, sizeof(buf));
+            else
+                write(fd, "1\n", 2);
+            close(fd);
+        }
+    }
+    direct = nowUs() - start;
+
+    cache->getStats(&before);
+    start = nowUs();
+    for (int loop = 0; loop < BENCH_LOOPS; loop++) {
+        for (int i = 0; i < nodes; i++) {
+            if (i % 3)
+                cache->read(node(sSwitchNodes[i]), buf, sizeof(buf));
+            else
+                cache->write(node(sSwitchNodes[i]), "1\n", 2);
+        }
+    }
+    cached = nowUs() - start;
+    cache->getStats(&after);
+
+    printf("open/close per access: %.3f us/access\n", direct / (BENCH_LOOPS * nodes));
+    printf("cached fd:             %.3f us/access, %u syscalls saved\n",
+        cached / (BENCH_LOOPS * nodes), after.syscallsSaved - before.syscallsSaved);
+    CHECK(after.misses - before.misses == (unsigned int)nodes);
+
+    cache->clear();
+    for (int i = 0; i < nodes; i++)
+        unlink(node(sSwitchNodes[i]));
+}
+
+int main(int argc, char **argv) {
+    SysfsFdCache *cache = SysfsFdCache::getInstance();
+
+    //not /dev/shm: everything under /dev is on the fresh open list
+    snprintf(gRoot, sizeof(gRoot), "%s/sysfs_XXXXXX",
+        getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp");
+    if (mkdtemp(gRoot) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    testCache(cache);
+    testThreads(cache);
+    benchmark(cache);
+    rmdir(gRoot);
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Per item latency of single SystemControlClient calls against batched ones,
+ * on the nodes and properties a settings screen reads to show the display
+ * state. ISystemControl@1.1 has no list transactions yet, so a batch is
+ * taken as one transaction round trip plus the SysWrite list call the
+ * service runs for it, here in process. Writes are only measured on the
+ * nodes named on the command line, and only write back the value just read:
+ *     test-systemcontrol-batch [rounds] [write <node>...]
+ */
+
+#define LOG_TAG "SystemControlBatchTest"
+
+#include <utils/Log.h>
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#include <../SystemControlClient.h>
+#include "../SysWrite.h"
+#include <string>
+#include <vector>
+
+using namespace android;
+
+static const char *sNodes[] = {
+    "/sys/class/display/mode",
+    "/sys/class/amhdmitx/amhdmitx0/hpd_state",
+    "/sys/class/amhdmitx/amhdmitx0/disp_cap",
+    "/sys/class/amhdmitx/amhdmitx0/dc_cap",
+    "/sys/class/amhdmitx/amhdmitx0/attr",
+    "/sys/class/amhdmitx/amhdmitx0/hdr_cap",
+    "/sys/class/amhdmitx/amhdmitx0/dv_cap",
+    "/sys/class/amhdmitx/amhdmitx0/config",
+    "/sys/class/amhdmitx/amhdmitx0/hdcp_mode",
+    "/sys/class/amhdmitx/amhdmitx0/hdcp_ver",
+    "/sys/class/amhdmitx/amhdmitx0/rawedid",
+    "/sys/class/amhdmitx/amhdmitx0/frac_rate_policy",
+    "/sys/module/amdolby_vision/parameters/dolby_vision_enable",
+    "/sys/class/graphics/fb0/window_axis",
+    "/sys/class/graphics/fb0/free_scale",
+    "/sys/class/video/disable_video",
+};
+
+static const char *sProps[] = {
+    "persist.vendor.sys.hdmi.keep_fb",
+    "ubootenv.var.outputmode",
+    "ubootenv.var.colorattribute",
+    "ubootenv.var.hdmimode",
+    "ubootenv.var.cvbsmode",
+    "ro.vendor.platform.has.tvuimode",
+    "ro.vendor.platform.hdmi.device_type",
+    "persist.vendor.sys.cec.enable",
+    "vendor.sys.hdr.policy",
+    "persist.vendor.sys.dolbyvision.enable",
+};
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void report(const char *name, int64_t singleNs, int64_t batchNs, int items) {
+    printf("%-16s %3d items  single: %8.1f us/item  batch: %8.1f us/item\n",
+        name, items, singleNs / 1000.0 / items, batchNs / 1000.0 / items);
+}
+
+//one transaction that carries nothing, what a list transaction costs on top of its items
+static int64_t roundTripNs(SystemControlClient *client, int rounds) {
+    std::string value;
+
+    int64_t start = nowNs();
+    for (int r = 0; r < rounds; r++)
+        client->getProperty("", value);
+    return (nowNs() - start) / rounds;
+}
+
+static void benchRead(SystemControlClient *client, SysWrite *sysWrite, int rounds, int64_t tripNs) {
+    std::vector<std::string> paths(sNodes, sNodes + ARRAY_SIZE(sNodes));
+    std::vector<std::string> values;
+    std::string value;
+    int failed = 0;
+
+    int64_t start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < paths.size(); i++)
+            client->readSysfs(paths[i], value);
+    }
+    int64_t singleNs = nowNs() - start;
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++)
+        failed += sysWrite->readSysfsBatch(paths, values);
+    int64_t batchNs = nowNs() - start + tripNs * rounds;
+
+    report("readSysfs", singleNs, batchNs, rounds * paths.size());
+    if (failed > 0)
+        printf("readSysfsBatch: %d failed reads\n", failed);
+}
+
+static void benchProperty(SystemControlClient *client, SysWrite *sysWrite, int rounds, int64_t tripNs) {
+    std::vector<std::string> keys(sProps, sProps + ARRAY_SIZE(sProps));
+    std::vector<std::string> values;
+    std::string value;
+
+    int64_t start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < keys.size(); i++)
+            client->getProperty(keys[i], value);
+    }
+    int64_t singleNs = nowNs() - start;
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++)
+        sysWrite->getPropertyBatch(keys, values);
+    int64_t batchNs = nowNs() - start + tripNs * rounds;
+
+    report("getProperty", singleNs, batchNs, rounds * keys.size());
+}
+
+static void benchWrite(SystemControlClient *client, SysWrite *sysWrite, int rounds, int64_t tripNs,
+    const std::vector<std::string> &paths) {
+    std::vector<std::string> values;
+    int failed = 0;
+
+    //the value every node already holds, so the writes change nothing
+    sysWrite->readSysfsBatch(paths, values);
+
+    int64_t start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < paths.size(); i++)
+            client->writeSysfs(paths[i], values[i]);
+    }
+    int64_t singleNs = nowNs() - start;
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++)
+        failed += sysWrite->writeSysfsBatch(paths, values);
+    int64_t batchNs = nowNs() - start + tripNs * rounds;
+
+    report("writeSysfs", singleNs, batchNs, rounds * paths.size());
+    if (failed > 0)
+        printf("writeSysfsBatch: %d failed writes\n", failed);
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = 100;
+    std::vector<std::string> writePaths;
+    int i = 1;
+
+    if (i < argc && strcmp(argv[i], "write") != 0)
+        rounds = atoi(argv[i++]);
+    if (rounds <= 0)
+        rounds = 100;
+    if (i < argc && strcmp(argv[i], "write") == 0) {
+        for (i++; i < argc; i++)
+            writePaths.push_back(argv[i]);
+    }
+
+    sp<SystemControlClient> client = new SystemControlClient();
+    SysWrite sysWrite;
+    int64_t tripNs = roundTripNs(client.get(), rounds);
+    printf("%d rounds, %.1f us per transaction\n", rounds, tripNs / 1000.0);
+    benchRead(client.get(), &sysWrite, rounds, tripNs);
+    benchProperty(client.get(), &sysWrite, rounds, tripNs);
+    if (!writePaths.empty())
+        benchWrite(client.get(), &sysWrite, rounds, tripNs, writePaths);
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Runs a UeventHub on one end of a datagram socketpair in place of the
+ * netlink socket and injects uevents from the other end. Checks that the
+ * hdcp tx and rx queues and a DEVTYPE filtered callback each get only their
+ * own messages, that a slow queue keeps every message in order, and that the
+ * delivery counters and latencies add up. A burst queued before the hub
+ * starts must be read in full batches, with uevents longer than 1 KB kept
+ * whole and oversized ones rejected.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <string>
+
+#include "../UeventHub.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+#define TX_PLUG         "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi"
+#define TX_HDCP         "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdcp"
+#define RX_AUTH         "DEVPATH=/devices/platform/ffd26000.hdmirx/hdmirx/hdmirx0/rp_auth"
+#define USB_DEVICE      "DEVPATH=/devices/platform/ff500000.dwc2_a/usb1/1-1"
+
+static int gSender = -1;
+
+//fields separated by '\n' in the source text, '\0' on the wire
+static void inject(const char *text) {
+    std::string msg(text);
+
+    for (size_t i = 0; i < msg.size(); i++) {
+        if (msg[i] == '\n')
+            msg[i] = '\0';
+    }
+    send(gSender, msg.c_str(), msg.size(), 0);
+}
+
+static void injectTx(const char *devpath, const char *devtype, int state) {
+    char text[512];
+
+    snprintf(text, sizeof(text), "change@%s\nACTION=change\n%s\nDEVTYPE=%s\n"
+        "SUBSYSTEM=amhdmitx\nSTATE=HDMI=%d", devpath + strlen("DEVPATH="), devpath,
+        devtype, state);
+    inject(text);
+}
+
+static void injectUsb(const char *devtype) {
+    char text[512];
+
+    snprintf(text, sizeof(text), "add@%s\nACTION=add\n%s\nSUBSYSTEM=usb\nDEVTYPE=%s",
+        USB_DEVICE + strlen("DEVPATH="), USB_DEVICE, devtype);
+    inject(text);
+}
+
+//the hub thread delivers asynchronously, wait until it saw count messages
+static void settle(UeventHub *hub, int64_t count) {
+    for (int i = 0; i < 200 && hub->getReceived() < count; i++)
+        usleep(5000);
+    CHECK(hub->getReceived() == count);
+}
+
+static int gUsbCalls = 0;
+static char gUsbName[64];
+
+static void onUsb(const uevent_data_t *ueventData, void *user) {
+    CHECK(user == &gUsbCalls);
+    gUsbCalls++;
+    strcpy(gUsbName, ueventData->switchName);
+}
+
+static void testFanOut(UeventHub *hub) {
+    uevent_data_t data;
+    uevent_sub_stats_t stats;
+
+    UeventSubscriber *tx = hub->subscribe("hdcp_tx");
+    tx->addMatch(TX_PLUG);
+    tx->addMatch(TX_HDCP);
+    UeventSubscriber *rx = hub->subscribe("hdcp_rx");
+    rx->addMatch(RX_AUTH);
+    UeventSubscriber *usb = hub->subscribe("usb", onUsb, &gUsbCalls);
+    usb->addMatch(USB_DEVICE, "usb_interface");
+
+    injectTx(TX_PLUG, "hdmi", 1);
+    injectUsb("usb_device");
+    injectTx(RX_AUTH, "rp_auth", 2);
+    injectUsb("usb_interface");
+    injectTx(TX_HDCP, "hdcp", 0);
+    settle(hub, 5);
+
+    CHECK(tx->waitForNextEvent(&data, 100));
+    CHECK(!strcmp(data.matchName, TX_PLUG));
+    CHECK(!strcmp(data.switchName, "hdmi"));
+    CHECK(!strcmp(data.switchState, "1"));
+    CHECK(tx->waitForNextEvent(&data, 100));
+    CHECK(!strcmp(data.matchName, TX_HDCP));
+    CHECK(!strcmp(data.switchState, "0"));
+    //the rx message never reached the tx queue
+    CHECK(!tx->waitForNextEvent(&data, 20));
+
+    CHECK(rx->waitForNextEvent(&data, 100));
+    CHECK(!strcmp(data.matchName, RX_AUTH));
+    CHECK(!strcmp(data.switchState, "2"));
+    CHECK(!rx->waitForNextEvent(&data, 20));
+
+    //only the usb_interface message passed the DEVTYPE filter
+    CHECK(gUsbCalls == 1);
+    CHECK(!strcmp(gUsbName, "usb_interface"));
+
+    tx->getStats(&stats);
+    CHECK(stats.name == "hdcp_tx");
+    CHECK(stats.delivered == 2);
+    CHECK(stats.maxQueued == 2);
+    CHECK(stats.maxLatencyNs > 0 && stats.totalLatencyNs >= stats.maxLatencyNs);
+    usb->getStats(&stats);
+    CHECK(stats.delivered == 1);
+
+    char dump[4096] = {0};
+    CHECK(hub->dump(dump) == 0);
+    CHECK(strstr(dump, "hdcp_rx delivered:1 max queued:1") != NULL);
+    printf("%s", dump);
+
+    hub->unsubscribe(usb);
+    injectUsb("usb_interface");
+    settle(hub, 6);
+    CHECK(gUsbCalls == 1);
+
+    hub->unsubscribe(rx);
+    hub->unsubscribe(tx);
+}
+
+static void testBacklog(UeventHub *hub) {
+    uevent_data_t data;
+    uevent_sub_stats_t stats;
+    int64_t base = hub->getReceived();
+    const int count = UEVENT_QUEUE_MAX * 2;
+    const int kept = UEVENT_QUEUE_MAX - 1;
+
+    UeventSubscriber *tx = hub->subscribe("slow");
+    tx->addMatch(TX_PLUG);
+    tx->addMatch(TX_HDCP);
+    tx->addMatch(RX_AUTH);
+    injectTx(TX_HDCP, "hdcp", 100);
+    for (int i = 0; i < count; i++)
+        injectTx(TX_PLUG, "hdmi", i);
+    //the queue holds no rx state to replace, the oldest event goes
+    injectTx(RX_AUTH, "rp_auth", 200);
+    settle(hub, base + count + 2);
+
+    //the newest plug states in order, then the rx one, the hdcp one is gone
+    for (int i = count - kept; i < count; i++) {
+        CHECK(tx->waitForNextEvent(&data, 100));
+        CHECK(!strcmp(data.matchName, TX_PLUG));
+        CHECK(atoi(data.switchState) == i);
+    }
+    CHECK(tx->waitForNextEvent(&data, 100));
+    CHECK(!strcmp(data.matchName, RX_AUTH));
+    CHECK(!tx->waitForNextEvent(&data, 20));
+
+    tx->getStats(&stats);
+    CHECK(stats.maxQueued == UEVENT_QUEUE_MAX);
+    CHECK(stats.coalesced == count - kept);
+    CHECK(stats.dropped == 1);
+    CHECK(stats.delivered == kept + 1);
+
+    char dump[4096] = {0};
+    CHECK(hub->dump(dump) == 0);
+    CHECK(strstr(dump, "slow delivered:64 max queued:64 coalesced:65 dropped:1") != NULL);
+    hub->unsubscribe(tx);
+}
+
+#define BURST_SIZE      40
+
+static void injectBurstTx(int state, const std::string &edid) {
+    char text[UEVENT_MSG_LEN * 2];
+
+    if (edid.empty())
+        snprintf(text, sizeof(text), "change@/devices/virtual/amhdmitx/amhdmitx0/hdmi\n"
+            TX_PLUG "\nDEVTYPE=hdmi\nSTATE=HDMI=%d", state);
+    else
+        snprintf(text, sizeof(text), "change@/devices/virtual/amhdmitx/amhdmitx0/hdmi\n"
+            TX_PLUG "\nDEVTYPE=hdmi\nEDID=%s\nSTATE=HDMI=%d", edid.c_str(), state);
+    inject(text);
+}
+
+static void testBurst() {
+    int fds[2];
+    int sndbuf = 1024 * 1024;
+    int on = 1;
+    uevent_data_t data;
+    uevent_hub_stats_t hubStats;
+    std::string edid(2600, 'a');
+
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) == 0);
+    gSender = fds[1];
+    setsockopt(gSender, SOL_SOCKET, SO_SNDBUFFORCE, &sndbuf, sizeof(sndbuf));
+    //the hub asks for credentials only when it starts, after the burst is sent
+    setsockopt(fds[0], SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+
+    //queued before the hub starts, every third one carries a raw EDID field
+    for (int i = 0; i < BURST_SIZE; i++)
+        injectBurstTx(i, (i % 3 == 0) ? edid : "");
+    //does not fit a page
+    injectBurstTx(1, std::string(UEVENT_MSG_LEN, 'b'));
+
+    UeventHub *hub = new UeventHub(fds[0], getuid());
+    for (int i = 0; i < 200; i++) {
+        hub->getHubStats(&hubStats);
+        if (hubStats.received + hubStats.rejected == BURST_SIZE + 1)
+            break;
+        usleep(5000);
+    }
+
+    hub->getHubStats(&hubStats);
+    CHECK(hubStats.received == BURST_SIZE);
+    CHECK(hubStats.rejected == 1);
+    //41 messages in reads of 16, and no read only to learn the socket is empty
+    CHECK(hubStats.reads == (BURST_SIZE + 1 + UEVENT_BATCH_SIZE - 1) / UEVENT_BATCH_SIZE);
+    printf("burst: %d messages in %lld reads\n", BURST_SIZE + 1, (long long)hubStats.reads);
+
+    UeventSubscriber *tx = hub->subscribe("burst");
+    tx->addMatch(TX_PLUG);
+    for (int i = 0; i < BURST_SIZE; i++) {
+        //a batch worth at a time, within the socket buffer
+        if (i % UEVENT_BATCH_SIZE == 0) {
+            for (int j = i; j < BURST_SIZE && j < i + UEVENT_BATCH_SIZE; j++)
+                injectBurstTx(j, edid);
+        }
+        if (!tx->waitForNextEvent(&data, 1000)) {
+            CHECK(false);
+            break;
+        }
+        //the state field sits past the first kilobyte
+        CHECK(atoi(data.switchState) == i);
+        CHECK(data.len > (int)edid.size() && data.len < UEVENT_MSG_LEN);
+        CHECK(!strcmp(data.buf, "change@/devices/virtual/amhdmitx/amhdmitx0/hdmi"));
+    }
+    hub->unsubscribe(tx);
+    delete hub;
+    close(gSender);
+}
+
+int main(int argc, char **argv) {
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) < 0) {
+        perror("socketpair");
+        return 1;
+    }
+    gSender = fds[1];
+
+    UeventHub *hub = new UeventHub(fds[0], getuid());
+    testFanOut(hub);
+    testBacklog(hub);
+    delete hub;
+    close(gSender);
+
+    testBurst();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Replays a 10k message uevent corpus, mostly usb and block noise with the
+ * hdmi, hdcp and frame rate events systemcontrol listens for, through the
+ * old per pattern field walk and through UeventMatcher. Both must give the
+ * same result for every message, then the time per message is printed.
+ * Last a reader matches while the patterns keep changing, the replaced
+ * pattern sets must be freed as soon as the reader leaves them.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "../UeventMatcher.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+#define CORPUS_SIZE     10000
+
+static const char *sPatterns[] = {
+    "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi",
+    "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi_audio",
+    "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdcp",
+    "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi_power",
+    "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi_hdr",
+    "DEVPATH=/devices/platform/vout/extcon/setmode",
+    "DEVPATH=/devices/platform/vout/extcon/vout_setmode",
+    "DEVPATH=/devices/virtual/hdmirx/hdmirx0/hdcp_auth",
+    "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/frame_rate_hint",
+};
+
+//the field walk UEventObserver::isMatch() did before UeventMatcher
+static bool legacyMatch(const char *buffer, size_t length,
+    uevent_data_t *ueventData, const char *matchStr) {
+    bool matched = false;
+    const char *field = buffer;
+    const char *end = buffer + length + 1;
+
+    do {
+        if (!strcmp(field, matchStr)) {
+            strcpy(ueventData->matchName, matchStr);
+            matched = true;
+        }
+        else if (strstr(field, "STATE=HDMI=")) {
+            strcpy(ueventData->switchState, field + strlen("STATE=HDMI="));
+        }
+        else if (strstr(field, "DEVTYPE=")) {
+            strcpy(ueventData->switchName, field + strlen("DEVTYPE="));
+        }
+        else if (strstr(field, "FRAME_RATE_HINT=")) {
+            strcpy(ueventData->switchName, field + strlen("FRAME_RATE_HINT="));
+        }
+        else if (strstr(field, "FRAME_RATE_END_HINT")) {
+            strcpy(ueventData->switchName, "end_hint");
+        }
+        field += strlen(field) + 1;
+    } while (field != end);
+
+    if (matched) {
+        ueventData->len = length;
+        memcpy(ueventData->buf, buffer, length);
+    }
+    return matched;
+}
+
+static bool legacyMatch(const std::vector<std::string> &patterns, const char *buffer,
+    size_t length, uevent_data_t *ueventData) {
+    for (size_t i = 0; i < patterns.size(); i++) {
+        if (legacyMatch(buffer, length, ueventData, patterns[i].c_str()))
+            return true;
+    }
+    return false;
+}
+
+//fields separated by '\n' in the source text, '\0' in the message
+static std::string message(const char *text) {
+    std::string msg(text);
+
+    for (size_t i = 0; i < msg.size(); i++) {
+        if (msg[i] == '\n')
+            msg[i] = '\0';
+    }
+    return msg;
+}
+
+static void buildCorpus(std::vector<std::string> &corpus) {
+    char text[1024];
+
+    srand(20160906);
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        int seq = 2791 + i;
+        int kind = rand() % 100;
+
+        if (kind < 45) {
+            snprintf(text, sizeof(text),
+                "add@/devices/platform/ff500000.dwc2_a/usb1/1-1/1-1.%d\nACTION=add\n"
+                "DEVPATH=/devices/platform/ff500000.dwc2_a/usb1/1-1/1-1.%d\nSUBSYSTEM=usb\n"
+                "MAJOR=189\nMINOR=%d\nDEVNAME=bus/usb/001/%03d\nDEVTYPE=usb_device\n"
+                "PRODUCT=46d/c52b/1211\nTYPE=0/0/0\nBUSNUM=001\nDEVNUM=%03d\nSEQNUM=%d",
+                i % 4, i % 4, i % 128, i % 128, i % 128, seq);
+        } else if (kind < 75) {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/block/loop%d\nACTION=change\n"
+                "DEVPATH=/devices/virtual/block/loop%d\nSUBSYSTEM=block\nMAJOR=7\n"
+                "MINOR=%d\nDEVNAME=loop%d\nDEVTYPE=disk\nDISK_MEDIA_CHANGE=1\nSEQNUM=%d",
+                i % 16, i % 16, i % 16, i % 16, seq);
+        } else if (kind < 85) {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/power_supply/battery\nACTION=change\n"
+                "DEVPATH=/devices/virtual/power_supply/battery\nSUBSYSTEM=power_supply\n"
+                "POWER_SUPPLY_NAME=battery\nPOWER_SUPPLY_STATUS=Charging\n"
+                "POWER_SUPPLY_CAPACITY=%d\nSEQNUM=%d", i % 100, seq);
+        } else if (kind < 92) {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/amhdmitx/amhdmitx0/hdmi\nACTION=change\n"
+                "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi\nSUBSYSTEM=amhdmitx\n"
+                "STATE=HDMI=%d\nSEQNUM=%d", i & 1, seq);
+        } else if (kind < 96) {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/amhdmitx/amhdmitx0/hdcp\nACTION=change\n"
+                "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdcp\nSUBSYSTEM=amhdmitx\n"
+                "STATE=HDMI=%d\nSEQNUM=%d", i & 1, seq);
+        } else if (kind < 98) {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/amhdmitx/amhdmitx0/frame_rate_hint\nACTION=change\n"
+                "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/frame_rate_hint\n"
+                "SUBSYSTEM=amhdmitx\nFRAME_RATE_HINT=%d\nSEQNUM=%d", 2397 + i % 3, seq);
+        } else {
+            snprintf(text, sizeof(text),
+                "change@/devices/virtual/amhdmitx/amhdmitx0/frame_rate_hint\nACTION=change\n"
+                "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/frame_rate_hint\n"
+                "SUBSYSTEM=amhdmitx\nFRAME_RATE_END_HINT\nSEQNUM=%d", seq);
+        }
+        corpus.push_back(message(text));
+    }
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void testParse() {
+    std::string msg = message("change@/devices/virtual/amhdmitx/amhdmitx0/hdmi\n"
+        "ACTION=change\nDEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi\n"
+        "STATE=HDMI=1\nFRAME_RATE_END_HINT\nSEQNUM=2791");
+    uevent_view_t view;
+
+    CHECK(ueventParse(msg.c_str(), msg.size(), &view) == 6);
+    CHECK(view.fields[0].value == NULL);
+    CHECK(!strcmp(ueventGetValue(&view, "ACTION"), "change"));
+    //only the first '=' splits
+    CHECK(!strcmp(ueventGetValue(&view, "STATE"), "HDMI=1"));
+    CHECK(!strcmp(ueventGetValue(&view, "SEQNUM"), "2791"));
+    CHECK(ueventGetValue(&view, "FRAME_RATE_END_HINT") == NULL);
+    CHECK(ueventGetValue(&view, "SUBSYSTEM") == NULL);
+    CHECK(view.fields[2].hash == ueventHash(sPatterns[0], strlen(sPatterns[0])));
+}
+
+static void testOrderAndRemove() {
+    UeventMatcher matcher;
+    uevent_data_t data;
+    std::string msg = message("change@/devices/virtual/amhdmitx/amhdmitx0/hdmi\n"
+        "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi\nSUBSYSTEM=amhdmitx\n"
+        "STATE=HDMI=1");
+
+    memset(&data, 0, sizeof(data));
+    CHECK(!matcher.match(msg.c_str(), msg.size(), &data));
+
+    //the pattern added first wins when one message matches two
+    matcher.addMatch("SUBSYSTEM=amhdmitx");
+    matcher.addMatch(sPatterns[0]);
+    CHECK(matcher.match(msg.c_str(), msg.size(), &data));
+    CHECK(!strcmp(data.matchName, "SUBSYSTEM=amhdmitx"));
+    CHECK(!strcmp(data.switchState, "1"));
+    CHECK(data.len == (int)msg.size());
+
+    matcher.removeMatch("SUBSYSTEM=amhdmitx");
+    CHECK(matcher.match(msg.c_str(), msg.size(), &data));
+    CHECK(!strcmp(data.matchName, sPatterns[0]));
+
+    //a duplicate stays registered until removed as often as added
+    matcher.addMatch(sPatterns[0]);
+    matcher.removeMatch(sPatterns[0]);
+    CHECK(matcher.match(msg.c_str(), msg.size(), &data));
+    matcher.removeMatch(sPatterns[0]);
+    CHECK(!matcher.match(msg.c_str(), msg.size(), &data));
+}
+
+static void testCorpus() {
+    std::vector<std::string> corpus;
+    std::vector<std::string> patterns;
+    UeventMatcher matcher;
+    uevent_data_t legacy, data;
+    int matched = 0;
+
+    buildCorpus(corpus);
+    for (size_t i = 0; i < sizeof(sPatterns)/sizeof(sPatterns[0]); i++) {
+        patterns.push_back(sPatterns[i]);
+        matcher.addMatch(sPatterns[i]);
+    }
+
+    for (size_t i = 0; i < corpus.size(); i++) {
+        const std::string &msg = corpus[i];
+        memset(&legacy, 0, sizeof(legacy));
+        memset(&data, 0, sizeof(data));
+
+        bool want = legacyMatch(patterns, msg.c_str(), msg.size(), &legacy);
+        bool got = matcher.match(msg.c_str(), msg.size(), &data);
+        CHECK(want == got);
+        CHECK(!memcmp(&legacy, &data, sizeof(data)));
+        if (want != got || memcmp(&legacy, &data, sizeof(data))) {
+            printf("  message %d differs\n", (int)i);
+            break;
+        }
+        if (got)
+            matched++;
+    }
+    printf("corpus: %d messages, %d matched\n", (int)corpus.size(), matched);
+    CHECK(matched > CORPUS_SIZE / 10 && matched < CORPUS_SIZE / 2);
+
+    int64_t start = nowNs();
+    for (size_t i = 0; i < corpus.size(); i++)
+        legacyMatch(patterns, corpus[i].c_str(), corpus[i].size(), &legacy);
+    int64_t legacyNs = nowNs() - start;
+
+    start = nowNs();
+    for (size_t i = 0; i < corpus.size(); i++)
+        matcher.match(corpus[i].c_str(), corpus[i].size(), &data);
+    int64_t matcherNs = nowNs() - start;
+
+    printf("legacy walk: %.2fus/message, matcher: %.2fus/message\n",
+        legacyNs / 1000.0 / corpus.size(), matcherNs / 1000.0 / corpus.size());
+}
+
+typedef struct reader {
+    UeventMatcher *matcher;
+    std::string msg;
+    std::atomic<bool> stop;
+    int missed;
+} reader_t;
+
+static void *readLoop(void *data) {
+    reader_t *reader = (reader_t *)data;
+    uevent_data_t ueventData;
+
+    while (!reader->stop.load()) {
+        memset(&ueventData, 0, sizeof(ueventData));
+        if (!reader->matcher->match(reader->msg.c_str(), reader->msg.size(), &ueventData))
+            reader->missed++;
+    }
+    return NULL;
+}
+
+static void testRetire() {
+    UeventMatcher matcher;
+    reader_t reader;
+    pthread_t thread;
+    int maxRetired = 0;
+
+    reader.matcher = &matcher;
+    reader.msg = message("change@/devices/virtual/amhdmitx/amhdmitx0/hdmi\n"
+        "DEVPATH=/devices/virtual/amhdmitx/amhdmitx0/hdmi\nSUBSYSTEM=amhdmitx\n"
+        "STATE=HDMI=1");
+    reader.stop = false;
+    reader.missed = 0;
+    matcher.addMatch(sPatterns[0]);
+    pthread_create(&thread, NULL, readLoop, &reader);
+
+    for (int i = 0; i < 5000; i++) {
+        matcher.addMatch("SUBSYSTEM=usb");
+        matcher.removeMatch("SUBSYSTEM=usb");
+        int retired = matcher.getRetiredCount();
+        if (retired > maxRetired)
+            maxRetired = retired;
+    }
+    reader.stop = true;
+    pthread_join(thread, NULL);
+
+    //the hdmi pattern never went away, every set the reader saw had it
+    CHECK(reader.missed == 0);
+    CHECK(maxRetired <= 1);
+    matcher.addMatch("SUBSYSTEM=usb");
+    CHECK(matcher.getRetiredCount() == 0);
+    printf("retire: at most %d set held by the reader\n", maxRetired);
+}
+
+int main(int argc, char **argv) {
+    testParse();
+    testOrderAndRemove();
+    testCorpus();
+    testRetire();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
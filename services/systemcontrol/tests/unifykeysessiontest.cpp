@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Runs a UnifyKeySession on regular files standing in for the unifykey
+ * nodes and the key device. An io adapter gives them the driver behaviour:
+ * the name node selects the key that exist, read and write act on, and the
+ * key info ioctl hands out an offset into the device file. Checks that many
+ * keys go through without reopening a node, with one name select per key
+ * and one info query per key, and prints the cost against the old open per
+ * node flow.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../UnifyKeySession.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+static const char *sNodeFiles[] = { "attach", "name", "exist", "read", "write", "lock", "list" };
+
+//the driver state behind the files
+static std::map<std::string, std::string> gKeys;
+static std::string gSelected;
+static bool gLocked = false;
+static int gAttaches = 0;
+
+typedef struct {
+    unsigned int id;
+    unsigned int size;
+} dev_key_t;
+static std::map<std::string, dev_key_t> gDevKeys;
+
+static int fillText(char *buf, int count, const std::string &text) {
+    int len = (int)text.size() < count ? text.size() : count;
+    memcpy(buf, text.data(), len);
+    return len;
+}
+
+static int fakeRead(int node, int fd, char *buf, int count, off_t offset) {
+    switch (node) {
+    case UNIFYKEY_NODE_EXIST:
+        return fillText(buf, count, gKeys.count(gSelected) ? "1\n" : "0\n");
+    case UNIFYKEY_NODE_READ: {
+        std::map<std::string, std::string>::iterator it = gKeys.find(gSelected);
+        if (it == gKeys.end())
+            return 0;
+        return fillText(buf, count, it->second);
+    }
+    case UNIFYKEY_NODE_LOCK:
+        return fillText(buf, count, gLocked ? "1\n" : "0\n");
+    case UNIFYKEY_NODE_LIST: {
+        std::string text;
+        char line[128];
+        int i = 0;
+        for (std::map<std::string, std::string>::iterator it = gKeys.begin(); it != gKeys.end(); ++it) {
+            snprintf(line, sizeof(line), "%d: %s\n", i++, it->first.c_str());
+            text += line;
+        }
+        return fillText(buf, count, text);
+    }
+    default:
+        return pread(fd, buf, count, offset);
+    }
+}
+
+static int fakeWrite(int node, int fd, const char *buf, int count, off_t offset) {
+    switch (node) {
+    case UNIFYKEY_NODE_ATTACH:
+        gAttaches++;
+        break;
+    case UNIFYKEY_NODE_NAME:
+        gSelected.assign(buf, count);
+        break;
+    case UNIFYKEY_NODE_WRITE:
+        gKeys[gSelected].assign(buf, count);
+        break;
+    case UNIFYKEY_NODE_LOCK:
+        gLocked = buf[0] == '1';
+        break;
+    case UNIFYKEY_NODE_DEV:
+        for (std::map<std::string, dev_key_t>::iterator it = gDevKeys.begin(); it != gDevKeys.end(); ++it) {
+            if (it->second.id == (unsigned int)offset)
+                it->second.size = count;
+        }
+        break;
+    }
+    //the value lands in the backing file too, the device keeps every key
+    if (node != UNIFYKEY_NODE_DEV && ftruncate(fd, 0) < 0)
+        return -1;
+    return pwrite(fd, buf, count, offset);
+}
+
+static int fakeGetInfo(int fd, struct key_item_info_t *info) {
+    std::map<std::string, dev_key_t>::iterator it = gDevKeys.find(info->name);
+
+    if (it == gDevKeys.end()) {
+        dev_key_t key = { (unsigned int)gDevKeys.size() * 1024, 0 };
+        it = gDevKeys.insert(std::make_pair(std::string(info->name), key)).first;
+    }
+    info->id = it->second.id;
+    info->size = it->second.size;
+    info->flag = it->second.size > 0;
+    return 0;
+}
+
+static const unifykey_io_t sFakeIo = {
+    fakeRead,
+    fakeWrite,
+    fakeGetInfo,
+};
+
+static char gDir[64];
+static char gDev[128];
+
+static void makeNodes(bool withLock) {
+    char path[128];
+
+    strcpy(gDir, "/tmp/unifykeysXXXXXX");
+    CHECK(mkdtemp(gDir) != NULL);
+    for (size_t i = 0; i < sizeof(sNodeFiles) / sizeof(sNodeFiles[0]); i++) {
+        if (!withLock && !strcmp(sNodeFiles[i], "lock"))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", gDir, sNodeFiles[i]);
+        ::close(::open(path, O_CREAT | O_RDWR, 0600));
+    }
+    snprintf(gDev, sizeof(gDev), "%s/dev", gDir);
+    ::close(::open(gDev, O_CREAT | O_RDWR, 0600));
+}
+
+static void removeNodes() {
+    char path[128];
+
+    for (size_t i = 0; i < sizeof(sNodeFiles) / sizeof(sNodeFiles[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", gDir, sNodeFiles[i]);
+        unlink(path);
+    }
+    unlink(gDev);
+    rmdir(gDir);
+}
+
+static void keyNames(int count, std::vector<std::string> &names, std::vector<std::string> &values) {
+    char name[32], value[64];
+
+    names.clear();
+    values.clear();
+    for (int i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "factory_key%02d", i);
+        snprintf(value, sizeof(value), "value-%d-%08x", i, i * 2654435761u);
+        names.push_back(name);
+        values.push_back(value);
+    }
+}
+
+static void testSession() {
+    unifykey_session_stats_t stats;
+    std::vector<std::string> names, values, got;
+
+    gKeys.clear();
+    makeNodes(true);
+    UnifyKeySession session(gDir, gDev, &sFakeIo);
+    CHECK(session.open() == 0);
+    CHECK(gAttaches == 1);
+
+    keyNames(24, names, values);
+    CHECK(session.writeMany(names, values) == 0);
+    CHECK(!gLocked);
+    CHECK(session.readMany(names, got) == 0);
+    CHECK(got == values);
+
+    CHECK(session.exists("factory_key03"));
+    CHECK(!session.exists("missing"));
+    std::vector<std::string> listed;
+    CHECK(session.list(listed) == 24);
+    CHECK(listed.size() == 24 && listed[0] == "factory_key00");
+
+    std::vector<std::string> some;
+    some.push_back("factory_key01");
+    some.push_back("missing");
+    CHECK(session.readMany(some, got) == 1);
+    CHECK(got[0] == values[1] && got[1].empty());
+
+    session.getStats(&stats);
+    //attach, name, exist, read, write, lock, list and the device, once
+    CHECK(stats.opens == UNIFYKEY_NODE_COUNT);
+    //24 writes, 24 reads, 2 exists, 2 reads
+    CHECK(stats.selects == 52);
+
+    //a key held by another writer is skipped after the wait
+    gLocked = true;
+    std::vector<std::string> one(1, "factory_key00"), oneValue(1, "x");
+    CHECK(session.writeMany(one, oneValue) == 1);
+    gLocked = false;
+    removeNodes();
+}
+
+static void testDevice() {
+    unifykey_session_stats_t stats;
+    struct key_item_info_t info;
+    char buf[256];
+
+    gDevKeys.clear();
+    makeNodes(false);
+    UnifyKeySession session(gDir, gDev, &sFakeIo);
+    CHECK(session.open() == 0);
+
+    CHECK(session.getInfo("usid", &info) == 0);
+    CHECK(info.flag == 0);
+    CHECK(session.readDevice("usid", buf, sizeof(buf)) == 0);
+    CHECK(session.writeDevice("usid", "0123456789", 10) == 0);
+    CHECK(session.writeDevice("attestation", "abcdef", 6) == 0);
+
+    //the write made the size known, queried again once
+    memset(buf, 0, sizeof(buf));
+    CHECK(session.readDevice("usid", buf, sizeof(buf)) == 10);
+    CHECK(!strcmp(buf, "0123456789"));
+    CHECK(session.readDevice("usid", buf, 4) == 4);
+    CHECK(session.getInfo("usid", &info) == 0);
+    CHECK(info.size == 10 && info.flag);
+
+    session.getStats(&stats);
+    //usid, attestation, and usid once more after its write
+    CHECK(stats.infoQueries == 3);
+    //no lock node here, nothing waits for it
+    std::vector<std::string> names(1, "mac"), values(1, "00:11:22:33:44:55");
+    CHECK(session.writeMany(names, values) == 0);
+    removeNodes();
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//what SysWrite did per key: every node opened, used once and closed
+static int legacyRead(const char *name, char *buf, int count) {
+    char path[128];
+    int fd, len = 0;
+    const int nodes[] = { UNIFYKEY_NODE_ATTACH, UNIFYKEY_NODE_NAME, UNIFYKEY_NODE_EXIST, UNIFYKEY_NODE_READ };
+
+    for (size_t i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", gDir, sNodeFiles[nodes[i]]);
+        fd = ::open(path, O_RDWR);
+        if (fd < 0)
+            return -1;
+        if (nodes[i] == UNIFYKEY_NODE_ATTACH)
+            fakeWrite(nodes[i], fd, "1", 1, 0);
+        else if (nodes[i] == UNIFYKEY_NODE_NAME)
+            fakeWrite(nodes[i], fd, name, strlen(name), 0);
+        else
+            len = fakeRead(nodes[i], fd, buf, count, 0);
+        ::close(fd);
+    }
+    return len;
+}
+
+static void benchmark() {
+    std::vector<std::string> names, values, got;
+    char buf[UNIFYKEY_VALUE_LEN];
+    int rounds = 200;
+
+    gKeys.clear();
+    makeNodes(true);
+    keyNames(32, names, values);
+    UnifyKeySession session(gDir, gDev, &sFakeIo);
+    CHECK(session.open() == 0);
+    CHECK(session.writeMany(names, values) == 0);
+
+    int64_t start = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < names.size(); i++)
+            legacyRead(names[i].c_str(), buf, sizeof(buf));
+    }
+    int64_t legacyNs = nowNs() - start;
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++)
+        session.readMany(names, got);
+    int64_t sessionNs = nowNs() - start;
+
+    double total = (double)rounds * names.size();
+    printf("read %d keys: open per node %.2f us, session %.2f us per key\n",
+        (int)names.size(), legacyNs / total / 1000, sessionNs / total / 1000);
+    removeNodes();
+}
+
+int main(int argc, char **argv) {
+    testSession();
+    testDevice();
+    benchmark();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
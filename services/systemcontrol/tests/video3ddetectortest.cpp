@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Runs the Video3DDetector against fake videos that report their 3d format
+ * and frame info changes on a timeline the way the decoder does: a side by
+ * side movie, a 2d movie that never changes its frame info, a detection
+ * that flips between two formats, one that never agrees, a decoder that only
+ * moves on the timer and one slower than the deadline. Checks the format
+ * each one decides, the time it takes and the samples it reads, against the
+ * five samples 200ms apart detect3DThread() voted on before.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../Video3DDetector.h"
+
+static int gFailed = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        gFailed++; \
+    } \
+} while (0)
+
+//FORMAT_3D_* of Dimension.h
+#define SIDE_BY_SIDE    2
+#define TOP_AND_BOTTOM  3
+
+#define OLD_SAMPLES     5
+#define OLD_INTERVAL_MS 200
+#define TIMELINE_MAX    8
+#define CHANGES_MAX     16
+
+typedef struct format_at {
+    int fromMs;
+    int format;
+} format_at_t;
+
+typedef struct video_case {
+    const char *name;
+    format_at_t formats[TIMELINE_MAX];  //what the decoder reports from fromMs on
+    int formatCount;
+    int changes[CHANGES_MAX];           //frame info changes, ms
+    int changeCount;
+    int format;                         //expected decision
+    bool confirmed;
+    int samples;
+    int latencyMs;                      //expected, +-sDelta
+} video_case_t;
+
+static const int sDelta = 40;
+
+static const video_case_t sCases[] = {
+    {
+        //25fps, the 3d type is known from the first frame on
+        "sbs movie",
+        { { 0, 0 }, { 30, SIDE_BY_SIDE } }, 2,
+        { 40, 80, 120, 160, 200, 240 }, 6,
+        SIDE_BY_SIDE, true, 3, 80,
+    },
+    {
+        //one frame size for the whole movie, no frame change comes
+        "2d movie",
+        { { 0, 0 } }, 1,
+        { 0 }, 0,
+        0, true, 2, 200,
+    },
+    {
+        "flipping detection",
+        { { 0, SIDE_BY_SIDE }, { 40, TOP_AND_BOTTOM }, { 80, SIDE_BY_SIDE }, { 120, TOP_AND_BOTTOM },
+          { 160, SIDE_BY_SIDE } }, 5,
+        { 40, 80, 120, 160 }, 4,
+        SIDE_BY_SIDE, false, 5, 160,
+    },
+    {
+        //no format more than twice, 3d off
+        "no agreement",
+        { { 0, 1 }, { 40, 2 }, { 80, 3 }, { 120, 4 }, { 160, 5 } }, 5,
+        { 40, 80, 120, 160 }, 4,
+        0, false, 5, 160,
+    },
+    {
+        "timer only",
+        { { 0, SIDE_BY_SIDE }, { 100, TOP_AND_BOTTOM }, { 300, SIDE_BY_SIDE }, { 500, TOP_AND_BOTTOM },
+          { 700, SIDE_BY_SIDE } }, 5,
+        { 0 }, 0,
+        SIDE_BY_SIDE, false, 5, 800,
+    },
+};
+
+//the decoder and the frame changes on a timeline starting at the first sample
+class FakeVideo : public Video3DDetector::Source {
+public:
+    FakeVideo(const video_case_t *test)
+        :mTest(test),
+        mStartNs(0),
+        mNextChange(0),
+        mSamples(0),
+        mWakeups(0) {
+    }
+
+    int elapsedMs() {
+        return (int)((Video3DDetector::now() - mStartNs) / 1000000);
+    }
+    int formatAt(int ms) {
+        int format = mTest->formats[0].format;
+        for (int i = 0; i < mTest->formatCount; i++) {
+            if (mTest->formats[i].fromMs <= ms)
+                format = mTest->formats[i].format;
+        }
+        return format;
+    }
+
+    virtual int sample3DFormat() {
+        if (mStartNs == 0)
+            mStartNs = Video3DDetector::now();
+        mSamples++;
+        return formatAt(elapsedMs());
+    }
+    virtual bool waitFrameChange(int timeoutMs) {
+        int nowMs = elapsedMs();
+        mWakeups++;
+        while (mNextChange < mTest->changeCount && mTest->changes[mNextChange] <= nowMs)
+            mNextChange++;
+        if (mNextChange < mTest->changeCount && mTest->changes[mNextChange] <= nowMs + timeoutMs) {
+            usleep((mTest->changes[mNextChange] - nowMs) * 1000);
+            mNextChange++;
+            return true;
+        }
+        usleep(timeoutMs * 1000);
+        return false;
+    }
+
+    const video_case_t *mTest;
+    int64_t mStartNs;
+    int mNextChange;
+    int mSamples;
+    int mWakeups;
+};
+
+//what detect3DThread() decided before on samples 200ms apart
+static int oldDetect(FakeVideo *video) {
+    int retry = OLD_SAMPLES;
+    int di3Dformat[OLD_SAMPLES] = {0};
+    int times[OLD_SAMPLES] = {0};
+
+    while (retry > 0) {
+        retry--;
+        di3Dformat[retry] = video->formatAt((OLD_SAMPLES - 1 - retry) * OLD_INTERVAL_MS);
+    }
+
+    for (int i = 0; i < OLD_SAMPLES - 1; i++) {
+        for (int j = i + 1; j < OLD_SAMPLES; j++) {
+            if (di3Dformat[i] == di3Dformat[j]) {
+                times[i]++;
+            }
+        }
+    }
+    int max = times[0];
+    int idx = 0;
+    for (int i = 0; i < OLD_SAMPLES - 1; i++) {
+        if (times[i] > max) {
+            max = times[i];
+            idx = i;
+        }
+    }
+    if (max == 1) {
+        idx = 0;
+        di3Dformat[0] = 0;
+    }
+    return di3Dformat[idx];
+}
+
+static void runCase(const video_case_t &test) {
+    FakeVideo video(&test);
+    Video3DDetector detector(Video3DDetector::getDefaultConfig(), &video);
+    detect_3d_result_t result;
+
+    int format = detector.detect(&result);
+    int latencyMs = (int)(result.latencyUs / 1000);
+    int oldFormat = oldDetect(&video);
+    printf("%-20s format:%d %s samples:%d frame changes:%d %4dms, before format:%d %dms\n", test.name,
+        format, result.confirmed ? "confirmed" : "voted", result.samples, result.frameChanges, latencyMs,
+        oldFormat, OLD_SAMPLES * OLD_INTERVAL_MS);
+
+    CHECK(format == test.format);
+    CHECK(result.format == test.format);
+    CHECK(result.confirmed == test.confirmed);
+    CHECK(result.samples == test.samples);
+    CHECK(video.mSamples == test.samples);
+    CHECK(latencyMs >= test.latencyMs && latencyMs < test.latencyMs + sDelta);
+    //sampling stops with the decision
+    CHECK(video.mWakeups == test.samples - 1);
+    //the old vote picked the last sample when all five differed, the new one keeps 3d off
+    if (strcmp(test.name, "no agreement"))
+        CHECK(format == oldFormat);
+}
+
+static void testCases() {
+    for (size_t i = 0; i < sizeof(sCases) / sizeof(sCases[0]); i++)
+        runCase(sCases[i]);
+}
+
+//a decoder slower than the deadline, decided on what came by then
+static void testDeadline() {
+    static const video_case_t slow = {
+        "slow decoder",
+        { { 0, SIDE_BY_SIDE }, { 300, TOP_AND_BOTTOM }, { 600, SIDE_BY_SIDE }, { 900, TOP_AND_BOTTOM } }, 4,
+        { 0 }, 0,
+        0, false, 4, 1000,
+    };
+    detect_3d_config_t config = *Video3DDetector::getDefaultConfig();
+    config.sampleIntervalMs = 300;
+
+    FakeVideo video(&slow);
+    Video3DDetector detector(&config, &video);
+    detect_3d_result_t result;
+    detector.detect(&result);
+    int latencyMs = (int)(result.latencyUs / 1000);
+    printf("%-20s format:%d %s samples:%d %4dms\n", slow.name, result.format,
+        result.confirmed ? "confirmed" : "voted", result.samples, latencyMs);
+
+    //two of four is no majority
+    CHECK(result.format == 0);
+    CHECK(!result.confirmed);
+    CHECK(result.samples == 4);
+    CHECK(latencyMs >= config.deadlineMs && latencyMs < config.deadlineMs + sDelta);
+}
+
+static void testFilter() {
+    Video3DDetector detector(Video3DDetector::getDefaultConfig(), NULL);
+
+    detector.reset();
+    CHECK(!detector.addSample(0));
+    CHECK(detector.addSample(0));
+    CHECK(detector.getFormat() == 0);
+
+    detector.reset();
+    CHECK(!detector.addSample(SIDE_BY_SIDE));
+    CHECK(!detector.addSample(TOP_AND_BOTTOM));
+    CHECK(detector.addSample(TOP_AND_BOTTOM));
+    CHECK(detector.getFormat() == TOP_AND_BOTTOM);
+    //decided, later samples change nothing
+    CHECK(detector.addSample(SIDE_BY_SIDE));
+    CHECK(detector.getFormat() == TOP_AND_BOTTOM);
+
+    //no /dev/amvideo, as getVideo3DFormat() gives it
+    detector.reset();
+    CHECK(!detector.addSample(-1));
+    CHECK(detector.addSample(-1));
+    CHECK(detector.getFormat() == -1);
+
+    detector.reset();
+    const int flipping[] = { 2, 3, 2, 3, 2 };
+    for (int i = 0; i < 5; i++)
+        CHECK(detector.addSample(flipping[i]) == (i == 4));
+    CHECK(detector.getFormat() == 2);
+
+    detector.reset();
+    CHECK(detector.vote() == 0);
+    detector.addSample(2);
+    CHECK(detector.vote() == 2);
+    detector.addSample(3);
+    CHECK(detector.vote() == 0);
+}
+
+int main(int argc, char **argv) {
+    testFilter();
+    testCases();
+    testDeadline();
+
+    printf("%s\n", gFailed ? "FAILED" : "PASSED");
+    return gFailed ? 1 : 0;
+}
@@ -71,7 +71,8 @@ int isBootiniValue(const char *key) {
 
 Ubootenv::Ubootenv() :
 	mEnvInitDone(false),
-	mEnvLock(PTHREAD_MUTEX_INITIALIZER)
+	mEnvLock(PTHREAD_MUTEX_INITIALIZER),
+	mEnvDirty(false)
 {
 	init();
 }
@@ -95,6 +96,16 @@ Ubootenv::~Ubootenv()
 }
 
 int Ubootenv::updateValue(const char* name, const char* value)
+{
+	int ret = setValue(name, value);
+	if (ret <= 0)
+		return ret;
+
+	commit();
+	return 0;
+}
+
+int Ubootenv::setValue(const char* name, const char* value)
 {
 	if (!mEnvInitDone) {
 		SYS_LOGE("[ubootenv] bootenv do not init\n");
@@ -123,10 +134,19 @@ int Ubootenv::updateValue(const char* name, const char* value)
 		return 0;
 
 	mutex_lock(&mEnvLock);
-
 	set(envName, value, true);
-	save();
+	mEnvDirty = true;
+	mutex_unlock(&mEnvLock);
+	return 1;
+}
 
+int Ubootenv::commit()
+{
+	mutex_lock(&mEnvLock);
+	if (mEnvDirty) {
+		save();
+		mEnvDirty = false;
+	}
 	mutex_unlock(&mEnvLock);
 	return 0;
 }
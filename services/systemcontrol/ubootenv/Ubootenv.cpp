@@ -39,7 +39,8 @@
 const char *PROFIX_UBOOTENV_VAR = "ubootenv.var.";
 
 Ubootenv::Ubootenv() :
-    mEnvLock(MUTEX_INITIALIZER) {
+    mEnvLock(MUTEX_INITIALIZER),
+    mEnvDirty(false) {
 
     init();
 
@@ -64,6 +65,14 @@ Ubootenv::~Ubootenv() {
 }
 
 int Ubootenv::updateValue(const char* name, const char* value) {
+    int ret = setValue(name, value);
+    if (ret <= 0)
+        return ret;
+
+    return commit();
+}
+
+int Ubootenv::setValue(const char* name, const char* value) {
     if (!mEnvInitDone) {
         SYS_LOGE("[ubootenv] bootenv do not init\n");
         return -1;
@@ -92,6 +101,18 @@ int Ubootenv::updateValue(const char* name, const char* value) {
 
     mutex_lock(&mEnvLock);
     set(envName, value, true);
+    mEnvDirty = true;
+    mutex_unlock(&mEnvLock);
+
+    return 1;
+}
+
+int Ubootenv::commit() {
+    mutex_lock(&mEnvLock);
+    if (!mEnvDirty) {
+        mutex_unlock(&mEnvLock);
+        return 0;
+    }
 
     int i = 0;
     int ret = -1;
@@ -105,6 +126,8 @@ int Ubootenv::updateValue(const char* name, const char* value) {
     if (i < MAX_UBOOT_RWRETRY) {
         SYS_LOGI("[ubootenv] Save ubootenv to %s succeed!\n", mEnvPartitionName);
     }
+    if (ret >= 0)
+        mEnvDirty = false;
 
     mutex_unlock(&mEnvLock);
 
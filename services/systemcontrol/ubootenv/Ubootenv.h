@@ -53,6 +53,10 @@ public:
     int reInit();
     const char * getValue(const char * key);
     int updateValue(const char* name, const char* value);
+    //change the value in memory only, 1 when it changed, commit() saves it
+    int setValue(const char* name, const char* value);
+    //save the values set since the last save, one partition write for all of them
+    int commit();
     void printValues();
 
 private:
@@ -90,6 +94,7 @@ private:
     mutex_t mEnvLock;
 #endif
     bool mEnvInitDone;
+    bool mEnvDirty;
 };
 
 #if defined(ODROID)